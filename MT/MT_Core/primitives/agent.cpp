@@ -16,8 +16,11 @@
 
 // #include "types.h"
 
-// Carefully include OpenGL
-#if defined(__APPLE__) || defined(MACOSX) && !(defined NO_GL)
+// Carefully include OpenGL (not at all in a headless build)
+#ifdef MT_NO_GL
+#define NO_GL
+#endif
+#if (defined(__APPLE__) || defined(MACOSX)) && !(defined NO_GL)
 #include <OpenGL/gl.h>
 // #include <GLUT/glut.h>
 #elif !(defined NO_GL)
@@ -1,6 +1,7 @@
 #include "BiCC.h"
 
 #include <algorithm>
+#include <stdio.h>
 
 unsigned int MT_BiCC::getNumberOfLabels(const std::vector<unsigned int>& labels)
 {
@@ -98,6 +99,110 @@ int MT_BiCC::findComponents(const std::vector<unsigned int>& adj_sub)
     return m_iCurrentLabel;
 }
 
+int MT_BiCC::findComponents(const std::vector<MT_BiCCEdge>& edges)
+{
+    unsigned int n_edges = edges.size();
+
+    m_vuiLabelMatrix.assign(m_iNRows*m_iNCols, 0);
+    m_vuiLabelVector.assign(m_iNRows + m_iNCols, 0);
+    m_iCurrentLabel = 0;
+
+    /* bucket the edges by row and by column */
+    m_vuiRowStart.assign(m_iNRows + 1, 0);
+    m_vuiColStart.assign(m_iNCols + 1, 0);
+    for(unsigned int e = 0; e < n_edges; e++)
+    {
+        if(edges[e].first >= m_iNRows || edges[e].second >= m_iNCols)
+        {
+            fprintf(stderr, "MT_BiCC::findComponents Error:  Edge (%d, %d) "
+                    "is out of range and will be ignored.\n",
+                    (int) edges[e].first, (int) edges[e].second);
+            continue;
+        }
+        m_vuiRowStart[edges[e].first + 1]++;
+        m_vuiColStart[edges[e].second + 1]++;
+    }
+    for(unsigned int i = 0; i < m_iNRows; i++)
+    {
+        m_vuiRowStart[i + 1] += m_vuiRowStart[i];
+    }
+    for(unsigned int j = 0; j < m_iNCols; j++)
+    {
+        m_vuiColStart[j + 1] += m_vuiColStart[j];
+    }
+    m_vuiRowEdges.resize(m_vuiRowStart[m_iNRows]);
+    m_vuiColEdges.resize(m_vuiColStart[m_iNCols]);
+    {
+        std::vector<unsigned int> row_fill(m_vuiRowStart.begin(),
+                                           m_vuiRowStart.end() - 1);
+        std::vector<unsigned int> col_fill(m_vuiColStart.begin(),
+                                           m_vuiColStart.end() - 1);
+        for(unsigned int e = 0; e < n_edges; e++)
+        {
+            if(edges[e].first >= m_iNRows || edges[e].second >= m_iNCols)
+            {
+                continue;
+            }
+            m_vuiRowEdges[row_fill[edges[e].first]++] = e;
+            m_vuiColEdges[col_fill[edges[e].second]++] = e;
+        }
+    }
+
+    /* The dense version starts a new label at each row that is not
+     * already part of a component (including rows with no edges), in
+     * row order, then labels the leftover columns in column order.
+     * Doing a search from each unlabeled row in the same order gives
+     * the same labels. Nodes are numbered as in the label vector:
+     * rows first, then columns. */
+    for(unsigned int i = 0; i < m_iNRows; i++)
+    {
+        if(m_vuiLabelVector[i] != 0)
+        {
+            continue;
+        }
+
+        m_iCurrentLabel++;
+        m_vuiLabelVector[i] = m_iCurrentLabel;
+        m_vuiStack.resize(0);
+        m_vuiStack.push_back(i);
+
+        while(m_vuiStack.size())
+        {
+            unsigned int k = m_vuiStack.back();
+            m_vuiStack.pop_back();
+
+            const std::vector<unsigned int>& start =
+                (k < m_iNRows) ? m_vuiRowStart : m_vuiColStart;
+            const std::vector<unsigned int>& list =
+                (k < m_iNRows) ? m_vuiRowEdges : m_vuiColEdges;
+            unsigned int n = (k < m_iNRows) ? k : k - m_iNRows;
+
+            for(unsigned int q = start[n]; q < start[n + 1]; q++)
+            {
+                const MT_BiCCEdge& edge = edges[list[q]];
+                m_vuiLabelMatrix[edge.first*m_iNCols + edge.second] = m_iCurrentLabel;
+                unsigned int other = (k < m_iNRows) ?
+                    m_iNRows + edge.second : edge.first;
+                if(m_vuiLabelVector[other] == 0)
+                {
+                    m_vuiLabelVector[other] = m_iCurrentLabel;
+                    m_vuiStack.push_back(other);
+                }
+            }
+        }
+    }
+
+    for(unsigned int j = 0; j < m_iNCols; j++)
+    {
+        if(m_vuiLabelVector[m_iNRows + j] == 0)
+        {
+            m_vuiLabelVector[m_iNRows + j] = ++m_iCurrentLabel;
+        }
+    }
+
+    return m_iCurrentLabel;
+}
+
 void MT_BiCC::followCol(unsigned int j)
 {
     for(unsigned int i = 0; i < m_iNRows; i++)
@@ -4,6 +4,11 @@
 /* Bivariate connected component solver */
 
 #include <vector>
+#include <utility>
+
+/* (row, col) pair of adjacent elements, for the sparse version of
+ * findComponents */
+typedef std::pair<unsigned int, unsigned int> MT_BiCCEdge;
 
 class MT_BiCC
 {
@@ -13,6 +18,10 @@ public:
     void doInit(unsigned int rows, unsigned int cols);
 
     int findComponents(const std::vector<unsigned int>& adj_sub);
+    /* same labeling as above, but the adjacency is given as a list of
+     * (row, col) edges instead of a dense rows x cols matrix.
+     * Duplicate edges are allowed. */
+    int findComponents(const std::vector<MT_BiCCEdge>& edges);
     std::vector<unsigned int> getLabelMatrix(){ return m_vuiLabelMatrix; };
     std::vector<unsigned int> getLabelVector(){ return m_vuiLabelVector; };
 
@@ -29,6 +38,14 @@ private:
     std::vector<unsigned int> m_vuiLabelVector;
     std::vector<unsigned int> m_vuiAdj;
 
+    /* workspace for the sparse version:  edges sorted by row and by
+     * column (compressed), plus a stack for the search */
+    std::vector<unsigned int> m_vuiRowStart;
+    std::vector<unsigned int> m_vuiRowEdges;
+    std::vector<unsigned int> m_vuiColStart;
+    std::vector<unsigned int> m_vuiColEdges;
+    std::vector<unsigned int> m_vuiStack;
+
     unsigned int m_iNRows;
     unsigned int m_iNCols;
     unsigned int m_iCurrentLabel;
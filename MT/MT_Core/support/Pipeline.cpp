@@ -0,0 +1,313 @@
+/*
+ *  Pipeline.cpp
+ *  MADTraC
+ *
+ *  See Pipeline.h
+ *
+ */
+
+#include "Pipeline.h"
+
+#include <stdio.h>
+#include <deque>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+typedef CRITICAL_SECTION MT_PL_mutex;
+typedef CONDITION_VARIABLE MT_PL_cond;
+typedef HANDLE MT_PL_thread;
+#else
+#include <pthread.h>
+typedef pthread_mutex_t MT_PL_mutex;
+typedef pthread_cond_t MT_PL_cond;
+typedef pthread_t MT_PL_thread;
+#endif
+
+struct MT_PipelineImpl
+{
+    /* one lock for everything - there are only a handful of items per
+     * frame, so there's little to gain from finer locking */
+    MT_PL_mutex mutex;
+    MT_PL_cond cond;        /* any queue changed (or quit) */
+
+    std::vector<MT_PipelineStage*> stages;
+    std::vector<MT_PL_thread> threads;
+
+    /* queues[k] is in front of stage k, all protected by mutex */
+    std::vector<std::deque<void*> > queues;
+    std::deque<void*> output;
+    unsigned int queue_size;
+    int n_in_flight;        /* pushed but not popped */
+    bool running;
+    bool quit;
+    unsigned int n_stopped; /* threads that have quit, they quit in order */
+};
+
+/* argument for each thread */
+typedef struct
+{
+    MT_PipelineImpl* impl;
+    unsigned int stage;
+} MT_PipelineThreadArg;
+
+#ifdef _WIN32
+
+static void pl_init(MT_PipelineImpl* p)
+{
+    InitializeCriticalSection(&p->mutex);
+    InitializeConditionVariable(&p->cond);
+}
+static void pl_destroy(MT_PipelineImpl* p)
+{
+    DeleteCriticalSection(&p->mutex);
+}
+static void pl_lock(MT_PipelineImpl* p){EnterCriticalSection(&p->mutex);}
+static void pl_unlock(MT_PipelineImpl* p){LeaveCriticalSection(&p->mutex);}
+static void pl_wait(MT_PipelineImpl* p)
+{
+    SleepConditionVariableCS(&p->cond, &p->mutex, INFINITE);
+}
+static void pl_broadcast(MT_PipelineImpl* p){WakeAllConditionVariable(&p->cond);}
+
+#else
+
+static void pl_init(MT_PipelineImpl* p)
+{
+    pthread_mutex_init(&p->mutex, NULL);
+    pthread_cond_init(&p->cond, NULL);
+}
+static void pl_destroy(MT_PipelineImpl* p)
+{
+    pthread_cond_destroy(&p->cond);
+    pthread_mutex_destroy(&p->mutex);
+}
+static void pl_lock(MT_PipelineImpl* p){pthread_mutex_lock(&p->mutex);}
+static void pl_unlock(MT_PipelineImpl* p){pthread_mutex_unlock(&p->mutex);}
+static void pl_wait(MT_PipelineImpl* p){pthread_cond_wait(&p->cond, &p->mutex);}
+static void pl_broadcast(MT_PipelineImpl* p){pthread_cond_broadcast(&p->cond);}
+
+#endif
+
+static void pl_thread_main(MT_PipelineThreadArg* arg)
+{
+    MT_PipelineImpl* p = arg->impl;
+    unsigned int k = arg->stage;
+    delete arg;
+
+    MT_PipelineStage* stage = p->stages[k];
+    bool last = (k + 1 == p->stages.size());
+
+    pl_lock(p);
+    for(;;)
+    {
+        /* stage k - 1 may still hand us items until it has quit */
+        while(p->queues[k].empty() && !(p->quit && p->n_stopped == k))
+        {
+            pl_wait(p);
+        }
+        if(p->queues[k].empty())
+        {
+            break;
+        }
+        void* item = p->queues[k].front();
+        p->queues[k].pop_front();
+        /* there's room in front of us now */
+        pl_broadcast(p);
+        pl_unlock(p);
+
+        stage->process(item);
+
+        pl_lock(p);
+        if(last)
+        {
+            p->output.push_back(item);
+        }
+        else
+        {
+            while(p->queues[k + 1].size() >= p->queue_size)
+            {
+                pl_wait(p);
+            }
+            p->queues[k + 1].push_back(item);
+        }
+        pl_broadcast(p);
+    }
+    p->n_stopped++;
+    pl_broadcast(p);
+    pl_unlock(p);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI pl_thread_entry(LPVOID arg)
+{
+    pl_thread_main((MT_PipelineThreadArg*) arg);
+    return 0;
+}
+#else
+static void* pl_thread_entry(void* arg)
+{
+    pl_thread_main((MT_PipelineThreadArg*) arg);
+    return NULL;
+}
+#endif
+
+MT_Pipeline::MT_Pipeline(int queue_size)
+{
+    m_pImpl = new MT_PipelineImpl;
+    MT_PipelineImpl* p = m_pImpl;
+    pl_init(p);
+    p->queue_size = (queue_size > 0) ? queue_size : 1;
+    p->n_in_flight = 0;
+    p->running = false;
+    p->quit = false;
+    p->n_stopped = 0;
+}
+
+MT_Pipeline::~MT_Pipeline()
+{
+    finish();
+    pl_destroy(m_pImpl);
+    delete m_pImpl;
+}
+
+void MT_Pipeline::addStage(MT_PipelineStage* stage)
+{
+    if(m_pImpl->running || !stage)
+    {
+        fprintf(stderr, "MT_Pipeline Error:  Stages must be added before start\n");
+        return;
+    }
+    m_pImpl->stages.push_back(stage);
+}
+
+int MT_Pipeline::getNumStages() const
+{
+    return m_pImpl->stages.size();
+}
+
+bool MT_Pipeline::start()
+{
+    MT_PipelineImpl* p = m_pImpl;
+    if(p->running)
+    {
+        return true;
+    }
+
+    p->queues.resize(p->stages.size());
+    p->quit = false;
+    p->n_stopped = 0;
+    p->running = true;
+    for(unsigned int k = 0; k < p->stages.size(); k++)
+    {
+        MT_PipelineThreadArg* arg = new MT_PipelineThreadArg;
+        arg->impl = p;
+        arg->stage = k;
+        MT_PL_thread t;
+#ifdef _WIN32
+        t = CreateThread(NULL, 0, pl_thread_entry, arg, 0, NULL);
+        bool ok = (t != NULL);
+#else
+        bool ok = (pthread_create(&t, NULL, pl_thread_entry, arg) == 0);
+#endif
+        if(!ok)
+        {
+            fprintf(stderr, "MT_Pipeline Error:  Could not start a thread for stage %d\n", k);
+            delete arg;
+            finish();
+            return false;
+        }
+        p->threads.push_back(t);
+    }
+    return true;
+}
+
+void MT_Pipeline::push(void* item)
+{
+    MT_PipelineImpl* p = m_pImpl;
+
+    if(!p->running)
+    {
+        /* not started, or couldn't be - run the stages right here */
+        for(unsigned int k = 0; k < p->stages.size(); k++)
+        {
+            p->stages[k]->process(item);
+        }
+        p->output.push_back(item);
+        p->n_in_flight++;
+        return;
+    }
+
+    pl_lock(p);
+    p->n_in_flight++;
+    if(p->stages.empty())
+    {
+        p->output.push_back(item);
+    }
+    else
+    {
+        while(p->queues[0].size() >= p->queue_size)
+        {
+            pl_wait(p);
+        }
+        p->queues[0].push_back(item);
+    }
+    pl_broadcast(p);
+    pl_unlock(p);
+}
+
+void* MT_Pipeline::pop()
+{
+    MT_PipelineImpl* p = m_pImpl;
+
+    pl_lock(p);
+    void* item = NULL;
+    if(p->n_in_flight > 0)
+    {
+        while(p->output.empty())
+        {
+            pl_wait(p);
+        }
+        item = p->output.front();
+        p->output.pop_front();
+        p->n_in_flight--;
+    }
+    pl_unlock(p);
+    return item;
+}
+
+int MT_Pipeline::getNumInFlight() const
+{
+    pl_lock(m_pImpl);
+    int n = m_pImpl->n_in_flight;
+    pl_unlock(m_pImpl);
+    return n;
+}
+
+void MT_Pipeline::finish()
+{
+    MT_PipelineImpl* p = m_pImpl;
+    if(!p->running)
+    {
+        return;
+    }
+
+    /* each thread quits once the one before it has and its own queue
+     * is empty, so everything pushed so far makes it to the output */
+    pl_lock(p);
+    p->quit = true;
+    pl_broadcast(p);
+    pl_unlock(p);
+
+    for(unsigned int k = 0; k < p->threads.size(); k++)
+    {
+#ifdef _WIN32
+        WaitForSingleObject(p->threads[k], INFINITE);
+        CloseHandle(p->threads[k]);
+#else
+        pthread_join(p->threads[k], NULL);
+#endif
+    }
+    p->threads.resize(0);
+    p->running = false;
+}
@@ -0,0 +1,78 @@
+#ifndef MT_PIPELINE_H
+#define MT_PIPELINE_H
+
+/*
+ *  Pipeline.h
+ *  MADTraC
+ *
+ *  A chain of stages, each on its own thread, connected by bounded
+ *  queues.  Uses pthreads, or native threads on Windows.
+ *
+ *  Usage:  derive from MT_PipelineStage for each step, add the stages
+ *  in order, then start the pipeline and push items into it.  Each
+ *  item goes through every stage in turn and comes out of pop.  Since
+ *  every stage is one thread and every queue is first in first out,
+ *  items come out in the order they were pushed and each stage sees
+ *  them in that order, so a stage can keep state from one item to
+ *  the next.  While stage k works on item n, stage k - 1 can already
+ *  work on item n + 1, so the throughput approaches that of the
+ *  slowest stage rather than the sum over all of them.
+ *
+ *  push blocks while the first queue is full, so a fast source can
+ *  get at most (queue_size + 1) items ahead of each stage.
+ *
+ */
+
+class MT_PipelineStage
+{
+public:
+    virtual ~MT_PipelineStage(){};
+
+    /* Called on the stage's thread for each item, in order. */
+    virtual void process(void* item) = 0;
+};
+
+struct MT_PipelineImpl;
+
+class MT_Pipeline
+{
+public:
+    /* queue_size items can wait in front of each stage */
+    MT_Pipeline(int queue_size = 2);
+    /* waits for the items in flight, see finish */
+    ~MT_Pipeline();
+
+    /* The stages are not owned.  All stages have to be added before
+     * start. */
+    void addStage(MT_PipelineStage* stage);
+    int getNumStages() const;
+
+    /* Starts one thread per stage.  Returns false if a thread could
+     * not be started, in which case the pipeline can't be used. */
+    bool start();
+
+    /* Hands item to the first stage.  Blocks while the queue in front
+     * of it is full. */
+    void push(void* item);
+
+    /* Returns the next item out of the last stage, waiting for it if
+     * necessary.  Returns NULL if no items are in flight. */
+    void* pop();
+
+    /* Number of items pushed but not yet popped */
+    int getNumInFlight() const;
+
+    /* Waits for the items in flight to go through every stage and
+     * stops the threads.  Items not yet popped can still be popped
+     * afterwards. */
+    void finish();
+
+private:
+    /* not copyable */
+    MT_Pipeline(const MT_Pipeline&);
+    MT_Pipeline& operator=(const MT_Pipeline&);
+
+    MT_PipelineImpl* m_pImpl;
+};
+
+#endif // MT_PIPELINE_H
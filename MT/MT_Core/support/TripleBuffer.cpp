@@ -0,0 +1,82 @@
+/*
+ *  TripleBuffer.cpp
+ *  MADTraC
+ *
+ *  See TripleBuffer.h
+ *
+ */
+
+#include "TripleBuffer.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+/* set in m_lMiddle when the middle slot holds something the reader
+ * hasn't taken yet */
+const long MT_TB_NEW = 4;
+const long MT_TB_INDEX = 3;
+
+/* Atomic exchange and load, each a full barrier, so that whatever the
+ * writer put in its slot is visible to the reader once it sees the
+ * slot in the middle. */
+#ifdef _WIN32
+
+static long tb_exchange(volatile long* p, long v)
+{
+    return InterlockedExchange((volatile LONG*) p, v);
+}
+static long tb_load(volatile long* p)
+{
+    return InterlockedCompareExchange((volatile LONG*) p, 0, 0);
+}
+
+#else
+
+static long tb_exchange(volatile long* p, long v)
+{
+    /* __sync_lock_test_and_set is only an acquire barrier */
+    __sync_synchronize();
+    return __sync_lock_test_and_set(p, v);
+}
+static long tb_load(volatile long* p)
+{
+    return __sync_fetch_and_add(p, 0);
+}
+
+#endif
+
+MT_TripleBuffer::MT_TripleBuffer()
+{
+    reset();
+}
+
+void MT_TripleBuffer::reset()
+{
+    m_iWrite = 0;
+    m_lMiddle = 1;
+    m_iRead = 2;
+}
+
+int MT_TripleBuffer::publish()
+{
+    m_iWrite = tb_exchange(&m_lMiddle, m_iWrite | MT_TB_NEW) & MT_TB_INDEX;
+    return m_iWrite;
+}
+
+bool MT_TripleBuffer::update()
+{
+    if(!(tb_load(&m_lMiddle) & MT_TB_NEW))
+    {
+        return false;
+    }
+    /* only the writer changes the middle slot otherwise, and it can
+     * only make it newer */
+    m_iRead = tb_exchange(&m_lMiddle, m_iRead) & MT_TB_INDEX;
+    return true;
+}
+
+bool MT_TripleBuffer::getHasNew() const
+{
+    return (tb_load((volatile long*) &m_lMiddle) & MT_TB_NEW) != 0;
+}
@@ -0,0 +1,63 @@
+#ifndef MT_TRIPLEBUFFER_H
+#define MT_TRIPLEBUFFER_H
+
+/*
+ *  TripleBuffer.h
+ *  MADTraC
+ *
+ *  Lock-free handoff of the latest result from one thread (the
+ *  writer) to another (the reader), e.g. from a tracking thread to
+ *  the GUI.  Neither side ever waits for the other.
+ *
+ *  Usage:  keep three slots of whatever is handed off, e.g.
+ *  Result results[3].  The writer fills
+ *  results[getWriteIndex()] and calls publish.  The reader calls
+ *  update and uses results[getReadIndex()].  Each side owns its slot
+ *  until its next publish / update, and the third slot holds the most
+ *  recently published one.  Results the reader didn't get to in time
+ *  are skipped, so the writer can run faster or slower than the
+ *  reader.
+ *
+ *  Only one thread may write and only one may read.
+ *
+ */
+
+class MT_TripleBuffer
+{
+public:
+    MT_TripleBuffer();
+
+    /* Writer side:  the slot to fill next. */
+    int getWriteIndex() const {return m_iWrite;};
+    /* Hands the write slot to the reader and returns the new write
+     * slot. */
+    int publish();
+
+    /* Reader side:  the slot holding the result last taken by
+     * update. */
+    int getReadIndex() const {return m_iRead;};
+    /* Takes the most recently published result, if there is one the
+     * reader hasn't seen yet.  Returns true if the read slot
+     * changed. */
+    bool update();
+
+    /* True if something was published since the last update. */
+    bool getHasNew() const;
+
+    /* Drops anything published and not read yet.  Only call this when
+     * neither side is in use, e.g. before starting the writer
+     * thread. */
+    void reset();
+
+private:
+    /* not copyable */
+    MT_TripleBuffer(const MT_TripleBuffer&);
+    MT_TripleBuffer& operator=(const MT_TripleBuffer&);
+
+    /* index of the middle slot, and whether it's new */
+    volatile long m_lMiddle;
+    int m_iWrite;
+    int m_iRead;
+};
+
+#endif // MT_TRIPLEBUFFER_H
@@ -0,0 +1,670 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "UKFBatch.h"
+
+/* Everything here loops over the objects innermost, i.e. over
+ * consecutive doubles, so that the compiler can vectorize it. */
+
+static void alloc_array(double** a, unsigned int size)
+{
+    free(*a);
+    *a = (double *) malloc((size ? size : 1)*sizeof(double));
+    if(!*a)
+    {
+        fprintf(stderr, "MT_UKFBatch Error:  Could not allocate memory.\n");
+    }
+}
+
+/* L = chol(A) for one small matrix, with the same safeguards as
+ * MT_Cholesky */
+static void cholesky_single(const double* A, double* L, unsigned int R)
+{
+    for(unsigned int i = 0; i < R*R; i++)
+    {
+        L[i] = 0;
+    }
+    for(unsigned int i = 0; i < R; i++)
+    {
+        for(unsigned int j = 0; j <= i; j++)
+        {
+            double p = A[i*R + j];
+            for(unsigned int k = 0; k < j; k++)
+            {
+                p -= L[i*R + k]*L[j*R + k];
+            }
+            if(i == j)
+            {
+                if(p < 0)
+                {
+                    p = fabs(p);
+                }
+                if(p == 0)
+                {
+                    p = 1e-6;
+                }
+                L[i*R + i] = sqrt(p);
+            }
+            else
+            {
+                L[i*R + j] = p/L[j*R + j];
+            }
+        }
+    }
+}
+
+/* L = chol(A) for each of N matrices (R x R) in the batch layout */
+static void cholesky_batch(const double* A, double* L,
+                           unsigned int R, unsigned int N)
+{
+    for(unsigned int i = 0; i < R; i++)
+    {
+        for(unsigned int j = 0; j <= i; j++)
+        {
+            double* Lij = L + (i*R + j)*N;
+            const double* Aij = A + (i*R + j)*N;
+            for(unsigned int o = 0; o < N; o++)
+            {
+                Lij[o] = Aij[o];
+            }
+            for(unsigned int k = 0; k < j; k++)
+            {
+                const double* Lik = L + (i*R + k)*N;
+                const double* Ljk = L + (j*R + k)*N;
+                for(unsigned int o = 0; o < N; o++)
+                {
+                    Lij[o] -= Lik[o]*Ljk[o];
+                }
+            }
+            if(i == j)
+            {
+                for(unsigned int o = 0; o < N; o++)
+                {
+                    double p = fabs(Lij[o]);
+                    Lij[o] = sqrt((p == 0) ? 1e-6 : p);
+                }
+            }
+            else
+            {
+                const double* Ljj = L + (j*R + j)*N;
+                for(unsigned int o = 0; o < N; o++)
+                {
+                    Lij[o] /= Ljj[o];
+                }
+            }
+        }
+    }
+}
+
+/* y = sum_s W[s]*Y(:, s) for each object and row of Y (rows x
+ * n_sigma*N), then D = Y - y, then C = D*diag(Wc)*D' (rows x rows) */
+static void unscented_mean_cov(const double* Y, double* y, double* D, double* C,
+                               const double* Wm, const double* Wc,
+                               unsigned int rows, unsigned int n_sigma,
+                               unsigned int N)
+{
+    unsigned int NP = n_sigma*N;
+    for(unsigned int i = 0; i < rows; i++)
+    {
+        double* yi = y + i*N;
+        for(unsigned int o = 0; o < N; o++)
+        {
+            yi[o] = 0;
+        }
+        for(unsigned int s = 0; s < n_sigma; s++)
+        {
+            const double* Yis = Y + i*NP + s*N;
+            double w = Wm[s];
+            for(unsigned int o = 0; o < N; o++)
+            {
+                yi[o] += Yis[o]*w;
+            }
+        }
+        for(unsigned int s = 0; s < n_sigma; s++)
+        {
+            const double* Yis = Y + i*NP + s*N;
+            double* Dis = D + i*NP + s*N;
+            for(unsigned int o = 0; o < N; o++)
+            {
+                Dis[o] = Yis[o] - yi[o];
+            }
+        }
+    }
+
+    for(unsigned int i = 0; i < rows; i++)
+    {
+        for(unsigned int j = 0; j <= i; j++)
+        {
+            double* Cij = C + (i*rows + j)*N;
+            for(unsigned int o = 0; o < N; o++)
+            {
+                Cij[o] = 0;
+            }
+            for(unsigned int s = 0; s < n_sigma; s++)
+            {
+                const double* Dis = D + i*NP + s*N;
+                const double* Djs = D + j*NP + s*N;
+                double w = Wc[s];
+                for(unsigned int o = 0; o < N; o++)
+                {
+                    Cij[o] += w*Dis[o]*Djs[o];
+                }
+            }
+            if(i != j)
+            {
+                memcpy(C + (j*rows + i)*N, Cij, N*sizeof(double));
+            }
+        }
+    }
+}
+
+MT_UKFBatch_struct* MT_UKFBatchInit(unsigned int num_objects,
+                                    unsigned int n_states,
+                                    unsigned int n_meas,
+                                    unsigned int n_inputs,
+                                    double alpha,
+                                    double k,
+                                    double beta)
+{
+    MT_UKFBatch_struct* pB = (MT_UKFBatch_struct *) calloc(1, sizeof(MT_UKFBatch_struct));
+    if(!pB)
+    {
+        fprintf(stderr, "MT_UKFBatchInit Error:  Could not allocate MT_UKFBatch_struct.\n");
+        return NULL;
+    }
+
+    pB->N = num_objects;
+    pB->n = n_states;
+    pB->m = n_meas;
+    pB->n_u = n_inputs;
+
+    pB->alpha = alpha;
+    pB->k = k;
+    pB->beta = beta;
+
+    unsigned int N = pB->N;
+    unsigned int n = pB->n;
+
+    alloc_array(&(pB->x), n*N);
+    alloc_array(&(pB->x1), n*N);
+    alloc_array(&(pB->P), n*n*N);
+    alloc_array(&(pB->u), pB->n_u*N);
+    alloc_array(&(pB->z), pB->m*N);
+    pB->have_measurement = (unsigned char *) calloc(N ? N : 1, 1);
+
+    memset(pB->x, 0, n*N*sizeof(double));
+    memset(pB->x1, 0, n*N*sizeof(double));
+    memset(pB->u, 0, pB->n_u*N*sizeof(double));
+    memset(pB->z, 0, pB->m*N*sizeof(double));
+    for(unsigned int r = 0; r < n; r++)
+    {
+        for(unsigned int c = 0; c < n; c++)
+        {
+            double v = (r == c) ? 1.0 : 0.0;
+            for(unsigned int o = 0; o < N; o++)
+            {
+                pB->P[(r*n + c)*N + o] = v;
+            }
+        }
+    }
+
+    return pB;
+}
+
+void MT_UKFBatchCopyQR(MT_UKFBatch_struct* pB,
+                       const double* Q,
+                       unsigned int n_q,
+                       const double* R,
+                       unsigned int n_r)
+{
+    if(!Q || !R || n_r != pB->m)
+    {
+        fprintf(stderr,
+                "MT_UKFBatchCopyQR Error:  Q or R is uninitialized, or R is "
+                "not the size of the measurement\n");
+        return;
+    }
+
+    unsigned int N = pB->N;
+    unsigned int n = pB->n;
+    unsigned int m = pB->m;
+
+    pB->n_q = n_q;
+    pB->n_r = n_r;
+    pB->n_aug = n + n_q + n_r;
+    pB->n_sigma = 2*pB->n_aug + 1;
+    unsigned int NP = pB->n_sigma*N;
+
+    alloc_array(&(pB->Q), n_q*n_q);
+    memcpy(pB->Q, Q, n_q*n_q*sizeof(double));
+    alloc_array(&(pB->R), n_r*n_r);
+    memcpy(pB->R, R, n_r*n_r*sizeof(double));
+
+    pB->lambda = (pB->alpha)*(pB->alpha)*((double) (pB->n_aug) + pB->k)
+        - pB->n_aug;
+    pB->c = pB->lambda + (double) (pB->n_aug);
+    double c = pB->c;
+    if(c <= 0)
+    {
+        fprintf(stderr, "MT_UKFBatchCopyQR Error:  c must be > 0\n");
+    }
+
+    alloc_array(&(pB->Wm), pB->n_sigma);
+    alloc_array(&(pB->Wc), pB->n_sigma);
+    for(unsigned int s = 0; s < pB->n_sigma; s++)
+    {
+        pB->Wm[s] = pB->Wc[s] = 0.5/c;
+    }
+    pB->Wm[0] = pB->lambda/c;
+    pB->Wc[0] = pB->lambda/c + 1 - (pB->alpha)*(pB->alpha) + pB->beta;
+
+    /* Q and R are the same for every object and P_aug is block
+     * diagonal, so their part of chol(P_aug) only needs doing once */
+    alloc_array(&(pB->LQ), n_q*n_q);
+    cholesky_single(pB->Q, pB->LQ, n_q);
+    alloc_array(&(pB->LR), n_r*n_r);
+    cholesky_single(pB->R, pB->LR, n_r);
+    double sc = sqrt(c);
+    for(unsigned int i = 0; i < n_q*n_q; i++)
+    {
+        pB->LQ[i] *= sc;
+    }
+    for(unsigned int i = 0; i < n_r*n_r; i++)
+    {
+        pB->LR[i] *= sc;
+    }
+
+    alloc_array(&(pB->K), n*m*N);
+    alloc_array(&(pB->L), n*n*N);
+    alloc_array(&(pB->X_aug), pB->n_aug*NP);
+    alloc_array(&(pB->U), pB->n_u*NP);
+    alloc_array(&(pB->X1), n*NP);
+    alloc_array(&(pB->X2), n*NP);
+    alloc_array(&(pB->Z), m*NP);
+    alloc_array(&(pB->Z2), m*NP);
+    alloc_array(&(pB->z1), m*N);
+    alloc_array(&(pB->P1), n*n*N);
+    alloc_array(&(pB->P2), m*m*N);
+    alloc_array(&(pB->P12), n*m*N);
+    alloc_array(&(pB->L2), m*m*N);
+}
+
+void MT_UKFBatchSetState(MT_UKFBatch_struct* pB,
+                         unsigned int obj,
+                         const double* x_set)
+{
+    if(!x_set || obj >= pB->N)
+    {
+        fprintf(stderr,
+                "MT_UKFBatchSetState Error:  x_set is not initialized "
+                "or object %d is out of range\n", obj);
+        return;
+    }
+    for(unsigned int i = 0; i < pB->n; i++)
+    {
+        pB->x[i*pB->N + obj] = x_set[i];
+    }
+}
+
+void MT_UKFBatchSetCovariance(MT_UKFBatch_struct* pB,
+                              unsigned int obj,
+                              const double* P_set)
+{
+    if(!P_set || obj >= pB->N)
+    {
+        fprintf(stderr,
+                "MT_UKFBatchSetCovariance Error:  P_set is not initialized "
+                "or object %d is out of range\n", obj);
+        return;
+    }
+    for(unsigned int i = 0; i < pB->n*pB->n; i++)
+    {
+        pB->P[i*pB->N + obj] = P_set[i];
+    }
+}
+
+void MT_UKFBatchSetInput(MT_UKFBatch_struct* pB,
+                         unsigned int obj,
+                         const double* u_set)
+{
+    if(!u_set || obj >= pB->N)
+    {
+        fprintf(stderr,
+                "MT_UKFBatchSetInput Error:  u_set is not initialized "
+                "or object %d is out of range\n", obj);
+        return;
+    }
+    for(unsigned int i = 0; i < pB->n_u; i++)
+    {
+        pB->u[i*pB->N + obj] = u_set[i];
+    }
+}
+
+void MT_UKFBatchSetMeasurement(MT_UKFBatch_struct* pB,
+                               unsigned int obj,
+                               const double* z_set)
+{
+    if(!z_set || obj >= pB->N)
+    {
+        fprintf(stderr,
+                "MT_UKFBatchSetMeasurement Error:  z_set is not initialized "
+                "or object %d is out of range\n", obj);
+        return;
+    }
+    for(unsigned int i = 0; i < pB->m; i++)
+    {
+        pB->z[i*pB->N + obj] = z_set[i];
+    }
+    pB->have_measurement[obj] = 1;
+}
+
+void MT_UKFBatchGetState(const MT_UKFBatch_struct* pB,
+                         unsigned int obj,
+                         double* x_get)
+{
+    for(unsigned int i = 0; i < pB->n; i++)
+    {
+        x_get[i] = pB->x[i*pB->N + obj];
+    }
+}
+
+void MT_UKFBatchGetPrediction(const MT_UKFBatch_struct* pB,
+                              unsigned int obj,
+                              double* x1_get)
+{
+    for(unsigned int i = 0; i < pB->n; i++)
+    {
+        x1_get[i] = pB->x1[i*pB->N + obj];
+    }
+}
+
+void MT_UKFBatchGetCovariance(const MT_UKFBatch_struct* pB,
+                              unsigned int obj,
+                              double* P_get)
+{
+    for(unsigned int i = 0; i < pB->n*pB->n; i++)
+    {
+        P_get[i] = pB->P[i*pB->N + obj];
+    }
+}
+
+void MT_UKFBatchPredict(MT_UKFBatch_struct* pB,
+                        MT_UKFBatchStateTxfm f,
+                        MT_UKFBatchMeasTxfm h)
+{
+    if(!pB->X_aug)
+    {
+        fprintf(stderr,
+                "MT_UKFBatchPredict Error:  Q and R not initialized.  "
+                "Call MT_UKFBatchCopyQR.\n");
+        return;
+    }
+
+    unsigned int N = pB->N;
+    unsigned int n = pB->n;
+    unsigned int n_q = pB->n_q;
+    unsigned int n_r = pB->n_r;
+    unsigned int n_aug = pB->n_aug;
+    unsigned int n_sigma = pB->n_sigma;
+    unsigned int NP = n_sigma*N;
+    double sc = sqrt(pB->c);
+
+    /* A = sqrt(c)*chol(P_aug)', P_aug = blockdiag(P, Q, R) */
+    cholesky_batch(pB->P, pB->L, n, N);
+
+    /* X_aug = [x Y+A Y-A], x_aug = [x; 0; 0].  Sigma point s of
+     * object o is column s*N + o. */
+    memset(pB->X_aug, 0, n_aug*NP*sizeof(double));
+    for(unsigned int i = 0; i < n; i++)
+    {
+        const double* xi = pB->x + i*N;
+        double* Xi = pB->X_aug + i*NP;
+        for(unsigned int s = 0; s < n_sigma; s++)
+        {
+            memcpy(Xi + s*N, xi, N*sizeof(double));
+        }
+        for(unsigned int j = 0; j <= i; j++)
+        {
+            const double* Lij = pB->L + (i*n + j)*N;
+            double* Xp = Xi + (1 + j)*N;
+            double* Xm = Xi + (1 + n_aug + j)*N;
+            for(unsigned int o = 0; o < N; o++)
+            {
+                double a = sc*Lij[o];
+                Xp[o] = xi[o] + a;
+                Xm[o] = xi[o] - a;
+            }
+        }
+    }
+    for(unsigned int a = 0; a < n_q + n_r; a++)
+    {
+        /* noise rows, the same for every object */
+        unsigned int i = n + a;
+        double* Xi = pB->X_aug + i*NP;
+        for(unsigned int b = 0; b <= a; b++)
+        {
+            double v = (a < n_q) ?
+                ((b < n_q) ? pB->LQ[a*n_q + b] : 0) :
+                ((b >= n_q) ? pB->LR[(a - n_q)*n_r + b - n_q] : 0);
+            if(v == 0)
+            {
+                continue;
+            }
+            double* Xp = Xi + (1 + n + b)*N;
+            double* Xm = Xi + (1 + n_aug + n + b)*N;
+            for(unsigned int o = 0; o < N; o++)
+            {
+                Xp[o] = v;
+                Xm[o] = -v;
+            }
+        }
+    }
+
+    /* the inputs for each sigma point */
+    for(unsigned int i = 0; i < pB->n_u; i++)
+    {
+        for(unsigned int s = 0; s < n_sigma; s++)
+        {
+            memcpy(pB->U + i*NP + s*N, pB->u + i*N, N*sizeof(double));
+        }
+    }
+
+    /* unscented transformation of the state */
+    f(pB->X_aug,
+      pB->n_u ? pB->U : NULL,
+      pB->X_aug + n*NP,
+      pB->X1,
+      NP);
+    unscented_mean_cov(pB->X1, pB->x1, pB->X2, pB->P1,
+                       pB->Wm, pB->Wc, n, n_sigma, N);
+
+    /* unscented transformation of the measurement */
+    h(pB->X1, pB->X_aug + (n + n_q)*NP, pB->Z, NP);
+    unscented_mean_cov(pB->Z, pB->z1, pB->Z2, pB->P2,
+                       pB->Wm, pB->Wc, pB->m, n_sigma, N);
+}
+
+void MT_UKFBatchCorrect(MT_UKFBatch_struct* pB)
+{
+    if(!pB->X_aug)
+    {
+        fprintf(stderr,
+                "MT_UKFBatchCorrect Error:  Q and R not initialized.  "
+                "Call MT_UKFBatchCopyQR.\n");
+        return;
+    }
+
+    unsigned int N = pB->N;
+    unsigned int n = pB->n;
+    unsigned int m = pB->m;
+    unsigned int n_sigma = pB->n_sigma;
+    unsigned int NP = n_sigma*N;
+
+    /* P12 = X2*Wc*Z2' */
+    for(unsigned int i = 0; i < n; i++)
+    {
+        for(unsigned int j = 0; j < m; j++)
+        {
+            double* Pij = pB->P12 + (i*m + j)*N;
+            for(unsigned int o = 0; o < N; o++)
+            {
+                Pij[o] = 0;
+            }
+            for(unsigned int s = 0; s < n_sigma; s++)
+            {
+                const double* Xis = pB->X2 + i*NP + s*N;
+                const double* Zjs = pB->Z2 + j*NP + s*N;
+                double w = pB->Wc[s];
+                for(unsigned int o = 0; o < N; o++)
+                {
+                    Pij[o] += w*Xis[o]*Zjs[o];
+                }
+            }
+        }
+    }
+
+    /* K = P12*inv(P2), i.e. P2*K' = P12' solved with chol(P2) one
+     * row of K at a time */
+    cholesky_batch(pB->P2, pB->L2, m, N);
+    for(unsigned int i = 0; i < n; i++)
+    {
+        double* Ki = pB->K + i*m*N;
+        const double* Pi = pB->P12 + i*m*N;
+        /* forward, L2*y = P12(i, :)' */
+        for(unsigned int j = 0; j < m; j++)
+        {
+            double* Kij = Ki + j*N;
+            memcpy(Kij, Pi + j*N, N*sizeof(double));
+            for(unsigned int l = 0; l < j; l++)
+            {
+                const double* L = pB->L2 + (j*m + l)*N;
+                const double* Kil = Ki + l*N;
+                for(unsigned int o = 0; o < N; o++)
+                {
+                    Kij[o] -= L[o]*Kil[o];
+                }
+            }
+            const double* Ljj = pB->L2 + (j*m + j)*N;
+            for(unsigned int o = 0; o < N; o++)
+            {
+                Kij[o] /= Ljj[o];
+            }
+        }
+        /* back, L2'*K(i, :)' = y */
+        for(int j = m - 1; j >= 0; j--)
+        {
+            double* Kij = Ki + j*N;
+            for(unsigned int l = j + 1; l < m; l++)
+            {
+                const double* L = pB->L2 + (l*m + j)*N;
+                const double* Kil = Ki + l*N;
+                for(unsigned int o = 0; o < N; o++)
+                {
+                    Kij[o] -= L[o]*Kil[o];
+                }
+            }
+            const double* Ljj = pB->L2 + (j*m + j)*N;
+            for(unsigned int o = 0; o < N; o++)
+            {
+                Kij[o] /= Ljj[o];
+            }
+        }
+    }
+
+    /* z1 = z - z1, zeroed for the objects without a measurement so
+     * that they get x = x1 */
+    const unsigned char* have = pB->have_measurement;
+    for(unsigned int j = 0; j < m; j++)
+    {
+        double* dz = pB->z1 + j*N;
+        const double* zj = pB->z + j*N;
+        for(unsigned int o = 0; o < N; o++)
+        {
+            dz[o] = have[o] ? zj[o] - dz[o] : 0;
+        }
+    }
+
+    /* x = x1 + K*(z - z1) */
+    for(unsigned int i = 0; i < n; i++)
+    {
+        double* xi = pB->x + i*N;
+        const double* x1i = pB->x1 + i*N;
+        for(unsigned int o = 0; o < N; o++)
+        {
+            xi[o] = 0;
+        }
+        for(unsigned int j = 0; j < m; j++)
+        {
+            const double* Kij = pB->K + (i*m + j)*N;
+            const double* dz = pB->z1 + j*N;
+            for(unsigned int o = 0; o < N; o++)
+            {
+                xi[o] += Kij[o]*dz[o];
+            }
+        }
+        for(unsigned int o = 0; o < N; o++)
+        {
+            xi[o] += x1i[o];
+        }
+    }
+
+    /* P = P1 - P12*K', only for the objects with a measurement */
+    for(unsigned int i = 0; i < n; i++)
+    {
+        for(unsigned int j = 0; j < n; j++)
+        {
+            double* Pij = pB->P + (i*n + j)*N;
+            const double* P1ij = pB->P1 + (i*n + j)*N;
+            for(unsigned int o = 0; o < N; o++)
+            {
+                double p = 0;
+                for(unsigned int l = 0; l < m; l++)
+                {
+                    p += pB->P12[(i*m + l)*N + o]*pB->K[(j*m + l)*N + o];
+                }
+                Pij[o] = have[o] ? P1ij[o] - p : Pij[o];
+            }
+        }
+    }
+
+    memset(pB->have_measurement, 0, N);
+}
+
+#define UKFB_SAFE_FREE(M) if((*pB)->M){free((*pB)->M);};
+
+void MT_UKFBatchFree(MT_UKFBatch_struct** pB)
+{
+    if(*pB)
+    {
+        UKFB_SAFE_FREE(x);
+        UKFB_SAFE_FREE(P);
+        UKFB_SAFE_FREE(u);
+        UKFB_SAFE_FREE(z);
+        UKFB_SAFE_FREE(have_measurement);
+        UKFB_SAFE_FREE(x1);
+        UKFB_SAFE_FREE(K);
+        UKFB_SAFE_FREE(Q);
+        UKFB_SAFE_FREE(R);
+        UKFB_SAFE_FREE(Wm);
+        UKFB_SAFE_FREE(Wc);
+        UKFB_SAFE_FREE(LQ);
+        UKFB_SAFE_FREE(LR);
+        UKFB_SAFE_FREE(L);
+        UKFB_SAFE_FREE(X_aug);
+        UKFB_SAFE_FREE(U);
+        UKFB_SAFE_FREE(X1);
+        UKFB_SAFE_FREE(X2);
+        UKFB_SAFE_FREE(Z);
+        UKFB_SAFE_FREE(Z2);
+        UKFB_SAFE_FREE(z1);
+        UKFB_SAFE_FREE(P1);
+        UKFB_SAFE_FREE(P2);
+        UKFB_SAFE_FREE(P12);
+        UKFB_SAFE_FREE(L2);
+
+        free(*pB);
+        *pB = NULL;
+    }
+}
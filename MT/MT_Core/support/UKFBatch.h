@@ -0,0 +1,227 @@
+#ifndef UKFBATCH_H
+#define UKFBATCH_H
+
+/** @addtogroup MT_Core
+ * @{ */
+
+/** @file  UKFBatch.h
+ *
+ * Unscented Kalman Filter for a batch of objects that share the same
+ * model, i.e. the same state and measurement transformations and the
+ * same Q and R.  The math is that of UKF.h (and gives the same
+ * results to within round-off), but rather than one MT_UKF_struct
+ * per object with its own matrices, the states and covariances of
+ * all of the objects are stored contiguously and each step runs over
+ * the whole batch at once:
+ *
+ *  - Element e of object o is stored at [e*num_objects + o], so
+ *      every loop over the objects runs over consecutive doubles and
+ *      can be vectorized by the compiler.
+ *  - The sigma points of all of the objects go through the state and
+ *      measurement transformations in ONE call each, instead of one
+ *      call per sigma point per object.
+ *  - Nothing is allocated after MT_UKFBatchCopyQR.
+ *
+ * Usage is the same as UKF.h, with an object index:
+ *
+ *  - Allocate and initialize with MT_UKFBatchInit.
+ *  - Set the Q and R matrices with MT_UKFBatchCopyQR.
+ *  - Set the initial conditions with MT_UKFBatchSetState.
+ *  - Set any inputs with MT_UKFBatchSetInput.
+ *  - Prediction step: MT_UKFBatchPredict.
+ *  - Set the measurements with MT_UKFBatchSetMeasurement.
+ *  - Correct step: MT_UKFBatchCorrect.
+ *  - Get the estimated states with MT_UKFBatchGetState.
+ *  - As with UKF.h, an object whose measurement was not set since
+ *      the last correction takes the predicted state, and its
+ *      covariance is not updated.
+ *
+ * The transformations see the sigma points as columns of a matrix
+ * stored by rows, element i of point p at [i*num_points + p].  The
+ * example f and h of UKF.h become
+ * @code
+ * void f(const double* X, const double* U, const double* V,
+ *        double* X1, unsigned int num_points)
+ * {
+ *     const double* x0 = X;             // first elements
+ *     const double* x1 = X + num_points; // second elements
+ *     for(unsigned int p = 0; p < num_points; p++)
+ *     {
+ *         double a = x0[p] + 0.1*x1[p] + U[p];
+ *         double b = 0.9*x1[p] + U[num_points + p];
+ *         X1[p] = a + sin(x0[p]) + V[p];
+ *         X1[num_points + p] = b + V[num_points + p];
+ *     }
+ * }
+ *
+ * void h(const double* X, const double* N, double* Z, unsigned int num_points)
+ * {
+ *     for(unsigned int p = 0; p < num_points; p++)
+ *     {
+ *         Z[p] = X[p] + N[p];
+ *     }
+ * }
+ * @endcode
+ * X1 never shares memory with X.  U is NULL if there are no inputs.
+ *
+ */
+
+/** Unscented Kalman Filter for a batch of objects.  Members are in
+ * the layout described in UKFBatch.h, i.e. element e of object o is
+ * [e*N + o], and matrices are stored by rows, so element (r, c) of
+ * object o's P is P[(r*n + c)*N + o]. */
+typedef struct MT_UKFBatch_struct
+{
+    unsigned int N; /**< number of objects */
+    unsigned int n; /**< number of state elements */
+    unsigned int m; /**< number of measurements */
+    unsigned int n_u; /**< number of inputs */
+
+    unsigned int n_q; /**< num of process noise inputs, i.e. size(Q) */
+    unsigned int n_r; /**< num of meas noise inputs, i.e. size(R) */
+
+    unsigned int n_aug; /**< num augmented states = n + n_q + n_r */
+    unsigned int n_sigma; /**< num sigma points per object = 2*n_aug + 1 */
+
+    double alpha;  /**< Parameter.  Default 1e-3 */
+    double k;      /**< Parameter.  Default 0 */
+    double beta;   /**< Parameter.  Default 2.0 */
+
+    double c;      /* calculated */
+    double lambda; /* calculated */
+
+    double* x;     /**< Most recent state estimates.  n x N */
+    double* P;     /**< State covariances.  Initialized to identity.
+                    * n*n x N */
+    double* u;     /**< Inputs.  Initialized to zero.  n_u x N */
+    double* z;     /**< Measurements.  Use MT_UKFBatchSetMeasurement
+                    * to set these.  m x N */
+    unsigned char* have_measurement; /**< Set to 1 by
+                                      * MT_UKFBatchSetMeasurement,
+                                      * set to 0 by
+                                      * MT_UKFBatchCorrect.  N */
+
+    double* x1;    /**< Most recent predicted states.  n x N */
+    double* K;     /**< Most recent gains.  n*m x N */
+
+    double* Q;     /**< Disturbance covariance, shared.  n_q x n_q */
+    double* R;     /**< Measurement noise covariance, shared.  n_r x n_r */
+
+    /* Undocumented members:  all of these get calculated in the code. */
+    double* Wm;    /* n_sigma */
+    double* Wc;    /* n_sigma, the diagonal */
+    double* LQ;    /* sqrt(c)*chol(Q), n_q x n_q */
+    double* LR;    /* sqrt(c)*chol(R), n_r x n_r */
+
+    double* L;     /* chol(P), n*n x N */
+    double* X_aug; /* sigma points, n_aug x n_sigma*N */
+    double* U;     /* inputs for each sigma point, n_u x n_sigma*N */
+    double* X1;    /* n x n_sigma*N */
+    double* X2;    /* X1 - x1, n x n_sigma*N */
+    double* Z;     /* m x n_sigma*N */
+    double* Z2;    /* Z - z1, m x n_sigma*N */
+    double* z1;    /* m x N */
+    double* P1;    /* n*n x N */
+    double* P2;    /* m*m x N */
+    double* P12;   /* n*m x N */
+    double* L2;    /* chol(P2), m*m x N */
+
+} MT_UKFBatch_struct;
+
+/** Function pointer type for the state transformation of a batch of
+ * points, i.e. X1(:, p) = f(X(:, p), U(:, p), V(:, p)) for each of
+ * the num_points points.  Element i of point p is at [i*num_points +
+ * p] in each array.
+ * @param X States, n x num_points
+ * @param U Inputs, n_u x num_points, or NULL if n_u is 0
+ * @param V Disturbances, n_q x num_points
+ * @param X1 Result, n x num_points
+ * @param num_points Number of points */
+typedef void(* MT_UKFBatchStateTxfm)(const double* X,
+                                     const double* U,
+                                     const double* V,
+                                     double* X1,
+                                     unsigned int num_points);
+/** Function pointer type for the measurement transformation of a
+ * batch of points, i.e. Z(:, p) = h(X(:, p), N(:, p)).
+ * @param X States, n x num_points
+ * @param N Noise, n_r x num_points
+ * @param Z Result, m x num_points
+ * @param num_points Number of points */
+typedef void(* MT_UKFBatchMeasTxfm)(const double* X,
+                                    const double* N,
+                                    double* Z,
+                                    unsigned int num_points);
+
+/** Creates an MT_UKFBatch_struct for num_objects objects and returns
+ * a pointer to it.  Allocates what it can; the rest is allocated by
+ * MT_UKFBatchCopyQR.  */
+MT_UKFBatch_struct* MT_UKFBatchInit(unsigned int num_objects,
+                                    unsigned int n_states,
+                                    unsigned int n_meas,
+                                    unsigned int n_inputs = 0,
+                                    double alpha = 0.001,
+                                    double k = 0,
+                                    double beta = 2.0);
+
+/** Copy the disturbance and measurement noise covariance matrices
+ * (n_q x n_q and n_r x n_r, by rows), which are shared by all of the
+ * objects.  n_r must be the number of measurements.  Allocates the
+ * rest of the batch, re-allocating if the sizes change. */
+void MT_UKFBatchCopyQR(MT_UKFBatch_struct* pB,
+                       const double* Q,
+                       unsigned int n_q,
+                       const double* R,
+                       unsigned int n_r);
+
+/** Force setting the state of object obj, e.g. initial conditions.
+ * x_set has n elements. */
+void MT_UKFBatchSetState(MT_UKFBatch_struct* pB,
+                         unsigned int obj,
+                         const double* x_set);
+/** Force setting the covariance (n x n, by rows) of object obj. */
+void MT_UKFBatchSetCovariance(MT_UKFBatch_struct* pB,
+                              unsigned int obj,
+                              const double* P_set);
+/** Set the input of object obj for the next prediction.  u_set has
+ * n_u elements. */
+void MT_UKFBatchSetInput(MT_UKFBatch_struct* pB,
+                         unsigned int obj,
+                         const double* u_set);
+/** Set the measurement of object obj.  Also marks it as having a
+ * measurement for the next MT_UKFBatchCorrect. */
+void MT_UKFBatchSetMeasurement(MT_UKFBatch_struct* pB,
+                               unsigned int obj,
+                               const double* z_set);
+
+/** Copy out the estimated state of object obj (n elements). */
+void MT_UKFBatchGetState(const MT_UKFBatch_struct* pB,
+                         unsigned int obj,
+                         double* x_get);
+/** Copy out the predicted state of object obj (n elements). */
+void MT_UKFBatchGetPrediction(const MT_UKFBatch_struct* pB,
+                              unsigned int obj,
+                              double* x1_get);
+/** Copy out the covariance of object obj (n x n, by rows). */
+void MT_UKFBatchGetCovariance(const MT_UKFBatch_struct* pB,
+                              unsigned int obj,
+                              double* P_get);
+
+/** Prediction step for all of the objects:  generates the sigma
+ * points and does the unscented transformations of the state and
+ * measurement. */
+void MT_UKFBatchPredict(MT_UKFBatch_struct* pB,
+                        MT_UKFBatchStateTxfm f,
+                        MT_UKFBatchMeasTxfm h);
+
+/** Correction step for all of the objects.  Objects without a
+ * measurement since the last call take the predicted state.  Clears
+ * the measurement flags. */
+void MT_UKFBatchCorrect(MT_UKFBatch_struct* pB);
+
+/** Deallocate a MT_UKFBatch_struct and everything it points to. */
+void MT_UKFBatchFree(MT_UKFBatch_struct** pB);
+
+/** @} */
+
+#endif /* UKFBATCH_H */
@@ -0,0 +1,384 @@
+#ifndef UKFTEMPLATE_H
+#define UKFTEMPLATE_H
+
+/** @addtogroup MT_Core
+ * @{ */
+
+/** @file  UKFTemplate.h
+ *
+ * Unscented Kalman Filter with the state and measurement sizes fixed
+ * at compile time, built on MT_Matrix / MT_Vector.  The math is that
+ * of UKF.h (and gives the same results to within round-off) with the
+ * process noise the size of the state and the measurement noise the
+ * size of the measurement, but
+ *
+ *  - everything lives in the object (no allocation at all, so an
+ *      MT_UKF can go on the stack or in a std::vector),
+ *  - the Cholesky factorizations and the gain solve are small loops
+ *      with constant bounds that the compiler unrolls, and the gain
+ *      is found by forward and back substitution with chol(P2)
+ *      rather than by SVD inversion of P2,
+ *  - the models are template parameters, so a functor (or lambda)
+ *      is inlined into the sigma point loops.
+ *
+ * This is header-only.  The models are called as
+ * @code
+ * f(x, v, x1);  // x1 = f(x, v), MT_Vector<NX> x, v, x1
+ * h(x, n, z);   // z = h(x, n), MT_Vector<NX> x, MT_Vector<NZ> n, z
+ * @endcode
+ * with x1 and z never sharing memory with the inputs.  Inputs (u in
+ * UKF.h) go in the functor.  For example, the model of test_UKF is
+ * @code
+ * struct Model
+ * {
+ *     double u[2];
+ *     void operator()(const MT_Vector<2>& x, const MT_Vector<2>& v,
+ *                     MT_Vector<2>& x1) const
+ *     {
+ *         x1.data[0] = x.data[0] + 0.1*x.data[1] + u[0]
+ *             + sin(x.data[0]) + v.data[0];
+ *         x1.data[1] = 0.9*x.data[1] + u[1] + v.data[1];
+ *     }
+ *     void operator()(const MT_Vector<2>& x, const MT_Vector<1>& n,
+ *                     MT_Vector<1>& z) const
+ *     {
+ *         z.data[0] = x.data[0] + n.data[0];
+ *     }
+ * };
+ *
+ * MT_UKF<2, 1> ukf;
+ * ukf.setQR(Q, R);
+ * ukf.setState(x0);
+ * Model model;
+ * // each step
+ * model.u[0] = ...;
+ * ukf.predict(model, model);
+ * ukf.setMeasurement(z);   // skip if the measurement was missed
+ * ukf.correct();
+ * ukf.getState();
+ * @endcode
+ *
+ */
+
+#include <math.h>
+
+#include "MT/MT_Core/primitives/Matrix.h"
+
+/** L = chol(A) (lower triangular, by rows) for an R x R matrix, with
+ * the safeguards of MT_Cholesky.  Only the lower triangle of L is
+ * written. */
+template<int R>
+inline void MT_UKFCholesky(const double* A, double* L)
+{
+    for(int i = 0; i < R; i++)
+    {
+        for(int j = 0; j < i; j++)
+        {
+            double p = A[i*R + j];
+            for(int k = 0; k < j; k++)
+            {
+                p -= L[i*R + k]*L[j*R + k];
+            }
+            L[i*R + j] = p/L[j*R + j];
+        }
+        double p = A[i*R + i];
+        for(int k = 0; k < i; k++)
+        {
+            p -= L[i*R + k]*L[i*R + k];
+        }
+        p = fabs(p);
+        L[i*R + i] = sqrt((p == 0) ? 1e-6 : p);
+    }
+}
+
+/** Unscented Kalman Filter with NX states and NZ measurements.  See
+ * UKFTemplate.h. */
+template<int NX, int NZ>
+class MT_UKF
+{
+public:
+    /** Augmented state size and number of sigma points */
+    enum {NA = 2*NX + NZ, NS = 2*NA + 1};
+
+    MT_UKF(double alpha = 0.001, double k = 0, double beta = 2.0)
+        : m_dAlpha(alpha),
+          m_dK(k),
+          m_dBeta(beta),
+          m_bHaveMeasurement(false)
+    {
+        m_dLambda = alpha*alpha*((double) NA + k) - NA;
+        m_dC = m_dLambda + (double) NA;
+        for(int s = 0; s < NS; s++)
+        {
+            m_dWm[s] = m_dWc[s] = 0.5/m_dC;
+        }
+        m_dWm[0] = m_dLambda/m_dC;
+        m_dWc[0] = m_dLambda/m_dC + 1 - alpha*alpha + beta;
+
+        m_P = IdentityMT_Matrix<NX>();
+        setQR(IdentityMT_Matrix<NX>(), IdentityMT_Matrix<NZ>());
+    };
+
+    /** Sets the disturbance (NX x NX) and measurement noise (NZ x NZ)
+     * covariances.  Both are identity to start with. */
+    void setQR(const MT_Matrix<NX, NX>& Q, const MT_Matrix<NZ, NZ>& R)
+    {
+        m_Q = Q;
+        m_R = R;
+        /* P_aug = blockdiag(P, Q, R), so the Q and R parts of its
+         * Cholesky factor only change here */
+        double sc = sqrt(m_dC);
+        MT_UKFCholesky<NX>(m_Q.data, m_LQ.data);
+        MT_UKFCholesky<NZ>(m_R.data, m_LR.data);
+        for(int i = 0; i < NX*NX; i++)
+        {
+            m_LQ.data[i] *= sc;
+        }
+        for(int i = 0; i < NZ*NZ; i++)
+        {
+            m_LR.data[i] *= sc;
+        }
+    };
+
+    /** Force setting the state, e.g. initial conditions. */
+    void setState(const MT_Vector<NX>& x) {m_x = x;};
+    /** Force setting the covariance.  Identity to start with. */
+    void setCovariance(const MT_Matrix<NX, NX>& P) {m_P = P;};
+    /** Sets the measurement for the next correct().  If this isn't
+     * called, correct() uses the prediction and leaves P alone. */
+    void setMeasurement(const MT_Vector<NZ>& z)
+    {
+        m_z = z;
+        m_bHaveMeasurement = true;
+    };
+
+    /** The most recent state estimate */
+    const MT_Vector<NX>& getState() const {return m_x;};
+    /** The most recent predicted state */
+    const MT_Vector<NX>& getPrediction() const {return m_x1;};
+    /** The most recent predicted measurement */
+    const MT_Vector<NZ>& getPredictedMeasurement() const {return m_z1;};
+    const MT_Matrix<NX, NX>& getCovariance() const {return m_P;};
+    /** The most recent gain (only updated when there's a measurement) */
+    const MT_Matrix<NX, NZ>& getGain() const {return m_K;};
+
+    /** Prediction step:  generates the sigma points and does the
+     * unscented transformations of the state (through f) and
+     * measurement (through h). */
+    template<class F, class H>
+    void predict(const F& f, const H& h)
+    {
+        /* A = sqrt(c)*chol(P), the state part of chol(P_aug) */
+        double A[NX*NX];
+        MT_UKFCholesky<NX>(m_P.data, A);
+        double sc = sqrt(m_dC);
+
+        /* X_aug = [x Y+A Y-A], x_aug = [x; 0; 0] */
+        for(int s = 0; s < NS; s++)
+        {
+            m_Xx[s] = m_x;
+            m_Xv[s] = MT_Vector<NX>();
+            m_Xn[s] = MT_Vector<NZ>();
+        }
+        for(int j = 0; j < NX; j++)
+        {
+            for(int i = j; i < NX; i++)
+            {
+                double a = sc*A[i*NX + j];
+                m_Xx[1 + j].data[i] = m_x.data[i] + a;
+                m_Xx[1 + NA + j].data[i] = m_x.data[i] - a;
+            }
+        }
+        for(int j = 0; j < NX; j++)
+        {
+            for(int i = j; i < NX; i++)
+            {
+                m_Xv[1 + NX + j].data[i] = m_LQ.data[i*NX + j];
+                m_Xv[1 + NA + NX + j].data[i] = -m_LQ.data[i*NX + j];
+            }
+        }
+        for(int j = 0; j < NZ; j++)
+        {
+            for(int i = j; i < NZ; i++)
+            {
+                m_Xn[1 + 2*NX + j].data[i] = m_LR.data[i*NZ + j];
+                m_Xn[1 + NA + 2*NX + j].data[i] = -m_LR.data[i*NZ + j];
+            }
+        }
+
+        /* unscented transformation of the state */
+        for(int s = 0; s < NS; s++)
+        {
+            f(m_Xx[s], m_Xv[s], m_X1[s]);
+        }
+        meanAndCovariance<NX>(m_X1, &m_x1, m_X2, &m_P1);
+
+        /* unscented transformation of the measurement */
+        for(int s = 0; s < NS; s++)
+        {
+            h(m_X1[s], m_Xn[s], m_Z[s]);
+        }
+        meanAndCovariance<NZ>(m_Z, &m_z1, m_Z2, &m_P2);
+    };
+
+    /** Correction step.  Without a measurement since the last call
+     * the state is the prediction and P isn't changed. */
+    void correct()
+    {
+        if(!m_bHaveMeasurement)
+        {
+            m_x = m_x1;
+            return;
+        }
+        m_bHaveMeasurement = false;
+
+        /* P12 = X2*Wc*Z2' */
+        for(int i = 0; i < NX; i++)
+        {
+            for(int j = 0; j < NZ; j++)
+            {
+                double p = 0;
+                for(int s = 0; s < NS; s++)
+                {
+                    p += m_dWc[s]*m_X2[s].data[i]*m_Z2[s].data[j];
+                }
+                m_P12.data[i*NZ + j] = p;
+            }
+        }
+
+        /* K = P12*inv(P2):  P2*K' = P12' by forward and back
+         * substitution with chol(P2), a row of K at a time */
+        double L[NZ*NZ];
+        MT_UKFCholesky<NZ>(m_P2.data, L);
+        for(int i = 0; i < NX; i++)
+        {
+            double* k = m_K.data + i*NZ;
+            for(int j = 0; j < NZ; j++)
+            {
+                double p = m_P12.data[i*NZ + j];
+                for(int l = 0; l < j; l++)
+                {
+                    p -= L[j*NZ + l]*k[l];
+                }
+                k[j] = p/L[j*NZ + j];
+            }
+            for(int j = NZ - 1; j >= 0; j--)
+            {
+                double p = k[j];
+                for(int l = j + 1; l < NZ; l++)
+                {
+                    p -= L[l*NZ + j]*k[l];
+                }
+                k[j] = p/L[j*NZ + j];
+            }
+        }
+
+        /* x = x1 + K*(z - z1) */
+        double dz[NZ];
+        for(int j = 0; j < NZ; j++)
+        {
+            dz[j] = m_z.data[j] - m_z1.data[j];
+        }
+        for(int i = 0; i < NX; i++)
+        {
+            double p = 0;
+            for(int j = 0; j < NZ; j++)
+            {
+                p += m_K.data[i*NZ + j]*dz[j];
+            }
+            m_x.data[i] = p + m_x1.data[i];
+        }
+
+        /* P = P1 - P12*K' */
+        for(int i = 0; i < NX; i++)
+        {
+            for(int j = 0; j < NX; j++)
+            {
+                double p = 0;
+                for(int l = 0; l < NZ; l++)
+                {
+                    p += m_P12.data[i*NZ + l]*m_K.data[j*NZ + l];
+                }
+                m_P.data[i*NX + j] = m_P1.data[i*NX + j] - p;
+            }
+        }
+    };
+
+protected:
+    /* y = sum Wm(s)*Y(s), D(s) = Y(s) - y, C = sum Wc(s)*D(s)*D(s)' */
+    template<int N>
+    void meanAndCovariance(const MT_Vector<N>* Y,
+                           MT_Vector<N>* y,
+                           MT_Vector<N>* D,
+                           MT_Matrix<N, N>* C) const
+    {
+        for(int i = 0; i < N; i++)
+        {
+            double p = 0;
+            for(int s = 0; s < NS; s++)
+            {
+                p += Y[s].data[i]*m_dWm[s];
+            }
+            y->data[i] = p;
+        }
+        for(int s = 0; s < NS; s++)
+        {
+            for(int i = 0; i < N; i++)
+            {
+                D[s].data[i] = Y[s].data[i] - y->data[i];
+            }
+        }
+        for(int i = 0; i < N; i++)
+        {
+            for(int j = 0; j <= i; j++)
+            {
+                double p = 0;
+                for(int s = 0; s < NS; s++)
+                {
+                    p += m_dWc[s]*D[s].data[i]*D[s].data[j];
+                }
+                C->data[i*N + j] = C->data[j*N + i] = p;
+            }
+        }
+    };
+
+    double m_dAlpha;
+    double m_dK;
+    double m_dBeta;
+    double m_dLambda;
+    double m_dC;
+    double m_dWm[NS];
+    double m_dWc[NS];
+
+    bool m_bHaveMeasurement;
+
+    MT_Vector<NX> m_x;
+    MT_Matrix<NX, NX> m_P;
+    MT_Vector<NZ> m_z;
+    MT_Matrix<NX, NX> m_Q;
+    MT_Matrix<NZ, NZ> m_R;
+    MT_Matrix<NX, NX> m_LQ;   /* sqrt(c)*chol(Q) */
+    MT_Matrix<NZ, NZ> m_LR;   /* sqrt(c)*chol(R) */
+
+    /* sigma points, state, disturbance and noise parts */
+    MT_Vector<NX> m_Xx[NS];
+    MT_Vector<NX> m_Xv[NS];
+    MT_Vector<NZ> m_Xn[NS];
+
+    MT_Vector<NX> m_X1[NS];
+    MT_Vector<NX> m_X2[NS];
+    MT_Vector<NX> m_x1;
+    MT_Matrix<NX, NX> m_P1;
+
+    MT_Vector<NZ> m_Z[NS];
+    MT_Vector<NZ> m_Z2[NS];
+    MT_Vector<NZ> m_z1;
+    MT_Matrix<NZ, NZ> m_P2;
+
+    MT_Matrix<NX, NZ> m_P12;
+    MT_Matrix<NX, NZ> m_K;
+};
+
+/** @} */
+
+#endif /* UKFTEMPLATE_H */
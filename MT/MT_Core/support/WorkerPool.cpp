@@ -0,0 +1,322 @@
+/*
+ *  WorkerPool.cpp
+ *  MADTraC
+ *
+ *  See WorkerPool.h
+ *
+ */
+
+#include "WorkerPool.h"
+
+#include <stdio.h>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+typedef CRITICAL_SECTION MT_WP_mutex;
+typedef CONDITION_VARIABLE MT_WP_cond;
+typedef HANDLE MT_WP_thread;
+#else
+#include <pthread.h>
+#include <unistd.h>
+typedef pthread_mutex_t MT_WP_mutex;
+typedef pthread_cond_t MT_WP_cond;
+typedef pthread_t MT_WP_thread;
+#endif
+
+struct MT_WorkerPoolImpl
+{
+    MT_WP_mutex mutex;
+    MT_WP_cond start_cond;  /* a new batch (or quit) */
+    MT_WP_cond done_cond;   /* a thread finished its part of a batch */
+
+    std::vector<MT_WP_thread> threads;
+
+    /* the current batch, all protected by mutex */
+    MT_WorkerJob* job;
+    int n_jobs;
+    int next_job;
+    int n_active;           /* threads not yet done with the batch */
+    unsigned int batch;     /* counts batches */
+    bool quit;
+};
+
+/* argument for each thread */
+typedef struct
+{
+    MT_WorkerPoolImpl* impl;
+    int worker;
+    unsigned int batch;     /* the last batch before the thread started */
+} MT_WorkerThreadArg;
+
+#ifdef _WIN32
+
+static void wp_init(MT_WorkerPoolImpl* p)
+{
+    InitializeCriticalSection(&p->mutex);
+    InitializeConditionVariable(&p->start_cond);
+    InitializeConditionVariable(&p->done_cond);
+}
+static void wp_destroy(MT_WorkerPoolImpl* p)
+{
+    DeleteCriticalSection(&p->mutex);
+}
+static void wp_lock(MT_WorkerPoolImpl* p){EnterCriticalSection(&p->mutex);}
+static void wp_unlock(MT_WorkerPoolImpl* p){LeaveCriticalSection(&p->mutex);}
+static void wp_wait(MT_WorkerPoolImpl* p, MT_WP_cond* c)
+{
+    SleepConditionVariableCS(c, &p->mutex, INFINITE);
+}
+static void wp_broadcast(MT_WP_cond* c){WakeAllConditionVariable(c);}
+static void wp_signal(MT_WP_cond* c){WakeConditionVariable(c);}
+
+#else
+
+static void wp_init(MT_WorkerPoolImpl* p)
+{
+    pthread_mutex_init(&p->mutex, NULL);
+    pthread_cond_init(&p->start_cond, NULL);
+    pthread_cond_init(&p->done_cond, NULL);
+}
+static void wp_destroy(MT_WorkerPoolImpl* p)
+{
+    pthread_cond_destroy(&p->done_cond);
+    pthread_cond_destroy(&p->start_cond);
+    pthread_mutex_destroy(&p->mutex);
+}
+static void wp_lock(MT_WorkerPoolImpl* p){pthread_mutex_lock(&p->mutex);}
+static void wp_unlock(MT_WorkerPoolImpl* p){pthread_mutex_unlock(&p->mutex);}
+static void wp_wait(MT_WorkerPoolImpl* p, MT_WP_cond* c)
+{
+    pthread_cond_wait(c, &p->mutex);
+}
+static void wp_broadcast(MT_WP_cond* c){pthread_cond_broadcast(c);}
+static void wp_signal(MT_WP_cond* c){pthread_cond_signal(c);}
+
+#endif
+
+/* Takes jobs off the current batch until there are none left.  Called
+ * with the mutex held, returns with it held. */
+static void wp_work(MT_WorkerPoolImpl* p, int worker)
+{
+    while(p->next_job < p->n_jobs)
+    {
+        int i = p->next_job++;
+        MT_WorkerJob* job = p->job;
+        wp_unlock(p);
+        job->doJob(i, worker);
+        wp_lock(p);
+    }
+}
+
+static void wp_thread_main(MT_WorkerThreadArg* arg)
+{
+    MT_WorkerPoolImpl* p = arg->impl;
+    int worker = arg->worker;
+    unsigned int batch = arg->batch;
+    delete arg;
+
+    wp_lock(p);
+    for(;;)
+    {
+        while(!p->quit && p->batch == batch)
+        {
+            wp_wait(p, &p->start_cond);
+        }
+        if(p->quit)
+        {
+            break;
+        }
+        batch = p->batch;
+
+        wp_work(p, worker);
+
+        p->n_active--;
+        if(p->n_active == 0)
+        {
+            wp_signal(&p->done_cond);
+        }
+    }
+    wp_unlock(p);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI wp_thread_entry(LPVOID arg)
+{
+    wp_thread_main((MT_WorkerThreadArg*) arg);
+    return 0;
+}
+#else
+static void* wp_thread_entry(void* arg)
+{
+    wp_thread_main((MT_WorkerThreadArg*) arg);
+    return NULL;
+}
+#endif
+
+int MT_WorkerPool::getNumCores()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    int n = (int) info.dwNumberOfProcessors;
+#else
+    int n = (int) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return (n > 0) ? n : 1;
+}
+
+MT_WorkerPool::MT_WorkerPool(int n_workers)
+{
+    if(n_workers <= 0)
+    {
+        n_workers = getNumCores();
+    }
+
+    m_pImpl = new MT_WorkerPoolImpl;
+    MT_WorkerPoolImpl* p = m_pImpl;
+    wp_init(p);
+    p->job = NULL;
+    p->n_jobs = 0;
+    p->next_job = 0;
+    p->n_active = 0;
+    p->batch = 0;
+    p->quit = false;
+
+    /* the caller is worker 0 */
+    m_iNumWorkers = 1;
+    for(int i = 1; i < n_workers; i++)
+    {
+        MT_WorkerThreadArg* arg = new MT_WorkerThreadArg;
+        arg->impl = p;
+        arg->worker = i;
+        arg->batch = p->batch;
+        MT_WP_thread t;
+#ifdef _WIN32
+        t = CreateThread(NULL, 0, wp_thread_entry, arg, 0, NULL);
+        bool ok = (t != NULL);
+#else
+        bool ok = (pthread_create(&t, NULL, wp_thread_entry, arg) == 0);
+#endif
+        if(!ok)
+        {
+            /* carry on with the threads we have */
+            fprintf(stderr, "MT_WorkerPool Warning:  Could only start %d of %d threads\n",
+                    i - 1, n_workers - 1);
+            delete arg;
+            break;
+        }
+        p->threads.push_back(t);
+        m_iNumWorkers++;
+    }
+}
+
+MT_WorkerPool::~MT_WorkerPool()
+{
+    MT_WorkerPoolImpl* p = m_pImpl;
+
+    wp_lock(p);
+    p->quit = true;
+    wp_broadcast(&p->start_cond);
+    wp_unlock(p);
+
+    for(unsigned int i = 0; i < p->threads.size(); i++)
+    {
+#ifdef _WIN32
+        WaitForSingleObject(p->threads[i], INFINITE);
+        CloseHandle(p->threads[i]);
+#else
+        pthread_join(p->threads[i], NULL);
+#endif
+    }
+
+    wp_destroy(p);
+    delete p;
+}
+
+void MT_WorkerPool::run(MT_WorkerJob* job, int n_jobs)
+{
+    if(n_jobs <= 0)
+    {
+        return;
+    }
+
+    /* nothing to share */
+    if(m_iNumWorkers == 1 || n_jobs == 1)
+    {
+        for(int i = 0; i < n_jobs; i++)
+        {
+            job->doJob(i, 0);
+        }
+        return;
+    }
+
+    MT_WorkerPoolImpl* p = m_pImpl;
+    wp_lock(p);
+    p->job = job;
+    p->n_jobs = n_jobs;
+    p->next_job = 0;
+    p->n_active = p->threads.size();
+    p->batch++;
+    wp_broadcast(&p->start_cond);
+
+    wp_work(p, 0);
+
+    /* every thread has to check in, even ones that found nothing left
+     * to do, so that none of them still holds the job after we
+     * return */
+    while(p->n_active > 0)
+    {
+        wp_wait(p, &p->done_cond);
+    }
+    p->job = NULL;
+    wp_unlock(p);
+}
+
+/* runs chunk index of a MT_RangeJob */
+class MT_ChunkJob : public MT_WorkerJob
+{
+public:
+    MT_ChunkJob(MT_RangeJob* job, int n_items, int chunk_size)
+        : m_pJob(job), m_iNumItems(n_items), m_iChunkSize(chunk_size) {};
+
+    void doJob(int index, int worker)
+    {
+        int begin = index*m_iChunkSize;
+        int end = begin + m_iChunkSize;
+        if(end > m_iNumItems)
+        {
+            end = m_iNumItems;
+        }
+        m_pJob->doRange(begin, end, worker);
+    };
+
+private:
+    MT_RangeJob* m_pJob;
+    int m_iNumItems;
+    int m_iChunkSize;
+};
+
+void MT_WorkerPool::runChunked(MT_RangeJob* job,
+                               int n_items,
+                               int chunk_size,
+                               int min_parallel)
+{
+    if(n_items <= 0)
+    {
+        return;
+    }
+    if(chunk_size <= 0)
+    {
+        chunk_size = n_items;
+    }
+
+    if(m_iNumWorkers == 1 || n_items < min_parallel || chunk_size >= n_items)
+    {
+        job->doRange(0, n_items, 0);
+        return;
+    }
+
+    MT_ChunkJob chunks(job, n_items, chunk_size);
+    run(&chunks, (n_items + chunk_size - 1)/chunk_size);
+}
@@ -0,0 +1,82 @@
+#ifndef MT_WORKERPOOL_H
+#define MT_WORKERPOOL_H
+
+/*
+ *  WorkerPool.h
+ *  MADTraC
+ *
+ *  A fixed set of worker threads that run batches of independent
+ *  jobs, e.g. one EM fit per merged blob.  Uses pthreads, or native
+ *  threads on Windows.
+ *
+ *  Usage:  derive from MT_WorkerJob, implement doJob, and hand it to
+ *  MT_WorkerPool::run along with the number of jobs.  run returns
+ *  once every job is done.  Each job should only write to its own
+ *  output (e.g. element index of a pre-sized vector) so that the
+ *  results don't depend on which thread ran what.
+ *
+ */
+
+class MT_WorkerJob
+{
+public:
+    virtual ~MT_WorkerJob(){};
+
+    /* Called once for each index 0 .. n_jobs - 1.  worker is the
+     * number (0 .. MT_WorkerPool::getNumWorkers() - 1) of the thread
+     * running the job, e.g. to pick a per-worker workspace.  Jobs
+     * running at the same time always have different workers. */
+    virtual void doJob(int index, int worker) = 0;
+};
+
+/* A job over a range of items, e.g. tracks, for
+ * MT_WorkerPool::runChunked. */
+class MT_RangeJob
+{
+public:
+    virtual ~MT_RangeJob(){};
+
+    /* Called for items begin .. end - 1.  Ranges never overlap, so as
+     * long as each item only touches its own outputs the result is the
+     * same as one call over all of the items. */
+    virtual void doRange(int begin, int end, int worker) = 0;
+};
+
+struct MT_WorkerPoolImpl;
+
+class MT_WorkerPool
+{
+public:
+    /* n_workers <= 0 means one per core.  The thread calling run is
+     * worker 0, so n_workers - 1 threads are started. */
+    MT_WorkerPool(int n_workers = 0);
+    ~MT_WorkerPool();
+
+    int getNumWorkers() const {return m_iNumWorkers;};
+
+    /* Runs the jobs and returns when all are done.  Jobs are started
+     * in order of index, so put the longest ones first. */
+    void run(MT_WorkerJob* job, int n_jobs);
+
+    /* Splits items 0 .. n_items - 1 into chunks of chunk_size
+     * consecutive items and runs each chunk as a job.  With fewer than
+     * min_parallel items (or one worker) this is just
+     * job->doRange(0, n_items, 0) on the calling thread, so small
+     * batches don't pay for waking the threads. */
+    void runChunked(MT_RangeJob* job,
+                    int n_items,
+                    int chunk_size,
+                    int min_parallel = 0);
+
+    static int getNumCores();
+
+private:
+    /* not copyable */
+    MT_WorkerPool(const MT_WorkerPool&);
+    MT_WorkerPool& operator=(const MT_WorkerPool&);
+
+    int m_iNumWorkers;
+    MT_WorkerPoolImpl* m_pImpl;
+};
+
+#endif // MT_WORKERPOOL_H
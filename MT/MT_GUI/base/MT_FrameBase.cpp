@@ -707,6 +707,7 @@ MT_FrameBase::MT_FrameBase(wxFrame* parent,
     m_bMakingMovie(false),
     m_iFramePeriod_msec(MT_DEFAULT_FRAME_PERIOD),
     m_bDoQuitWasCalled(false),
+    m_bHoldDialogUpdates(false),
     m_ClientSize(size),
     m_pTimer(NULL),
     m_pCanvas(NULL),
@@ -918,7 +919,10 @@ void MT_FrameBase::doStep()
 
     doUserStep();
 
-    m_DialogGroup.UpdateAll();
+    if(!m_bHoldDialogUpdates)
+    {
+        m_DialogGroup.UpdateAll();
+    }
 
     ensureDraw();
 
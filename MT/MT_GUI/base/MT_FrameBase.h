@@ -490,6 +490,7 @@ private:
     bool m_bMakingMovie;
     int m_iFramePeriod_msec;
     bool m_bDoQuitWasCalled;
+    bool m_bHoldDialogUpdates;
 
     void doMasterInitialization();
     void createMenus();
@@ -810,6 +811,10 @@ protected:
 
 	void stopTimedEvents(){m_bDoTimedEvents = false;};
 
+    /** While set, doStep doesn't update the registered dialogs, e.g.
+     * while their data is being changed on another thread. */
+    void setHoldDialogUpdates(bool hold){m_bHoldDialogUpdates = hold;};
+
     void ensureDraw(){if(m_pCanvas){m_pCanvas->doDraw();}};
 
     void drawStatusBar(double frac);
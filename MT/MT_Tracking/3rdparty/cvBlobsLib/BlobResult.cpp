@@ -1134,7 +1134,17 @@ void CBlobResult::Filter(CBlobResult &dst,
 
 {
 
-	int numBlobs = GetNumBlobs();
+	// inline operation: compact the blobs without copying them
+
+	if( &dst == this ) 
+
+	{
+
+		FilterInPlace( filterAction, evaluador, condition, lowLimit, highLimit );
+
+		return;
+
+	}
 
 
 
@@ -1142,34 +1152,168 @@ void CBlobResult::Filter(CBlobResult &dst,
 
 	DoFilter(dst, filterAction, evaluador, condition, lowLimit, highLimit );
 
+}
 
 
-	// inline operation: remove previous blobs
 
-	if( &dst == this ) 
+/**
 
-	{
+- FUNCTION: FilterInPlace
+
+- FUNCTIONALITY: Filters the blobs of the class without copying them.  Blobs
+
+				 that do not pass the filter are deleted and the remaining
+
+				 blobs are moved to the front of the blob vector, keeping
+
+				 their original order.
+
+- PARAMETERS:
+
+	- filterAction:	B_INCLUDE: keep the blobs which pass the filter
+
+				    B_EXCLUDE: remove the blobs which pass the filter
+
+	- evaluador: Object to evaluate the blob
+
+	- Condition: B_EQUAL,B_NOT_EQUAL,B_GREATER,B_LESS,B_GREATER_OR_EQUAL,
+
+				 B_LESS_OR_EQUAL,B_INSIDE,B_OUTSIDE
+
+	- LowLimit:  numerical value to evaluate the Condition on evaluador(blob)
+
+	- HighLimit: numerical value to evaluate the Condition on evaluador(blob).
+
+				 Only useful for B_INSIDE and B_OUTSIDE
+
+- RESULT:
+
+	- The same blobs that Filter(*this, ...) would leave, in the same order
+
+- RESTRICTIONS:
+
+*/
+
+void CBlobResult::FilterInPlace(int filterAction, 
+
+								funcio_calculBlob *evaluador, 
+
+								int condition, 
+
+								double lowLimit, double highLimit /*=0*/)
+
+{
+
+	int i, numBlobs, numKept;
+
+	bool resultavaluacio;
+
+	double valor;
+
+
+
+	if( GetNumBlobs() <= 0 ) return;
+
+	if( !evaluador ) return;
 
-		// esborrem els primers blobs ( que sn els originals )
 
-		// ja que els tindrem replicats al final si passen el filtre
 
-		Blob_vector::iterator itBlobs = m_blobs.begin();
+	numBlobs = GetNumBlobs();
 
-		for( int i = 0; i < numBlobs; i++ )
+	numKept = 0;
+
+	for( i = 0; i < numBlobs; i++ )
+
+	{
+
+		valor = (*evaluador)( *m_blobs[i] );
+
+		switch(condition)
 
 		{
 
-			delete *itBlobs;
+			case B_EQUAL:
+
+				resultavaluacio = valor == lowLimit;
+
+				break;
+
+			case B_NOT_EQUAL:
+
+				resultavaluacio = valor != lowLimit;
+
+				break;
+
+			case B_GREATER:
+
+				resultavaluacio = valor > lowLimit;
+
+				break;
+
+			case B_LESS:
+
+				resultavaluacio = valor < lowLimit;
+
+				break;
+
+			case B_GREATER_OR_EQUAL:
+
+				resultavaluacio = valor >= lowLimit;
+
+				break;
+
+			case B_LESS_OR_EQUAL:
+
+				resultavaluacio = valor <= lowLimit;
+
+				break;
 
-			itBlobs++;
+			case B_INSIDE:
+
+				resultavaluacio = ( valor >= lowLimit) && ( valor <= highLimit);
+
+				break;
+
+			case B_OUTSIDE:
+
+				resultavaluacio = ( valor < lowLimit) || ( valor > highLimit);
+
+				break;
+
+			default:
+
+				// unknown condition: DoFilter keeps nothing
+
+				resultavaluacio = ( filterAction != B_INCLUDE );
+
+				break;
 
 		}
 
-		m_blobs.erase( m_blobs.begin(), itBlobs );
+
+
+		if( ( resultavaluacio && filterAction == B_INCLUDE ) ||
+
+			( !resultavaluacio && filterAction == B_EXCLUDE ))
+
+		{
+
+			m_blobs[numKept++] = m_blobs[i];
+
+		}
+
+		else
+
+		{
+
+			delete m_blobs[i];
+
+		}
 
 	}
 
+	m_blobs.erase( m_blobs.begin() + numKept, m_blobs.end() );
+
 }
 
 
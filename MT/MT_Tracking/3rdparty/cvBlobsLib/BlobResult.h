@@ -126,6 +126,12 @@ public:
 	void Filter(CBlobResult &dst,
 				int filterAction, funcio_calculBlob *evaluador, 
 				int condition, double lowLimit, double highLimit = 0 ) const;
+
+	//! Filtra els blobs de la classe sense copiar-los
+	//! Filters the blobs of the class in place: rejected blobs are deleted and
+	//! the surviving blobs are compacted without being copied
+	void FilterInPlace(int filterAction, funcio_calculBlob *evaluador, 
+				int condition, double lowLimit, double highLimit = 0 );
 			
 	//! Retorna l'enËssim blob segons un determinat criteri
 	//! Sorts the blobs of the class acording to some criteria and returns the n-th blob
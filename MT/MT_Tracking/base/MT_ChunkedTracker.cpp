@@ -0,0 +1,421 @@
+/*
+ *  MT_ChunkedTracker.cpp
+ *
+ *  See MT_ChunkedTracker.h
+ *
+ */
+
+#include "MT_ChunkedTracker.h"
+#include "MT_TrackerPipeline.h"
+#include "MT/MT_Tracking/capture/MT_Capture.h"
+
+#include "MT/MT_Core/support/mathsupport.h"
+#include "MT/MT_Core/support/WorkerPool.h"
+
+#include <stdio.h>
+#include <limits>
+
+/* one chunk's frames and results */
+struct MT_TrackerChunk
+{
+    int first;      /* first frame tracked */
+    int start;      /* first frame written - first to start is overlap */
+    int end;        /* one past the last frame */
+
+    /* m_vvdData of each frame tracked in track order,
+     * [frame - first][row][object] */
+    std::vector<std::vector<std::vector<double> > > rows;
+    unsigned int n_objects;
+
+    /* identity of each object, from the stitcher */
+    std::vector<int> identity;
+    int n_matched;
+    double rms_distance;
+
+    double time;
+    bool failed;
+    std::string error;
+};
+
+class MT_ChunkedTrackerJob : public MT_WorkerJob
+{
+public:
+    MT_ChunkedTrackerJob(MT_ChunkedTracker* tracker) : m_pTracker(tracker) {};
+
+    void doJob(int index, int worker){m_pTracker->trackChunk(index);};
+
+private:
+    MT_ChunkedTracker* m_pTracker;
+};
+
+MT_ChunkedTracker::MT_ChunkedTracker(const char* video_file,
+                                     int n_chunks,
+                                     int overlap,
+                                     int n_threads)
+    : m_iXRow(0),
+      m_iYRow(1),
+      m_sVideoFile(video_file),
+      m_iNumChunksWanted(n_chunks),
+      m_iOverlap(overlap > 0 ? overlap : 0),
+      m_iNumThreads(n_threads > 0 ? n_threads : MT_WorkerPool::getNumCores()),
+      m_iFramesWritten(0),
+      m_iNumIdentities(0),
+      m_dTrackTime(0),
+      m_dStitchTime(0)
+{
+}
+
+MT_ChunkedTracker::~MT_ChunkedTracker()
+{
+    clearChunks();
+}
+
+void MT_ChunkedTracker::clearChunks()
+{
+    for(unsigned int k = 0; k < m_vpChunks.size(); k++)
+    {
+        delete m_vpChunks[k];
+    }
+    m_vpChunks.resize(0);
+}
+
+int MT_ChunkedTracker::getChunkStart(int k) const
+{
+    return (k >= 0 && k < getNumChunks()) ? m_vpChunks[k]->start : 0;
+}
+
+int MT_ChunkedTracker::getChunkEnd(int k) const
+{
+    return (k >= 0 && k < getNumChunks()) ? m_vpChunks[k]->end : 0;
+}
+
+double MT_ChunkedTracker::getChunkTime(int k) const
+{
+    return (k >= 0 && k < getNumChunks()) ? m_vpChunks[k]->time : 0;
+}
+
+int MT_ChunkedTracker::getChunkNumMatched(int k) const
+{
+    return (k >= 0 && k < getNumChunks()) ? m_vpChunks[k]->n_matched : 0;
+}
+
+double MT_ChunkedTracker::getChunkRMSDistance(int k) const
+{
+    return (k >= 0 && k < getNumChunks()) ? m_vpChunks[k]->rms_distance : 0;
+}
+
+bool MT_ChunkedTracker::run(const char* output_file, int max_frames)
+{
+    clearChunks();
+    m_sError = "";
+    m_iFramesWritten = 0;
+    m_iNumIdentities = 0;
+    m_dTrackTime = 0;
+    m_dStitchTime = 0;
+
+    /* also sets up MT_Capture's interface table before the workers
+     * make their captures */
+    int n_frames = 0;
+    {
+        MT_Capture probe;
+        if(!probe.initCaptureFromFile(m_sVideoFile.c_str()))
+        {
+            m_sError = "Failed to initialize capture from file " + m_sVideoFile;
+            return false;
+        }
+        n_frames = probe.getNFrames();
+    }
+    if(n_frames <= 0)
+    {
+        m_sError = "Can't tell how many frames are in " + m_sVideoFile;
+        return false;
+    }
+    if(max_frames > 0 && max_frames < n_frames)
+    {
+        n_frames = max_frames;
+    }
+
+    int n_chunks = (m_iNumChunksWanted > 0) ? m_iNumChunksWanted : m_iNumThreads;
+    n_chunks = MT_MIN(n_chunks, n_frames);
+    for(int k = 0; k < n_chunks; k++)
+    {
+        MT_TrackerChunk* c = new MT_TrackerChunk;
+        c->start = (int) (((double) k)*n_frames/n_chunks);
+        c->end = (int) (((double) (k + 1))*n_frames/n_chunks);
+        c->first = MT_MAX(0, c->start - m_iOverlap);
+        c->n_objects = 0;
+        c->n_matched = 0;
+        c->rms_distance = 0;
+        c->time = 0;
+        c->failed = false;
+        m_vpChunks.push_back(c);
+    }
+
+    double t0 = MT_getTimeSec();
+    {
+        MT_WorkerPool pool(MT_MIN(m_iNumThreads, n_chunks));
+        MT_ChunkedTrackerJob job(this);
+        pool.run(&job, n_chunks);
+    }
+    m_dTrackTime = MT_getTimeSec() - t0;
+
+    for(int k = 0; k < n_chunks; k++)
+    {
+        MT_TrackerChunk* c = m_vpChunks[k];
+        if(c->failed)
+        {
+            char buf[64];
+            sprintf(buf, "Chunk %d (frames %d - %d):  ", k, c->first, c->end - 1);
+            m_sError = buf + c->error;
+            return false;
+        }
+    }
+
+    t0 = MT_getTimeSec();
+    bool ok = stitchChunks() && writeChunks(output_file);
+    m_dStitchTime = MT_getTimeSec() - t0;
+
+    return ok;
+}
+
+void MT_ChunkedTracker::trackChunk(int k)
+{
+    MT_TrackerChunk* c = m_vpChunks[k];
+    double t0 = MT_getTimeSec();
+
+    MT_Capture capture;
+    if(!capture.initCaptureFromFile(m_sVideoFile.c_str()))
+    {
+        c->failed = true;
+        c->error = "Failed to initialize capture from file " + m_sVideoFile;
+        return;
+    }
+
+    /* seeks to the start of the chunk */
+    IplImage* frame = capture.getFrame(c->first);
+    if(!frame)
+    {
+        c->failed = true;
+        c->error = "Could not acquire the first frame";
+        return;
+    }
+
+    MT_TrackerBase* tracker = createTracker(frame, &c->error);
+    if(!tracker)
+    {
+        c->failed = true;
+        return;
+    }
+
+    /* the same steps MT_TrackerPipeline runs, keeping what would be
+     * written out */
+    MT_TrackerPipelineFrame pf;
+    unsigned int n_rows = MT_MAX(m_iXRow, m_iYRow) + 1;
+    c->rows.reserve(c->end - c->first);
+    for(int f = c->first; f < c->end; f++)
+    {
+        if(f > c->first)
+        {
+            frame = capture.getFrame();
+        }
+        if(!frame)
+        {
+            char buf[64];
+            sprintf(buf, "Ran out of frames at frame %d", f);
+            c->failed = true;
+            c->error = buf;
+            break;
+        }
+
+        if(!pf.m_pFrame)
+        {
+            pf.m_pFrame = cvCloneImage(frame);
+        }
+        else
+        {
+            cvCopy(frame, pf.m_pFrame);
+        }
+        pf.m_iNumber = f;
+        pf.m_vvdData.resize(0);
+        pf.m_viDataTracks.resize(0);
+
+        tracker->doPipelinePreprocess(&pf);
+        tracker->doPipelineTrack(&pf);
+
+        if(pf.m_vvdData.size() < n_rows)
+        {
+            c->failed = true;
+            c->error = "The tracker doesn't hand over its positions "
+                "(see MT_TrackerBase::doPipelineTrack)";
+            break;
+        }
+        c->rows.push_back(std::vector<std::vector<double> >());
+        getTrackOrderedData(pf,
+                            m_iXRow,
+                            tracker->getTrackedObjects()
+                            ? tracker->getTrackedObjects()->getNumObjects() : 0,
+                            &c->rows.back());
+        c->n_objects = MT_MAX(c->n_objects, c->rows.back()[m_iXRow].size());
+    }
+
+    delete tracker;
+    c->time = MT_getTimeSec() - t0;
+}
+
+void MT_ChunkedTracker::getTrackOrderedData(const MT_TrackerPipelineFrame& frame,
+                                            int x_row,
+                                            int n_tracks,
+                                            std::vector<std::vector<double> >* rows)
+{
+    const std::vector<std::vector<double> >& data = frame.m_vvdData;
+    const std::vector<int>& tracks = frame.m_viDataTracks;
+    if(x_row < 0 || x_row >= (int) data.size() || tracks.size() == 0)
+    {
+        *rows = data;
+        return;
+    }
+
+    unsigned int n = data[x_row].size();
+    if(n_tracks <= 0)
+    {
+        for(unsigned int j = 0; j < n && j < tracks.size(); j++)
+        {
+            n_tracks = MT_MAX(n_tracks, tracks[j] + 1);
+        }
+    }
+
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    rows->resize(data.size());
+    for(unsigned int r = 0; r < data.size(); r++)
+    {
+        if(data[r].size() != n)
+        {
+            /* not one per object */
+            (*rows)[r] = data[r];
+            continue;
+        }
+        (*rows)[r].assign(n_tracks, nan);
+        for(unsigned int j = 0; j < n && j < tracks.size(); j++)
+        {
+            if(tracks[j] >= 0 && tracks[j] < n_tracks)
+            {
+                (*rows)[r][tracks[j]] = data[r][j];
+            }
+        }
+    }
+}
+
+bool MT_ChunkedTracker::stitchChunks()
+{
+    m_Stitcher.reset();
+
+    std::vector<std::vector<double> > px, py, nx, ny;
+    for(unsigned int k = 0; k < m_vpChunks.size(); k++)
+    {
+        MT_TrackerChunk* c = m_vpChunks[k];
+        if(k == 0 || c->first == c->start)
+        {
+            c->identity = m_Stitcher.addChunk(c->n_objects);
+            continue;
+        }
+
+        /* the second half of the overlap, once this chunk's tracker
+         * has settled */
+        MT_TrackerChunk* p = m_vpChunks[k - 1];
+        int f0 = c->first + (c->start - c->first)/2;
+        px.resize(0);
+        py.resize(0);
+        nx.resize(0);
+        ny.resize(0);
+        for(int f = f0; f < c->start; f++)
+        {
+            const std::vector<std::vector<double> >& prev = p->rows[f - p->first];
+            const std::vector<std::vector<double> >& next = c->rows[f - c->first];
+            px.push_back(prev[m_iXRow]);
+            py.push_back(prev[m_iYRow]);
+            nx.push_back(next[m_iXRow]);
+            ny.push_back(next[m_iYRow]);
+        }
+
+        c->identity = m_Stitcher.addChunk(c->n_objects, px, py, nx, ny);
+        c->n_matched = m_Stitcher.getNumMatched();
+        c->rms_distance = m_Stitcher.getRMSDistance();
+    }
+    m_iNumIdentities = m_Stitcher.getNumIdentities();
+
+    return true;
+}
+
+bool MT_ChunkedTracker::writeChunks(const char* output_file)
+{
+    MT_TrackerBase* tracker = NULL;
+    if(output_file)
+    {
+        MT_Capture capture;
+        IplImage* proto_frame = NULL;
+        if(capture.initCaptureFromFile(m_sVideoFile.c_str()))
+        {
+            proto_frame = capture.getFrame(0);
+        }
+        if(!proto_frame)
+        {
+            m_sError = "Could not acquire a frame from file " + m_sVideoFile;
+            return false;
+        }
+        tracker = createTracker(proto_frame, &m_sError);
+        if(!tracker)
+        {
+            return false;
+        }
+        if(!tracker->setDataFile(output_file, &m_sError))
+        {
+            delete tracker;
+            return false;
+        }
+    }
+
+    /* every object's data goes in its identity's column */
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    MT_TrackerPipelineFrame pf;
+    for(unsigned int k = 0; k < m_vpChunks.size(); k++)
+    {
+        MT_TrackerChunk* c = m_vpChunks[k];
+        for(int f = c->start; f < c->end; f++)
+        {
+            const std::vector<std::vector<double> >& rows = c->rows[f - c->first];
+            unsigned int n = rows[m_iXRow].size();
+            pf.m_iNumber = f;
+            pf.m_vvdData.resize(rows.size());
+            for(unsigned int r = 0; r < rows.size(); r++)
+            {
+                if(rows[r].size() != n)
+                {
+                    /* not one per object, so leave it be */
+                    pf.m_vvdData[r] = rows[r];
+                    continue;
+                }
+                pf.m_vvdData[r].assign(m_iNumIdentities, nan);
+                for(unsigned int j = 0; j < n; j++)
+                {
+                    pf.m_vvdData[r][c->identity[j]] = rows[r][j];
+                }
+            }
+            if(tracker)
+            {
+                tracker->doPipelineOutput(&pf);
+            }
+            m_iFramesWritten++;
+        }
+
+        /* done with it */
+        std::vector<std::vector<std::vector<double> > >().swap(c->rows);
+    }
+
+    /* the tracker writes out the rest of the data file when it goes */
+    if(tracker)
+    {
+        delete tracker;
+    }
+
+    return true;
+}
@@ -0,0 +1,166 @@
+#ifndef MT_CHUNKEDTRACKER_H
+#define MT_CHUNKEDTRACKER_H
+
+/** @addtogroup MT_Tracking
+ * @{ */
+
+/** @file
+ *  MT_ChunkedTracker.h
+ *
+ *  @brief Tracks a video file in overlapping time chunks at the same
+ *  time, then joins the chunks' identities into one data file.
+ *
+ */
+
+#include <string>
+#include <vector>
+
+#include "MT/MT_Tracking/base/MT_TrackerBase.h"
+#include "MT/MT_Tracking/cv/MT_ChunkStitcher.h"
+
+class MT_TrackerPipelineFrame;
+struct MT_TrackerChunk;
+class MT_ChunkedTrackerJob;
+
+/** @class MT_ChunkedTracker
+ *
+ * @brief Offline tracking of one long video on many cores.
+ *
+ * Each frame is tracked from the tracks of the frame before, so one
+ * tracker can't spread a video over more than the few threads of an
+ * MT_TrackerPipeline.  Here the video is cut into n_chunks chunks of
+ * consecutive frames, and each is tracked by its own tracker on an
+ * MT_WorkerPool, starting cold at the beginning of its chunk.
+ *
+ * Each chunk after the first starts overlap frames before the end of
+ * the chunk before it.  The first half of those is left for the new
+ * chunk's tracker to settle, and over the second half the two chunks'
+ * objects are matched by position with an MT_ChunkStitcher.  The
+ * result is written as though one tracker had tracked the whole
+ * video:  every frame once, with each object's data always in the
+ * same column.  An object that only one chunk could match gets a
+ * column of its own, with NaNs where it isn't tracked.
+ *
+ * The tracker has to hand its results over in
+ * MT_TrackerPipelineFrame::m_vvdData (see
+ * MT_TrackerBase::doPipelineTrack), with one row per quantity and
+ * one element per object, e.g. GYSegmenter's X, Y, area and
+ * orientation.  m_iXRow and m_iYRow say which rows are the
+ * positions.  If the elements aren't in the order of the tracked
+ * objects, e.g. GYSegmenter's are in the order the blobs were found,
+ * the tracker has to say which tracked object each one is in
+ * MT_TrackerPipelineFrame::m_viDataTracks, and the rows are put in
+ * track order (getTrackOrderedData) before anything else is done
+ * with them.  The output is written by the tracker's own
+ * doPipelineOutput, to a data file set up by its setDataFile.
+ *
+ * Usage:  derive from MT_ChunkedTracker and implement createTracker,
+ * then call run.  The chunks' results are kept in memory until
+ * they're written, about (objects x rows x 8) bytes per frame.
+ *
+ * Things to look out for:
+ *  - The tracker's state should come from the frames and from what
+ *    createTracker sets, not from the first frame alone; e.g. give
+ *    it a background image rather than having each chunk take its
+ *    own first frame as the background.
+ *  - Chunks start by seeking in the video, which is only frame
+ *    accurate for some codecs.  If the chunks don't line up, the
+ *    matched distances (getChunkRMSDistance) will be large.
+ *  - The overlap is tracked twice, so with enough threads the
+ *    speedup is at most n_frames / (n_frames/n_chunks + overlap).
+ */
+class MT_ChunkedTracker
+{
+public:
+    /** n_chunks <= 0 means one per thread, n_threads <= 0 one thread
+     * per core */
+    MT_ChunkedTracker(const char* video_file,
+                      int n_chunks = 0,
+                      int overlap = 50,
+                      int n_threads = 0);
+    virtual ~MT_ChunkedTracker();
+
+    /** Makes a tracker sized for proto_frame and set up to track
+     * (parameters, background, ROI, ...), but without a data file.
+     * One is made per chunk on the worker threads, and one on the
+     * thread calling run to write the output.  Return NULL (and say
+     * why in error) if it can't be done. */
+    virtual MT_TrackerBase* createTracker(IplImage* proto_frame,
+                                          std::string* error) = 0;
+
+    /** Tracks the first max_frames frames (all if max_frames <= 0),
+     * stitches the chunks together and writes the result to
+     * output_file (nothing if NULL).  Returns false, with the reason
+     * in getError(), if any chunk failed. */
+    bool run(const char* output_file, int max_frames = -1);
+
+    /** Rows of MT_TrackerPipelineFrame::m_vvdData with the x and y
+     * positions.  0 and 1 by default. */
+    int m_iXRow;
+    int m_iYRow;
+
+    /** Does the matching between chunks, e.g. to set its
+     * m_dMaxCost */
+    MT_ChunkStitcher m_Stitcher;
+
+    const std::string& getError() const {return m_sError;};
+
+    /** frame's m_vvdData with the per-object rows (those the same
+     * length as row x_row) in the order of the tracked objects, by
+     * m_viDataTracks.  They have n_tracks elements (n_tracks <= 0
+     * means as many as the highest track), with NaNs for tracks
+     * without data.  The other rows are copied as they are. */
+    static void getTrackOrderedData(const MT_TrackerPipelineFrame& frame,
+                                    int x_row,
+                                    int n_tracks,
+                                    std::vector<std::vector<double> >* rows);
+
+    /** After run */
+    int getNumChunks() const {return m_vpChunks.size();};
+    int getNumThreads() const {return m_iNumThreads;};
+    int getNumFramesWritten() const {return m_iFramesWritten;};
+    int getNumIdentities() const {return m_iNumIdentities;};
+    /** Seconds spent tracking all of the chunks, and stitching and
+     * writing */
+    double getTrackTime() const {return m_dTrackTime;};
+    double getStitchTime() const {return m_dStitchTime;};
+    /** Chunk k's first frame, and one past its last */
+    int getChunkStart(int k) const;
+    int getChunkEnd(int k) const;
+    /** Seconds chunk k took to track */
+    double getChunkTime(int k) const;
+    /** Objects of chunk k matched to the one before, and their RMS
+     * distance [px] in the overlap */
+    int getChunkNumMatched(int k) const;
+    double getChunkRMSDistance(int k) const;
+
+private:
+    friend class MT_ChunkedTrackerJob;
+
+    /* not copyable */
+    MT_ChunkedTracker(const MT_ChunkedTracker&);
+    MT_ChunkedTracker& operator=(const MT_ChunkedTracker&);
+
+    /* runs on the workers */
+    void trackChunk(int k);
+    void clearChunks();
+    bool stitchChunks();
+    bool writeChunks(const char* output_file);
+
+    std::string m_sVideoFile;
+    int m_iNumChunksWanted;
+    int m_iOverlap;
+    int m_iNumThreads;
+
+    std::vector<MT_TrackerChunk*> m_vpChunks;
+
+    std::string m_sError;
+    int m_iFramesWritten;
+    int m_iNumIdentities;
+    double m_dTrackTime;
+    double m_dStitchTime;
+};
+
+/** @} */
+
+#endif // MT_CHUNKEDTRACKER_H
@@ -0,0 +1,401 @@
+/*
+ *  MT_TrackedObjectStore.cpp
+ *
+ *  See MT_TrackedObjectStore.h
+ *
+ */
+
+#include "MT_TrackedObjectStore.h"
+
+#define TOS_P(r, c) m_vdP[(r)*MT_TOS_STATE_SIZE + (c)]
+
+/* doubles per cache line; chunks are kept a multiple of this so that
+ * two workers never write to the same line of an array */
+const int TOS_CACHE_LINE_DOUBLES = 8;
+
+/* runs predictRange or updateRange over a chunk of objects */
+class MT_TOSRangeJob : public MT_RangeJob
+{
+public:
+    MT_TOSRangeJob(MT_TrackedObjectStore* store, bool update)
+        : m_pStore(store), m_bUpdate(update) {};
+
+    void doRange(int begin, int end, int worker)
+    {
+        if(m_bUpdate)
+        {
+            m_pStore->updateRange(begin, end);
+        }
+        else
+        {
+            m_pStore->predictRange(begin, end);
+        }
+    };
+
+private:
+    MT_TrackedObjectStore* m_pStore;
+    bool m_bUpdate;
+};
+
+MT_TrackedObjectStore::MT_TrackedObjectStore(unsigned int nobj)
+    : MT_TrackedObjectsBase(0),
+      m_dDt(1.0),
+      m_dProcessNoise(1.0),
+      m_dMeasurementNoise(4.0),
+      m_dInitialVelocityVariance(100.0),
+      m_bMeasureOnSetXY(false),
+      m_pWorkerPool(NULL),
+      m_iChunkSize(256),
+      m_iMinParallelObjects(4096)
+{
+    m_iNumObjects = 0;
+    resize(nobj);
+}
+
+void MT_TrackedObjectStore::resize(unsigned int nobj)
+{
+    unsigned int n_old = m_iNumObjects;
+
+    m_vdX.resize(nobj);
+    m_vdY.resize(nobj);
+    m_vdVX.resize(nobj);
+    m_vdVY.resize(nobj);
+    m_vdOrientation.resize(nobj);
+    for(unsigned int k = 0; k < MT_TOS_STATE_SIZE*MT_TOS_STATE_SIZE; k++)
+    {
+        m_vdP[k].resize(nobj);
+    }
+    m_vdZX.resize(nobj);
+    m_vdZY.resize(nobj);
+    m_vucHasMeasurement.resize(nobj);
+    m_viNumConsecutiveFrames.resize(nobj);
+    m_viRobotIndex.resize(nobj);
+
+    m_iNumObjects = nobj;
+    for(unsigned int i = n_old; i < nobj; i++)
+    {
+        reset(i, 0, 0);
+        m_vdOrientation[i] = 0;
+        m_viRobotIndex[i] = MT_NO_ROBOT;
+    }
+}
+
+void MT_TrackedObjectStore::reset(unsigned int i, double x, double y)
+{
+    if(i >= m_iNumObjects)
+    {
+        return;
+    }
+    m_vdX[i] = x;
+    m_vdY[i] = y;
+    m_vdVX[i] = 0;
+    m_vdVY[i] = 0;
+    for(unsigned int k = 0; k < MT_TOS_STATE_SIZE*MT_TOS_STATE_SIZE; k++)
+    {
+        m_vdP[k][i] = 0;
+    }
+    TOS_P(0, 0)[i] = TOS_P(1, 1)[i] = m_dMeasurementNoise;
+    TOS_P(2, 2)[i] = TOS_P(3, 3)[i] = m_dInitialVelocityVariance;
+    m_vucHasMeasurement[i] = 0;
+    m_viNumConsecutiveFrames[i] = 0;
+}
+
+void MT_TrackedObjectStore::setWorkerPool(MT_WorkerPool* pool,
+                                          int chunk_size,
+                                          int min_parallel)
+{
+    m_pWorkerPool = pool;
+    /* round up to whole cache lines */
+    if(chunk_size < TOS_CACHE_LINE_DOUBLES)
+    {
+        chunk_size = TOS_CACHE_LINE_DOUBLES;
+    }
+    m_iChunkSize = TOS_CACHE_LINE_DOUBLES*
+        ((chunk_size + TOS_CACHE_LINE_DOUBLES - 1)/TOS_CACHE_LINE_DOUBLES);
+    m_iMinParallelObjects = min_parallel;
+}
+
+void MT_TrackedObjectStore::runRange(bool update)
+{
+    if(m_iNumObjects == 0)
+    {
+        return;
+    }
+    if(!m_pWorkerPool)
+    {
+        update ? updateRange(0, m_iNumObjects) : predictRange(0, m_iNumObjects);
+        return;
+    }
+    MT_TOSRangeJob job(this, update);
+    m_pWorkerPool->runChunked(&job, m_iNumObjects, m_iChunkSize,
+                              m_iMinParallelObjects);
+}
+
+void MT_TrackedObjectStore::doPredict()
+{
+    runRange(false);
+}
+
+void MT_TrackedObjectStore::doUpdate()
+{
+    runRange(true);
+}
+
+void MT_TrackedObjectStore::predictRange(unsigned int begin, unsigned int end)
+{
+    const double dt = m_dDt;
+    const double q = m_dProcessNoise;
+    const double q_pp = 0.25*q*dt*dt*dt*dt;
+    const double q_pv = 0.5*q*dt*dt*dt;
+    const double q_vv = q*dt*dt;
+
+    double* x = &m_vdX[0];
+    double* y = &m_vdY[0];
+    const double* vx = &m_vdVX[0];
+    const double* vy = &m_vdVY[0];
+    for(unsigned int i = begin; i < end; i++)
+    {
+        x[i] += dt*vx[i];
+        y[i] += dt*vy[i];
+    }
+
+    /* P = F*P*F' + Q with F = [I dt*I; 0 I] */
+    double* P00 = &TOS_P(0, 0)[0];  double* P01 = &TOS_P(0, 1)[0];
+    double* P02 = &TOS_P(0, 2)[0];  double* P03 = &TOS_P(0, 3)[0];
+    double* P11 = &TOS_P(1, 1)[0];  double* P12 = &TOS_P(1, 2)[0];
+    double* P13 = &TOS_P(1, 3)[0];  double* P22 = &TOS_P(2, 2)[0];
+    double* P23 = &TOS_P(2, 3)[0];  double* P33 = &TOS_P(3, 3)[0];
+    double* P10 = &TOS_P(1, 0)[0];  double* P20 = &TOS_P(2, 0)[0];
+    double* P30 = &TOS_P(3, 0)[0];  double* P21 = &TOS_P(2, 1)[0];
+    double* P31 = &TOS_P(3, 1)[0];  double* P32 = &TOS_P(3, 2)[0];
+    for(unsigned int i = begin; i < end; i++)
+    {
+        double p00 = P00[i] + dt*(2.0*P02[i] + dt*P22[i]) + q_pp;
+        double p11 = P11[i] + dt*(2.0*P13[i] + dt*P33[i]) + q_pp;
+        double p01 = P01[i] + dt*(P03[i] + P12[i] + dt*P23[i]);
+        double p02 = P02[i] + dt*P22[i] + q_pv;
+        double p03 = P03[i] + dt*P23[i];
+        double p12 = P12[i] + dt*P23[i];
+        double p13 = P13[i] + dt*P33[i] + q_pv;
+        P00[i] = p00;
+        P11[i] = p11;
+        P01[i] = P10[i] = p01;
+        P02[i] = P20[i] = p02;
+        P03[i] = P30[i] = p03;
+        P12[i] = P21[i] = p12;
+        P13[i] = P31[i] = p13;
+        P22[i] += q_vv;
+        P33[i] += q_vv;
+        P32[i] = P23[i];
+    }
+}
+
+void MT_TrackedObjectStore::updateRange(unsigned int begin, unsigned int end)
+{
+    const double r = m_dMeasurementNoise;
+
+    double* x = &m_vdX[0];
+    double* y = &m_vdY[0];
+    double* vx = &m_vdVX[0];
+    double* vy = &m_vdVY[0];
+    const double* zx = &m_vdZX[0];
+    const double* zy = &m_vdZY[0];
+    unsigned char* has = &m_vucHasMeasurement[0];
+    unsigned int* nc = &m_viNumConsecutiveFrames[0];
+
+    double* P00 = &TOS_P(0, 0)[0];  double* P01 = &TOS_P(0, 1)[0];
+    double* P02 = &TOS_P(0, 2)[0];  double* P03 = &TOS_P(0, 3)[0];
+    double* P11 = &TOS_P(1, 1)[0];  double* P12 = &TOS_P(1, 2)[0];
+    double* P13 = &TOS_P(1, 3)[0];  double* P22 = &TOS_P(2, 2)[0];
+    double* P23 = &TOS_P(2, 3)[0];  double* P33 = &TOS_P(3, 3)[0];
+    double* P10 = &TOS_P(1, 0)[0];  double* P20 = &TOS_P(2, 0)[0];
+    double* P30 = &TOS_P(3, 0)[0];  double* P21 = &TOS_P(2, 1)[0];
+    double* P31 = &TOS_P(3, 1)[0];  double* P32 = &TOS_P(3, 2)[0];
+    for(unsigned int i = begin; i < end; i++)
+    {
+        if(!has[i])
+        {
+            nc[i] = 0;
+            continue;
+        }
+
+        /* S = H*P*H' + R with H = [I 0], inverted in closed form */
+        double s00 = P00[i] + r;
+        double s01 = P01[i];
+        double s11 = P11[i] + r;
+        double d = 1.0/(s00*s11 - s01*s01);
+        double i00 = s11*d;
+        double i01 = -s01*d;
+        double i11 = s00*d;
+
+        /* K = P*H'*inv(S), rows are the states */
+        double p0[4] = {P00[i], P01[i], P02[i], P03[i]};
+        double p1[4] = {P01[i], P11[i], P12[i], P13[i]};
+        double k0[4], k1[4];
+        for(int s = 0; s < 4; s++)
+        {
+            k0[s] = p0[s]*i00 + p1[s]*i01;
+            k1[s] = p0[s]*i01 + p1[s]*i11;
+        }
+
+        /* x = x + K*(z - H*x) */
+        double ex = zx[i] - x[i];
+        double ey = zy[i] - y[i];
+        x[i] += k0[0]*ex + k1[0]*ey;
+        y[i] += k0[1]*ex + k1[1]*ey;
+        vx[i] += k0[2]*ex + k1[2]*ey;
+        vy[i] += k0[3]*ex + k1[3]*ey;
+
+        /* P = P - K*H*P, i.e. P(r, c) -= K(r, :)*P(0:1, c) */
+        P00[i] -= k0[0]*p0[0] + k1[0]*p1[0];
+        P01[i] -= k0[0]*p0[1] + k1[0]*p1[1];
+        P02[i] -= k0[0]*p0[2] + k1[0]*p1[2];
+        P03[i] -= k0[0]*p0[3] + k1[0]*p1[3];
+        P11[i] -= k0[1]*p0[1] + k1[1]*p1[1];
+        P12[i] -= k0[1]*p0[2] + k1[1]*p1[2];
+        P13[i] -= k0[1]*p0[3] + k1[1]*p1[3];
+        P22[i] -= k0[2]*p0[2] + k1[2]*p1[2];
+        P23[i] -= k0[2]*p0[3] + k1[2]*p1[3];
+        P33[i] -= k0[3]*p0[3] + k1[3]*p1[3];
+        P10[i] = P01[i];
+        P20[i] = P02[i];
+        P30[i] = P03[i];
+        P21[i] = P12[i];
+        P31[i] = P13[i];
+        P32[i] = P23[i];
+
+        has[i] = 0;
+        nc[i]++;
+    }
+}
+
+void MT_TrackedObjectStore::setMeasurement(unsigned int i, double x, double y)
+{
+    if(i >= m_iNumObjects)
+    {
+        return;
+    }
+    m_vdZX[i] = x;
+    m_vdZY[i] = y;
+    m_vucHasMeasurement[i] = 1;
+}
+
+void MT_TrackedObjectStore::setMeasurements(const double* xs,
+                                            const double* ys,
+                                            const unsigned char* has_meas)
+{
+    for(unsigned int i = 0; i < m_iNumObjects; i++)
+    {
+        if(!has_meas || has_meas[i])
+        {
+            m_vdZX[i] = xs[i];
+            m_vdZY[i] = ys[i];
+            m_vucHasMeasurement[i] = 1;
+        }
+    }
+}
+
+unsigned int MT_TrackedObjectStore::getNumConsecutiveFrames(unsigned int i) const
+{
+    return (i < m_iNumObjects) ? m_viNumConsecutiveFrames[i] : 0;
+}
+
+int MT_TrackedObjectStore::getRobotIndex(unsigned int i) const
+{
+    return (i < m_iNumObjects) ? m_viRobotIndex[i] : MT_NO_ROBOT;
+}
+
+void MT_TrackedObjectStore::setRobotIndex(unsigned int i, int new_index)
+{
+    if(i < m_iNumObjects)
+    {
+        m_viRobotIndex[i] = new_index;
+    }
+}
+
+void MT_TrackedObjectStore::setXY(unsigned int i, double x, double y)
+{
+    if(i >= m_iNumObjects)
+    {
+        return;
+    }
+    if(m_bMeasureOnSetXY)
+    {
+        setMeasurement(i, x, y);
+    }
+    else
+    {
+        m_vdX[i] = x;
+        m_vdY[i] = y;
+    }
+}
+
+void MT_TrackedObjectStore::setOrientation(unsigned int i, double orientation)
+{
+    if(i < m_iNumObjects)
+    {
+        m_vdOrientation[i] = orientation;
+    }
+}
+
+double MT_TrackedObjectStore::getX(unsigned int i) const
+{
+    return (i < m_iNumObjects) ? m_vdX[i] : 0;
+}
+
+double MT_TrackedObjectStore::getY(unsigned int i) const
+{
+    return (i < m_iNumObjects) ? m_vdY[i] : 0;
+}
+
+double MT_TrackedObjectStore::getOrientation(unsigned int i) const
+{
+    return (i < m_iNumObjects) ? m_vdOrientation[i] : 0;
+}
+
+void MT_TrackedObjectStore::setState(unsigned int i, double* state)
+{
+    if(i >= m_iNumObjects || !state)
+    {
+        return;
+    }
+    m_vdX[i] = state[0];
+    m_vdY[i] = state[1];
+    m_vdVX[i] = state[2];
+    m_vdVY[i] = state[3];
+}
+
+double* MT_TrackedObjectStore::getState(unsigned int i) const
+{
+    if(i >= m_iNumObjects)
+    {
+        return NULL;
+    }
+    m_pdStateCopy[0] = m_vdX[i];
+    m_pdStateCopy[1] = m_vdY[i];
+    m_pdStateCopy[2] = m_vdVX[i];
+    m_pdStateCopy[3] = m_vdVY[i];
+    return m_pdStateCopy;
+}
+
+void MT_TrackedObjectStore::setMeasurement(unsigned int i, double* measurement)
+{
+    if(i >= m_iNumObjects || !measurement)
+    {
+        return;
+    }
+    setMeasurement(i, measurement[0], measurement[1]);
+    m_vdOrientation[i] = measurement[2];
+}
+
+double* MT_TrackedObjectStore::getMeasurement(unsigned int i) const
+{
+    if(i >= m_iNumObjects)
+    {
+        return NULL;
+    }
+    m_pdMeasurementCopy[0] = m_vdZX[i];
+    m_pdMeasurementCopy[1] = m_vdZY[i];
+    m_pdMeasurementCopy[2] = m_vdOrientation[i];
+    return m_pdMeasurementCopy;
+}
@@ -0,0 +1,188 @@
+#ifndef MT_TRACKEDOBJECTSTORE_H
+#define MT_TRACKEDOBJECTSTORE_H
+
+/** @addtogroup MT_Tracking
+ * @{ */
+
+/** @file
+ *  MT_TrackedObjectStore.h
+ *
+ *  @brief Tracked objects stored by field rather than by object, with
+ *  a constant velocity Kalman filter run over all of them at once.
+ *
+ */
+
+#include <vector>
+
+#include "MT/MT_Core/support/WorkerPool.h"
+#include "MT/MT_Tracking/base/MT_TrackerBase.h"
+
+/* Kalman state [x y vx vy] */
+const unsigned int MT_TOS_STATE_SIZE = 4;
+/* Measurement [x y phi], phi is passed through to the orientation */
+const unsigned int MT_TOS_MEASUREMENT_SIZE = 3;
+
+/** @class MT_TrackedObjectStore
+ *
+ * @brief Drop-in MT_TrackedObjectsBase that keeps every field of
+ * every object in one contiguous array.
+ *
+ * MT_TrackedObjectsBase keeps a vector of MT_TrackedObjectBase, each
+ * with its own heap state and CvKalman, so going through all of the
+ * objects means a virtual call and a cache miss per value.  Here
+ * field f of object i is element i of the array for f, so e.g. all
+ * of the x positions are getXs()[0 .. getNumObjects()-1], and the
+ * covariance element (r, c) of all of the objects is
+ * getCovariance(r, c)[0 .. getNumObjects()-1].
+ *
+ * The state is [x y vx vy] with a constant velocity model:
+ *  - doPredict() moves every object on by m_dDt and adds white
+ *      acceleration noise of variance m_dProcessNoise (per axis).
+ *  - setMeasurement() (or setXY() with m_bMeasureOnSetXY) gives an
+ *      object a position measurement with variance
+ *      m_dMeasurementNoise (per axis) for the next doUpdate().
+ *  - doUpdate() does the Kalman correction for every object with a
+ *      measurement and clears the measurements.  Objects without one
+ *      keep their prediction.
+ * Both are plain loops over the objects that the compiler vectorizes.
+ * With a worker pool (setWorkerPool) the objects are split into
+ * chunks that are filtered on different threads.  Each object only
+ * touches its own elements, so the result is bit for bit the same as
+ * the serial loop.
+ *
+ * The per-object accessors of MT_TrackedObjectsBase work as before,
+ * except that there is no CvKalman (initKalmanFilter and
+ * getKalmanFilterStruct return NULL), and getState / getMeasurement
+ * return a copy that is only good until the next call.
+ */
+class MT_TrackedObjectStore : public MT_TrackedObjectsBase
+{
+public:
+    MT_TrackedObjectStore(unsigned int nobj = 0);
+    virtual ~MT_TrackedObjectStore(){};
+
+    /** Time step for doPredict */
+    double m_dDt;
+    /** Acceleration noise variance per axis [px^2/frame^4] */
+    double m_dProcessNoise;
+    /** Position measurement noise variance per axis [px^2] */
+    double m_dMeasurementNoise;
+    /** Velocity variance of a newly reset object [px^2/frame^2] */
+    double m_dInitialVelocityVariance;
+    /** If true, setXY counts as a measurement rather than setting the
+     * position.  False by default, so setXY behaves as it does in
+     * MT_TrackedObjectsBase. */
+    bool m_bMeasureOnSetXY;
+
+    /** Changes the number of objects.  New objects are reset at the
+     * origin. */
+    void resize(unsigned int nobj);
+    /** Starts object i over at (x, y) with zero velocity, position
+     * variance m_dMeasurementNoise and velocity variance
+     * m_dInitialVelocityVariance. */
+    void reset(unsigned int i, double x, double y);
+
+    /** Kalman prediction for all of the objects */
+    void doPredict();
+    /** Kalman correction for all of the objects with a measurement */
+    void doUpdate();
+
+    /** Runs doPredict / doUpdate on pool (not owned, NULL for none) in
+     * chunks of chunk_size objects, rounded up to a whole number of
+     * cache lines.  With fewer than min_parallel objects the loops
+     * stay on the calling thread. */
+    void setWorkerPool(MT_WorkerPool* pool,
+                       int chunk_size = 256,
+                       int min_parallel = 4096);
+
+    /** Prediction / correction for objects begin .. end - 1 only */
+    void predictRange(unsigned int begin, unsigned int end);
+    void updateRange(unsigned int begin, unsigned int end);
+
+    /** Position measurement for object i for the next doUpdate */
+    void setMeasurement(unsigned int i, double x, double y);
+    /** Position measurements for all of the objects.  has_meas may
+     * be NULL, meaning that every object has one. */
+    void setMeasurements(const double* xs,
+                         const double* ys,
+                         const unsigned char* has_meas = NULL);
+
+    /* spans over all of the objects */
+    const double* getXs() const {return span(m_vdX);};
+    const double* getYs() const {return span(m_vdY);};
+    const double* getVXs() const {return span(m_vdVX);};
+    const double* getVYs() const {return span(m_vdVY);};
+    const double* getOrientations() const {return span(m_vdOrientation);};
+    /** Element (r, c) of every object's covariance, r, c < 4 */
+    const double* getCovariance(unsigned int r, unsigned int c) const
+        {return span(m_vdP[r*MT_TOS_STATE_SIZE + c]);};
+    /** 1 for each object with a measurement waiting for doUpdate */
+    const unsigned char* getHasMeasurement() const
+        {return m_vucHasMeasurement.size() ? &m_vucHasMeasurement[0] : NULL;};
+    const unsigned int* getNumConsecutiveFrames() const
+        {return m_viNumConsecutiveFrames.size() ? &m_viNumConsecutiveFrames[0] : NULL;};
+
+    /* MT_TrackedObjectsBase interface */
+    virtual unsigned int getNumConsecutiveFrames(unsigned int i) const;
+    virtual int getRobotIndex(unsigned int i) const;
+    virtual bool getIsMoving(unsigned int i) const {return false;};
+
+    virtual void setXY(unsigned int i, double x, double y);
+    virtual void setOrientation(unsigned int i, double orientation);
+    virtual double getX(unsigned int i) const;
+    virtual double getY(unsigned int i) const;
+    virtual double getOrientation(unsigned int i) const;
+
+    virtual CvKalman* initKalmanFilter(unsigned int i,
+            unsigned int num_control_inputs = 0) {return NULL;};
+
+    /** state = [x y vx vy] */
+    virtual void setState(unsigned int i, double* state);
+    virtual double* getState(unsigned int i) const;
+
+    /** measurement = [x y phi] */
+    virtual void setMeasurement(unsigned int i, double* measurement);
+    virtual double* getMeasurement(unsigned int i) const;
+
+    virtual void setRobotIndex(unsigned int i, int new_index);
+
+    virtual CvKalman* getKalmanFilterStruct(unsigned int i) {return NULL;};
+
+    virtual unsigned int getStateSize(unsigned int i) const
+        {return MT_TOS_STATE_SIZE;};
+    virtual unsigned int getMeasurementSize(unsigned int i) const
+        {return MT_TOS_MEASUREMENT_SIZE;};
+
+protected:
+    static const double* span(const std::vector<double>& v)
+        {return v.size() ? &v[0] : NULL;};
+
+    std::vector<double> m_vdX;
+    std::vector<double> m_vdY;
+    std::vector<double> m_vdVX;
+    std::vector<double> m_vdVY;
+    std::vector<double> m_vdOrientation;
+    /* covariance, m_vdP[r*4 + c][i] for object i */
+    std::vector<double> m_vdP[MT_TOS_STATE_SIZE*MT_TOS_STATE_SIZE];
+
+    std::vector<double> m_vdZX;
+    std::vector<double> m_vdZY;
+    std::vector<unsigned char> m_vucHasMeasurement;
+
+    std::vector<unsigned int> m_viNumConsecutiveFrames;
+    std::vector<int> m_viRobotIndex;
+
+    void runRange(bool update);
+
+    MT_WorkerPool* m_pWorkerPool;
+    int m_iChunkSize;
+    int m_iMinParallelObjects;
+
+    /* returned by getState / getMeasurement */
+    mutable double m_pdStateCopy[MT_TOS_STATE_SIZE];
+    mutable double m_pdMeasurementCopy[MT_TOS_MEASUREMENT_SIZE];
+};
+
+/** @} */
+
+#endif // MT_TRACKEDOBJECTSTORE_H
@@ -6,6 +6,7 @@
  */
 
 #include "MT_TrackerBase.h"
+#include "MT_TrackerPipeline.h"
 #include "MT/MT_Core/support/mathsupport.h"  /* for MT_getTimeSec() */
 
 /* MT_TrackedObjectsBase safe access convenience macros */
@@ -256,6 +257,9 @@ void MT_TrackerBase::doInit(IplImage* ProtoFrame)
     m_Note = "None";
     NFound = 0;
 
+    m_dFrameRateTime = MT_getTimeSec();
+    m_dFrameRateDT = 0;
+
     m_vDataGroups.resize(0);
     m_pTrackerFrameGroup = NULL;
   
@@ -516,24 +520,20 @@ MT_DataReport* MT_TrackerBase::getDataReport(unsigned int i) const
 double MT_TrackerBase::getFrameRate(bool updaterate)
 {
   
-    static double t_previous = MT_getTimeSec();
-    static double t_now = MT_getTimeSec();
-    static double dt;
-  
     if(updaterate)
     {
-        t_now = MT_getTimeSec();
-        dt = t_now - t_previous;
-        t_previous = t_now;
+        double t_now = MT_getTimeSec();
+        m_dFrameRateDT = t_now - m_dFrameRateTime;
+        m_dFrameRateTime = t_now;
     }
   
-    if(dt == 0)
+    if(m_dFrameRateDT == 0)
     {
         return 0;
     }
     else
     {
-        return 1.0/dt;
+        return 1.0/m_dFrameRateDT;
     }
 
 }
@@ -543,6 +543,11 @@ MT_BoundingBox MT_TrackerBase::getObjectBoundingBox() const
     return MT_BoundingBox(0,0,0,0);
 }
 
+void MT_TrackerBase::doPipelineTrack(MT_TrackerPipelineFrame* frame)
+{
+    doTracking(frame->m_pFrame);
+}
+
 void MT_TrackerBase::setNote(const char* note)
 {
     m_Note = std::string(note);
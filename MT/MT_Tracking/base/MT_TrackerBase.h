@@ -106,6 +106,7 @@ public:
 };
 
 class MT_TrackedObjectBase;
+class MT_TrackerPipelineFrame;
 
 class MT_TrackedObjectsBase
 {
@@ -252,6 +253,11 @@ protected:
 
     unsigned int NFound;
 
+    /* kept per tracker (not static) so that trackers running side by
+     * side don't share them - see getFrameRate */
+    double m_dFrameRateTime;
+    double m_dFrameRateDT;
+
     /** MT_ExperimentDataFile managed by the tracker.
      * @see setDataFile
      * @see initDataFile
@@ -439,6 +445,24 @@ public:
      * each time step. */
     virtual void doTracking(IplImage* frame){};
 
+    /** Pipelined tracking (see MT_TrackerPipeline).  doTracking is
+     * split into three steps that each run on their own thread, so
+     * that e.g. frame n + 1 is preprocessed while frame n is tracked
+     * and frame n - 1 is written out.  Each step sees the frames in
+     * order, one at a time.
+     *  - doPipelinePreprocess can run alongside the tracking of an
+     *    earlier frame, so it should only read the frame and write to
+     *    buffers kept in it (frame->m_vpImages).
+     *  - doPipelineTrack does the rest of the tracking, and copies
+     *    whatever is to be written out to frame->m_vvdData.
+     *  - doPipelineOutput writes frame->m_vvdData, and can run
+     *    alongside the tracking of a later frame.
+     * By default all of doTracking (including any writeData) runs in
+     * doPipelineTrack, so only capture overlaps with tracking. */
+    virtual void doPipelinePreprocess(MT_TrackerPipelineFrame* frame){};
+    virtual void doPipelineTrack(MT_TrackerPipelineFrame* frame);
+    virtual void doPipelineOutput(MT_TrackerPipelineFrame* frame){};
+
     /** Use this function to do any drawing that you want to do.
      * When integrated with MT_TrackerFrameBase, this gets called
      * during each draw cycle.  The integer argument is optional and
@@ -7,7 +7,10 @@
 
 #include <wx/progdlg.h>
 #include <wx/filename.h>
+#include <wx/thread.h>
 
+#include "MT/MT_Core/gl/glSupport.h"               // for drawing results
+#include "MT/MT_Core/support/mathsupport.h"        // for MT_getTimeSec
 #include "MT/MT_GUI/support/wxSupport.h"           // for MT_GetXMLPath
 #include "MT/MT_Tracking/cv/MT_MakeBackgroundFrame.h"
 #include "MT/MT_Tracking/dialogs/MT_CreateBackgroundDialog.h"
@@ -100,6 +103,42 @@ void MT_TrackerControlFrameBase::enableButtons()
 }
 
 
+/********************************************************************/
+/*         MT_TrackingThread                                        */
+/********************************************************************/
+
+/* Runs MT_TrackerFrameBase::runTrackingThread.  Joinable, so that
+ * stopTrackingThread can wait for it. */
+class MT_TrackingThread : public wxThread
+{
+private:
+    MT_TrackerFrameBase* m_pFrame;
+
+public:
+    MT_TrackingThread(MT_TrackerFrameBase* frame)
+        : wxThread(wxTHREAD_JOINABLE), m_pFrame(frame) {};
+
+    void* Entry(){m_pFrame->runTrackingThread(); return NULL;};
+};
+
+MT_TrackerFrameResult::MT_TrackerFrameResult()
+    : m_pImage(NULL),
+      m_iNFound(0),
+      m_dFrameRate(0),
+      m_dProgress(0),
+      m_ObjectBox(0, 0, 0, 0),
+      m_bAtEnd(false)
+{
+}
+
+MT_TrackerFrameResult::~MT_TrackerFrameResult()
+{
+    if(m_pImage)
+    {
+        cvReleaseImage(&m_pImage);
+    }
+}
+
 /********************************************************************/
 /*         MT_TrackerFrameBase ctors and dtors                      */
 /********************************************************************/
@@ -121,6 +160,13 @@ MT_TrackerFrameBase::MT_TrackerFrameBase(wxFrame* parent,
     m_sDataFilePath(wxT("")),
     m_bTracking(false),
     m_iView(MT_VIEW_FRAME),
+    m_bUseTrackingThread(false),
+    m_bTrackAsFastAsPossible(false),
+    m_pTrackingThread(NULL),
+    m_bStopTrackingThread(false),
+    m_bTrackingThreadAtEnd(false),
+    m_pShownResult(NULL),
+    m_pStartImage(NULL),
     m_pTrackerControlFrame(NULL),
     m_pCapture(NULL),
     m_pTracker(NULL),
@@ -132,6 +178,22 @@ MT_TrackerFrameBase::MT_TrackerFrameBase(wxFrame* parent,
 
 MT_TrackerFrameBase::~MT_TrackerFrameBase()
 {
+    stopTrackingThread();
+
+    /* the dialogs can outlive us */
+    for(unsigned int i = 0; i < m_vpOpenParamDialogs.size(); i++)
+    {
+        m_vpOpenParamDialogs[i]->Disconnect(wxID_ANY,
+                                            wxEVT_DESTROY,
+                                            wxWindowDestroyEventHandler(MT_TrackerFrameBase::onTrackerParamsDialogDestroyed),
+                                            NULL,
+                                            this);
+    }
+    if(m_pStartImage)
+    {
+        cvReleaseImage(&m_pStartImage);
+    }
+
     if(!m_bAmSlave && m_pCapture)
     {
         delete m_pCapture;
@@ -542,6 +604,8 @@ bool MT_TrackerFrameBase::setupCameraCapture()
     // make sure we're paused
     doPause();
 
+    m_bTrackingThreadAtEnd = false;
+
     // TODO: Need an intermediary dialog to get camera settings...
 
     if(!m_pCapture->initCaptureFromCamera(MT_FC_DEFAULT_FW,
@@ -595,6 +659,7 @@ bool MT_TrackerFrameBase::setupAVICapture(const char* filename)
     {
         return false;
     }
+    m_bTrackingThreadAtEnd = false;
 
     // frame period in msec, set to 0 and override with UI
     int FramePeriod_msec = 0;
@@ -637,7 +702,25 @@ bool MT_TrackerFrameBase::setupAVICapture(const char* filename)
 
 void MT_TrackerFrameBase::doTrackerGLDrawing()
 {
-    if(m_pTracker)
+    if(m_pTrackingThread)
+    {
+        /* the tracker is busy on the other thread, so draw what it
+         * handed over */
+        if(m_pShownResult && m_pShownResult->m_pImage)
+        {
+            drawStatusBar(m_pShownResult->m_dProgress);
+            double h = m_pShownResult->m_pImage->height;
+            for(unsigned int i = 0; i < m_pShownResult->m_vdX.size(); i++)
+            {
+                MT_DrawEllipse(MT_R3(m_pShownResult->m_vdX[i],
+                                     h - m_pShownResult->m_vdY[i],
+                                     0),
+                               15.0, 15.0, 0,
+                               MT_Primaries[i % MT_NPrimaries]);
+            }
+        }
+    }
+    else if(m_pTracker)
     {
         drawStatusBar(m_pCapture->getProgressFraction());
         /* typically this means "draw everything" 
@@ -678,6 +761,12 @@ void MT_TrackerFrameBase::initTrackerFrameData()
                               wxCMD_LINE_VAL_STRING,
                               wxCMD_LINE_PARAM_OPTIONAL);
     m_CmdLineParser.AddSwitch(wxT("T"), wxT("Track-now"), wxT("Start tracking right away."));
+    m_CmdLineParser.AddSwitch(wxEmptyString,
+                              wxT("thread"),
+                              wxT("Track on a separate thread from the display."));
+    m_CmdLineParser.AddSwitch(wxEmptyString,
+                              wxT("fast"),
+                              wxT("With --thread, track as fast as possible instead of at the movie's frame rate."));
 
 }
 
@@ -694,6 +783,24 @@ void MT_TrackerFrameBase::writeTrackerXML()
 
 void MT_TrackerFrameBase::doTrackerStep()
 {
+    if(m_bUseTrackingThread && m_bTracking && m_pTracker && m_pCapture)
+    {
+        /* the tracking thread does the work, we just show the latest
+         * result */
+        if(!m_pTrackingThread && !m_bTrackingThreadAtEnd
+           && m_vpOpenParamDialogs.empty())
+        {
+            startTrackingThread();
+        }
+        if(m_pTrackingThread || m_bTrackingThreadAtEnd)
+        {
+            showTrackerResult();
+            return;
+        }
+        /* couldn't start the thread, or a parameter dialog is open -
+         * carry on without it */
+    }
+
     acquireFrames();
 
     // do tracking if we've started that
@@ -752,6 +859,7 @@ bool MT_TrackerFrameBase::startTracking()
         }
 
         initTracker();
+        m_bTrackingThreadAtEnd = false;
 		if(!m_pTrackerFrameGroup)
 		{
 			m_pTrackerFrameGroup = m_pTracker->getFrameGroup();
@@ -821,6 +929,11 @@ void MT_TrackerFrameBase::handleCommandLineArguments(int argc, wxChar** argv)
         MT_GetAbsolutePath(v, &m_sROIPath, &m_sROIDirectory);
     }
 
+    if(m_CmdLineParser.Found(wxT("thread")))
+    {
+        setUseTrackingThread(true, m_CmdLineParser.Found(wxT("fast")));
+    }
+
     if(m_CmdLineParser.GetParamCount())
     {
         v = m_CmdLineParser.GetParam(0);
@@ -928,6 +1041,8 @@ void MT_TrackerFrameBase::onMenuViewSelect(wxCommandEvent& event)
 
 void MT_TrackerFrameBase::setView(unsigned int i)
 {
+    /* the thread picks up the new view when it is restarted */
+    stopTrackingThread();
     m_iView = i;
 	if(i > 0)
 	{
@@ -942,6 +1057,7 @@ void MT_TrackerFrameBase::setView(unsigned int i)
 
 void MT_TrackerFrameBase::onMenuTrackerTrain(wxCommandEvent& WXUNUSED(event))
 {
+    stopTrackingThread();
     if(m_pTracker && m_pCurrentFrame)
     {
         m_pTracker->doTrain(m_pCurrentFrame);
@@ -956,14 +1072,38 @@ void MT_TrackerFrameBase::onMenuTrackerParams(wxCommandEvent& event)
         MT_DataGroup* dg = m_pTracker->getDataGroup(parameter_group_id);
         if(dg)
         {
+            /* the dialog writes straight to the tracker, so it can't
+             * be tracking on the other thread until the dialog is
+             * gone (see doTrackerStep) */
+            stopTrackingThread();
+
             MT_DataGroupDialog* dlg = new MT_DataGroupDialog(dg, this);
             registerDialogForXML(dlg);
+            m_vpOpenParamDialogs.push_back(dlg);
+            dlg->Connect(wxID_ANY,
+                         wxEVT_DESTROY,
+                         wxWindowDestroyEventHandler(MT_TrackerFrameBase::onTrackerParamsDialogDestroyed),
+                         NULL,
+                         this);
             dlg->Show();      
         }
     }
 
 }
 
+void MT_TrackerFrameBase::onTrackerParamsDialogDestroyed(wxWindowDestroyEvent& event)
+{
+    for(unsigned int i = 0; i < m_vpOpenParamDialogs.size(); i++)
+    {
+        if(m_vpOpenParamDialogs[i] == event.GetEventObject())
+        {
+            m_vpOpenParamDialogs.erase(m_vpOpenParamDialogs.begin() + i);
+            break;
+        }
+    }
+    event.Skip();
+}
+
 void MT_TrackerFrameBase::onMenuTrackerReports(wxCommandEvent& event)
 {
     int report_id = event.GetId() - MT_TFB_ID_MENU_TRACKER_REPORTS00;
@@ -985,6 +1125,7 @@ void MT_TrackerFrameBase::onMenuTrackerReports(wxCommandEvent& event)
 
 void MT_TrackerFrameBase::onMenuTrackerNote(wxCommandEvent& event)
 {
+    stopTrackingThread();
     if(m_pTracker)
     {
         std::string exist_note = "";
@@ -1147,6 +1288,238 @@ void MT_TrackerFrameBase::setCurrentFrame(IplImage* frame)
 	m_pCurrentFrame = frame;
 }
 
+/********************************************************************/
+/*     MT_TrackerFrameBase tracking thread                          */
+/********************************************************************/
+
+void MT_TrackerFrameBase::setUseTrackingThread(bool use_thread,
+                                               bool as_fast_as_possible)
+{
+    /* restarted with the new settings on the next step */
+    stopTrackingThread();
+    m_bUseTrackingThread = use_thread;
+    m_bTrackAsFastAsPossible = as_fast_as_possible;
+}
+
+void MT_TrackerFrameBase::onPauseToggled(bool paused_state)
+{
+    if(paused_state)
+    {
+        stopTrackingThread();
+    }
+    MT_FrameBase::onPauseToggled(paused_state);
+}
+
+void MT_TrackerFrameBase::setStopTrackingThread(bool stop)
+{
+    wxMutexLocker lock(m_StopTrackingThreadMutex);
+    m_bStopTrackingThread = stop;
+}
+
+bool MT_TrackerFrameBase::getStopTrackingThread()
+{
+    wxMutexLocker lock(m_StopTrackingThreadMutex);
+    return m_bStopTrackingThread;
+}
+
+IplImage* MT_TrackerFrameBase::getViewImage()
+{
+    if(m_iView > 0 && m_pTrackerFrameGroup
+       && m_pTrackerFrameGroup->getFrame(m_iView - 1))
+    {
+        return m_pTrackerFrameGroup->getFrame(m_iView - 1);
+    }
+    return m_pCurrentFrame;
+}
+
+void MT_TrackerFrameBase::startTrackingThread()
+{
+    /* The canvas may be showing the frame or a tracker frame, which
+     * the thread is about to write to, or the image of an old result,
+     * which it may release.  Show a copy until the first result. */
+    if(m_pStartImage)
+    {
+        cvReleaseImage(&m_pStartImage);
+    }
+    IplImage* view = getViewImage();
+    if(view)
+    {
+        m_pStartImage = cvCloneImage(view);
+    }
+    setImage(m_pStartImage);
+
+    setStopTrackingThread(false);
+    m_pTrackingThread = new MT_TrackingThread(this);
+    if(m_pTrackingThread->Create() != wxTHREAD_NO_ERROR
+       || m_pTrackingThread->Run() != wxTHREAD_NO_ERROR)
+    {
+        fprintf(stderr, "MT_TrackerFrameBase Error:  Could not start the "
+                "tracking thread, tracking on the timer instead.\n");
+        delete m_pTrackingThread;
+        m_pTrackingThread = NULL;
+        m_bUseTrackingThread = false;
+        setImage(getViewImage());
+        return;
+    }
+    /* the dialogs would read the tracker while it works */
+    setHoldDialogUpdates(true);
+}
+
+bool MT_TrackerFrameBase::stopTrackingThread()
+{
+    if(!m_pTrackingThread)
+    {
+        return false;
+    }
+
+    setStopTrackingThread(true);
+    m_pTrackingThread->Wait();
+    delete m_pTrackingThread;
+    m_pTrackingThread = NULL;
+    setHoldDialogUpdates(false);
+
+    /* take anything published in the meantime, so that nothing stale
+     * is waiting when the thread starts again */
+    if(m_TrackerResultBuffer.update())
+    {
+        m_pShownResult = &m_TrackerResults[m_TrackerResultBuffer.getReadIndex()];
+    }
+
+    /* back to showing the frames themselves (as on the timer), so
+     * that the canvas isn't left with a result's image.  Once the
+     * capture has run out there's nothing else to show, and
+     * startTrackingThread takes the canvas off it before anything
+     * else can write to it. */
+    IplImage* view = getViewImage();
+    if(view)
+    {
+        setImage(view);
+    }
+
+    return true;
+}
+
+void MT_TrackerFrameBase::runTrackingThread()
+{
+    /* files are paced to their frame rate, cameras pace themselves */
+    double period = 0;
+    if(!m_bTrackAsFastAsPossible && m_pCapture->getNFrames() > 0)
+    {
+        period = 0.001*m_pCapture->getFramePeriod_msec();
+    }
+    double t_next = MT_getTimeSec();
+
+    while(!getStopTrackingThread())
+    {
+        acquireFrames();
+        bool at_end = !m_pCurrentFrame || m_pCapture->getIsAtEnd();
+        if(m_pCurrentFrame)
+        {
+            runTracker();
+            doTrackingThreadStep();
+        }
+        publishTrackerResult(at_end);
+        if(at_end)
+        {
+            break;
+        }
+
+        if(period > 0)
+        {
+            t_next += period;
+            double wait = t_next - MT_getTimeSec();
+            if(wait > 0)
+            {
+                wxThread::Sleep((unsigned long) (1000.0*wait));
+            }
+            else
+            {
+                /* fell behind - don't try to catch up */
+                t_next = MT_getTimeSec();
+            }
+        }
+    }
+}
+
+void MT_TrackerFrameBase::publishTrackerResult(bool at_end)
+{
+    MT_TrackerFrameResult* r = &m_TrackerResults[m_TrackerResultBuffer.getWriteIndex()];
+
+    const IplImage* view = getViewImage();
+    if(view)
+    {
+        if(r->m_pImage
+           && (r->m_pImage->width != view->width
+               || r->m_pImage->height != view->height
+               || r->m_pImage->nChannels != view->nChannels
+               || r->m_pImage->depth != view->depth))
+        {
+            cvReleaseImage(&r->m_pImage);
+        }
+        if(!r->m_pImage)
+        {
+            r->m_pImage = cvCloneImage(view);
+        }
+        else
+        {
+            cvCopy(view, r->m_pImage);
+        }
+    }
+
+    r->m_iNFound = m_pTracker->getNFound();
+    r->m_dFrameRate = m_pTracker->getFrameRate();
+    r->m_dProgress = m_pCapture->getProgressFraction();
+    r->m_ObjectBox = m_pTracker->getObjectBoundingBox();
+    r->m_vdX.resize(0);
+    r->m_vdY.resize(0);
+    MT_TrackedObjectsBase* objects = m_pTracker->getTrackedObjects();
+    if(objects)
+    {
+        for(unsigned int i = 0; i < objects->getNumObjects(); i++)
+        {
+            r->m_vdX.push_back(objects->getX(i));
+            r->m_vdY.push_back(objects->getY(i));
+        }
+    }
+    r->m_bAtEnd = at_end;
+
+    m_TrackerResultBuffer.publish();
+}
+
+void MT_TrackerFrameBase::showTrackerResult()
+{
+    if(m_TrackerResultBuffer.update())
+    {
+        m_pShownResult = &m_TrackerResults[m_TrackerResultBuffer.getReadIndex()];
+        if(m_pShownResult->m_pImage)
+        {
+            setImage(m_pShownResult->m_pImage);
+        }
+        tellObjectLimits(MT_RectangleFromBoundingBox(m_pShownResult->m_ObjectBox), 0.05);
+
+        if(haveControlFrame())
+        {
+            wxString statustext;
+            statustext.Printf(wxT("%d blobs, %3.1f FPS"),
+                              m_pShownResult->m_iNFound,
+                              m_pShownResult->m_dFrameRate);
+            setControlFrameStatusText(statustext);
+        }
+
+        if(m_pShownResult->m_bAtEnd)
+        {
+            /* it's done, don't restart it until there's more to do */
+            stopTrackingThread();
+            m_bTrackingThreadAtEnd = true;
+        }
+    }
+
+    if(m_bTrackingThreadAtEnd)
+    {
+        doReset();
+    }
+}
+
 MT_XDFNoteDialog::MT_XDFNoteDialog(wxFrame* parent, wxString* note)
     : wxDialog(parent,
                wxID_ANY,
@@ -31,6 +31,9 @@
 // FrameCapture is the camera/avi capture class
 #include "MT/MT_Tracking/capture/MT_Capture.h"
 #include "MT/MT_Tracking/base/MT_TrackerBase.h"
+#include "MT/MT_Core/support/TripleBuffer.h"
+
+#include <wx/thread.h>
 
 
 /* ---------- Definitions of default parameters --------- */
@@ -165,6 +168,38 @@ const unsigned int MT_MAX_NUM_TRACKER_REPORTS = 10;
 
 /* Forward class definitions */
 class MT_TrackerFrameBase;
+class MT_TrackingThread;
+
+/** @class MT_TrackerFrameResult
+ *
+ * What the tracking thread hands to the GUI after each frame, see
+ * MT_TrackerFrameBase::setUseTrackingThread.  Each one is only ever
+ * touched by one thread at a time.
+ */
+class MT_TrackerFrameResult
+{
+public:
+    MT_TrackerFrameResult();
+    ~MT_TrackerFrameResult();
+
+    /** Copy of the view that was selected (the frame or one of the
+     * tracker's frames) */
+    IplImage* m_pImage;
+    unsigned int m_iNFound;
+    double m_dFrameRate;
+    double m_dProgress;
+    MT_BoundingBox m_ObjectBox;
+    /** Positions of the tracked objects, if the tracker has any */
+    std::vector<double> m_vdX;
+    std::vector<double> m_vdY;
+    /** True if the capture ran out of frames */
+    bool m_bAtEnd;
+
+private:
+    /* not copyable */
+    MT_TrackerFrameResult(const MT_TrackerFrameResult&);
+    MT_TrackerFrameResult& operator=(const MT_TrackerFrameResult&);
+};
 
 class MT_TrackerControlFrameBase : public MT_ControlFrameBase
 {
@@ -199,6 +234,7 @@ public:
 class MT_TrackerFrameBase : public MT_FrameBase
 {
     friend class MT_TrackerControlFrameBase;
+    friend class MT_TrackingThread;
 private:
 
     // state flags
@@ -211,6 +247,38 @@ private:
     void addDataGroupsToTrackerMenu(wxMenu* tracker_menu);
     void addDataReportsToTrackerMenu(wxMenu* tracker_menu);
 
+    /* tracking thread, see setUseTrackingThread */
+    bool m_bUseTrackingThread;
+    bool m_bTrackAsFastAsPossible;
+    MT_TrackingThread* m_pTrackingThread;
+    /* set by the GUI to stop the thread, read by the thread */
+    wxMutex m_StopTrackingThreadMutex;
+    bool m_bStopTrackingThread;
+    void setStopTrackingThread(bool stop);
+    bool getStopTrackingThread();
+    /* set once the thread has run out of frames, so that it isn't
+     * restarted until there's something new to track */
+    bool m_bTrackingThreadAtEnd;
+    MT_TripleBuffer m_TrackerResultBuffer;
+    MT_TrackerFrameResult m_TrackerResults[3];
+    /* the result being displayed, NULL until there is one */
+    MT_TrackerFrameResult* m_pShownResult;
+    /* what the canvas shows from when the thread starts until its
+     * first result:  a copy, since the thread writes to the frames */
+    IplImage* m_pStartImage;
+    /* parameter dialogs that are open - the thread isn't run while
+     * there are any, see onMenuTrackerParams */
+    std::vector<wxWindow*> m_vpOpenParamDialogs;
+    void onTrackerParamsDialogDestroyed(wxWindowDestroyEvent& event);
+
+    /* the frame or tracker frame picked by m_iView */
+    IplImage* getViewImage();
+
+    void startTrackingThread();
+    void runTrackingThread();
+    void publishTrackerResult(bool at_end);
+    void showTrackerResult();
+
 protected:
     
     // various directories / paths
@@ -263,6 +331,27 @@ protected:
 	virtual void acquireFrames();
 	virtual void runTracker();
 
+    /** Called after runTracker for each frame on the tracking thread,
+     * when that is used (see setUseTrackingThread).  Anything a
+     * derived frame does with the tracker's results every frame
+     * (e.g. in doUserStep) should go here in that case, since the
+     * tracker can't be touched from the GUI thread while the tracking
+     * thread runs. */
+    virtual void doTrackingThreadStep(){};
+
+    /** Stops the tracking thread, if it's running, and waits for it
+     * to finish the frame it's on.  Returns true if it was running.
+     * It is started again on the next step if tracking isn't paused,
+     * so call this before touching the tracker or the capture from
+     * the GUI. */
+    bool stopTrackingThread();
+
+    /** Hides MT_FrameBase::doPause to stop the tracking thread as
+     * well, since pausing usually means that the tracker or capture
+     * is about to be changed. */
+    void doPause(){stopTrackingThread(); MT_FrameBase::doPause();};
+    virtual void onPauseToggled(bool paused_state);
+
     /* virtual because the robot frame needs to interject here */
     virtual bool startTracking();
 
@@ -284,8 +373,33 @@ public:
 
 	void setView(unsigned int i);
 
+    /** Run the tracker on its own thread instead of on the GUI's
+     * timer.  The thread tracks each frame as it is captured - at
+     * the video's frame rate, or as fast as it can if
+     * as_fast_as_possible is true (cameras always go at their own
+     * rate).  After each frame it hands the frame (or the selected
+     * tracker view), the status and the object positions to the GUI
+     * through an MT_TripleBuffer, and the GUI shows the latest of
+     * these each time its timer fires.  So a busy GUI (e.g. a window
+     * being dragged) doesn't hold up tracking and a slow tracker
+     * doesn't hold up the GUI.
+     *
+     * While the thread runs, the tracker's doGLDrawing isn't called
+     * (it would read the tracker while it works) - the tracked
+     * objects are drawn from the result instead - and registered
+     * dialogs aren't updated.  The thread is stopped while any of the
+     * tracker's parameter dialogs is open, and tracking carries on on
+     * the timer until they're all closed, so that the parameters are
+     * never changed under the thread.  Also see doTrackingThreadStep.
+     * Off by default.
+     *
+     * Can also be turned on with the --thread (and --fast) command
+     * line switches. */
+    void setUseTrackingThread(bool use_thread, bool as_fast_as_possible = false);
+    bool getUseTrackingThread() const {return m_bUseTrackingThread;};
+
     virtual void doUserQuit()
-    { MT_FrameBase::doUserQuit(); };
+    { stopTrackingThread(); MT_FrameBase::doUserQuit(); };
 
     virtual void handleCommandLineArguments(int argc, wxChar** argv);
     virtual void handleOpenWithFile(const wxString& filename);
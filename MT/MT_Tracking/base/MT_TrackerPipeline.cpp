@@ -0,0 +1,224 @@
+/*
+ *  MT_TrackerPipeline.cpp
+ *
+ *  See MT_TrackerPipeline.h
+ *
+ */
+
+#include "MT_TrackerPipeline.h"
+#include "MT/MT_Tracking/capture/MT_Capture.h"
+
+#include "MT/MT_Core/support/mathsupport.h"
+
+#include <stdio.h>
+
+class MT_TrackerPipelineStage : public MT_PipelineStage
+{
+public:
+    MT_TrackerPipelineStage(MT_TrackerBase* tracker, MT_TP_STEP step)
+        : m_dTime(0), m_pTracker(tracker), m_Step(step) {};
+
+    void process(void* item)
+    {
+        MT_TrackerPipelineFrame* frame = (MT_TrackerPipelineFrame*) item;
+        double t0 = MT_getTimeSec();
+        switch(m_Step)
+        {
+        case MT_TP_PREPROCESS:
+            m_pTracker->doPipelinePreprocess(frame);
+            break;
+        case MT_TP_TRACK:
+            m_pTracker->doPipelineTrack(frame);
+            break;
+        default:
+            m_pTracker->doPipelineOutput(frame);
+            break;
+        }
+        /* only touched by this stage's thread, read after a flush */
+        m_dTime += MT_getTimeSec() - t0;
+    };
+
+    double m_dTime;
+
+private:
+    MT_TrackerBase* m_pTracker;
+    MT_TP_STEP m_Step;
+};
+
+MT_TrackerPipelineFrame::MT_TrackerPipelineFrame()
+    : m_pFrame(NULL),
+      m_iNumber(0)
+{
+}
+
+MT_TrackerPipelineFrame::~MT_TrackerPipelineFrame()
+{
+    if(m_pFrame)
+    {
+        cvReleaseImage(&m_pFrame);
+    }
+    for(unsigned int i = 0; i < m_vpImages.size(); i++)
+    {
+        if(m_vpImages[i])
+        {
+            cvReleaseImage(&m_vpImages[i]);
+        }
+    }
+}
+
+MT_TrackerPipeline::MT_TrackerPipeline(MT_TrackerBase* tracker, int queue_size)
+    : m_pTracker(tracker),
+      m_Pipeline(queue_size),
+      m_dCaptureTime(0),
+      m_iFramesPushed(0),
+      m_iFramesDone(0)
+{
+    if(queue_size < 1)
+    {
+        queue_size = 1;
+    }
+    /* a full pipeline, plus the one being captured */
+    m_iMaxFrames = MT_TP_NUM_STEPS*(queue_size + 1) + 1;
+
+    for(int s = 0; s < MT_TP_NUM_STEPS; s++)
+    {
+        m_vpStages.push_back(new MT_TrackerPipelineStage(tracker, (MT_TP_STEP) s));
+        m_Pipeline.addStage(m_vpStages[s]);
+    }
+    if(!m_Pipeline.start())
+    {
+        fprintf(stderr, "MT_TrackerPipeline Warning:  "
+                "Could not start threads, frames will be tracked one at a time\n");
+    }
+}
+
+MT_TrackerPipeline::~MT_TrackerPipeline()
+{
+    flush();
+    m_Pipeline.finish();
+
+    for(unsigned int i = 0; i < m_vpStages.size(); i++)
+    {
+        delete m_vpStages[i];
+    }
+    for(unsigned int i = 0; i < m_vpFrames.size(); i++)
+    {
+        delete m_vpFrames[i];
+    }
+}
+
+void MT_TrackerPipeline::collect(MT_TrackerPipelineFrame* frame)
+{
+    m_iFramesDone++;
+    m_vpFreeFrames.push_back(frame);
+}
+
+bool MT_TrackerPipeline::pushFrame(const IplImage* frame)
+{
+    if(!frame)
+    {
+        return false;
+    }
+
+    MT_TrackerPipelineFrame* f = NULL;
+    if(m_vpFreeFrames.size())
+    {
+        f = m_vpFreeFrames.back();
+        m_vpFreeFrames.pop_back();
+    }
+    else if(m_vpFrames.size() < m_iMaxFrames)
+    {
+        f = new MT_TrackerPipelineFrame;
+        m_vpFrames.push_back(f);
+    }
+    else
+    {
+        /* full - wait for the oldest frame to come out */
+        f = (MT_TrackerPipelineFrame*) m_Pipeline.pop();
+        m_iFramesDone++;
+    }
+
+    if(f->m_pFrame
+       && (f->m_pFrame->width != frame->width
+           || f->m_pFrame->height != frame->height
+           || f->m_pFrame->nChannels != frame->nChannels
+           || f->m_pFrame->depth != frame->depth))
+    {
+        cvReleaseImage(&f->m_pFrame);
+    }
+    if(!f->m_pFrame)
+    {
+        f->m_pFrame = cvCloneImage(frame);
+        if(!f->m_pFrame)
+        {
+            fprintf(stderr, "MT_TrackerPipeline Error:  Could not copy frame %d\n",
+                    m_iFramesPushed);
+            m_vpFreeFrames.push_back(f);
+            return false;
+        }
+    }
+    else
+    {
+        cvCopy(frame, f->m_pFrame);
+    }
+
+    f->m_iNumber = m_iFramesPushed++;
+    m_Pipeline.push(f);
+    return true;
+}
+
+int MT_TrackerPipeline::run(MT_Capture* capture, int max_frames)
+{
+    if(!capture)
+    {
+        return 0;
+    }
+
+    int n_frames = capture->getNFrames();
+    int n_pushed = 0;
+    while(max_frames <= 0 || n_pushed < max_frames)
+    {
+        /* files know how long they are, cameras don't */
+        if(n_frames > 0 && capture->getFrameNumber() >= n_frames - 1)
+        {
+            break;
+        }
+        double t0 = MT_getTimeSec();
+        IplImage* frame = capture->getFrame();
+        m_dCaptureTime += MT_getTimeSec() - t0;
+        if(!pushFrame(frame))
+        {
+            break;
+        }
+        n_pushed++;
+        if(capture->getIsAtEnd())
+        {
+            break;
+        }
+    }
+
+    flush();
+    return n_pushed;
+}
+
+void MT_TrackerPipeline::flush()
+{
+    MT_TrackerPipelineFrame* f;
+    while((f = (MT_TrackerPipelineFrame*) m_Pipeline.pop()))
+    {
+        collect(f);
+    }
+}
+
+double MT_TrackerPipeline::getStepTime(int step) const
+{
+    if(step == MT_TP_CAPTURE)
+    {
+        return m_dCaptureTime;
+    }
+    if(step < 0 || step >= (int) m_vpStages.size())
+    {
+        return 0;
+    }
+    return ((const MT_TrackerPipelineStage*) m_vpStages[step])->m_dTime;
+}
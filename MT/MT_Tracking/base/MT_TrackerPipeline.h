@@ -0,0 +1,144 @@
+#ifndef MT_TRACKERPIPELINE_H
+#define MT_TRACKERPIPELINE_H
+
+/** @addtogroup MT_Tracking
+ * @{ */
+
+/** @file
+ *  MT_TrackerPipeline.h
+ *
+ *  @brief Runs a tracker's steps for consecutive frames at the same
+ *  time on separate threads.
+ *
+ */
+
+#include "MT/MT_Tracking/base/MT_TrackerBase.h"
+
+#include "MT/MT_Core/support/Pipeline.h"
+
+#include <vector>
+
+class MT_Capture;
+
+/** Steps of an MT_TrackerPipeline, in order.  MT_TP_CAPTURE is done
+ * by the thread that pushes frames and only timed by run. */
+enum MT_TP_STEP
+{
+    MT_TP_PREPROCESS = 0,
+    MT_TP_TRACK,
+    MT_TP_OUTPUT,
+    MT_TP_NUM_STEPS,
+    MT_TP_CAPTURE = MT_TP_NUM_STEPS
+};
+
+/** @class MT_TrackerPipelineFrame
+ *
+ * @brief One frame on its way through an MT_TrackerPipeline, along
+ * with whatever the tracker works out for it.
+ *
+ * The pipeline reuses these, so the tracker can keep buffers in
+ * m_vpImages from one use to the next.  They are released with the
+ * frame.
+ */
+class MT_TrackerPipelineFrame
+{
+public:
+    MT_TrackerPipelineFrame();
+    ~MT_TrackerPipelineFrame();
+
+    /** Copy of the captured frame, owned by this */
+    IplImage* m_pFrame;
+    /** Number of the frame, counting from zero */
+    int m_iNumber;
+    /** Buffers for the tracker, e.g. from doPipelinePreprocess.
+     * Released along with this. */
+    std::vector<IplImage*> m_vpImages;
+    /** Data from doPipelineTrack for doPipelineOutput */
+    std::vector<std::vector<double> > m_vvdData;
+    /** If the per-object rows of m_vvdData aren't in the order of
+     * the tracked objects (e.g. they're in the order the blobs were
+     * found), the tracked object of each element, -1 for none.
+     * Empty means that element j is tracked object j. */
+    std::vector<int> m_viDataTracks;
+
+private:
+    /* not copyable */
+    MT_TrackerPipelineFrame(const MT_TrackerPipelineFrame&);
+    MT_TrackerPipelineFrame& operator=(const MT_TrackerPipelineFrame&);
+};
+
+/** @class MT_TrackerPipeline
+ *
+ * @brief Feeds frames through a tracker's doPipelinePreprocess,
+ * doPipelineTrack and doPipelineOutput, each on its own thread.
+ *
+ * MT_TrackerFrameBase::doTrackerStep captures, tracks and writes one
+ * frame after the other, so the time per frame is the sum of the
+ * times of all of the steps.  Here the thread that pushes frames
+ * captures frame n + 2 while frame n + 1 is preprocessed, frame n
+ * tracked and frame n - 1 written out, so that the time per frame
+ * tends to that of the slowest step.  The steps see the frames in the
+ * order they were pushed, so the results are the same as running
+ * doTracking on each frame in turn.
+ *
+ * Frames are copied on the way in, since captures reuse their
+ * buffer.  At most a fixed number of frames are in the pipeline at
+ * once, after which pushFrame waits for the oldest to come out.
+ *
+ * Since the tracker is busy on other threads, it shouldn't be touched
+ * (e.g. drawn) between the first pushFrame and flush.
+ */
+class MT_TrackerPipeline
+{
+public:
+    /** queue_size frames can wait in front of each step */
+    MT_TrackerPipeline(MT_TrackerBase* tracker, int queue_size = 2);
+    /** Calls flush */
+    ~MT_TrackerPipeline();
+
+    /** Copies frame into the pipeline, waiting if it is full.
+     * Returns false if frame is NULL or can't be copied. */
+    bool pushFrame(const IplImage* frame);
+
+    /** Pushes frames from capture until it runs out of them or
+     * max_frames (if > 0) have been pushed, then calls flush.
+     * Returns the number of frames pushed. */
+    int run(MT_Capture* capture, int max_frames = -1);
+
+    /** Waits for every frame pushed so far to be written out */
+    void flush();
+
+    /** Number of frames that have been through every step */
+    int getNumFramesDone() const {return m_iFramesDone;};
+
+    /** Total seconds spent in step (an MT_TP_STEP) so far.  The steps
+     * overlap, so these add up to more than the time taken.  Only
+     * up to date after flush. */
+    double getStepTime(int step) const;
+
+private:
+    /* not copyable */
+    MT_TrackerPipeline(const MT_TrackerPipeline&);
+    MT_TrackerPipeline& operator=(const MT_TrackerPipeline&);
+
+    /* takes a frame out of the pipeline once all steps are done */
+    void collect(MT_TrackerPipelineFrame* frame);
+
+    MT_TrackerBase* m_pTracker;
+
+    MT_Pipeline m_Pipeline;
+    std::vector<MT_PipelineStage*> m_vpStages;
+    double m_dCaptureTime;
+
+    /* every frame ever made, and the ones not in the pipeline */
+    std::vector<MT_TrackerPipelineFrame*> m_vpFrames;
+    std::vector<MT_TrackerPipelineFrame*> m_vpFreeFrames;
+    unsigned int m_iMaxFrames;
+
+    int m_iFramesPushed;
+    int m_iFramesDone;
+};
+
+/** @} */
+
+#endif // MT_TRACKERPIPELINE_H
@@ -70,6 +70,7 @@
 
 #include <map>
 #include <vector>
+#include <string>
 
 
 // Defines to make capture options more readable
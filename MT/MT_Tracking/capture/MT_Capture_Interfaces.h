@@ -16,7 +16,9 @@
  */
 
 #include "MT_Capture.h"
+#ifdef MT_HAVE_AVT
 #include "MT_AVTCameraDialog.h"
+#endif
 
 #include <map>
 #include <string>
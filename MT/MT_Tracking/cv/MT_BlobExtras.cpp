@@ -9,3 +9,84 @@
 
 #include "MT_BlobExtras.h"
 
+
+/* resizes v to n if the feature is wanted, otherwise empties it
+ * (clear/resize keep the vector's capacity, so there is no
+ * reallocation from frame to frame) */
+static void prepFeatureVector(std::vector<double>* v,
+                              unsigned int n,
+                              bool wanted)
+{
+    if(wanted)
+    {
+        v->resize(n);
+    }
+    else
+    {
+        v->clear();
+    }
+}
+
+void MT_GetBlobFeatures(CBlobResult& blobs,
+                        MT_BlobFeatures* features,
+                        unsigned int flags)
+{
+    if(!features)
+    {
+        return;
+    }
+
+    bool do_xy = (flags & MT_BLOB_FEATURE_XY) != 0;
+    bool do_area = (flags & MT_BLOB_FEATURE_AREA) != 0;
+    bool do_perimeter = (flags & MT_BLOB_FEATURE_PERIMETER) != 0;
+    bool do_orientation = (flags & MT_BLOB_FEATURE_ORIENTATION) != 0;
+    bool do_axes = (flags & MT_BLOB_FEATURE_AXES) != 0;
+
+    unsigned int n = blobs.GetNumBlobs();
+    features->m_iNBlobs = n;
+
+    prepFeatureVector(&features->m_vdX, n, do_xy);
+    prepFeatureVector(&features->m_vdY, n, do_xy);
+    prepFeatureVector(&features->m_vdArea, n, do_area);
+    prepFeatureVector(&features->m_vdPerimeter, n, do_perimeter);
+    prepFeatureVector(&features->m_vdOrientation, n, do_orientation);
+    prepFeatureVector(&features->m_vdMajorAxis, n, do_axes);
+    prepFeatureVector(&features->m_vdMinorAxis, n, do_axes);
+
+    CBlob* blob;
+    CvBox2D ellipse;
+    for(unsigned int i = 0; i < n; i++)
+    {
+        blob = blobs.GetBlob(i);
+
+        /* the ellipse fit (and the moments behind it) gets cached in
+         * the blob, so the orientation below reuses it */
+        if(do_xy || do_axes)
+        {
+            ellipse = blob->GetEllipse();
+        }
+
+        if(do_xy)
+        {
+            features->m_vdX[i] = ellipse.center.x;
+            features->m_vdY[i] = ellipse.center.y;
+        }
+        if(do_area)
+        {
+            features->m_vdArea[i] = blob->Area();
+        }
+        if(do_perimeter)
+        {
+            features->m_vdPerimeter[i] = blob->Perimeter();
+        }
+        if(do_orientation)
+        {
+            features->m_vdOrientation[i] = MT_BlobHeadOrientation(*blob);
+        }
+        if(do_axes)
+        {
+            features->m_vdMajorAxis[i] = ellipse.size.width;
+            features->m_vdMinorAxis[i] = ellipse.size.height;
+        }
+    }
+}
@@ -21,6 +21,62 @@
 // for MT_DEG2RAD and MT_RAD2DEG
 #include "MT/MT_Core/support/mathsupport.h"
 
+#include <vector>
+
+/* Calculates the "true" orientation of a blob based on its skewness.
+   Algorithm inspired by work by Adrian DeFroment.  This is designed for a
+   fish-like object where the head should be fatter than the tail,
+   therefore the distribution of pixels along the body axis should be
+   skewed towards the tail.
+
+   Shared by MT_CBlobGetHeadOrientation and MT_GetBlobFeatures so that
+   both give identical results. */
+inline double MT_BlobHeadOrientation(CBlob &blob)
+{
+    // we need the direction vector for the ellipse-fit orientation
+    CvBox2D ellipse = blob.GetEllipse();
+      
+    // the center of mass
+    double xcm = ellipse.center.x;
+    double ycm = ellipse.center.y;
+      
+    double m00 = blob.Moment(0,0);
+      
+    double m10 = blob.Moment(1,0);
+    double m01 = blob.Moment(0,1);
+    double m11 = blob.Moment(1,1);
+      
+    double m20 = blob.Moment(2,0);
+    double m02 = blob.Moment(0,2);
+    double m12 = blob.Moment(1,2);
+    double m21 = blob.Moment(2,1);
+      
+    double m30 = blob.Moment(3,0);
+    double m03 = blob.Moment(0,3);
+      
+    double u20p = (m20/m00) - xcm*xcm;
+    double u02p = (m02/m00) - ycm*ycm;
+    double u11p = (m11/m00) - xcm*ycm;
+      
+    double myangle =  180.0 - MT_RAD2DEG*0.5*atan2( (2.0)*u11p, u20p-u02p );
+      
+    double u30 = m30 - 3.0*xcm*m20 + 2.0*xcm*xcm*m10;
+    double u21 = m21 - 2.0*xcm*m11 - ycm*m20 + 2.0*xcm*xcm*m01;
+    double u12 = m12 - 2.0*ycm*m11 - xcm*m02 + 2.0*ycm*ycm*m10;
+    double u03 = m03 - 3*ycm*m02 + 2*ycm*ycm*m01;
+    double qx = cos(MT_DEG2RAD*myangle);
+    double qy = -sin(MT_DEG2RAD*myangle);
+      
+    double s = u30*qx*qx*qx + 3.0*u21*qx*qx*qy + 3.0*u12*qx*qy*qy + u03*qy*qy*qy;
+      
+    if(s > 0)
+    {
+        myangle += 180.0;
+    }
+      
+    return myangle;
+}
+
 /* Class to calculate the ratio of the second order moments (related to
    eccentricity).   Returns either u20/u02 or u02/u20, which ever is > 1,
    where u20 and u02 are the second-order centralized moments.
@@ -62,9 +118,7 @@ public:
 
 
 /* Class to calculate the "true" orientation of a blob based on its skewness.
-   Algorithm inspired by work by Adrian DeFroment.  This is designed for a fish-like
-   object where the head should be fatter than the tail, therefore the distribution
-   of pixels along the body axis should be skewed towards the tail. 
+   See MT_BlobHeadOrientation above.
  
    Based on the COperadorBlob class by Inspecta S.L.  Allows us to use all of the built-in
    classes in CBlobsLib.
@@ -77,48 +131,7 @@ public:
     
     double operator()( CBlob &blob)
     {
-        // we need the direction vector for the ellipse-fit orientation
-        CvBox2D ellipse = blob.GetEllipse();
-      
-        // the center of mass
-        double xcm = ellipse.center.x;
-        double ycm = ellipse.center.y;
-      
-        double m00 = blob.Moment(0,0);
-      
-        double m10 = blob.Moment(1,0);
-        double m01 = blob.Moment(0,1);
-        double m11 = blob.Moment(1,1);
-      
-        double m20 = blob.Moment(2,0);
-        double m02 = blob.Moment(0,2);
-        double m12 = blob.Moment(1,2);
-        double m21 = blob.Moment(2,1);
-      
-        double m30 = blob.Moment(3,0);
-        double m03 = blob.Moment(0,3);
-      
-        double u20p = (m20/m00) - xcm*xcm;
-        double u02p = (m02/m00) - ycm*ycm;
-        double u11p = (m11/m00) - xcm*ycm;
-      
-        double myangle =  180.0 - MT_RAD2DEG*0.5*atan2( (2.0)*u11p, u20p-u02p );
-      
-        double u30 = m30 - 3.0*xcm*m20 + 2.0*xcm*xcm*m10;
-        double u21 = m21 - 2.0*xcm*m11 - ycm*m20 + 2.0*xcm*xcm*m01;
-        double u12 = m12 - 2.0*ycm*m11 - xcm*m02 + 2.0*ycm*ycm*m10;
-        double u03 = m03 - 3*ycm*m02 + 2*ycm*ycm*m01;
-        double qx = cos(MT_DEG2RAD*myangle);
-        double qy = -sin(MT_DEG2RAD*myangle);
-      
-        double s = u30*qx*qx*qx + 3.0*u21*qx*qx*qy + 3.0*u12*qx*qy*qy + u03*qy*qy*qy;
-      
-        if(s > 0)
-        {
-            myangle += 180.0;
-        }
-      
-        return myangle;
+        return MT_BlobHeadOrientation(blob);
     }
     const char *GetNom() 
     {
@@ -178,4 +191,46 @@ public:
     }
 };
 
+/* Flags selecting which features MT_GetBlobFeatures computes. */
+enum
+{
+    MT_BLOB_FEATURE_XY = 0x01,           /* center of mass */
+    MT_BLOB_FEATURE_AREA = 0x02,
+    MT_BLOB_FEATURE_PERIMETER = 0x04,
+    MT_BLOB_FEATURE_ORIENTATION = 0x08,  /* MT_BlobHeadOrientation */
+    MT_BLOB_FEATURE_AXES = 0x10,         /* ellipse major/minor axes */
+    MT_BLOB_FEATURE_ALL = 0x1F
+};
+
+/* Structure-of-arrays holding per-blob features, filled in by
+   MT_GetBlobFeatures.  Element i of each vector corresponds to
+   blob i of the CBlobResult.  Vectors for features that were not
+   requested are left empty.  Keep one of these around between
+   frames so that the vectors' storage gets reused. */
+class MT_BlobFeatures
+{
+public:
+    MT_BlobFeatures() : m_iNBlobs(0) {};
+
+    unsigned int m_iNBlobs;
+    
+    std::vector<double> m_vdX;
+    std::vector<double> m_vdY;
+    std::vector<double> m_vdArea;
+    std::vector<double> m_vdPerimeter;
+    std::vector<double> m_vdOrientation;
+    std::vector<double> m_vdMajorAxis;
+    std::vector<double> m_vdMinorAxis;
+};
+
+/* Computes the features selected by flags (MT_BLOB_FEATURE_* OR'd
+   together) for every blob in blobs in a single pass, writing them to
+   features.  Each blob's moments and ellipse fit are evaluated once and
+   shared among the features, so this is equivalent to (but cheaper than)
+   one GetSTLResult call per feature with CBlobGetArea,
+   CBlobGetPerimeter, MT_CBlobGetXCenterOfMass, etc. */
+void MT_GetBlobFeatures(CBlobResult& blobs,
+                        MT_BlobFeatures* features,
+                        unsigned int flags = MT_BLOB_FEATURE_ALL);
+
 #endif // BLOBEXTRAS_H
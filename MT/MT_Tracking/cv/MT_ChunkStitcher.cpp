@@ -0,0 +1,128 @@
+/*
+ *  MT_ChunkStitcher.cpp
+ *
+ *  See MT_ChunkStitcher.h
+ *
+ */
+
+#include "MT/MT_Tracking/cv/MT_ChunkStitcher.h"
+
+#include <math.h>
+
+#include "MT/MT_Core/support/mathsupport.h"
+
+MT_ChunkStitcher::MT_ChunkStitcher()
+    : m_dMaxCost(2500.0),   /* within 50 px */
+      m_iNumIdentities(0),
+      m_iNumMatched(0),
+      m_dRMSDistance(0)
+{
+}
+
+void MT_ChunkStitcher::reset()
+{
+    m_viIdentity.resize(0);
+    m_iNumIdentities = 0;
+    m_iNumMatched = 0;
+    m_dRMSDistance = 0;
+}
+
+const std::vector<int>& MT_ChunkStitcher::addChunk(unsigned int n_objects)
+{
+    m_viIdentity.resize(n_objects);
+    for(unsigned int j = 0; j < n_objects; j++)
+    {
+        m_viIdentity[j] = m_iNumIdentities++;
+    }
+    m_iNumMatched = 0;
+    m_dRMSDistance = 0;
+    return m_viIdentity;
+}
+
+const std::vector<int>& MT_ChunkStitcher::addChunk(
+    unsigned int n_objects,
+    const std::vector<std::vector<double> >& prev_x,
+    const std::vector<std::vector<double> >& prev_y,
+    const std::vector<std::vector<double> >& next_x,
+    const std::vector<std::vector<double> >& next_y)
+{
+    unsigned int np = m_viIdentity.size();
+    unsigned int nn = n_objects;
+    if(np == 0 || nn == 0)
+    {
+        return addChunk(n_objects);
+    }
+
+    /* mean squared distance in the overlap of each pair */
+    m_vdSum.assign(nn*np, 0.0);
+    m_viCount.assign(nn*np, 0);
+    unsigned int nf = MT_MIN(MT_MIN(prev_x.size(), prev_y.size()),
+                             MT_MIN(next_x.size(), next_y.size()));
+    for(unsigned int f = 0; f < nf; f++)
+    {
+        unsigned int fp = MT_MIN(MT_MIN(prev_x[f].size(), prev_y[f].size()), np);
+        unsigned int fn = MT_MIN(MT_MIN(next_x[f].size(), next_y[f].size()), nn);
+        for(unsigned int j = 0; j < fn; j++)
+        {
+            double xj = next_x[f][j];
+            double yj = next_y[f][j];
+            if(MT_isnan(xj) || MT_isnan(yj))
+            {
+                continue;
+            }
+            for(unsigned int i = 0; i < fp; i++)
+            {
+                double dx = xj - prev_x[f][i];
+                double dy = yj - prev_y[f][i];
+                double d2 = dx*dx + dy*dy;
+                if(!MT_isnan(d2))
+                {
+                    m_vdSum[j*np + i] += d2;
+                    m_viCount[j*np + i]++;
+                }
+            }
+        }
+    }
+
+    /* Rows are the new chunk's objects, columns the last chunk's
+     * then one "new identity" column per object, as in
+     * MT_TrackAssigner.  Pairs never seen together can't match. */
+    unsigned int nc = np + nn;
+    m_vdCost.resize(nn*nc);
+    for(unsigned int j = 0; j < nn; j++)
+    {
+        double* row = &m_vdCost[j*nc];
+        for(unsigned int i = 0; i < np; i++)
+        {
+            int n = m_viCount[j*np + i];
+            row[i] = n ? m_vdSum[j*np + i]/n - m_dMaxCost : 0;
+        }
+        for(unsigned int i = np; i < nc; i++)
+        {
+            row[i] = 0;
+        }
+    }
+    m_LAPJV.solve(&m_vdCost[0], nn, nc, &m_viAssignment);
+
+    std::vector<int> prev_identity = m_viIdentity;
+    m_viIdentity.resize(nn);
+    m_iNumMatched = 0;
+    double sum = 0;
+    for(unsigned int j = 0; j < nn; j++)
+    {
+        int i = m_viAssignment[j];
+        if(i >= 0 && i < (int) np && m_vdCost[j*nc + i] < 0)
+        {
+            m_viIdentity[j] = prev_identity[i];
+            sum += m_vdCost[j*nc + i] + m_dMaxCost;
+            m_iNumMatched++;
+        }
+        else
+        {
+            m_viIdentity[j] = m_iNumIdentities++;
+        }
+    }
+    m_dRMSDistance = m_iNumMatched ? sqrt(sum/m_iNumMatched) : 0;
+
+    return m_viIdentity;
+}
@@ -0,0 +1,108 @@
+#ifndef MT_ChunkStitcher_H
+#define MT_ChunkStitcher_H
+
+/*
+ *  MT_ChunkStitcher.h
+ *
+ *  Identity matching between overlapping time chunks of tracking.
+ *
+ */
+
+#include <vector>
+
+#include "MT/MT_Tracking/cv/MT_LAPJV.h"
+
+/**
+ * @class MT_ChunkStitcher
+ *
+ * @brief Joins the objects tracked in consecutive time chunks of a
+ * video into identities that run through the whole video.
+ *
+ * When a video is cut into chunks that are tracked separately (see
+ * MT_ChunkedTracker), each chunk numbers its objects its own way.
+ * Consecutive chunks are tracked over a few frames in common (the
+ * overlap), and over those frames the same animal should be in the
+ * same place in both.  addChunk compares the positions in the
+ * overlap, object by object, and solves the assignment of the new
+ * chunk's objects to the previous chunk's (with MT_LAPJV) for the
+ * least total mean squared distance, so that one object can't take
+ * another's identity because it happens to be closest to it.
+ *
+ * As with MT_TrackAssigner, an object only keeps an identity if its
+ * mean squared distance to it is less than m_dMaxCost.  Others (e.g.
+ * an object that only turns up in the new chunk) get a new identity,
+ * and identities without an object in the new chunk end.
+ *
+ * Positions are one vector per overlap frame, one element per object
+ * (i.e. rows of an XDF stream).  NaNs, and objects missing from a
+ * frame, are left out of the means.
+ *
+ * Usage:
+ * @code
+ * MT_ChunkStitcher stitcher;
+ * stitcher.addChunk(n_objects_0);   // identities 0 .. n - 1
+ * for(k = 1; k < n_chunks; k++)
+ * {
+ *     stitcher.addChunk(n_objects_k,
+ *                       x_prev, y_prev,   // chunk k - 1 in the overlap
+ *                       x_next, y_next);  // chunk k in the overlap
+ *     // object i of chunk k is identity stitcher.getIdentities()[i]
+ * }
+ * @endcode
+ */
+class MT_ChunkStitcher
+{
+public:
+    MT_ChunkStitcher();
+
+    /** Largest mean squared distance [px^2] between two objects in
+     * the overlap for them to be the same */
+    double m_dMaxCost;
+
+    /** Forgets the chunks so far (identities start from 0 again) */
+    void reset();
+
+    /** Adds the first chunk, or one that doesn't overlap the last:
+     * its objects all get new identities. */
+    const std::vector<int>& addChunk(unsigned int n_objects);
+
+    /** Adds the next chunk, matching its n_objects objects to the
+     * last chunk's by their positions in the frames the two have in
+     * common.  prev_x[f][i] is the x position of object i of the last
+     * chunk in overlap frame f, next_x[f][j] that of object j of this
+     * chunk, and so on.  Returns getIdentities(). */
+    const std::vector<int>& addChunk(
+        unsigned int n_objects,
+        const std::vector<std::vector<double> >& prev_x,
+        const std::vector<std::vector<double> >& prev_y,
+        const std::vector<std::vector<double> >& next_x,
+        const std::vector<std::vector<double> >& next_y);
+
+    /** Identity of each object of the last chunk added */
+    const std::vector<int>& getIdentities() const {return m_viIdentity;};
+    /** Number of identities so far */
+    int getNumIdentities() const {return m_iNumIdentities;};
+
+    /** For the last chunk added:  number of its objects that kept an
+     * identity, and their RMS distance [px] in the overlap.  A large
+     * distance means the chunks didn't agree well, e.g. the overlap
+     * was too short for the new chunk's tracker to settle. */
+    int getNumMatched() const {return m_iNumMatched;};
+    double getRMSDistance() const {return m_dRMSDistance;};
+
+private:
+    MT_LAPJV m_LAPJV;
+
+    std::vector<int> m_viIdentity;
+    int m_iNumIdentities;
+    int m_iNumMatched;
+    double m_dRMSDistance;
+
+    /* sums over the overlap frames, n_next x n_prev */
+    std::vector<double> m_vdSum;
+    std::vector<int> m_viCount;
+    std::vector<double> m_vdCost;
+    std::vector<int> m_viAssignment;
+};
+
+#endif // MT_ChunkStitcher_H
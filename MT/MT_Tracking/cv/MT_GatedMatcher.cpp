@@ -0,0 +1,362 @@
+/*
+ *  MT_GatedMatcher.cpp
+ *
+ *  See MT_GatedMatcher.h
+ *
+ */
+
+#include "MT/MT_Tracking/cv/MT_GatedMatcher.h"
+
+#include <math.h>
+
+MT_GatedMatcher::MT_GatedMatcher()
+    : m_dCellSize(1.0),
+      m_iHashMask(0),
+      m_iNumSubproblems(0),
+      m_iLargestSubproblem(0)
+{
+}
+
+unsigned int MT_GatedMatcher::hashCell(int cx, int cy) const
+{
+    return (((unsigned int) cx)*73856093u ^ ((unsigned int) cy)*19349663u) & m_iHashMask;
+}
+
+void MT_GatedMatcher::hashDetections(const std::vector<double>& xs,
+                                     const std::vector<double>& ys,
+                                     double cell_size)
+{
+    unsigned int n = xs.size();
+    unsigned int nbuckets = 1;
+    while(nbuckets < 2*n)
+    {
+        nbuckets *= 2;
+    }
+    m_iHashMask = nbuckets - 1;
+    m_dCellSize = cell_size;
+
+    /* counting sort of the detections by bucket */
+    m_viBucketStart.assign(nbuckets + 1, 0);
+    m_viDetBucket.resize(n);
+    for(unsigned int i = 0; i < n; i++)
+    {
+        unsigned int b = hashCell((int) floor(xs[i]/cell_size),
+                                  (int) floor(ys[i]/cell_size));
+        m_viDetBucket[i] = b;
+        m_viBucketStart[b + 1]++;
+    }
+    for(unsigned int b = 0; b < nbuckets; b++)
+    {
+        m_viBucketStart[b + 1] += m_viBucketStart[b];
+    }
+    m_viBucketDets.resize(n);
+    /* m_viDetStamp as the fill position for now */
+    m_viDetStamp.assign(m_viBucketStart.begin(), m_viBucketStart.end() - 1);
+    for(unsigned int i = 0; i < n; i++)
+    {
+        m_viBucketDets[m_viDetStamp[m_viDetBucket[i]]++] = i;
+    }
+}
+
+int MT_GatedMatcher::findRoot(int k)
+{
+    while(m_viParent[k] != k)
+    {
+        m_viParent[k] = m_viParent[m_viParent[k]];
+        k = m_viParent[k];
+    }
+    return k;
+}
+
+static double squared_distance(double x, double y, const MT_GatedTrack& t)
+{
+    double dx = x - t.x;
+    double dy = y - t.y;
+    return dx*dx + dy*dy;
+}
+
+static bool has_gate(const MT_GatedTrack& t)
+{
+    return (t.gate_pxx > 0) && (t.gate_pyy > 0) && (t.gate_k > 0)
+        && (t.gate_pxx*t.gate_pyy - t.gate_pxy*t.gate_pxy > 0);
+}
+
+/* half-widths of the bounding box of t's gate */
+static double gate_rx(const MT_GatedTrack& t)
+{
+    return t.gate_k*sqrt(t.gate_pxx);
+}
+
+static double gate_ry(const MT_GatedTrack& t)
+{
+    return t.gate_k*sqrt(t.gate_pyy);
+}
+
+/* d' P^-1 d <= k^2, for a track with a gate */
+static bool in_gate(double x, double y, const MT_GatedTrack& t)
+{
+    double dx = x - t.gate_x;
+    double dy = y - t.gate_y;
+    double det = t.gate_pxx*t.gate_pyy - t.gate_pxy*t.gate_pxy;
+    double q = t.gate_pyy*dx*dx - 2.0*t.gate_pxy*dx*dy + t.gate_pxx*dy*dy;
+    return q <= t.gate_k*t.gate_k*det;
+}
+
+void MT_GatedMatcher::listByComponent(int first,
+                                      int count,
+                                      int ncomps,
+                                      std::vector<int>* start,
+                                      std::vector<int>* members)
+{
+    /* counting sort by component, leaving out the nodes in none */
+    start->assign(ncomps + 1, 0);
+    for(int k = 0; k < count; k++)
+    {
+        int c = m_viCompOf[first + k];
+        if(c >= 0)
+        {
+            (*start)[c + 1]++;
+        }
+    }
+    for(int c = 0; c < ncomps; c++)
+    {
+        (*start)[c + 1] += (*start)[c];
+    }
+    members->resize((*start)[ncomps]);
+    m_viFill.assign(start->begin(), start->end() - 1);
+    for(int k = 0; k < count; k++)
+    {
+        int c = m_viCompOf[first + k];
+        if(c >= 0)
+        {
+            (*members)[m_viFill[c]++] = k;
+        }
+    }
+}
+
+void MT_GatedMatcher::solveDense(const std::vector<double>& xs,
+                                 const std::vector<double>& ys,
+                                 const std::vector<MT_GatedTrack>& tracks,
+                                 const int* dets,
+                                 unsigned int nd,
+                                 const int* trks,
+                                 unsigned int nt,
+                                 bool gated,
+                                 std::vector<int>* assignment)
+{
+    m_vdCost.resize(nd*nt);
+    double maxcost = 0;
+    for(unsigned int a = 0; a < nd; a++)
+    {
+        int i = dets[a];
+        for(unsigned int b = 0; b < nt; b++)
+        {
+            const MT_GatedTrack& t = tracks[trks[b]];
+            double c = squared_distance(xs[i], ys[i], t);
+            if(gated && (!has_gate(t) || !in_gate(xs[i], ys[i], t)))
+            {
+                c = -1.0;   /* outside the gate, see below */
+            }
+            m_vdCost[a*nt + b] = c;
+            maxcost = (c > maxcost) ? c : maxcost;
+        }
+    }
+
+    /* pairs outside the gates cost more than any set of gated pairs,
+     * so the solver uses as many gated pairs as it can */
+    double outside = (maxcost + 1.0)*((nd < nt ? nd : nt) + 1);
+    if(gated)
+    {
+        for(unsigned int k = 0; k < nd*nt; k++)
+        {
+            if(m_vdCost[k] < 0)
+            {
+                m_vdCost[k] = outside;
+            }
+        }
+    }
+
+    m_LAPJV.solve(&m_vdCost[0], nd, nt, &m_viSubAssignment);
+
+    for(unsigned int a = 0; a < nd; a++)
+    {
+        int b = m_viSubAssignment[a];
+        if(b >= 0 && (!gated || m_vdCost[a*nt + b] < outside))
+        {
+            (*assignment)[dets[a]] = trks[b];
+        }
+    }
+}
+
+unsigned int MT_GatedMatcher::doMatch(const std::vector<double>& xs,
+                                      const std::vector<double>& ys,
+                                      const std::vector<MT_GatedTrack>& tracks,
+                                      std::vector<int>* assignment)
+{
+    int n = xs.size();
+    int m = tracks.size();
+    assignment->assign(n, -1);
+    m_iNumSubproblems = 0;
+    m_iLargestSubproblem = 0;
+    if(n == 0 || m == 0)
+    {
+        return 0;
+    }
+
+    /* cells about the size of an average gate */
+    double cell_size = 0;
+    int ngates = 0;
+    for(int j = 0; j < m; j++)
+    {
+        if(has_gate(tracks[j]))
+        {
+            double rx = gate_rx(tracks[j]);
+            double ry = gate_ry(tracks[j]);
+            cell_size += (rx > ry) ? rx : ry;
+            ngates++;
+        }
+    }
+    cell_size /= (ngates > 0) ? ngates : 1;
+    if(!(cell_size >= 1.0))
+    {
+        cell_size = 1.0;
+    }
+    hashDetections(xs, ys, cell_size);
+
+    /* candidate pairs:  each track looks at the detections in the
+     * buckets under its gate's bounding box (m_viDetStamp avoids
+     * looking twice when cells share a bucket) */
+    m_viEdgeDet.resize(0);
+    m_viEdgeTrk.resize(0);
+    m_viDetStamp.assign(n, -1);
+    double nbuckets = (double) (m_iHashMask + 1);
+    for(int j = 0; j < m; j++)
+    {
+        const MT_GatedTrack& t = tracks[j];
+        if(!has_gate(t))
+        {
+            continue;
+        }
+        double rx = gate_rx(t);
+        double ry = gate_ry(t);
+        double cx0 = floor((t.gate_x - rx)/cell_size);
+        double cx1 = floor((t.gate_x + rx)/cell_size);
+        double cy0 = floor((t.gate_y - ry)/cell_size);
+        double cy1 = floor((t.gate_y + ry)/cell_size);
+        bool scan_all = ((cx1 - cx0 + 1)*(cy1 - cy0 + 1) >= nbuckets);
+
+        int ncells = scan_all ? 1 : (int) ((cx1 - cx0 + 1)*(cy1 - cy0 + 1));
+        for(int c = 0; c < ncells; c++)
+        {
+            unsigned int start, end;
+            if(scan_all)
+            {
+                start = 0;
+                end = n;
+            }
+            else
+            {
+                int w = (int) (cx1 - cx0 + 1);
+                unsigned int b = hashCell((int) cx0 + c % w, (int) cy0 + c/w);
+                start = m_viBucketStart[b];
+                end = m_viBucketStart[b + 1];
+            }
+            for(unsigned int k = start; k < end; k++)
+            {
+                int i = m_viBucketDets[k];
+                if(m_viDetStamp[i] == j)
+                {
+                    continue;
+                }
+                m_viDetStamp[i] = j;
+                if(in_gate(xs[i], ys[i], t))
+                {
+                    m_viEdgeDet.push_back(i);
+                    m_viEdgeTrk.push_back(j);
+                }
+            }
+        }
+    }
+    unsigned int nedges = m_viEdgeDet.size();
+
+    /* connected components of the candidate pairs */
+    m_viParent.resize(n + m);
+    for(int k = 0; k < n + m; k++)
+    {
+        m_viParent[k] = k;
+    }
+    for(unsigned int e = 0; e < nedges; e++)
+    {
+        int a = findRoot(m_viEdgeDet[e]);
+        int b = findRoot(n + m_viEdgeTrk[e]);
+        if(a != b)
+        {
+            m_viParent[a] = b;
+        }
+    }
+
+    /* number the components that have a pair, then list their
+     * detections and tracks */
+    m_viCompOf.assign(n + m, -1);
+    int ncomps = 0;
+    for(unsigned int e = 0; e < nedges; e++)
+    {
+        int r = findRoot(m_viEdgeDet[e]);
+        if(m_viCompOf[r] < 0)
+        {
+            m_viCompOf[r] = ncomps++;
+        }
+    }
+    for(int k = 0; k < n + m; k++)
+    {
+        m_viCompOf[k] = m_viCompOf[findRoot(k)];
+    }
+    m_iNumSubproblems = ncomps;
+
+    listByComponent(0, n, ncomps, &m_viDetStart, &m_viCompDets);
+    listByComponent(n, m, ncomps, &m_viTrkStart, &m_viCompTrks);
+
+    for(int c = 0; c < ncomps; c++)
+    {
+        int nd = m_viDetStart[c + 1] - m_viDetStart[c];
+        int nt = m_viTrkStart[c + 1] - m_viTrkStart[c];
+        unsigned int size = nd + nt;
+        m_iLargestSubproblem = (size > m_iLargestSubproblem) ? size : m_iLargestSubproblem;
+        solveDense(xs, ys, tracks,
+                   &m_viCompDets[m_viDetStart[c]], nd,
+                   &m_viCompTrks[m_viTrkStart[c]], nt,
+                   true, assignment);
+    }
+
+    /* whatever is left over gets matched without gates */
+    m_viTrackUsed.assign(m, 0);
+    m_viCompDets.resize(0);
+    m_viCompTrks.resize(0);
+    for(int i = 0; i < n; i++)
+    {
+        if((*assignment)[i] >= 0)
+        {
+            m_viTrackUsed[(*assignment)[i]] = 1;
+        }
+        else
+        {
+            m_viCompDets.push_back(i);
+        }
+    }
+    for(int j = 0; j < m; j++)
+    {
+        if(!m_viTrackUsed[j])
+        {
+            m_viCompTrks.push_back(j);
+        }
+    }
+    if(m_viCompDets.size() > 0 && m_viCompTrks.size() > 0)
+    {
+        solveDense(xs, ys, tracks,
+                   &m_viCompDets[0], m_viCompDets.size(),
+                   &m_viCompTrks[0], m_viCompTrks.size(),
+                   false, assignment);
+    }
+
+    return nedges;
+}
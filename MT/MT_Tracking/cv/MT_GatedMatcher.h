@@ -0,0 +1,137 @@
+#ifndef MT_GatedMatcher_H
+#define MT_GatedMatcher_H
+
+/*
+ *  MT_GatedMatcher.h
+ *
+ *  Sparse detection-to-track assignment.
+ *
+ */
+
+#include <vector>
+
+#include "MT/MT_Tracking/cv/MT_LAPJV.h"
+
+/** A track for MT_GatedMatcher.  The cost of matching a detection to
+ * the track is the squared distance from (x, y).  The detection is
+ * only considered if it is inside the gate, the ellipse of points d
+ * from (gate_x, gate_y) (e.g. the predicted position) with
+ * d' P^-1 d <= gate_k^2, where P = [gate_pxx gate_pxy; gate_pxy
+ * gate_pyy] (e.g. the covariance of the predicted position, with
+ * gate_k the number of standard deviations).  A circle of radius r is
+ * gate_pxx = gate_pyy = r^2, gate_pxy = 0 and gate_k = 1.  Tracks
+ * whose P isn't positive definite have no gate. */
+struct MT_GatedTrack
+{
+    double x;
+    double y;
+    double gate_x;
+    double gate_y;
+    double gate_pxx;
+    double gate_pxy;
+    double gate_pyy;
+    double gate_k;
+};
+
+/**
+ * @class MT_GatedMatcher
+ *
+ * @brief Detection-to-track assignment over the pairs within each
+ * track's gate.
+ *
+ * The detections are bucketed in a uniform spatial hash so that each
+ * track only looks at the detections near it.  The pairs within the
+ * gates make a bipartite graph, each connected component of which is
+ * solved on its own with MT_LAPJV.  For tracks that are spread out
+ * this takes roughly linear time instead of cubic.
+ *
+ * Detections and tracks left over (outside every gate, or losing out
+ * within their component) are then matched among themselves with
+ * the full cost matrix, so with as many detections as tracks the
+ * result is still a one-to-one assignment.  It is the same as the
+ * dense solution whenever the dense solution only uses gated pairs.
+ *
+ * Work arrays are kept between calls.
+ */
+class MT_GatedMatcher
+{
+public:
+    MT_GatedMatcher();
+
+    /** Matches detections (xs[i], ys[i]) to tracks.
+     *
+     * @param assignment Resized to the number of detections;
+     *              assignment[i] is the track matched to detection i,
+     *              or -1 if there are more detections than tracks.
+     *
+     * @return The number of candidate (gated) pairs. */
+    unsigned int doMatch(const std::vector<double>& xs,
+                         const std::vector<double>& ys,
+                         const std::vector<MT_GatedTrack>& tracks,
+                         std::vector<int>* assignment);
+
+    /** Number of connected subproblems in the last doMatch */
+    unsigned int getNumSubproblems() const {return m_iNumSubproblems;};
+    /** Size (detections + tracks) of the largest subproblem in the
+     * last doMatch */
+    unsigned int getLargestSubproblem() const {return m_iLargestSubproblem;};
+
+private:
+    void hashDetections(const std::vector<double>& xs,
+                        const std::vector<double>& ys,
+                        double cell_size);
+    unsigned int hashCell(int cx, int cy) const;
+    int findRoot(int k);
+    void listByComponent(int first,
+                         int count,
+                         int ncomps,
+                         std::vector<int>* start,
+                         std::vector<int>* members);
+    /* solves the problem of the detections dets and tracks trks, only
+     * over pairs within the gates if gated */
+    void solveDense(const std::vector<double>& xs,
+                    const std::vector<double>& ys,
+                    const std::vector<MT_GatedTrack>& tracks,
+                    const int* dets,
+                    unsigned int nd,
+                    const int* trks,
+                    unsigned int nt,
+                    bool gated,
+                    std::vector<int>* assignment);
+
+    MT_LAPJV m_LAPJV;
+
+    /* spatial hash:  detections in bucket b are
+     * m_viBucketDets[m_viBucketStart[b] .. m_viBucketStart[b + 1]) */
+    double m_dCellSize;
+    unsigned int m_iHashMask;
+    std::vector<unsigned int> m_viBucketStart;
+    std::vector<int> m_viBucketDets;
+    std::vector<unsigned int> m_viDetBucket;
+    std::vector<int> m_viDetStamp;
+
+    /* candidate pairs */
+    std::vector<int> m_viEdgeDet;
+    std::vector<int> m_viEdgeTrk;
+
+    /* union-find over detections (0..n-1) then tracks (n..n+m-1),
+     * and the component (subproblem) of each, -1 for none */
+    std::vector<int> m_viParent;
+    std::vector<int> m_viCompOf;
+
+    /* detections and tracks of subproblem c are
+     * m_viCompDets[m_viDetStart[c] .. m_viDetStart[c + 1]), etc. */
+    std::vector<int> m_viDetStart;
+    std::vector<int> m_viCompDets;
+    std::vector<int> m_viTrkStart;
+    std::vector<int> m_viCompTrks;
+    std::vector<int> m_viFill;
+    std::vector<double> m_vdCost;
+    std::vector<int> m_viSubAssignment;
+    std::vector<int> m_viTrackUsed;
+
+    unsigned int m_iNumSubproblems;
+    unsigned int m_iLargestSubproblem;
+};
+
+#endif // MT_GatedMatcher_H
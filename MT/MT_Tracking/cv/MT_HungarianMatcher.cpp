@@ -27,6 +27,7 @@ MT_HungarianMatcher::MT_HungarianMatcher()
   : m_iRows(0),
     m_iCols(0),
     m_iMode(HUNGARIAN_MIN),
+    m_iAlgorithm(MT_HM_HUNGARIAN),
     m_piValues(NULL),
     m_pdValues(NULL),
     m_bHaveLimits(false)
@@ -42,19 +43,24 @@ MT_HungarianMatcher::~MT_HungarianMatcher()
     }
 }
 
-void MT_HungarianMatcher::doInit(int m, int n, int mode)
+void MT_HungarianMatcher::doInit(int m, int n, int mode, int algorithm)
 {
     if(n == MT_HM_SAME)
     {
         n = m;
     }
 
+    m_iAlgorithm = (algorithm == MT_HM_LAPJV || algorithm == MT_HM_LAPJV_WARM) ?
+        algorithm : MT_HM_HUNGARIAN;
+    m_LAPJV.setWarmStart(m_iAlgorithm == MT_HM_LAPJV_WARM);
+    m_LAPJV.resetWarmStart();
+
     /* 
      * libhungarian can't deal with m > n, so we'll force m = n
      * so the program doesn't crash.  This will cause bad results
      * but shouldn't crash the program. 
      */
-    if(m > n)
+    if(m_iAlgorithm == MT_HM_HUNGARIAN && m > n)
     {
         fprintf(stderr,
                 "MT_HungarianMatcher Error:  Cannot have more rows "
@@ -83,10 +89,14 @@ void MT_HungarianMatcher::doInit(int m, int n, int mode)
 void MT_HungarianMatcher::setValue(unsigned int i, unsigned int j, double v)
 {
 
-    /* force i, j in the proper range */
-    i = MT_MIN(i, m_iRows);
-    j = MT_MIN(j, m_iCols);
-    m_pdValues[i*m_iRows + j] = v;
+    if(i >= m_iRows || j >= m_iCols)
+    {
+        fprintf(stderr,
+                "MT_HungarianMatcher Error:  Element (%d, %d) is outside "
+                "the %d x %d matrix.\n", i, j, m_iRows, m_iCols);
+        return;
+    }
+    m_pdValues[i*m_iCols + j] = v;
 
     /* we're going to use these limits to calculate 
      * the double->integer scaling */
@@ -113,6 +123,14 @@ void MT_HungarianMatcher::doMatch(std::vector<int>* assignments)
         return;
     }
 
+    if(m_iAlgorithm != MT_HM_HUNGARIAN)
+    {
+        m_bHaveLimits = false;
+        m_LAPJV.solve(m_pdValues, m_iRows, m_iCols, assignments,
+                      m_iMode == HUNGARIAN_MAX);
+        return;
+    }
+
     /* 
      * The algorithm needs to work with integers, so we'll apply an
      * affine transformation to compress the double value range into
@@ -11,11 +11,17 @@
 /* using Brian Gerkey's implementation of the Hungarian algorithm 
  * see http://robotics.stanford.edu/~gerkey/tools/hungarian.html */
 #include "MT/MT_Tracking/3rdparty/libhungarian-0.3/hungarian.h"
+#include "MT/MT_Tracking/cv/MT_LAPJV.h"
 
 #include <vector>
 
 const int MT_HM_SAME = -1;
 
+/* solvers for doInit */
+const int MT_HM_HUNGARIAN = 0;  /* libhungarian, over integers */
+const int MT_HM_LAPJV = 1;      /* MT_LAPJV, over doubles */
+const int MT_HM_LAPJV_WARM = 2; /* MT_LAPJV warm started from the last doMatch */
+
 /** 
  * @class MT_HungarianMatcher
  *
@@ -38,6 +44,19 @@ const int MT_HM_SAME = -1;
  * to stuff the cost/value array with values and then
  * call doMatch to execute the match.
  *
+ * doInit can also select the Jonker-Volgenant solver (MT_LAPJV)
+ * instead.  It works on the double values directly rather than
+ * scaling them to integers, allows more rows than columns and
+ * doesn't allocate in doMatch once it has seen a problem of that
+ * size.  Both give an optimal assignment, but may pick different
+ * ones when there is a tie.
+ *
+ * MT_HM_LAPJV_WARM additionally starts each doMatch after the first
+ * from the previous solution (see MT_LAPJV::setWarmStart), which is
+ * much quicker when the values change little between calls and the
+ * columns stay the same (e.g. rows are detections and columns are
+ * tracks).  Calling doInit again starts from scratch.
+ *
  */
 class MT_HungarianMatcher
 {
@@ -48,6 +67,8 @@ private:
     unsigned int m_iCols;
     /* mode is either HUNGARIAN_MIN or HUNGARIAN_MAX */
     unsigned int m_iMode;
+    /* MT_HM_HUNGARIAN, MT_HM_LAPJV or MT_HM_LAPJV_WARM */
+    int m_iAlgorithm;
 
     /*
      * the solver evaluates over integers, but for the
@@ -72,6 +93,9 @@ private:
     /* structure used by the solver */
     hungarian_t m_HungarianStruct;
 
+    /* the LAPJV solver, keeps its workspace between matches */
+    MT_LAPJV m_LAPJV;
+
 public:
     /** The ctor doesn't really do anything.  Call doInit to
      * set up the matcher.  This is done so that you can reuse
@@ -87,10 +111,19 @@ public:
      * @param m Number of rows in matrix.
      * @param n Number of columns (default is m = n).
      * @param mode Either HUNGARIAN_MIN (minimize value, default) or
-     *              HUNGARIAN_MAX (maximize value). */
-    void doInit(int m, int n = MT_HM_SAME, int mode = HUNGARIAN_MIN);
+     *              HUNGARIAN_MAX (maximize value).
+     * @param algorithm MT_HM_HUNGARIAN (default), MT_HM_LAPJV or
+     *              MT_HM_LAPJV_WARM.  Only the LAPJV ones can have
+     *              m > n. */
+    void doInit(int m,
+                int n = MT_HM_SAME,
+                int mode = HUNGARIAN_MIN,
+                int algorithm = MT_HM_HUNGARIAN);
+
+    int getAlgorithm() const {return m_iAlgorithm;};
 
     /** Set the value of M(i,j) if M is the cost/value matrix.
+     * Elements outside of the matrix are an error and are ignored.
      *
      * @param i Row index
      * @param j Column index
@@ -101,7 +134,9 @@ public:
      *
      * @param assignment Pointer to vector in which to store results.
      *              assignment[i] = j means that column j should be 
-     *              matched with row i. */
+     *              matched with row i.  With MT_HM_LAPJV and more
+     *              rows than columns, assignment[i] = -1 for the
+     *              rows left over. */
     void doMatch(std::vector<int>* assignment);
 };
 
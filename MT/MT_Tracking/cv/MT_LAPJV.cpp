@@ -0,0 +1,434 @@
+/*
+ *  MT_LAPJV.cpp
+ *
+ *  See MT_LAPJV.h.  The structure follows Jonker and Volgenant's
+ *  original Pascal code:  column reduction, reduction transfer, two
+ *  rounds of augmenting row reduction, then a shortest augmenting
+ *  path for each row that is still free.
+ *
+ */
+
+#include "MT/MT_Tracking/cv/MT_LAPJV.h"
+
+#include <float.h>
+#include <math.h>
+
+MT_LAPJV::MT_LAPJV()
+    : m_bWarmStart(false),
+      m_iLastRows(0),
+      m_iLastCols(0),
+      m_bLastMaximize(false),
+      m_bWasWarmStarted(false),
+      m_iNumAugmentations(0)
+{
+}
+
+double MT_LAPJV::solve(const double* cost,
+                       unsigned int m,
+                       unsigned int n,
+                       std::vector<int>* assignment,
+                       bool maximize)
+{
+    if(assignment)
+    {
+        assignment->assign(m, -1);
+    }
+    m_bWasWarmStarted = false;
+    m_iNumAugmentations = 0;
+    if(m == 0 || n == 0)
+    {
+        return 0;
+    }
+
+    unsigned int dim = (m > n) ? m : n;
+
+    /* a square problem to minimize is solved in place; otherwise pad
+     * with zeros (dummy rows and columns cost the same whichever
+     * they are matched to, so they don't change the solution) */
+    const double* c = cost;
+    if(m != n || maximize)
+    {
+        m_vdCost.resize(dim*dim);
+        double sign = maximize ? -1.0 : 1.0;
+        for(unsigned int i = 0; i < dim; i++)
+        {
+            double* row = &m_vdCost[i*dim];
+            if(i < m)
+            {
+                for(unsigned int j = 0; j < n; j++)
+                {
+                    row[j] = sign*cost[i*n + j];
+                }
+                for(unsigned int j = n; j < dim; j++)
+                {
+                    row[j] = 0;
+                }
+            }
+            else
+            {
+                for(unsigned int j = 0; j < dim; j++)
+                {
+                    row[j] = 0;
+                }
+            }
+        }
+        c = &m_vdCost[0];
+    }
+
+    /* the last prices only mean something for the same rows and
+     * columns (a dummy's price doesn't carry over to a real one) */
+    bool warm = m_bWarmStart && m == m_iLastRows && n == m_iLastCols
+        && maximize == m_bLastMaximize;
+    solveSquare(c, dim, warm);
+    m_iLastRows = m;
+    m_iLastCols = n;
+    m_bLastMaximize = maximize;
+
+    double total = 0;
+    for(unsigned int i = 0; i < m; i++)
+    {
+        int j = m_viRowSol[i];
+        if(j >= 0 && j < (int) n)
+        {
+            total += cost[i*n + j];
+            if(assignment)
+            {
+                (*assignment)[i] = j;
+            }
+        }
+    }
+    return total;
+}
+
+int MT_LAPJV::initCold(const double* c, int n, double* maxcost)
+{
+    m_viRowSol.assign(n, -1);
+    m_viColSol.assign(n, -1);
+    m_viMatches.assign(n, 0);
+
+    double* v = &m_vdV[0];
+    int* rowsol = &m_viRowSol[0];
+    int* colsol = &m_viColSol[0];
+    int* freerows = &m_viFree[0];
+    int* matches = &m_viMatches[0];
+    int i, j, j1;
+
+    /* column reduction, last column first so that ties go to the
+     * earlier columns */
+    double cmax = 0;
+    for(j = n - 1; j >= 0; j--)
+    {
+        double cmin = c[j];
+        int imin = 0;
+        for(i = 0; i < n; i++)
+        {
+            double cij = c[i*n + j];
+            cmax = (fabs(cij) > cmax) ? fabs(cij) : cmax;
+            if(cij < cmin)
+            {
+                cmin = cij;
+                imin = i;
+            }
+        }
+        v[j] = cmin;
+        if(++matches[imin] == 1)
+        {
+            rowsol[imin] = j;
+            colsol[j] = imin;
+        }
+        else if(v[j] < v[rowsol[imin]])
+        {
+            /* keep the cheaper column for the row */
+            j1 = rowsol[imin];
+            rowsol[imin] = j;
+            colsol[j] = imin;
+            colsol[j1] = -1;
+        }
+        else
+        {
+            colsol[j] = -1;
+        }
+    }
+
+    /* reduction transfer */
+    int numfree = 0;
+    for(i = 0; i < n; i++)
+    {
+        if(matches[i] == 0)
+        {
+            freerows[numfree++] = i;
+        }
+        else if(matches[i] == 1)
+        {
+            j1 = rowsol[i];
+            double cmin = DBL_MAX;
+            for(j = 0; j < n; j++)
+            {
+                if(j != j1 && c[i*n + j] - v[j] < cmin)
+                {
+                    cmin = c[i*n + j] - v[j];
+                }
+            }
+            if(cmin < DBL_MAX)
+            {
+                v[j1] -= cmin;
+            }
+        }
+    }
+    *maxcost = cmax;
+    return numfree;
+}
+
+int MT_LAPJV::initWarm(const double* c, int n, double* maxcost)
+{
+    const double* v = &m_vdV[0];
+    int* rowsol = &m_viRowSol[0];
+    int* colsol = &m_viColSol[0];
+    int* freerows = &m_viFree[0];
+
+    /* every row takes a cheapest column at the current prices, which
+     * is what the augmentation needs of the assigned rows;  rows
+     * that find it taken are free */
+    for(int j = 0; j < n; j++)
+    {
+        colsol[j] = -1;
+    }
+    int numfree = 0;
+    double cmax = 0;
+    for(int i = 0; i < n; i++)
+    {
+        int jlast = rowsol[i];
+        int jmin = 0;
+        double hmin = DBL_MAX;
+        for(int j = 0; j < n; j++)
+        {
+            cmax = (fabs(c[i*n + j]) > cmax) ? fabs(c[i*n + j]) : cmax;
+            double h = c[i*n + j] - v[j];
+            if(h < hmin)
+            {
+                hmin = h;
+                jmin = j;
+            }
+        }
+        if(jlast >= 0 && c[i*n + jlast] - v[jlast] <= hmin)
+        {
+            jmin = jlast;
+        }
+
+        if(colsol[jmin] < 0)
+        {
+            rowsol[i] = jmin;
+            colsol[jmin] = i;
+        }
+        else
+        {
+            rowsol[i] = -1;
+            freerows[numfree++] = i;
+        }
+    }
+    *maxcost = cmax;
+    return numfree;
+}
+
+void MT_LAPJV::solveSquare(const double* c, unsigned int dim, bool warm)
+{
+    int n = dim;
+
+    m_vdV.resize(n);
+    m_vdD.resize(n);
+    m_viRowSol.resize(n);
+    m_viColSol.resize(n);
+    m_viFree.resize(n);
+    m_viColList.resize(n);
+    m_viMatches.resize(n);
+    m_viPred.resize(n);
+
+    double maxcost = 0;
+    int numfree = warm ? initWarm(c, n, &maxcost) : initCold(c, n, &maxcost);
+    m_bWasWarmStarted = warm;
+
+    double* v = &m_vdV[0];
+    double* d = &m_vdD[0];
+    int* rowsol = &m_viRowSol[0];
+    int* colsol = &m_viColSol[0];
+    int* freerows = &m_viFree[0];
+    int* collist = &m_viColList[0];
+    int* pred = &m_viPred[0];
+
+    int i, i0, j, j1, j2 = 0, k;
+    double h, umin, usubmin, v2;
+
+    /* a change in price smaller than this (relative to the biggest
+     * cost) isn't worth another pass of augmenting row reduction;
+     * with doubles the reductions could otherwise go on in ever
+     * smaller steps */
+    const double tol = 1e-12*(maxcost > 0 ? maxcost : 1.0);
+
+    /* augmenting row reduction, twice */
+    for(int loop = 0; loop < 2; loop++)
+    {
+        k = 0;
+        int prvnumfree = numfree;
+        numfree = 0;
+        while(k < prvnumfree)
+        {
+            i = freerows[k++];
+
+            /* smallest and second smallest reduced cost in row i */
+            umin = c[i*n] - v[0];
+            j1 = 0;
+            usubmin = DBL_MAX;
+            for(j = 1; j < n; j++)
+            {
+                h = c[i*n + j] - v[j];
+                if(h < usubmin)
+                {
+                    if(h >= umin)
+                    {
+                        usubmin = h;
+                        j2 = j;
+                    }
+                    else
+                    {
+                        usubmin = umin;
+                        umin = h;
+                        j2 = j1;
+                        j1 = j;
+                    }
+                }
+            }
+
+            i0 = colsol[j1];
+            bool lower = (n > 1 && usubmin - umin > tol);
+            if(lower)
+            {
+                /* lower the price of j1 so that it's i's by a margin */
+                v[j1] -= (usubmin - umin);
+            }
+            else if(i0 >= 0 && n > 1)
+            {
+                /* a tie, take the second best column instead */
+                j1 = j2;
+                i0 = colsol[j2];
+            }
+
+            rowsol[i] = j1;
+            colsol[j1] = i;
+            if(i0 >= 0)
+            {
+                rowsol[i0] = -1;
+                if(lower)
+                {
+                    /* the displaced row goes again straight away */
+                    freerows[--k] = i0;
+                }
+                else
+                {
+                    freerows[numfree++] = i0;
+                }
+            }
+        }
+    }
+
+    /* augmentation by shortest paths (Dijkstra) for the remaining
+     * free rows */
+    m_iNumAugmentations = numfree;
+    for(int f = 0; f < numfree; f++)
+    {
+        int freerow = freerows[f];
+        int endofpath = -1;
+        int low = 0;
+        int up = 0;
+        int last = 0;
+        double dmin = 0;
+
+        for(j = 0; j < n; j++)
+        {
+            d[j] = c[freerow*n + j] - v[j];
+            pred[j] = freerow;
+            collist[j] = j;
+        }
+
+        bool found = false;
+        while(!found)
+        {
+            if(up == low)
+            {
+                /* the columns at the next shortest distance go to
+                 * collist[low..up) */
+                last = low - 1;
+                dmin = d[collist[up++]];
+                for(k = up; k < n; k++)
+                {
+                    j = collist[k];
+                    h = d[j];
+                    if(h <= dmin)
+                    {
+                        if(h < dmin)
+                        {
+                            up = low;
+                            dmin = h;
+                        }
+                        collist[k] = collist[up];
+                        collist[up++] = j;
+                    }
+                }
+                for(k = low; k < up; k++)
+                {
+                    if(colsol[collist[k]] < 0)
+                    {
+                        endofpath = collist[k];
+                        found = true;
+                        break;
+                    }
+                }
+            }
+
+            if(!found)
+            {
+                /* scan a column at the shortest distance */
+                j1 = collist[low++];
+                i = colsol[j1];
+                h = c[i*n + j1] - v[j1] - dmin;
+                for(k = up; k < n; k++)
+                {
+                    j = collist[k];
+                    v2 = c[i*n + j] - v[j] - h;
+                    if(v2 < d[j])
+                    {
+                        pred[j] = i;
+                        if(v2 <= dmin)
+                        {
+                            if(colsol[j] < 0)
+                            {
+                                endofpath = j;
+                                found = true;
+                                break;
+                            }
+                            collist[k] = collist[up];
+                            collist[up++] = j;
+                        }
+                        d[j] = v2;
+                    }
+                }
+            }
+        }
+
+        /* update the prices of the columns scanned */
+        for(k = 0; k <= last; k++)
+        {
+            j1 = collist[k];
+            v[j1] += d[j1] - dmin;
+        }
+
+        /* flip the assignments along the path */
+        do
+        {
+            i = pred[endofpath];
+            colsol[endofpath] = i;
+            j1 = endofpath;
+            endofpath = rowsol[i];
+            rowsol[i] = j1;
+        } while(i != freerow);
+    }
+}
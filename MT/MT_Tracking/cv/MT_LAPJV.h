@@ -0,0 +1,107 @@
+#ifndef MT_LAPJV_H
+#define MT_LAPJV_H
+
+/*
+ *  MT_LAPJV.h
+ *
+ *  Jonker-Volgenant solver for the linear assignment problem.
+ *
+ */
+
+#include <vector>
+
+/**
+ * @class MT_LAPJV
+ *
+ * @brief Jonker-Volgenant (LAPJV) linear assignment solver working
+ * directly on double precision costs.
+ *
+ * Finds the row-to-column assignment a minimizing \sum_i M[i,a[i]]
+ * for an m x n cost matrix M, using the algorithm of R. Jonker and
+ * A. Volgenant, "A Shortest Augmenting Path Algorithm for Dense and
+ * Sparse Linear Assignment Problems", Computing 38 (1987).
+ *
+ * Rectangular matrices are padded to square with zero cost dummy
+ * rows or columns, so either m or n can be larger.  If m > n, m - n
+ * rows are left unassigned (a[i] = -1).
+ *
+ * The solver keeps its work arrays between calls, so solving
+ * problems of the same size again doesn't allocate.  Not thread
+ * safe; use one solver per thread.
+ *
+ * With setWarmStart(true), a solve with as many rows and columns
+ * as the last one starts from the last solution's column prices
+ * (dual variables) instead of from scratch:  each row takes its
+ * cheapest column at those prices (its last column if that is one
+ * of the cheapest), and only the rows that clash or have no column
+ * go through augmenting row reduction and shortest augmenting
+ * paths.  When the costs have changed little, e.g. frame to frame
+ * in a tracker, that is a few rows.  The result is still optimal;
+ * only the work changes.
+ * Columns should keep their meaning from one solve to the next
+ * (e.g. columns are tracks), rows needn't.
+ *
+ */
+class MT_LAPJV
+{
+public:
+    MT_LAPJV();
+
+    /** Solves the assignment problem.
+     *
+     * @param cost m x n cost matrix, row major (cost[i*n + j]).
+     * @param m Number of rows.
+     * @param n Number of columns.
+     * @param assignment Resized to m; assignment[i] is the column
+     *              assigned to row i or -1.
+     * @param maximize If true, maximize the total instead.
+     *
+     * @return The total cost (value) of the assignment. */
+    double solve(const double* cost,
+                 unsigned int m,
+                 unsigned int n,
+                 std::vector<int>* assignment,
+                 bool maximize = false);
+
+    /** Start from the last solution's prices when possible (off by
+     * default). */
+    void setWarmStart(bool warm) {m_bWarmStart = warm;};
+    bool getWarmStart() const {return m_bWarmStart;};
+    /** Forget the last solution, so the next solve is from scratch */
+    void resetWarmStart() {m_iLastRows = m_iLastCols = 0;};
+
+    /** Number of shortest augmenting paths in the last solve */
+    unsigned int getNumAugmentations() const {return m_iNumAugmentations;};
+    /** Whether the last solve was warm started */
+    bool wasWarmStarted() const {return m_bWasWarmStarted;};
+
+private:
+    /* solves the square problem c (the caller's costs or
+     * m_vdCost), starting from the prices in m_vdV and the
+     * assignment in m_viRowSol if warm */
+    void solveSquare(const double* c, unsigned int dim, bool warm);
+    /* initial assignment from scratch, returns the number of free
+     * rows (in m_viFree) and the largest |cost| */
+    int initCold(const double* c, int n, double* maxcost);
+    /* initial assignment at the current prices, ditto */
+    int initWarm(const double* c, int n, double* maxcost);
+
+    bool m_bWarmStart;
+    unsigned int m_iLastRows;    /* 0 if there is no last solution */
+    unsigned int m_iLastCols;
+    bool m_bLastMaximize;
+    bool m_bWasWarmStarted;
+    unsigned int m_iNumAugmentations;
+
+    std::vector<double> m_vdCost;   /* square, padded, if needed */
+    std::vector<double> m_vdV;      /* column prices */
+    std::vector<double> m_vdD;      /* shortest path lengths */
+    std::vector<int> m_viRowSol;    /* column assigned to each row */
+    std::vector<int> m_viColSol;    /* row assigned to each column */
+    std::vector<int> m_viFree;      /* unassigned rows */
+    std::vector<int> m_viColList;
+    std::vector<int> m_viMatches;
+    std::vector<int> m_viPred;
+};
+
+#endif // MT_LAPJV_H
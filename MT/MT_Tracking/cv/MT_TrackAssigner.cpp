@@ -0,0 +1,177 @@
+/*
+ *  MT_TrackAssigner.cpp
+ *
+ *  See MT_TrackAssigner.h
+ *
+ */
+
+#include "MT/MT_Tracking/cv/MT_TrackAssigner.h"
+
+MT_TrackAssigner::MT_TrackAssigner()
+    : m_dNewTrackCost(1250.0),   /* matches up to 50 px */
+      m_dMissCost(1250.0),
+      m_iConfirmHits(3),
+      m_iMaxTentativeMisses(1),
+      m_iMaxMisses(5),
+      m_iNextID(0),
+      m_iNumBirths(0),
+      m_iNumDeaths(0)
+{
+}
+
+void MT_TrackAssigner::reset()
+{
+    m_iNumDeaths += m_viActive.size();
+    for(unsigned int k = 0; k < m_viActive.size(); k++)
+    {
+        m_viFreeSlots.push_back(m_viActive[k]);
+    }
+    m_viActive.resize(0);
+    m_viDetectionTrack.resize(0);
+}
+
+void MT_TrackAssigner::reserve(unsigned int n)
+{
+    m_vTracks.reserve(n);
+    m_viFreeSlots.reserve(n);
+    m_viActive.reserve(n);
+}
+
+unsigned int MT_TrackAssigner::getNumConfirmed() const
+{
+    unsigned int n = 0;
+    for(unsigned int k = 0; k < m_viActive.size(); k++)
+    {
+        n += (m_vTracks[m_viActive[k]].state == MT_TRACK_CONFIRMED);
+    }
+    return n;
+}
+
+int MT_TrackAssigner::newTrack(double x, double y)
+{
+    int slot;
+    if(m_viFreeSlots.size() > 0)
+    {
+        slot = m_viFreeSlots.back();
+        m_viFreeSlots.pop_back();
+    }
+    else
+    {
+        slot = m_vTracks.size();
+        m_vTracks.push_back(MT_ManagedTrack());
+    }
+
+    MT_ManagedTrack& t = m_vTracks[slot];
+    t.id = m_iNextID++;
+    t.state = (m_iConfirmHits <= 1) ? MT_TRACK_CONFIRMED : MT_TRACK_TENTATIVE;
+    t.x = x;
+    t.y = y;
+    t.vx = 0;
+    t.vy = 0;
+    t.hits = 1;
+    t.misses = 0;
+    t.detection = -1;
+
+    m_viActive.push_back(slot);
+    m_iNumBirths++;
+    return slot;
+}
+
+void MT_TrackAssigner::doUpdate(const std::vector<double>& xs,
+                                const std::vector<double>& ys)
+{
+    unsigned int nd = xs.size();
+    unsigned int nt = m_viActive.size();
+
+    /* Rows are detections, columns the tracks then one "new track"
+     * column per detection.  Matching detection i to track j instead
+     * of starting a track and missing j saves new + miss - c_ij, so
+     * that is the cost less the constant, and the new track columns
+     * cost nothing. */
+    const double unmatched = m_dNewTrackCost + m_dMissCost;
+    unsigned int nc = nt + nd;
+    m_vdCost.resize(nd*nc);
+    for(unsigned int i = 0; i < nd; i++)
+    {
+        double* row = &m_vdCost[i*nc];
+        for(unsigned int j = 0; j < nt; j++)
+        {
+            const MT_ManagedTrack& t = m_vTracks[m_viActive[j]];
+            double dx = xs[i] - (t.x + t.vx);
+            double dy = ys[i] - (t.y + t.vy);
+            row[j] = dx*dx + dy*dy - unmatched;
+        }
+        for(unsigned int j = nt; j < nc; j++)
+        {
+            row[j] = 0;
+        }
+    }
+    if(nd > 0)
+    {
+        m_LAPJV.solve(&m_vdCost[0], nd, nc, &m_viAssignment);
+    }
+
+    for(unsigned int j = 0; j < nt; j++)
+    {
+        m_vTracks[m_viActive[j]].detection = -1;
+    }
+
+    /* matches */
+    m_viDetectionTrack.assign(nd, -1);
+    for(unsigned int i = 0; i < nd; i++)
+    {
+        int j = m_viAssignment[i];
+        if(j < 0 || j >= (int) nt || m_vdCost[i*nc + j] >= 0)
+        {
+            continue;
+        }
+        MT_ManagedTrack& t = m_vTracks[m_viActive[j]];
+        t.vx = xs[i] - t.x;
+        t.vy = ys[i] - t.y;
+        t.x = xs[i];
+        t.y = ys[i];
+        t.hits++;
+        t.misses = 0;
+        t.detection = i;
+        if(t.state == MT_TRACK_TENTATIVE && t.hits >= m_iConfirmHits)
+        {
+            t.state = MT_TRACK_CONFIRMED;
+        }
+        m_viDetectionTrack[i] = t.id;
+    }
+
+    /* misses, deleting the tracks that have missed too many */
+    unsigned int kept = 0;
+    for(unsigned int j = 0; j < nt; j++)
+    {
+        int slot = m_viActive[j];
+        MT_ManagedTrack& t = m_vTracks[slot];
+        if(t.detection < 0)
+        {
+            t.misses++;
+            t.x += t.vx;
+            t.y += t.vy;
+            int max_misses = (t.state == MT_TRACK_CONFIRMED) ?
+                m_iMaxMisses : m_iMaxTentativeMisses;
+            if(t.misses >= max_misses)
+            {
+                m_viFreeSlots.push_back(slot);
+                m_iNumDeaths++;
+                continue;
+            }
+        }
+        m_viActive[kept++] = slot;
+    }
+    m_viActive.resize(kept);
+
+    /* births */
+    for(unsigned int i = 0; i < nd; i++)
+    {
+        if(m_viDetectionTrack[i] < 0)
+        {
+            MT_ManagedTrack& t = m_vTracks[newTrack(xs[i], ys[i])];
+            t.detection = i;
+            m_viDetectionTrack[i] = t.id;
+        }
+    }
+}
@@ -0,0 +1,134 @@
+#ifndef MT_TrackAssigner_H
+#define MT_TrackAssigner_H
+
+/*
+ *  MT_TrackAssigner.h
+ *
+ *  Detection-to-track assignment with track birth and death.
+ *
+ */
+
+#include <vector>
+
+#include "MT/MT_Tracking/cv/MT_LAPJV.h"
+
+/* track states */
+const int MT_TRACK_TENTATIVE = 0;
+const int MT_TRACK_CONFIRMED = 1;
+
+/** A track managed by MT_TrackAssigner */
+struct MT_ManagedTrack
+{
+    int id;            /* unique, never reused */
+    int state;         /* MT_TRACK_TENTATIVE or MT_TRACK_CONFIRMED */
+    double x;          /* last position (predicted while missed) */
+    double y;
+    double vx;         /* velocity [px/frame] */
+    double vy;
+    int hits;          /* frames matched */
+    int misses;        /* consecutive frames missed */
+    int detection;     /* detection matched in the last update or -1 */
+};
+
+/**
+ * @class MT_TrackAssigner
+ *
+ * @brief Frame-to-frame assignment of detections to a changing set
+ * of tracks.
+ *
+ * MT_HungarianMatcher assigns a fixed number of detections to a fixed
+ * number of tracks.  MT_TrackAssigner instead lets a detection start
+ * a new track at a cost of m_dNewTrackCost, and lets a track go
+ * without a detection at a cost of m_dMissCost.  Each update solves
+ * that assignment optimally (with MT_LAPJV), so a detection is only
+ * matched to a track if the squared distance from the track's
+ * predicted (constant velocity) position is less than
+ * m_dNewTrackCost + m_dMissCost, and then only if that's the best
+ * overall.
+ *
+ * New tracks are tentative until they have been matched in
+ * m_iConfirmHits frames.  A tentative track is deleted after
+ * m_iMaxTentativeMisses consecutive misses, a confirmed one after
+ * m_iMaxMisses.  A spurious detection therefore makes a tentative
+ * track that soon goes away instead of taking over another track's
+ * identity, and an object that leaves is dropped rather than matched
+ * to whatever is left.
+ *
+ * Tracks live in slots that are reused after deletion, so once the
+ * number of tracks has settled the updates don't allocate.  Track ids
+ * are never reused.
+ *
+ * Usage:
+ * @code
+ * MT_TrackAssigner tracks;
+ * tracks.m_dNewTrackCost = tracks.m_dMissCost = 0.5*gate*gate;
+ * // each frame
+ * tracks.doUpdate(xs, ys);
+ * for(unsigned int k = 0; k < tracks.getNumTracks(); k++)
+ * {
+ *     const MT_ManagedTrack& t = tracks.getTrack(k);
+ *     if(t.state == MT_TRACK_CONFIRMED) ...
+ * }
+ * @endcode
+ */
+class MT_TrackAssigner
+{
+public:
+    MT_TrackAssigner();
+
+    /** Cost of a detection starting a new track [px^2] */
+    double m_dNewTrackCost;
+    /** Cost of a track missing a frame [px^2] */
+    double m_dMissCost;
+    /** Matches before a track is confirmed */
+    int m_iConfirmHits;
+    /** Consecutive misses before a tentative track is deleted */
+    int m_iMaxTentativeMisses;
+    /** Consecutive misses before a confirmed track is deleted */
+    int m_iMaxMisses;
+
+    /** Updates the tracks with the detections (xs[i], ys[i]) of the
+     * next frame. */
+    void doUpdate(const std::vector<double>& xs,
+                  const std::vector<double>& ys);
+
+    /** Deletes all of the tracks (ids carry on). */
+    void reset();
+    /** Makes room for n tracks. */
+    void reserve(unsigned int n);
+
+    /** Number of tracks, tentative and confirmed */
+    unsigned int getNumTracks() const {return m_viActive.size();};
+    /** The k'th track (0 <= k < getNumTracks()), oldest first */
+    const MT_ManagedTrack& getTrack(unsigned int k) const
+        {return m_vTracks[m_viActive[k]];};
+    unsigned int getNumConfirmed() const;
+
+    /** Id of the track each detection of the last update was matched
+     * to or started */
+    const std::vector<int>& getDetectionTracks() const
+        {return m_viDetectionTrack;};
+
+    /** Totals since construction */
+    int getNumBirths() const {return m_iNumBirths;};
+    int getNumDeaths() const {return m_iNumDeaths;};
+
+private:
+    int newTrack(double x, double y);
+
+    MT_LAPJV m_LAPJV;
+
+    std::vector<MT_ManagedTrack> m_vTracks;  /* slots */
+    std::vector<int> m_viFreeSlots;
+    std::vector<int> m_viActive;             /* slots in use, in order */
+
+    std::vector<double> m_vdCost;
+    std::vector<int> m_viAssignment;
+    std::vector<int> m_viDetectionTrack;
+
+    int m_iNextID;
+    int m_iNumBirths;
+    int m_iNumDeaths;
+};
+
+#endif // MT_TrackAssigner_H
@@ -2,7 +2,15 @@
 
 #include "MT/MT_Tracking/cv/MT_HungarianMatcher.h"
 #include "MT/MT_Tracking/trackers/DS/DSGYBlobber.h"
-#include "MT/MT_Core/support/BiCC.h"
+#include "MT/MT_Core/support/mathsupport.h"
+
+#include <float.h>
+#include <math.h>
+
+#include <algorithm>
+
+/* EMMG's own limit, used for the budget when there is no other */
+#define MT_DSGYA_MAX_EMMG_ITERATIONS 1000
 
 #define DEBUG_OUT(...) if(m_pDebugFile){fprintf(m_pDebugFile, __VA_ARGS__); fflush(m_pDebugFile);}
 
@@ -225,16 +233,71 @@ MT_DSGYA_Blob::MT_DSGYA_Blob(const GYBlob& in_blob)
 }
 
 
+MT_DSGYA_EMStats::MT_DSGYA_EMStats()
+    : m_iFits(0),
+      m_iIterations(0),
+      m_iMaxIterations(0),
+      m_iNotConverged(0)
+{
+}
+
+void MT_DSGYA_EMStats::addFit(int iterations, bool converged)
+{
+    m_iFits++;
+    m_iIterations += iterations;
+    m_iMaxIterations = MT_MAX(m_iMaxIterations, (unsigned int) iterations);
+    if(!converged)
+    {
+        m_iNotConverged++;
+    }
+}
+
+void MT_DSGYA_EMStats::add(const MT_DSGYA_EMStats& other)
+{
+    m_iFits += other.m_iFits;
+    m_iIterations += other.m_iIterations;
+    m_iMaxIterations = MT_MAX(m_iMaxIterations, other.m_iMaxIterations);
+    m_iNotConverged += other.m_iNotConverged;
+}
+
+double MT_DSGYA_EMStats::getMeanIterations() const
+{
+    return m_iFits ? ((double) m_iIterations)/((double) m_iFits) : 0.0;
+}
+
+/* covariance for an EMMG initial from an object's (predicted) axes
+ * and orientation, the same way GYSegmenter guesses from its last
+ * blobs */
+static void predicted_covariance(const MT_DSGYA_Blob& obj,
+                                 double* xx, double* xy, double* yy)
+{
+    double sigma1 = pow(MT_MAX(obj.m_dMajorAxis, 8.0)/1.95, 2);
+    double sigma2 = pow(MT_MAX(obj.m_dMinorAxis, 1.0)/1.95, 2);
+    double phi = MT_DEG2RAD*obj.m_dOrientation;
+    double cp = cos(phi);
+    double sp = -sin(phi);
+
+    *xx = sigma1*cp*cp + sigma2*sp*sp;
+    *xy = sp*cp*(sigma1 - sigma2);
+    *yy = sigma1*sp*sp + sigma2*cp*cp;
+}
+
 MT_DSGYA_Segmenter::MT_DSGYA_Segmenter()
     : m_iMinBlobArea(1),      
       m_iMinBlobPerimeter(1), 
       m_iMaxBlobArea(-1),      
       m_iMaxBlobPerimeter(-1),
       m_dOverlapFactor(1.0),
+      m_bUseAdjacencyGrid(true),
       m_iNumEMMGIterations(10),
+      m_iNumEMThreads(0),
       m_iFrameWidth(0),
       m_iFrameHeight(0),
       m_pBlobFrame(NULL),
+      m_pWorkerPool(NULL),
+      m_iWorkerPoolThreads(0),
+      m_vEMWorkspaces(1),
+      m_vpWorkerFrames(1, (IplImage*) NULL),
       m_pDebugFile(NULL)
 {
 }
@@ -242,6 +305,11 @@ MT_DSGYA_Segmenter::MT_DSGYA_Segmenter()
 MT_DSGYA_Segmenter::~MT_DSGYA_Segmenter()
 {
     if(m_pBlobFrame){cvReleaseImage(&m_pBlobFrame);}
+    for(unsigned int k = 0; k < m_vpWorkerFrames.size(); k++)
+    {
+        if(m_vpWorkerFrames[k]){cvReleaseImage(&m_vpWorkerFrames[k]);}
+    }
+    if(m_pWorkerPool){delete m_pWorkerPool;}
 }
 
 void MT_DSGYA_Segmenter::setDebugFile(FILE* file)
@@ -269,6 +337,206 @@ bool MT_DSGYA_Segmenter::areOverlapping(MT_DSGYA_Blob* obj, const YABlob& blob)
     return dx*dx + dy*dy < rho*rho;
 }
 
+static bool is_finite(double x)
+{
+    return !MT_isnan(x) && fabs(x) <= DBL_MAX;
+}
+
+/* cell index of v along one grid axis, clamped to the grid */
+static int grid_cell(double v, double origin, double cell, int n)
+{
+    double c = floor((v - origin)/cell);
+    c = MT_CLAMP(c, 0.0, (double) (n - 1));
+    return (int) c;
+}
+
+/* r clipped to a width x height frame, the whole frame if that leaves
+ * nothing */
+static CvRect clip_rect(CvRect r, int width, int height)
+{
+    int x0 = MT_MAX(r.x, 0);
+    int y0 = MT_MAX(r.y, 0);
+    int x1 = MT_MIN(r.x + r.width, width);
+    int y1 = MT_MIN(r.y + r.height, height);
+    if(x1 <= x0 || y1 <= y0)
+    {
+        return cvRect(0, 0, width, height);
+    }
+    return cvRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+void MT_DSGYA_Segmenter::findAdjacentPairs(std::vector<MT_DSGYA_Blob>* objs,
+                                           const std::vector<YABlob>& blobs,
+                                           std::vector<MT_BiCCEdge>* edges)
+{
+    unsigned int rows = objs->size();
+    unsigned int cols = blobs.size();
+
+    edges->resize(0);
+    if(rows == 0 || cols == 0)
+    {
+        return;
+    }
+
+    if(!m_bUseAdjacencyGrid)
+    {
+        for(unsigned int i = 0; i < rows; i++)
+        {
+            for(unsigned int j = 0; j < cols; j++)
+            {
+                if(areAdjacent(&(*objs)[i], blobs[j]))
+                {
+                    edges->push_back(MT_BiCCEdge(i, j));
+                }
+            }
+        }
+        return;
+    }
+
+    /* areAdjacent sets the default radius of each object the first
+     * time it sees it - do that up front since not every pair gets
+     * tested here */
+    for(unsigned int i = 0; i < rows; i++)
+    {
+        if((*objs)[i].m_dRhoContrib <= 0)
+        {
+            (*objs)[i].m_dRhoContrib = (*objs)[i].m_dMajorAxis;
+        }
+    }
+
+    /* An object and a blob can only be adjacent if the squares of
+     * half-width f*rho (object) and f*major_axis (blob) around their
+     * centers overlap.  Each blob goes into every grid cell its square
+     * touches, each object only tests the blobs in the cells its
+     * square touches.  The extra pixel covers rounding. */
+    const double f = fabs(m_dOverlapFactor);
+    const double pad = 1.0;
+
+    double x0 = DBL_MAX, y0 = DBL_MAX, x1 = -DBL_MAX, y1 = -DBL_MAX;
+    double mean_r = 0;
+    unsigned int n_ok = 0;
+    for(unsigned int j = 0; j < cols; j++)
+    {
+        double r = f*fabs(blobs[j].major_axis) + pad;
+        if(!is_finite(blobs[j].COMx) || !is_finite(blobs[j].COMy) || !is_finite(r))
+        {
+            continue;
+        }
+        x0 = MT_MIN(x0, blobs[j].COMx - r);
+        y0 = MT_MIN(y0, blobs[j].COMy - r);
+        x1 = MT_MAX(x1, blobs[j].COMx + r);
+        y1 = MT_MAX(y1, blobs[j].COMy + r);
+        mean_r += r;
+        n_ok++;
+    }
+
+    /* cells about the size of a blob, but no more cells than a few
+     * per blob */
+    double cell = 1.0;
+    int nx = 1;
+    int ny = 1;
+    if(n_ok > 0)
+    {
+        double max_cells = 4.0*((double) cols) + 16.0;
+        cell = MT_MAX(2.0*mean_r/((double) n_ok), 1.0);
+        while(ceil((x1 - x0)/cell)*ceil((y1 - y0)/cell) > max_cells)
+        {
+            cell *= 2.0;
+        }
+        nx = MT_MAX(1, (int) ceil((x1 - x0)/cell));
+        ny = MT_MAX(1, (int) ceil((y1 - y0)/cell));
+    }
+
+    /* cell range of each blob (-1 if it can't be adjacent to
+     * anything), then count, then fill */
+    m_viBlobCells.resize(4*cols);
+    m_viGridStart.assign(nx*ny + 1, 0);
+    for(unsigned int j = 0; j < cols; j++)
+    {
+        double r = f*fabs(blobs[j].major_axis) + pad;
+        int* c = &m_viBlobCells[4*j];
+        if(!is_finite(blobs[j].COMx) || !is_finite(blobs[j].COMy) || !is_finite(r))
+        {
+            c[0] = -1;
+            continue;
+        }
+        c[0] = grid_cell(blobs[j].COMx - r, x0, cell, nx);
+        c[1] = grid_cell(blobs[j].COMx + r, x0, cell, nx);
+        c[2] = grid_cell(blobs[j].COMy - r, y0, cell, ny);
+        c[3] = grid_cell(blobs[j].COMy + r, y0, cell, ny);
+        for(int cy = c[2]; cy <= c[3]; cy++)
+        {
+            for(int cx = c[0]; cx <= c[1]; cx++)
+            {
+                m_viGridStart[cy*nx + cx + 1]++;
+            }
+        }
+    }
+    for(int k = 0; k < nx*ny; k++)
+    {
+        m_viGridStart[k + 1] += m_viGridStart[k];
+    }
+    m_viGridBlobs.resize(m_viGridStart[nx*ny]);
+    {
+        std::vector<unsigned int> fill(m_viGridStart.begin(), m_viGridStart.end() - 1);
+        for(unsigned int j = 0; j < cols; j++)
+        {
+            const int* c = &m_viBlobCells[4*j];
+            if(c[0] < 0)
+            {
+                continue;
+            }
+            for(int cy = c[2]; cy <= c[3]; cy++)
+            {
+                for(int cx = c[0]; cx <= c[1]; cx++)
+                {
+                    m_viGridBlobs[fill[cy*nx + cx]++] = j;
+                }
+            }
+        }
+    }
+
+    /* a blob can be in several of an object's cells, the stamp makes
+     * sure each pair is tested once */
+    m_viGridStamp.assign(cols, 0);
+    for(unsigned int i = 0; i < rows; i++)
+    {
+        MT_DSGYA_Blob* obj = &(*objs)[i];
+        double r = f*fabs(obj->m_dRhoContrib) + pad;
+        if(n_ok == 0
+           || !is_finite(obj->m_dXCenter) || !is_finite(obj->m_dYCenter)
+           || obj->m_dXCenter + r < x0 || obj->m_dXCenter - r > x1
+           || obj->m_dYCenter + r < y0 || obj->m_dYCenter - r > y1)
+        {
+            continue;
+        }
+        int cx0 = grid_cell(obj->m_dXCenter - r, x0, cell, nx);
+        int cx1 = grid_cell(obj->m_dXCenter + r, x0, cell, nx);
+        int cy0 = grid_cell(obj->m_dYCenter - r, y0, cell, ny);
+        int cy1 = grid_cell(obj->m_dYCenter + r, y0, cell, ny);
+        for(int cy = cy0; cy <= cy1; cy++)
+        {
+            for(int cx = cx0; cx <= cx1; cx++)
+            {
+                for(unsigned int q = m_viGridStart[cy*nx + cx];
+                    q < m_viGridStart[cy*nx + cx + 1]; q++)
+                {
+                    unsigned int j = m_viGridBlobs[q];
+                    if(m_viGridStamp[j] == i + 1)
+                    {
+                        continue;
+                    }
+                    m_viGridStamp[j] = i + 1;
+                    if(areAdjacent(obj, blobs[j]))
+                    {
+                        edges->push_back(MT_BiCCEdge(i, j));
+                    }
+                }
+            }
+        }
+    }
+}
+
 void MT_DSGYA_Segmenter::usePrevious(MT_DSGYA_Blob* obj, unsigned int i)
 {
     obj->m_dRhoContrib += 0.25*obj->m_dMajorAxis;
@@ -297,6 +565,7 @@ std::vector<MT_DSGYA_Blob> MT_DSGYA_Segmenter::segmentFirstFrame(const IplImage*
 {
     DEBUG_OUT("Segmenting first frame\n");
     std::vector<MT_DSGYA_Blob> out_blobs(num_objs);    
+    m_EMStats = MT_DSGYA_EMStats();
 
     m_iFrameWidth = I->width;
     m_iFrameHeight = I->height;
@@ -340,7 +609,10 @@ std::vector<MT_DSGYA_Blob> MT_DSGYA_Segmenter::segmentFirstFrame(const IplImage*
     
     MT_DSGYBlobber blobber(num_objs);
     blobber.setTestOut(m_pDebugFile);
+    blobber.setWorkspace(&m_vEMWorkspaces[0]);
     std::vector<GYBlob> blobs = blobber.findBlobs(m_pBlobFrame, num_objs, m_iNumEMMGIterations);
+    m_EMStats.addFit(blobber.getNumEMIterations(), blobber.getEMConverged());
+    m_TotalEMStats.add(m_EMStats);
 
     for(unsigned int k = 0; k < num_objs; k++)
     {
@@ -353,12 +625,300 @@ std::vector<MT_DSGYA_Blob> MT_DSGYA_Segmenter::segmentFirstFrame(const IplImage*
 }
 
 
+/* one EMMG fit per job, in one of the passes of
+ * MT_DSGYA_Segmenter::runEMComponents.  Job k fits the k'th component
+ * of order with its own blobber, which is kept for later passes. */
+class MT_DSGYA_EMJob : public MT_WorkerJob
+{
+public:
+    MT_DSGYA_EMJob(MT_DSGYA_Segmenter* segmenter,
+                   const std::vector<MT_DSGYA_EMComponent>* comps,
+                   const std::vector<unsigned int>* order,
+                   const std::vector<YABlob>* yblobs)
+        : m_pSegmenter(segmenter),
+          m_pComps(comps),
+          m_pOrder(order),
+          m_pYBlobs(yblobs),
+          m_bResume(false),
+          m_dDeadline(-1),
+          m_viJobs(order->size()),
+          m_vpBlobbers(order->size(), (MT_DSGYBlobber*) NULL),
+          m_viMaxIters(order->size(), 0),
+          m_viIterations(order->size(), 0),
+          m_viConverged(order->size(), 0),
+          m_vdResidual(order->size(), 0),
+          m_vdSeconds(order->size(), 0)
+    {
+        for(unsigned int k = 0; k < m_viJobs.size(); k++)
+        {
+            m_viJobs[k] = k;
+        }
+    };
+
+    ~MT_DSGYA_EMJob()
+    {
+        for(unsigned int k = 0; k < m_vpBlobbers.size(); k++)
+        {
+            delete m_vpBlobbers[k];
+        }
+    };
+
+    void doJob(int index, int worker)
+    {
+        unsigned int k = m_viJobs[index];
+        double t = MT_getTimeSec();
+        if(!m_bResume)
+        {
+            const MT_DSGYA_EMComponent& comp = m_pComps->at(m_pOrder->at(k));
+            m_vpBlobbers[k] = new MT_DSGYBlobber(comp.objs.size());
+            m_vpBlobbers[k]->setEMDeadline(m_dDeadline);
+            m_pSegmenter->fitEMComponent(comp, *m_pYBlobs, m_vpBlobbers[k],
+                                         worker, m_viMaxIters[k]);
+        }
+        else
+        {
+            m_vpBlobbers[k]->setWorkspace(&m_pSegmenter->m_vEMWorkspaces[worker]);
+            m_vpBlobbers[k]->setEMDeadline(m_dDeadline);
+            m_vpBlobbers[k]->resumeSegmentation(m_viMaxIters[k]);
+        }
+        m_vdSeconds[k] = MT_getTimeSec() - t;
+        m_viIterations[k] += m_vpBlobbers[k]->getNumEMIterations();
+        m_viConverged[k] = m_vpBlobbers[k]->getEMConverged();
+        m_vdResidual[k] = m_vpBlobbers[k]->getEMResidualChange();
+    };
+
+private:
+    MT_DSGYA_Segmenter* m_pSegmenter;
+    const std::vector<MT_DSGYA_EMComponent>* m_pComps;
+    const std::vector<unsigned int>* m_pOrder;
+    const std::vector<YABlob>* m_pYBlobs;
+
+public:
+    /* first fit or carrying on from the last pass */
+    bool m_bResume;
+    double m_dDeadline;
+    /* the components to fit in this pass, in order */
+    std::vector<unsigned int> m_viJobs;
+
+    /* per component (not vector<bool>, which isn't safe to write
+     * from several threads) */
+    std::vector<MT_DSGYBlobber*> m_vpBlobbers;
+    std::vector<int> m_viMaxIters;      /* allowed in this pass */
+    std::vector<int> m_viIterations;    /* in all passes so far */
+    std::vector<int> m_viConverged;
+    std::vector<double> m_vdResidual;
+    std::vector<double> m_vdSeconds;    /* of this pass */
+};
+
+void MT_DSGYA_Segmenter::runEMComponents(const std::vector<MT_DSGYA_EMComponent>& comps,
+                                         const std::vector<YABlob>& yblobs,
+                                         std::vector<MT_DSGYA_Blob>* out_blobs,
+                                         const IplImage* I)
+{
+    unsigned int n = comps.size();
+
+    /* largest first, ties in component order */
+    std::vector<std::pair<double, unsigned int> > by_area(n);
+    for(unsigned int k = 0; k < n; k++)
+    {
+        by_area[k] = std::make_pair(-comps[k].area, k);
+    }
+    std::sort(by_area.begin(), by_area.end());
+    std::vector<unsigned int> order(n);
+    for(unsigned int k = 0; k < n; k++)
+    {
+        order[k] = by_area[k].second;
+    }
+
+    MT_DSGYA_EMJob job(this, &comps, &order, &yblobs);
+
+    /* With a budget, a first pass with an iteration cap sized to the
+     * time left, then the fits that haven't converged carry on until
+     * the deadline, the ones still changing the most first. */
+    int max_iters = m_iNumEMMGIterations;
+    if(m_EMBudget.IsActive() && max_iters <= 0)
+    {
+        max_iters = MT_DSGYA_MAX_EMMG_ITERATIONS;
+    }
+    double work = 0;
+    for(unsigned int k = 0; k < n; k++)
+    {
+        work += comps[k].area*comps[k].objs.size();
+    }
+    /* the debug output would get mixed up between threads */
+    bool serial = (m_pDebugFile || n == 1);
+    int n_workers = serial ? 1 : ((m_iNumEMThreads > 0) ? m_iNumEMThreads : MT_WorkerPool::getNumCores());
+    m_EMBudget.StartFrame();
+    job.m_viMaxIters.assign(n, m_EMBudget.FirstPassCap(work, n_workers, max_iters));
+    /* the cap is only a guess (and there's none before the first
+     * timing), so the first pass stops at the deadline too */
+    job.m_dDeadline = m_EMBudget.GetDeadline();
+
+    runEMPass(&job, n, serial, I);
+
+    bool degraded = false;
+    if(m_EMBudget.IsActive())
+    {
+        std::vector<std::pair<double, unsigned int> > pending(0);
+        for(unsigned int k = 0; k < n; k++)
+        {
+            const MT_DSGYA_EMComponent& comp = comps[order[k]];
+            m_EMBudget.AddTiming(comp.area*comp.objs.size(),
+                                 job.m_viIterations[k], job.m_vdSeconds[k]);
+            if(!job.m_viConverged[k] && job.m_viIterations[k] < max_iters)
+            {
+                pending.push_back(std::make_pair(-job.m_vdResidual[k], k));
+            }
+        }
+
+        if(pending.size() > 0 && m_EMBudget.GetRemaining() > 0)
+        {
+            std::sort(pending.begin(), pending.end());
+            job.m_viJobs.resize(pending.size());
+            for(unsigned int j = 0; j < pending.size(); j++)
+            {
+                unsigned int k = pending[j].second;
+                job.m_viJobs[j] = k;
+                job.m_viMaxIters[k] = max_iters - job.m_viIterations[k];
+            }
+            job.m_bResume = true;
+            job.m_dDeadline = m_EMBudget.GetDeadline();
+            runEMPass(&job, pending.size(), serial, I);
+        }
+
+        for(unsigned int k = 0; k < n; k++)
+        {
+            if(!job.m_viConverged[k] && job.m_viIterations[k] < max_iters)
+            {
+                degraded = true;
+            }
+        }
+        m_EMBudget.EndFrame(degraded);
+        DEBUG_OUT("EMMG budget:  %f s left%s\n", m_EMBudget.GetRemaining(),
+                  degraded ? ", degraded" : "");
+    }
+
+    for(unsigned int k = 0; k < n; k++)
+    {
+        writeEMComponent(comps[order[k]], job.m_vpBlobbers[k]->getCurrentBlobs(), out_blobs);
+        m_EMStats.addFit(job.m_viIterations[k], job.m_viConverged[k] != 0);
+    }
+}
+
+void MT_DSGYA_Segmenter::runEMPass(MT_WorkerJob* job,
+                                   unsigned int n_jobs,
+                                   bool serial,
+                                   const IplImage* I)
+{
+    if(serial)
+    {
+        for(unsigned int k = 0; k < n_jobs; k++)
+        {
+            job->doJob(k, 0);
+        }
+    }
+    else
+    {
+        runJobsOnPool(job, n_jobs, I);
+    }
+}
+
+void MT_DSGYA_Segmenter::runJobsOnPool(MT_WorkerJob* job,
+                                       unsigned int n_jobs,
+                                       const IplImage* I)
+{
+    int n_threads = (m_iNumEMThreads > 0) ? m_iNumEMThreads : MT_WorkerPool::getNumCores();
+    if(!m_pWorkerPool || n_threads != m_iWorkerPoolThreads)
+    {
+        if(m_pWorkerPool){delete m_pWorkerPool;}
+        m_pWorkerPool = new MT_WorkerPool(n_threads);
+        m_iWorkerPoolThreads = n_threads;
+    }
+
+    /* worker 0 paints into m_pBlobFrame, the others need their own */
+    unsigned int n_workers = m_pWorkerPool->getNumWorkers();
+    if(m_vEMWorkspaces.size() < n_workers)
+    {
+        m_vEMWorkspaces.resize(n_workers);
+        m_vpWorkerFrames.resize(n_workers, NULL);
+    }
+    for(unsigned int w = 1; w < n_workers; w++)
+    {
+        IplImage* f = m_vpWorkerFrames[w];
+        if(f && (f->width != I->width || f->height != I->height
+                 || f->depth != I->depth || f->nChannels != I->nChannels))
+        {
+            cvReleaseImage(&m_vpWorkerFrames[w]);
+        }
+        if(!m_vpWorkerFrames[w])
+        {
+            m_vpWorkerFrames[w] = cvCreateImage(cvGetSize(I), I->depth, I->nChannels);
+        }
+    }
+
+    m_pWorkerPool->run(job, n_jobs);
+}
+
+void MT_DSGYA_Segmenter::fitEMComponent(const MT_DSGYA_EMComponent& comp,
+                                        const std::vector<YABlob>& yblobs,
+                                        MT_DSGYBlobber* blobber,
+                                        int worker,
+                                        int max_iters)
+{
+    IplImage* frame = (worker == 0) ? m_pBlobFrame : m_vpWorkerFrames[worker];
+    unsigned int nobjs = comp.objs.size();
+    unsigned int nblobs = comp.blobs.size();
+
+    /* the blobs are all inside the box, and the blobber only scans
+     * the box, so whatever is left outside of it from other
+     * components doesn't matter */
+    cvSetImageROI(frame, comp.box);
+    cvZero(frame);
+    cvResetImageROI(frame);
+    for(unsigned int k = 0; k < nblobs; k++)
+    {
+        DEBUG_OUT("\tPainting in blob %d\n", comp.blobs[k]);
+        MT_DSGY_PaintYABlobIntoImage(yblobs[comp.blobs[k]], frame);
+    }
+
+    blobber->setTestOut(m_pDebugFile);
+    blobber->setWorkspace(&m_vEMWorkspaces[worker]);
+    blobber->setSearchArea(comp.box);
+    blobber->setInitials(comp.x, comp.y, comp.xx, comp.xy, comp.yy);
+    blobber->findBlobs(frame, nobjs, max_iters);
+}
+
+void MT_DSGYA_Segmenter::writeEMComponent(const MT_DSGYA_EMComponent& comp,
+                                          const std::vector<GYBlob>& blobs,
+                                          std::vector<MT_DSGYA_Blob>* out_blobs)
+{
+    unsigned int ox;
+    for(unsigned int k = 0; k < comp.objs.size(); k++)
+    {
+        ox = comp.objs[k];
+        if(blobs[k].m_dXXMoment > 0 &&
+           blobs[k].m_dYYMoment > 0)
+        {
+            (*out_blobs)[ox].m_dXCenter = blobs[k].m_dXCentre;
+            (*out_blobs)[ox].m_dYCenter = blobs[k].m_dYCentre;
+            (*out_blobs)[ox].m_dXXMoment = blobs[k].m_dXXMoment;
+            (*out_blobs)[ox].m_dXYMoment = blobs[k].m_dXYMoment;
+            (*out_blobs)[ox].m_dYYMoment = blobs[k].m_dYYMoment;
+            (*out_blobs)[ox].m_dArea = blobs[k].m_dArea;
+            (*out_blobs)[ox].m_dOrientation = blobs[k].m_dOrientation;
+            (*out_blobs)[ox].m_dMajorAxis = blobs[k].m_dMajorAxis;
+            (*out_blobs)[ox].m_dMinorAxis = blobs[k].m_dMinorAxis;
+        }
+    }
+}
+
 std::vector<MT_DSGYA_Blob> MT_DSGYA_Segmenter::doSegmentation(const IplImage* I,
                                                         const std::vector<MT_DSGYA_Blob>& in_blobs)
 {
     DEBUG_OUT("MT_DSGYA_Segmenter start doSegmentation\n");
     
     std::vector<MT_DSGYA_Blob> out_blobs(in_blobs);
+    m_EMStats = MT_DSGYA_EMStats();
 
     m_iFrameWidth = I->width;
     m_iFrameHeight = I->height;
@@ -378,26 +938,25 @@ std::vector<MT_DSGYA_Blob> MT_DSGYA_Segmenter::doSegmentation(const IplImage* I,
     unsigned int rows = in_blobs.size();
     unsigned int cols = yblobs.size();
 
-    std::vector<unsigned int> adj(rows*cols, 0);
+    std::vector<MT_BiCCEdge> edges(0);
     MT_BiCC bicc(rows, cols);
     
     DEBUG_OUT("Found %d blobs for %d objects\n", cols, rows);
-    
-    for(unsigned int i = 0; i < rows; i++)
-    {
-        for(unsigned int j = 0; j < cols; j++)
-        {
-            adj[i*cols + j] = areAdjacent(&out_blobs[i], yblobs[j]);
-        }
-    }
 
-    DEBUG_OUT("Adjacency matrix:\n");
+    findAdjacentPairs(&out_blobs, yblobs, &edges);
+
+    DEBUG_OUT("Adjacency matrix (%d pairs):\n", (int) edges.size());
     if(m_pDebugFile)
     {
+        std::vector<unsigned int> adj(rows*cols, 0);
+        for(unsigned int k = 0; k < edges.size(); k++)
+        {
+            adj[edges[k].first*cols + edges[k].second] = 1;
+        }
         spit_mat(adj, rows, cols, m_pDebugFile);
     }
 
-    int n_cc = bicc.findComponents(adj);
+    int n_cc = bicc.findComponents(edges);
     m_viAssignmentMat = bicc.getLabelMatrix();
     m_viAssignmentVec = bicc.getLabelVector();
     m_iAssignmentRows = bicc.getNumRows();
@@ -417,6 +976,7 @@ std::vector<MT_DSGYA_Blob> MT_DSGYA_Segmenter::doSegmentation(const IplImage* I,
 
     std::vector<unsigned int> objs_this_comp(0);
     std::vector<unsigned int> blobs_this_comp(0);
+    std::vector<MT_DSGYA_EMComponent> em_comps(0);
     unsigned int nblobs;
     unsigned int nobjs;
     for(int i = 1; i <= min(n_cc, (int) rows); i++)
@@ -581,20 +1141,33 @@ std::vector<MT_DSGYA_Blob> MT_DSGYA_Segmenter::doSegmentation(const IplImage* I,
                 if(nblobs != 0 && nobjs != 0)
                 {
                 
-                    /* not a 1-1 relationship -> use EMMG */
-                    cvZero(m_pBlobFrame);
+                    /* not a 1-1 relationship -> use EMMG.  The initials
+                     * are set up here, the fits are run below, once
+                     * all such components are known */
+                    em_comps.push_back(MT_DSGYA_EMComponent());
+                    MT_DSGYA_EMComponent& c = em_comps.back();
+                    c.objs.resize(0);
+                    c.blobs = blobs_this_comp;
+                    c.area = 0;
+                    c.box = cvRect(0, 0, 0, 0);
                     for(unsigned int k = 0; k < nblobs; k++)
                     {
-                        DEBUG_OUT("\tPainting in blob %d\n", blobs_this_comp[k]);
-                        MT_DSGY_PaintYABlobIntoImage(yblobs[blobs_this_comp[k]],
-                                                  m_pBlobFrame);
+                        const YABlob& b = yblobs[blobs_this_comp[k]];
+                        c.area += b.area;
+                        if(b.sequence)
+                        {
+                            CvRect r = cvBoundingRect(b.sequence);
+                            c.box = (c.box.width > 0) ? cvMaxRect(&c.box, &r) : r;
+                        }
                     }
-
-                    std::vector<double> x(nobjs);
-                    std::vector<double> y(nobjs);
-                    std::vector<double> xx(nobjs);
-                    std::vector<double> xy(nobjs);
-                    std::vector<double> yy(nobjs);
+                    c.box = clip_rect(c.box, I->width, I->height);
+
+                    /* warm start from the predicted state of each
+                     * object (in_blobs).  Objects without one go
+                     * last, the blobber places those with k-means++
+                     * seeding. */
+                    std::vector<unsigned int> unseeded(0);
+                    double xx, xy, yy;
                     unsigned int ox;
                     for(unsigned int k = 0; k < nobjs; k++)
                     {
@@ -602,50 +1175,39 @@ std::vector<MT_DSGYA_Blob> MT_DSGYA_Segmenter::doSegmentation(const IplImage* I,
                         if(out_blobs[ox].m_dXCenter == 0 && out_blobs[ox].m_dYCenter == 0)
                         {
                             printf("Warning:  Zero blob\n");
-                            x[k] = yblobs[blobs_this_comp[0]].COMx + MT_frandr(-10, 10);
-                            y[k] = yblobs[blobs_this_comp[0]].COMy + MT_frandr(-10, 10);
-                        }
-                        else
-                        {
-                            x[k] = out_blobs[ox].m_dXCenter;
-                            y[k] = out_blobs[ox].m_dYCenter;
-                        }
-                        xx[k] = 1; //MT_MAX(out_blobs[ox].m_dXXMoment, 1);
-                        xy[k] = 0; //out_blobs[ox].m_dXYMoment;
-                        yy[k] = 1; //MT_MAX(out_blobs[ox].m_dYYMoment, 1);
-                        DEBUG_OUT("\tSetting initials %f %f %f %f %f\n", x[k], y[k], xx[k], xy[k], yy[k]);
-                    }
-
-                    MT_DSGYBlobber blobber(nobjs);
-                    blobber.setTestOut(m_pDebugFile);
-                    blobber.setInitials(x, y, xx, xy, yy);
-                    std::vector<GYBlob> blobs = blobber.findBlobs(m_pBlobFrame,
-                                                                  nobjs,
-                                                                  m_iNumEMMGIterations);
-
-                    for(unsigned int k = 0; k < nobjs; k++)
-                    {
-                        ox = objs_this_comp[k];
-                        if(blobs[k].m_dXXMoment > 0 &&
-                           blobs[k].m_dYYMoment > 0)
-                        {
-                            out_blobs[ox].m_dXCenter = blobs[k].m_dXCentre;
-                            out_blobs[ox].m_dYCenter = blobs[k].m_dYCentre;
-                            out_blobs[ox].m_dXXMoment = blobs[k].m_dXXMoment;
-                            out_blobs[ox].m_dXYMoment = blobs[k].m_dXYMoment;
-                            out_blobs[ox].m_dYYMoment = blobs[k].m_dYYMoment;
-                            out_blobs[ox].m_dArea = blobs[k].m_dArea;
-                            out_blobs[ox].m_dOrientation = blobs[k].m_dOrientation;
-                            out_blobs[ox].m_dMajorAxis = blobs[k].m_dMajorAxis;
-                            out_blobs[ox].m_dMinorAxis = blobs[k].m_dMinorAxis;
+                            unseeded.push_back(ox);
+                            continue;
                         }
+                        c.objs.push_back(ox);
+                        predicted_covariance(out_blobs[ox], &xx, &xy, &yy);
+                        c.x.push_back(out_blobs[ox].m_dXCenter);
+                        c.y.push_back(out_blobs[ox].m_dYCenter);
+                        c.xx.push_back(xx);
+                        c.xy.push_back(xy);
+                        c.yy.push_back(yy);
+                        DEBUG_OUT("\tSetting initials %f %f %f %f %f\n",
+                                  c.x.back(), c.y.back(), xx, xy, yy);
                     }
+                    c.objs.insert(c.objs.end(), unseeded.begin(), unseeded.end());
                 }
             }
         }
         
     }
 
+    if(em_comps.size() > 0)
+    {
+        runEMComponents(em_comps, yblobs, &out_blobs, I);
+    }
+    else if(m_EMBudget.IsActive())
+    {
+        m_EMBudget.EndFrame(false);
+    }
+    m_TotalEMStats.add(m_EMStats);
+    DEBUG_OUT("EMMG:  %d fits, %f iterations on average, at most %d, %d did not converge\n",
+              m_EMStats.m_iFits, m_EMStats.getMeanIterations(),
+              m_EMStats.m_iMaxIterations, m_EMStats.m_iNotConverged);
+
     cvReleaseImage(&m_pBlobFrame);
         
     return out_blobs;
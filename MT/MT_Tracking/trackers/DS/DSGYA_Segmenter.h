@@ -4,8 +4,14 @@
 #include <vector>
 
 #include "MT/MT_Core/support/filesupport.h"
+#include "MT/MT_Core/support/BiCC.h"
+#include "MT/MT_Core/support/WorkerPool.h"
 #include "MT/MT_Tracking/trackers/YA/YABlobber.h"
 #include "MT/MT_Tracking/trackers/GY/GYBlobs.h"
+#include "MT/MT_Tracking/trackers/GY/MixGaussians.h"
+#include "MT/MT_Tracking/trackers/GY/MixGaussiansBudget.h"
+
+class MT_DSGYBlobber;
 
 class MT_DSGYA_Blob
 {
@@ -38,6 +44,37 @@ public:
 bool MT_writeDSGYABlobsToFile(const std::vector<MT_DSGYA_Blob>& blobs, const char* filename);
 std::vector<MT_DSGYA_Blob> MT_readDSGYABlobsFromFile(const char* filename);
 
+/* EMMG iterations-to-convergence statistics */
+struct MT_DSGYA_EMStats
+{
+    MT_DSGYA_EMStats();
+    void addFit(int iterations, bool converged);
+    void add(const MT_DSGYA_EMStats& other);
+    double getMeanIterations() const;
+
+    unsigned int m_iFits;
+    unsigned int m_iIterations;      /* total over all fits */
+    unsigned int m_iMaxIterations;
+    unsigned int m_iNotConverged;    /* fits that ran out of iterations */
+};
+
+/* objects and blobs that have to be sorted out with EMMG, along with
+ * the initial mean and covariance for each object with a prediction.
+ * The objects without one come last.  box is the bounding box of the
+ * blobs, which is all of the frame the fit looks at. */
+struct MT_DSGYA_EMComponent
+{
+    std::vector<unsigned int> objs;
+    std::vector<unsigned int> blobs;
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<double> xx;
+    std::vector<double> xy;
+    std::vector<double> yy;
+    double area;
+    CvRect box;
+};
+
 class MT_DSGYA_Segmenter
 {
 public:
@@ -72,17 +109,49 @@ public:
     unsigned int m_iMaxBlobArea;
     unsigned int m_iMaxBlobPerimeter;
     double m_dOverlapFactor;
+    /* if true (default), only pairs that are near each other are
+     * tested for adjacency, using a grid over the blobs.  false tests
+     * every object against every blob.  Both give the same result. */
+    bool m_bUseAdjacencyGrid;
 
     void setDebugFile(FILE* file);
 
     void setNumEMMGIterations(int n){m_iNumEMMGIterations = n;};
     int getNumEMMGIterations(){return m_iNumEMMGIterations;};    
+
+    /* Number of threads used to run EMMG on separate components,
+     * <= 0 (default) means one per core.  Does not change the
+     * result. */
+    void setNumEMThreads(int n){m_iNumEMThreads = n;};
+    int getNumEMThreads(){return m_iNumEMThreads;};
+
+    /* EMMG statistics for the last frame, and totals since
+     * construction or resetEMStats */
+    MT_DSGYA_EMStats getEMStats() const {return m_EMStats;};
+    MT_DSGYA_EMStats getTotalEMStats() const {return m_TotalEMStats;};
+    void resetEMStats(){m_EMStats = m_TotalEMStats = MT_DSGYA_EMStats();};
+
+    /* Time budget in seconds for the EMMG fits of each frame in
+     * doSegmentation, <= 0 (default) for none.  See
+     * MixGaussiansBudget.  With a budget, fits may stop before
+     * converging and the result depends on timing. */
+    void setEMFrameBudget(double seconds){m_EMBudget.m_dBudget = seconds;};
+    double getEMFrameBudget() const {return m_EMBudget.m_dBudget;};
+    /* frames in which the budget cut a fit short */
+    int getNumDegradedFrames() const {return m_EMBudget.m_iNumDegradedFrames;};
     
 protected:
     virtual bool areAdjacent(MT_DSGYA_Blob* obj, const YABlob& blob);
     virtual bool areOverlapping(MT_DSGYA_Blob* obj, const YABlob& blob);
     virtual void usePrevious(MT_DSGYA_Blob* obj, unsigned int i);
     virtual std::vector<YABlob> filterFirstBlobs(const std::vector<YABlob>& in_blobs);
+    /* fills edges with the (object, blob) pairs for which areAdjacent
+     * is true.  The grid version relies on areAdjacent never being
+     * true beyond m_dOverlapFactor*(m_dRhoContrib + major_axis), so
+     * subclasses that change areAdjacent should override this too. */
+    virtual void findAdjacentPairs(std::vector<MT_DSGYA_Blob>* objs,
+                                   const std::vector<YABlob>& blobs,
+                                   std::vector<MT_BiCCEdge>* edges);
 
     std::vector<unsigned int> m_viAssignmentMat;
     std::vector<unsigned int> m_viAssignmentVec;    
@@ -91,14 +160,57 @@ protected:
     unsigned int m_iAssignmentCols;
 
     int m_iNumEMMGIterations;
+    int m_iNumEMThreads;
+
+    MT_DSGYA_EMStats m_EMStats;
+    MT_DSGYA_EMStats m_TotalEMStats;
+
+    MixGaussiansBudget m_EMBudget;
     
 private:
+    /* runs the EMMG fits, largest first, on the worker pool, within
+     * m_EMBudget if it is set.  Each component only writes to its
+     * own objects. */
+    void runEMComponents(const std::vector<MT_DSGYA_EMComponent>& comps,
+                         const std::vector<YABlob>& yblobs,
+                         std::vector<MT_DSGYA_Blob>* out_blobs,
+                         const IplImage* I);
+    /* runs n_jobs of job in order on this thread if serial,
+     * otherwise on the pool */
+    void runEMPass(MT_WorkerJob* job, unsigned int n_jobs, bool serial, const IplImage* I);
+    void runJobsOnPool(MT_WorkerJob* job, unsigned int n_jobs, const IplImage* I);
+    friend class MT_DSGYA_EMJob;
+    /* paints the component's blobs and runs blobber on them, touching
+     * only the pixels in comp.box */
+    void fitEMComponent(const MT_DSGYA_EMComponent& comp,
+                        const std::vector<YABlob>& yblobs,
+                        MT_DSGYBlobber* blobber,
+                        int worker,
+                        int max_iters);
+    void writeEMComponent(const MT_DSGYA_EMComponent& comp,
+                          const std::vector<GYBlob>& blobs,
+                          std::vector<MT_DSGYA_Blob>* out_blobs);
+
     unsigned int m_iFrameWidth;
     unsigned int m_iFrameHeight;
     IplImage* m_pBlobFrame;
 
     YABlobber m_YABlobber;
 
+    /* EMMG workspace and image to paint components into, one per
+     * worker, kept between frames.  Worker 0 paints into
+     * m_pBlobFrame. */
+    MT_WorkerPool* m_pWorkerPool;
+    int m_iWorkerPoolThreads;
+    std::vector<MixGaussiansWorkspace> m_vEMWorkspaces;
+    std::vector<IplImage*> m_vpWorkerFrames;
+
+    /* adjacency grid workspace, kept between frames */
+    std::vector<unsigned int> m_viGridStart;
+    std::vector<unsigned int> m_viGridBlobs;
+    std::vector<unsigned int> m_viGridStamp;
+    std::vector<int> m_viBlobCells;
+
     FILE* m_pDebugFile;
 };
 
@@ -37,6 +37,16 @@ void MT_DSGYBlobber::setTestOut(FILE* fp)
     m_Gaussians.setDebugFile(fp);
 }
 
+void MT_DSGYBlobber::setWorkspace(MixGaussiansWorkspace* ws)
+{
+    m_Gaussians.setWorkspace(ws);
+}
+
+void MT_DSGYBlobber::setEMDeadline(double deadline)
+{
+    m_Gaussians.m_dDeadline = deadline;
+}
+
 void MT_DSGYBlobber::setNumberOfObjects(unsigned int num_obj)
 {
     m_iNObj = num_obj;
@@ -134,8 +144,8 @@ void MT_DSGYBlobber::doBlobFinding(IplImage* thresh_frame)
         m_SearchArea.height <= 0 ||
         m_SearchArea.x < 0 ||
         m_SearchArea.y < 0 ||
-        m_SearchArea.x + m_SearchArea.width >= thresh_frame->width ||
-        m_SearchArea.y + m_SearchArea.height >= thresh_frame->height)
+        m_SearchArea.x + m_SearchArea.width > thresh_frame->width ||
+        m_SearchArea.y + m_SearchArea.height > thresh_frame->height)
     {
         m_SearchArea = cvRect(0, 0, thresh_frame->width, thresh_frame->height);
     }
@@ -165,6 +175,9 @@ void MT_DSGYBlobber::doBlobFinding(IplImage* thresh_frame)
     }
 
     TEST_OUT("\tFound %d pixels in search area\n", m_RawBlobData[0]->GetNumPixels());
+
+    // Move the pixels into the shared, aligned buffer
+    m_PixelBuffer.Pack(m_RawBlobData);
     
     // if there are no pixels in the search area, try resizing it
     if (m_RawBlobData[0]->GetNumPixels() == 0)
@@ -189,45 +202,49 @@ void MT_DSGYBlobber::doSegmentation(int num_to_find, int max_iters)
 {
     TEST_OUT("EMMG\n");
     
-    int j, k;
-
-    int currentblob = 0;
-    /* int numpixels; */
-    int numinrawblob;
-    std::vector<CvPoint> PixelList;
-    PixelList.resize(0);
-    double XXMoment, YYMoment, XYMoment, Delta, A, theta, headfraction, slope;
-
-    numinrawblob = num_to_find;
-    
     TEST_OUT("\tInitialize Distributions\n");
     if(!m_bHasHistory)
     {
-        TEST_OUT("\tInitializing with uniform blobs\n");
+        TEST_OUT("\tInitializing with k-means++ seeds\n");
         //m_Gaussians = MixGaussians(num_to_find, m_SearchArea);
-        m_Gaussians.CoverBox(num_to_find, m_SearchArea);
+        m_Gaussians.ClearDists();
+        m_Gaussians.SeedKMeansPP(num_to_find, m_RawBlobData[0]);
     }
     else
     {
         TEST_OUT("\tAlready have %d distributions\n", m_Gaussians.GetNumDists());
         if(num_to_find > m_Gaussians.GetNumDists())
         {
+            /* e.g. objects without a prediction */
             TEST_OUT("\tAdding extra distributions\n");
-            m_Gaussians.CoverBox(num_to_find - m_Gaussians.GetNumDists(),
-                                 m_SearchArea);
+            m_Gaussians.SeedKMeansPP(num_to_find - m_Gaussians.GetNumDists(),
+                                     m_RawBlobData[0]);
         }
     }
 
 
+    fitAndExtract(num_to_find, max_iters);
+}       // end function
+
+void MT_DSGYBlobber::resumeSegmentation(int max_iters)
+{
+    TEST_OUT("EMMG (resumed)\n");
+    fitAndExtract(m_Gaussians.GetNumDists(), max_iters);
+}
+
+void MT_DSGYBlobber::fitAndExtract(int numinrawblob, int max_iters)
+{
+    int j, k;
+
+    int currentblob = 0;
+    std::vector<CvPoint> PixelList;
+    PixelList.resize(0);
+    double XXMoment, YYMoment, XYMoment, Delta, A, theta, headfraction, slope;
+
    //////////////////////////////////////////////////////////////////////
 
-    /* Create a vector to hold the distribution allocations of each pixel in the raw blob.
-       For a pixel assigned to distributions d_1, d_2, d_3, ..., the allocation number will
-       be d_1 + n*d_2 + n^2*d_3 + ..., where n is the total number of distributions 
-       (i.e. n = numinrawblob) */
-    TEST_OUT("\tInitialize Allocations\n");
-    std::vector<int> PixelAllocation;
-    PixelAllocation.resize(m_RawBlobData[0]->GetNumPixels());
+    /* m_PixelAllocation will hold the list of distributions each pixel in the raw
+       blob is allocated to */
 
     // Run the expectation maximisation algorithm
     TEST_OUT("\tRunning EMMG algorithm\n");
@@ -235,8 +252,11 @@ void MT_DSGYBlobber::doSegmentation(int num_to_find, int max_iters)
     /*m_Gaussians.m_dMaxDistance = 10.0;*/
     /*m_Gaussians.m_dMaxSizePercentChange = 10.0;*/
     m_Gaussians.EMMG(m_RawBlobData[0],
-                     PixelAllocation,
+                     m_PixelAllocation,
                      max_iters);
+    TEST_OUT("\tEMMG took %d iterations%s\n",
+             m_Gaussians.GetNumIterations(),
+             m_Gaussians.GetConverged() ? "" : " (did not converge)");
 
    //////////////////////////////////////////////////////////////////////
 
@@ -258,15 +278,10 @@ void MT_DSGYBlobber::doSegmentation(int num_to_find, int max_iters)
     m_RawBlobData[0]->GetPixelList(PixelList);
     for (k = 0 ; k < m_RawBlobData[0]->GetNumPixels() ; k++)
     {
-        int dists = PixelAllocation[k];
-        int p = 1;
-        for(int i = 0; i < numinrawblob; i++)
+        const int* dists = m_PixelAllocation.GetDists(k);
+        for(int d = 0; d < m_PixelAllocation.GetNumDists(k); d++)
         {
-            if(dists & p)
-            {
-                ExtractedBlobs[i]->AddPoint(PixelList[k]);
-            }
-            p *= 2;
+            ExtractedBlobs[dists[d]]->AddPoint(PixelList[k]);
         }
         
         /* int allocated;
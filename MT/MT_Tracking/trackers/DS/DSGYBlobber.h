@@ -34,10 +34,22 @@ class MT_DSGYBlobber
 public:
     MT_DSGYBlobber(unsigned int num_obj);
     void setTestOut(FILE* fp);
+    /* EMMG scratch space, owned by the caller */
+    void setWorkspace(MixGaussiansWorkspace* ws);
 
     void doBlobFinding(IplImage* thresh_image);
     void doSegmentation(int num_to_find, int max_iters = -1);
-
+    /* Runs EMMG again from where the last doSegmentation or
+     * resumeSegmentation stopped, e.g. after running out of
+     * iterations, and extracts the blobs again */
+    void resumeSegmentation(int max_iters = -1);
+    /* EMMG stops at this time (see MixGaussians::m_dDeadline) */
+    void setEMDeadline(double deadline);
+
+    /* Starting point for EMMG, e.g. the predicted state of each
+     * object.  If there are fewer than the number of blobs to find,
+     * the rest are placed by k-means++ seeding, as are all of them
+     * when setInitials isn't called. */
     void setInitials(std::vector<double> x_c,
                      std::vector<double> y_c,
                      std::vector<double> xx,
@@ -45,6 +57,13 @@ public:
                      std::vector<double> yy);
     std::vector<GYBlob> findBlobs(IplImage* thresh_image, int num_to_find, int max_iters = -1);
 
+    /* from the last EMMG fit */
+    int getNumEMIterations() const {return m_Gaussians.GetNumIterations();};
+    bool getEMConverged() const {return m_Gaussians.GetConverged();};
+    double getEMResidualChange() const {return m_Gaussians.GetResidualChange();};
+    /* the blobs from the last doSegmentation or resumeSegmentation */
+    const std::vector<GYBlob>& getCurrentBlobs() const {return m_CurrentBlobs;};
+
     int m_iBlob_area_thresh_low;
     int m_iBlob_area_thresh_high;
 
@@ -57,9 +76,12 @@ public:
 protected:
     
 private:
+    void fitAndExtract(int numinrawblob, int max_iters);
+
     CvRect m_SearchArea;
     
     std::vector<RawBlobPtr> m_RawBlobData;
+    GYPixelBuffer m_PixelBuffer;
     std::vector<GYBlob> m_CurrentBlobs;
     std::vector<GYBlob> m_OldBlobs;
 
@@ -67,6 +89,7 @@ private:
 
     unsigned int m_iNObj;
     MixGaussians m_Gaussians;
+    MixGaussiansAllocation m_PixelAllocation;
 
     FILE* m_pTestFile;
     
@@ -184,6 +184,9 @@ void GYBlobber::doBlobFinding(IplImage* thresh_frame)
         }
     }
 
+    // Move the pixels of all the raw blobs into one contiguous block
+    m_PixelBuffer.Pack(m_RawBlobData);
+
     // If we haven't found any blobs and we had a limited search area, reset the
     // search area and try again.
     if ((m_RawBlobData.size() == 0) && m_bHasHistory)
@@ -456,16 +459,13 @@ void GYBlobber::doSegmentation()
                 delete[] distances;             // release memory
             }           // end else
 
-            /* Create a vector to hold the distribution allocations of each pixel in the raw blob.
-               For a pixel assigned to distributions d_1, d_2, d_3, ..., the allocation number will
-               be d_1 + n*d_2 + n^2*d_3 + ..., where n is the total number of distributions 
-               (i.e. n = numinrawblob) */
-            std::vector<int> PixelAllocation;
-            PixelAllocation.resize(m_RawBlobData[i]->GetNumPixels());
+            /* m_PixelAllocation will hold the list of distributions each pixel in the raw
+               blob is allocated to */
 
             // Run the expectation maximisation algorithm
+            FittedBlobs.setWorkspace(&m_EMWorkspace);
             FittedBlobs.EMMG(m_RawBlobData[i],
-                             PixelAllocation,
+                             m_PixelAllocation,
                              0 /* was: m_iFrame_counter
                                 * doesn't appear to be used by EMMG */);
 
@@ -483,15 +483,10 @@ void GYBlobber::doSegmentation()
             m_RawBlobData[i]->GetPixelList(PixelList);
             for (k = 0 ; k < m_RawBlobData[i]->GetNumPixels() ; k++)
             {
-                int dists = PixelAllocation[k];
-                int p = 1;
-                for(int i = 0; i < numinrawblob; i++)
+                const int* dists = m_PixelAllocation.GetDists(k);
+                for(int d = 0; d < m_PixelAllocation.GetNumDists(k); d++)
                 {
-                    if(dists & p)
-                    {
-                        ExtractedBlobs[i]->AddPoint(PixelList[k]);
-                    }
-                    p *= 2;
+                    ExtractedBlobs[dists[d]]->AddPoint(PixelList[k]);
                 }
 
                 /* int allocated;
@@ -40,6 +40,9 @@ private:
     CvRect m_SearchArea;
     
     std::vector<RawBlobPtr> m_RawBlobData;
+    GYPixelBuffer m_PixelBuffer;
+    MixGaussiansWorkspace m_EMWorkspace;
+    MixGaussiansAllocation m_PixelAllocation;
     std::vector<GYBlob> m_CurrentBlobs;
     std::vector<GYBlob> m_OldBlobs;
 
@@ -14,6 +14,7 @@
 
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
 
 // Member functions for class GYBlob
 
@@ -43,8 +44,13 @@ GYBlob::GYBlob(double x, double y, double A, double phi, double major, double mi
 
 GYRawBlob::GYRawBlob(int expectedpixels)
 {
-    m_vPixelList.reserve(expectedpixels);
-    m_vPixelList.resize(0);
+    m_vX.reserve(expectedpixels);
+    m_vY.reserve(expectedpixels);
+    m_vX.resize(0);
+    m_vY.resize(0);
+    m_pPackedX = NULL;
+    m_pPackedY = NULL;
+    m_bPacked = false;
         
     m_iNumPixels = 0;
         
@@ -60,7 +66,13 @@ GYRawBlob::GYRawBlob(int expectedpixels)
 
 void GYRawBlob::AddPoint(CvPoint newpoint)
 {
-    m_vPixelList.push_back(newpoint);
+    if (m_bPacked)
+    {
+        Unpack();
+    }
+
+    m_vX.push_back((GYPixelCoord) newpoint.x);
+    m_vY.push_back((GYPixelCoord) newpoint.y);
     m_iNumPixels++;
 
     m_bCalcXCentre = false;
@@ -100,6 +112,16 @@ void GYRawBlob::AddPoint(CvPoint newpoint)
     }
 }
 
+// Copies the pixels back out of the shared buffer into the blob's own arrays
+void GYRawBlob::Unpack()
+{
+    m_vX.assign(m_pPackedX, m_pPackedX + m_iNumPixels);
+    m_vY.assign(m_pPackedY, m_pPackedY + m_iNumPixels);
+    m_pPackedX = NULL;
+    m_pPackedY = NULL;
+    m_bPacked = false;
+}
+
 void GYRawBlob::SetPerimeter(double p)
 {
     m_dPerimeter = p;
@@ -136,10 +158,11 @@ double GYRawBlob::GetXCentre()
     if (!m_bCalcXCentre)
     {
         double tempXCentre = 0.0;
+        const GYPixelCoord* xs = Xs();
         int pixelnum;
         for (pixelnum = 0 ; pixelnum < m_iNumPixels ; pixelnum++)
         {
-            tempXCentre += m_vPixelList[pixelnum].x;
+            tempXCentre += xs[pixelnum];
         }
 
         m_dXCentre = tempXCentre/((double) m_iNumPixels);
@@ -159,10 +182,11 @@ double GYRawBlob::GetYCentre()
     if (!m_bCalcYCentre)
     {
         double tempYCentre = 0.0;
+        const GYPixelCoord* ys = Ys();
         int pixelnum;
         for (pixelnum = 0 ; pixelnum < m_iNumPixels ; pixelnum++)
         {
-            tempYCentre += m_vPixelList[pixelnum].y;
+            tempYCentre += ys[pixelnum];
         }
                 
         m_dYCentre = tempYCentre/((double) m_iNumPixels);
@@ -187,10 +211,11 @@ double GYRawBlob::GetXXMoment()
         }
                 
         double XX = 0.0;
+        const GYPixelCoord* xs = Xs();
         int iter;
         for (iter = 0 ; iter < m_iNumPixels ; iter++)
         {
-            XX += pow(m_vPixelList[iter].x - m_dXCentre, 2);
+            XX += pow(xs[iter] - m_dXCentre, 2);
         }
                 
         // Protect against zero moments (e.g. when all pixels have the same x value)
@@ -223,10 +248,12 @@ double GYRawBlob::GetXYMoment()
         }
                 
         double XY = 0.0;
+        const GYPixelCoord* xs = Xs();
+        const GYPixelCoord* ys = Ys();
         int iter;
         for (iter = 0 ; iter < m_iNumPixels ; iter++)
         {
-            XY += (m_vPixelList[iter].x - m_dXCentre)*(m_vPixelList[iter].y - m_dYCentre);
+            XY += (xs[iter] - m_dXCentre)*(ys[iter] - m_dYCentre);
         }
                 
         return XY;
@@ -248,10 +275,11 @@ double GYRawBlob::GetYYMoment()
         }
                 
         double YY = 0.0;
+        const GYPixelCoord* ys = Ys();
         int iter;
         for (iter = 0 ; iter < m_iNumPixels ; iter++)
         {
-            YY += pow(m_vPixelList[iter].y - m_dYCentre, 2);
+            YY += pow(ys[iter] - m_dYCentre, 2);
         }
                 
         // Protect against zero moments (e.g. when all pixels have the same y value)
@@ -268,10 +296,116 @@ void GYRawBlob::GetPixelList(std::vector<CvPoint>& pixellist)
 {
     if (pixellist.size() == (unsigned int) m_iNumPixels)
     {
-        pixellist = m_vPixelList;
+        const GYPixelCoord* xs = Xs();
+        const GYPixelCoord* ys = Ys();
+        for (int i = 0 ; i < m_iNumPixels ; i++)
+        {
+            pixellist[i].x = xs[i];
+            pixellist[i].y = ys[i];
+        }
     }
     else
     {
         printf("Reserved vector has the wrong size\n");
     }   
 }
+
+GYPixelView GYRawBlob::GetPixelView() const
+{
+    GYPixelView view;
+    view.m_iNumPixels = m_iNumPixels;
+    view.m_bPadded = m_bPacked;
+    if (m_iNumPixels == 0)
+    {
+        view.m_pX = view.m_pY = NULL;
+    }
+    else
+    {
+        view.m_pX = Xs();
+        view.m_pY = Ys();
+    }
+    return view;
+}
+
+
+// Member functions for class GYPixelBuffer
+
+GYPixelBuffer::GYPixelBuffer()
+{
+    m_vStorage.resize(0);
+}
+
+void GYPixelBuffer::Pack(std::vector<RawBlobPtr>& blobs)
+{
+    unsigned int i;
+    int n;
+
+    // Blobs packed by an earlier call point into the storage we are about
+    // to reuse, so take their pixels back out first
+    for (i = 0 ; i < blobs.size() ; i++)
+    {
+        if (blobs[i]->m_bPacked)
+        {
+            blobs[i]->Unpack();
+        }
+    }
+
+    // Each blob's arrays are padded out to a multiple of GY_PIXEL_ALIGN entries
+    std::vector<int> offsets(blobs.size() + 1);
+    offsets[0] = 0;
+    for (i = 0 ; i < blobs.size() ; i++)
+    {
+        n = blobs[i]->m_iNumPixels;
+        offsets[i+1] = offsets[i] + GY_PIXEL_ALIGN*((n + GY_PIXEL_ALIGN - 1)/GY_PIXEL_ALIGN);
+    }
+    int total = offsets[blobs.size()];
+
+    // x block, y block, plus slack to align the start of the x block.
+    // Only grows, so the storage is reused from frame to frame
+    if (m_vStorage.size() < (unsigned int) (2*total + GY_PIXEL_ALIGN))
+    {
+        m_vStorage.resize(2*total + GY_PIXEL_ALIGN);
+    }
+    if (total == 0)
+    {
+        return;
+    }
+
+    GYPixelCoord* base = &m_vStorage[0];
+    size_t misalign = ((size_t) base) % (GY_PIXEL_ALIGN*sizeof(GYPixelCoord));
+    if (misalign)
+    {
+        base += (GY_PIXEL_ALIGN*sizeof(GYPixelCoord) - misalign)/sizeof(GYPixelCoord);
+    }
+    GYPixelCoord* xblock = base;
+    GYPixelCoord* yblock = base + total;
+
+    for (i = 0 ; i < blobs.size() ; i++)
+    {
+        GYRawBlob* b = blobs[i].get();
+        if (b->m_bPacked)
+        {
+            // blob listed twice - already packed above
+            continue;
+        }
+        n = b->m_iNumPixels;
+        GYPixelCoord* x = xblock + offsets[i];
+        GYPixelCoord* y = yblock + offsets[i];
+        if (n > 0)
+        {
+            memcpy(x, &b->m_vX[0], n*sizeof(GYPixelCoord));
+            memcpy(y, &b->m_vY[0], n*sizeof(GYPixelCoord));
+        }
+        for (int k = n ; k < offsets[i+1] - offsets[i] ; k++)
+        {
+            x[k] = y[k] = 0;
+        }
+
+        // release the blob's own arrays
+        std::vector<GYPixelCoord>().swap(b->m_vX);
+        std::vector<GYPixelCoord>().swap(b->m_vY);
+        b->m_pPackedX = x;
+        b->m_pPackedY = y;
+        b->m_bPacked = true;
+    }
+}
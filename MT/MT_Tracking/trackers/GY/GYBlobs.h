@@ -62,10 +62,46 @@ public:
 };
 
 
+/* Pixel coordinates are stored as 16-bit integers - plenty for any
+   frame we deal with, and half the memory traffic of a CvPoint. */
+typedef short GYPixelCoord;
+
+/* Pixel arrays packed by GYPixelBuffer start on GY_PIXEL_ALIGN-entry
+   (16-byte) boundaries and are zero-padded to a multiple of
+   GY_PIXEL_ALIGN entries */
+#define GY_PIXEL_ALIGN 8
+
+/* Read-only view of a raw blob's pixels as separate x and y arrays.
+   Only the first m_iNumPixels entries are meaningful, but for packed
+   blobs it is safe to read up to the next multiple of GY_PIXEL_ALIGN
+   (e.g. a whole SIMD vector at a time).  The view is invalidated by
+   AddPoint and by the next GYPixelBuffer::Pack. */
+class GYPixelView
+{
+public:
+    const GYPixelCoord* m_pX;
+    const GYPixelCoord* m_pY;
+    int m_iNumPixels;
+    bool m_bPadded;
+};
+
 class GYRawBlob
 {
 protected:
-    std::vector<CvPoint> m_vPixelList;
+    friend class GYPixelBuffer;
+
+    /* pixels are kept in the blob's own x and y arrays while the
+       blob is being built, then moved to a shared buffer by
+       GYPixelBuffer::Pack */
+    std::vector<GYPixelCoord> m_vX;
+    std::vector<GYPixelCoord> m_vY;
+    const GYPixelCoord* m_pPackedX;
+    const GYPixelCoord* m_pPackedY;
+    bool m_bPacked;
+
+    const GYPixelCoord* Xs() const {return m_bPacked ? m_pPackedX : (m_vX.empty() ? NULL : &m_vX[0]);};
+    const GYPixelCoord* Ys() const {return m_bPacked ? m_pPackedY : (m_vY.empty() ? NULL : &m_vY[0]);};
+    void Unpack();
                 
     int m_iNumPixels;
                 
@@ -92,6 +128,7 @@ public:
     double GetXYMoment();
     double GetYYMoment();
     void GetPixelList(std::vector<CvPoint>& pixellist);
+    GYPixelView GetPixelView() const;
                 
     void AddPoint(CvPoint newpoint);
     void SetPerimeter(double p);
@@ -100,4 +137,22 @@ public:
 
 typedef std::tr1::shared_ptr<GYRawBlob> RawBlobPtr;
 
+
+/* Per-frame storage for raw blob pixels.  Pack moves the pixels of
+   every blob into one contiguous, aligned block (all the x arrays,
+   then all the y arrays) so that the blobs of a frame sit together in
+   cache.  The storage is reused from frame to frame, so packing a new
+   set of blobs invalidates the pixels of any blobs packed before;
+   those blobs must not be used afterwards. */
+class GYPixelBuffer
+{
+protected:
+    std::vector<GYPixelCoord> m_vStorage;
+
+public:
+    GYPixelBuffer();
+
+    void Pack(std::vector<RawBlobPtr>& blobs);
+};
+
 #endif          // GYBLOBS_H
@@ -13,9 +13,14 @@
 
 #include "GYSegmenter.h"
 
+#include <algorithm>
+
 #include "MT/MT_Core/support/mathsupport.h"
 #include "MT/MT_Core/primitives/Matrix.h"
+#ifndef MT_NO_GL
 #include "MT/MT_Core/gl/glSupport.h"  // for blob drawing
+#endif
+#include "MT/MT_Tracking/base/MT_TrackerPipeline.h"
 
 GYBlobberParameters::GYBlobberParameters(int* val_thresh_low, 
                                      int* area_thresh_low, 
@@ -29,6 +34,70 @@ GYBlobberParameters::GYBlobberParameters(int* val_thresh_low,
 
 }
 
+GYSearchWindowParameters::GYSearchWindowParameters(bool* use_predicted_windows,
+                                                   double* window_sigmas,
+                                                   double* min_sigma,
+                                                   int* lost_frames_before_full,
+                                                   int* rescan_tiles)
+  : MT_DataGroup("Search Window Parameters")
+{
+
+    AddBool("Use Predicted Windows", use_predicted_windows, MT_DATA_READWRITE);
+    AddDouble("Window Size [sigmas]", window_sigmas, MT_DATA_READWRITE, 0);
+    AddDouble("Min Position Sigma [px]", min_sigma, MT_DATA_READWRITE, 0);
+    AddInt("Lost Frames Before Full Search", lost_frames_before_full, MT_DATA_READWRITE);
+    AddInt("Rescan Tiles", rescan_tiles, MT_DATA_READWRITE, 0);
+
+}
+
+GYEMParameters::GYEMParameters(int* bin_size,
+                               int* bin_min_pixels,
+                               double* bin_tolerance,
+                               int* num_threads,
+                               double* frame_budget,
+                               int* degraded_frames)
+  : MT_DataGroup("EM Parameters")
+{
+
+    AddInt("Bin Size [px]", bin_size, MT_DATA_READWRITE, 1);
+    AddInt("Bin Min Blob Size [px]", bin_min_pixels, MT_DATA_READWRITE, 0);
+    AddDouble("Bin Tolerance [px, deg]", bin_tolerance, MT_DATA_READWRITE, 0);
+    AddInt("Threads (0 = one per core)", num_threads, MT_DATA_READWRITE, 0);
+    AddDouble("Frame Budget [ms] (0 = none)", frame_budget, MT_DATA_READWRITE, 0);
+    AddInt("Degraded Frames", degraded_frames, MT_DATA_READONLY);
+
+}
+
+GYMatchingParameters::GYMatchingParameters(bool* use_gated_matching,
+                                           double* gate_sigmas,
+                                           double* gate_radius,
+                                           int* num_subproblems)
+  : MT_DataGroup("Matching Parameters")
+{
+
+    AddBool("Use Gated Matching", use_gated_matching, MT_DATA_READWRITE);
+    AddDouble("Gate Size [sigmas]", gate_sigmas, MT_DATA_READWRITE, 0);
+    AddDouble("Gate Radius [px] (0 = use sigmas)", gate_radius, MT_DATA_READWRITE, 0);
+    AddInt("Subproblems", num_subproblems, MT_DATA_READONLY);
+
+}
+
+GYTrackManagementParameters::GYTrackManagementParameters(bool* manage_tracks,
+                                                         double* track_gate,
+                                                         int* confirm_hits,
+                                                         int* max_misses,
+                                                         int* num_confirmed)
+  : MT_DataGroup("Track Management Parameters")
+{
+
+    AddBool("Manage Tracks", manage_tracks, MT_DATA_READWRITE);
+    AddDouble("Track Gate [px]", track_gate, MT_DATA_READWRITE, 0);
+    AddInt("Hits to Confirm", confirm_hits, MT_DATA_READWRITE, 1);
+    AddInt("Misses to Delete", max_misses, MT_DATA_READWRITE, 1);
+    AddInt("Confirmed Tracks", num_confirmed, MT_DATA_READONLY);
+
+}
+
 GYBlobberFrameGroup::GYBlobberFrameGroup(IplImage** diff_frame, IplImage** thresh_frame)
 {
 
@@ -86,7 +155,77 @@ static int IndexMaxDiff(int* array1, double* array2, int arraylength);
 
 static int IndexMin(double* array, int arraylength);
 
-static int ipow(int& a, int& n);
+static CvRect ClipToFrame(double xmin, double xmax, double ymin, double ymax, int width, int height);
+
+static bool RectsOverlapOrTouch(const CvRect& a, const CvRect& b);
+
+static void MergeOverlappingRects(std::vector<CvRect>* rects);
+
+// Splits the merged raw blobs, one per job, in one of the passes
+// described in GYSegmenter::doSegmentation
+class GYSegmentationJob : public MT_WorkerJob
+{
+public:
+    enum {FIRST_FIT, CONTINUE_FIT, EXTRACT};
+
+    GYSegmentationJob(GYSegmenter* segmenter)
+        : m_iPass(FIRST_FIT), m_dDeadline(-1), m_pSegmenter(segmenter) {};
+
+    int m_iPass;
+    double m_dDeadline;
+    // merged raw blobs to run in this pass, in order
+    std::vector<int> m_viOrder;
+
+    // for each merged raw blob
+    std::vector<int> m_viRawBlobs;
+    std::vector<int> m_viNumBlobs;
+    std::vector<int> m_viFirstBlob;
+    std::vector<int> m_viMaxIters;      // allowed in this pass
+    std::vector<int> m_viIterations;    // in all passes so far
+    std::vector<int> m_viConverged;
+    std::vector<double> m_vdResidual;
+    std::vector<double> m_vdSeconds;    // of this pass
+
+    void resize(int n)
+    {
+        m_viRawBlobs.resize(n);
+        m_viNumBlobs.resize(n);
+        m_viFirstBlob.resize(n);
+        m_viMaxIters.resize(n);
+        m_viIterations.assign(n, 0);
+        m_viConverged.assign(n, 0);
+        m_vdResidual.assign(n, 0);
+        m_vdSeconds.assign(n, 0);
+    };
+
+    void doJob(int index, int worker)
+    {
+        int m = m_viOrder[index];
+        if(m_iPass == EXTRACT)
+        {
+            m_pSegmenter->extractMergedBlob(m_viRawBlobs[m], m_viNumBlobs[m],
+                                            m_viFirstBlob[m], m);
+            return;
+        }
+
+        if(m_iPass == FIRST_FIT)
+        {
+            m_pSegmenter->initMergedBlob(m_viRawBlobs[m], m_viNumBlobs[m], m);
+        }
+        double t = MT_getTimeSec();
+        m_pSegmenter->fitMergedBlob(m_viRawBlobs[m], m, m_viMaxIters[m],
+                                    m_dDeadline, worker);
+        m_vdSeconds[m] = MT_getTimeSec() - t;
+
+        const MixGaussians& fit = m_pSegmenter->m_vEMFits[m];
+        m_viIterations[m] += fit.GetNumIterations();
+        m_viConverged[m] = fit.GetConverged();
+        m_vdResidual[m] = fit.GetResidualChange();
+    };
+
+private:
+    GYSegmenter* m_pSegmenter;
+};
 
 
 
@@ -98,6 +237,7 @@ GYSegmenter::GYSegmenter(IplImage* ProtoFrame)
 void GYSegmenter::doInit(IplImage* ProtoFrame)
 {
     m_pTrackedObjects = NULL;
+    m_pTrackStore = NULL;
 
     m_pTrackerFrameGroup = new GYBlobberFrameGroup(&m_pDiff_frame, &m_pThresh_frame);
 
@@ -123,6 +263,48 @@ void GYSegmenter::doInit(IplImage* ProtoFrame)
     m_ArrowColor = MT_Green;
     m_EllipseColor = MT_Blue;
 
+    // 3 sigmas of 20 px gives the same 60 px margin as the single
+    // search box
+    m_bUsePredictedWindows = false;
+    m_dSearchWindowSigmas = 3.0;
+    m_dSearchWindowMinSigma = 20.0;
+    m_iLostFramesBeforeFull = 1;
+    m_iLostFrames = 0;
+    m_iRescanTiles = RT_RESCAN_TILES;
+    m_iRescanTile = 0;
+    m_RescanTile = cvRect(0, 0, 0, 0);
+    m_vTrackWindows.resize(0);
+    m_vSearchWindows.resize(0);
+    m_vdLastTrackX.resize(0);
+    m_vdLastTrackY.resize(0);
+
+    // binning off by default
+    m_iEMBinSize = 1;
+    m_iEMBinMinPixels = 2000;
+    m_dEMBinTolerance = 0.5;
+
+    m_iEMThreads = 0;
+    m_pWorkerPool = NULL;
+    m_iWorkerPoolThreads = 0;
+    m_vEMWorkspaces.resize(0);
+    m_vEMFits.resize(0);
+    m_vPixelAllocations.resize(0);
+
+    m_dEMFrameBudget = 0;
+
+    m_bUseGatedMatching = false;
+    m_dMatchGateSigmas = 3.0;
+    m_dMatchGateRadius = 0;
+    m_iMatchSubproblems = 0;
+    m_vMatchTracks.resize(0);
+
+    m_bManageTracks = false;
+    m_dTrackGate = 50.0;
+    m_iTrackConfirmHits = 3;
+    m_iTrackMaxMisses = 5;
+    m_iNumConfirmedTracks = 0;
+    m_viSlotTrackID.resize(0);
+
     m_vDataGroups.resize(0);
     m_vDataGroups.push_back(
         new GYBlobberParameters(
@@ -137,6 +319,34 @@ void GYSegmenter::doInit(IplImage* ProtoFrame)
             &m_dArrowLength,
             &m_ArrowColor,
             &m_EllipseColor));
+    m_vDataGroups.push_back(
+        new GYSearchWindowParameters(
+            &m_bUsePredictedWindows,
+            &m_dSearchWindowSigmas,
+            &m_dSearchWindowMinSigma,
+            &m_iLostFramesBeforeFull,
+            &m_iRescanTiles));
+    m_vDataGroups.push_back(
+        new GYEMParameters(
+            &m_iEMBinSize,
+            &m_iEMBinMinPixels,
+            &m_dEMBinTolerance,
+            &m_iEMThreads,
+            &m_dEMFrameBudget,
+            &m_EMBudget.m_iNumDegradedFrames));
+    m_vDataGroups.push_back(
+        new GYMatchingParameters(
+            &m_bUseGatedMatching,
+            &m_dMatchGateSigmas,
+            &m_dMatchGateRadius,
+            &m_iMatchSubproblems));
+    m_vDataGroups.push_back(
+        new GYTrackManagementParameters(
+            &m_bManageTracks,
+            &m_dTrackGate,
+            &m_iTrackConfirmHits,
+            &m_iTrackMaxMisses,
+            &m_iNumConfirmedTracks));
 
     BlobIndexes.resize(0);
     XBlobs.resize(0);
@@ -148,6 +358,7 @@ void GYSegmenter::doInit(IplImage* ProtoFrame)
     m_vDataReports.push_back(new GYBlobInfoReport(&BlobIndexes, &XBlobs, &YBlobs, &ABlobs, &OBlobs));
 
     m_iFrame_counter = 0;
+    m_dTPrevious = m_dTStart = MT_getTimeSec();
 
     doTrain(ProtoFrame);
 
@@ -201,6 +412,11 @@ GYSegmenter::~GYSegmenter()
     {
         cvReleaseImage(&m_pROI_frame);
     }
+
+    if(m_pWorkerPool)
+    {
+        delete m_pWorkerPool;
+    }
 }       // end function
 
 void GYSegmenter::createFrames()
@@ -296,6 +512,11 @@ int GYSegmenter::getNumFrames()
     return m_iFrame_counter;
 }       // end function
 
+int GYSegmenter::getNumDegradedFrames()
+{
+    return m_EMBudget.m_iNumDegradedFrames;
+}       // end function
+
 
 double GYSegmenter::getFrameRate()
 {
@@ -341,10 +562,19 @@ IplImage* GYSegmenter::getROI_frame()
 
 void GYSegmenter::doImageProcessing()
 {
-    // Select the region to search for the raw blobs - the region containing the last
+    m_vTrackWindows.resize(0);
+    m_vSearchWindows.resize(0);
+    m_RescanTile = cvRect(0, 0, 0, 0);
+
+    if (m_bHasHistory && m_bUsePredictedWindows && m_pTrackedObjects)
+    {
+        // One window per track around its predicted position
+        computeSearchWindows();
+    }
+    // Otherwise select the region to search for the raw blobs - the region containing the last
     // measured blob positions and up to 60 pixels in every direction. Note: the 60 
     // pixel value might not be appropriate for other applications
-    if (m_bHasHistory)
+    else if (m_bHasHistory)
     {
         // Find a bounding box around the current locations of all the blobs
         unsigned int i;
@@ -422,6 +652,7 @@ void GYSegmenter::doImageProcessing()
         m_SearchArea.width = xmax_i - xmin_i + 1;
         m_SearchArea.y = ymin_i;
         m_SearchArea.height = ymax_i - ymin_i + 1;
+        m_vSearchWindows.push_back(m_SearchArea);
     }           // end if (m_bHasHistory)
     else        // No currently known blobs, so set the search area to the whole image
     {
@@ -429,12 +660,147 @@ void GYSegmenter::doImageProcessing()
         m_SearchArea.width = m_iFrameWidth;
         m_SearchArea.y = 0;
         m_SearchArea.height = m_iFrameHeight;
+        m_vSearchWindows.push_back(m_SearchArea);
     }           // end else
 
-    cvSetImageROI(m_pBG_frame, m_SearchArea);
-    cvSetImageROI(m_pGS_frame, m_SearchArea);
-    cvSetImageROI(m_pThresh_frame, m_SearchArea);
-    cvSetImageROI(m_pDiff_frame, m_SearchArea);
+    MergeOverlappingRects(&m_vSearchWindows);
+
+    // While tracking inside limited windows, also search one band of the
+    // frame per frame so that new objects are found within m_iRescanTiles
+    // frames, at a constant extra cost.  The band is kept apart from the
+    // windows - merging it with a window it touches would give their
+    // bounding box, up to the full width times both their heights.
+    if (m_bHasHistory && (m_iRescanTiles > 0))
+    {
+        m_RescanTile = getRescanTile();
+        for (unsigned int i = 0 ; i < m_vSearchWindows.size() ; i++)
+        {
+            CvRect& w = m_vSearchWindows[i];
+            if ((w.x <= m_RescanTile.x) && (w.y <= m_RescanTile.y)
+                && (w.x + w.width >= m_RescanTile.x + m_RescanTile.width)
+                && (w.y + w.height >= m_RescanTile.y + m_RescanTile.height))
+            {
+                // already searched
+                m_RescanTile = cvRect(0, 0, 0, 0);
+                break;
+            }
+        }
+    }
+
+    // m_SearchArea is kept as the bounding box of the windows and band
+    m_SearchArea = cvRect(0, 0, 0, 0);
+    std::vector<CvRect> areas(m_vSearchWindows);
+    if (m_RescanTile.width > 0)
+    {
+        areas.push_back(m_RescanTile);
+    }
+    if (areas.size() > 0)
+    {
+        int xmin = areas[0].x;
+        int ymin = areas[0].y;
+        int xmax = areas[0].x + areas[0].width;
+        int ymax = areas[0].y + areas[0].height;
+        for (unsigned int i = 1 ; i < areas.size() ; i++)
+        {
+            xmin = MT_MIN(xmin, areas[i].x);
+            ymin = MT_MIN(ymin, areas[i].y);
+            xmax = MT_MAX(xmax, areas[i].x + areas[i].width);
+            ymax = MT_MAX(ymax, areas[i].y + areas[i].height);
+        }
+        m_SearchArea = cvRect(xmin, ymin, xmax - xmin, ymax - ymin);
+    }
+
+    // where the band and a window overlap the same pixels are
+    // thresholded twice, to the same result
+    for (unsigned int i = 0 ; i < areas.size() ; i++)
+    {
+        processSearchArea(areas[i]);
+    }
+}       // end function
+
+
+/* Returns the next of m_iRescanTiles horizontal bands that together
+   cover the frame, cycling through them in order.  Neighbouring bands
+   overlap by RT_RESCAN_OVERLAP pixels so that an object straddling a
+   band edge is seen whole in one of the two bands. */
+CvRect GYSegmenter::getRescanTile()
+{
+    int band = (m_iFrameHeight + m_iRescanTiles - 1)/m_iRescanTiles;
+
+    m_iRescanTile = m_iRescanTile % m_iRescanTiles;
+    int ymin = MT_MAX(m_iRescanTile*band - RT_RESCAN_OVERLAP, 0);
+    int ymax = MT_MIN((m_iRescanTile + 1)*band + RT_RESCAN_OVERLAP, m_iFrameHeight);
+    m_iRescanTile++;
+
+    if (ymax <= ymin)
+    {
+        // more tiles than rows - this band is past the bottom of the frame
+        return getRescanTile();
+    }
+
+    return cvRect(0, ymin, m_iFrameWidth, ymax - ymin);
+}       // end function
+
+
+/* Builds one search window per track, centred on the track's
+   predicted position and sized to the uncertainty of that prediction.
+   doImageProcessing merges the windows that overlap or touch so that
+   no blob is split between two windows.
+
+   The prediction is constant velocity from the last two track
+   positions.  The predicted position covariance is taken to be
+   P = s^2 I + v v^T, i.e. a base uncertainty s (m_dSearchWindowMinSigma)
+   plus the uncertainty of the velocity estimate along the direction of
+   motion.  The k-sigma ellipse of P is bounded by half-widths
+   k sqrt(Pxx) and k sqrt(Pyy). */
+void GYSegmenter::computeSearchWindows()
+{
+    unsigned int ntracks = m_pTrackedObjects->getNumObjects();
+    double s2 = m_dSearchWindowMinSigma*m_dSearchWindowMinSigma;
+    double x, y, vx, vy, hx, hy;
+
+    if ((m_vdLastTrackX.size() != ntracks) || (m_vdLastTrackY.size() != ntracks))
+    {
+        m_vdLastTrackX.resize(ntracks);
+        m_vdLastTrackY.resize(ntracks);
+        for (unsigned int j = 0 ; j < ntracks ; j++)
+        {
+            m_vdLastTrackX[j] = m_pTrackedObjects->getX(j);
+            m_vdLastTrackY[j] = m_pTrackedObjects->getY(j);
+        }
+    }
+
+    m_vTrackWindows.resize(ntracks);
+    for (unsigned int j = 0 ; j < ntracks ; j++)
+    {
+        x = m_pTrackedObjects->getX(j);
+        y = m_pTrackedObjects->getY(j);
+        vx = x - m_vdLastTrackX[j];
+        vy = y - m_vdLastTrackY[j];
+        x += vx;
+        y += vy;
+
+        hx = m_dSearchWindowSigmas*sqrt(s2 + vx*vx);
+        hy = m_dSearchWindowSigmas*sqrt(s2 + vy*vy);
+
+        m_vTrackWindows[j] = ClipToFrame(x - hx, x + hx, y - hy, y + hy, m_iFrameWidth, m_iFrameHeight);
+
+        // tracks predicted to be off the frame get no window
+        if ((m_vTrackWindows[j].width > 0) && (m_vTrackWindows[j].height > 0))
+        {
+            m_vSearchWindows.push_back(m_vTrackWindows[j]);
+        }
+    }
+}       // end function
+
+
+// Background subtraction and thresholding restricted to area
+void GYSegmenter::processSearchArea(CvRect area)
+{
+    cvSetImageROI(m_pBG_frame, area);
+    cvSetImageROI(m_pGS_frame, area);
+    cvSetImageROI(m_pThresh_frame, area);
+    cvSetImageROI(m_pDiff_frame, area);
     // Find regions that are darker than the background
     //   - first, mark pixels that are darker into a binary image
     //    (note we hijack the thresh_frame for the result, since it is temporary)
@@ -451,7 +817,7 @@ void GYSegmenter::doImageProcessing()
     if(m_pROI_frame)   // only if the ROI has been specified
     {
         //   - also AND with the ROI to make sure that blobs are only found inside the tank
-        cvSetImageROI(m_pROI_frame, m_SearchArea);
+        cvSetImageROI(m_pROI_frame, area);
         cvAnd(m_pDiff_frame,m_pROI_frame,m_pDiff_frame);
         cvResetImageROI(m_pROI_frame);
     }
@@ -481,6 +847,7 @@ double GYSegmenter::updateFrameRate(double dt)
 
 void GYSegmenter::glDraw(bool DrawBlobs)
 {
+#ifndef MT_NO_GL  /* headless build - nothing to draw with */
 
     MT_R3 blobcenter;
 
@@ -504,7 +871,14 @@ void GYSegmenter::glDraw(bool DrawBlobs)
 
     if(m_bDrawSearchRect && m_bHasHistory)
     {
-        MT_DrawRectangle(m_SearchArea.x, m_iFrameHeight - m_SearchArea.y, m_SearchArea.width, -m_SearchArea.height);
+        for (unsigned int i = 0; i < m_vSearchWindows.size(); i++)
+        {
+            MT_DrawRectangle(m_vSearchWindows[i].x, m_iFrameHeight - m_vSearchWindows[i].y, m_vSearchWindows[i].width, -m_vSearchWindows[i].height);
+        }
+        if (m_RescanTile.width > 0)
+        {
+            MT_DrawRectangle(m_RescanTile.x, m_iFrameHeight - m_RescanTile.y, m_RescanTile.width, -m_RescanTile.height);
+        }
     }
 
     if(m_pTrackedObjects)
@@ -519,6 +893,7 @@ void GYSegmenter::glDraw(bool DrawBlobs)
         }
     }
 
+#endif  // MT_NO_GL
 }       // end function
 
 void GYSegmenter::doMatching()
@@ -527,65 +902,239 @@ void GYSegmenter::doMatching()
     if(!m_pTrackedObjects) /* this should happen on the first iteration only */
     {
 
-        m_pTrackedObjects = new MT_TrackedObjectsBase(m_iNobj);
+        m_pTrackStore = new MT_TrackedObjectStore(m_iNobj);
+        m_pTrackedObjects = m_pTrackStore;
         /* note these get deleted by the tracker base if != NULL */
-        m_HungarianMatcher.doInit(m_iNobj);
+        m_HungarianMatcher.doInit(m_iNobj, MT_HM_SAME, HUNGARIAN_MIN, MT_HM_LAPJV_WARM);
 
         /* first time through just take the positions as initial */
+        m_vdLastTrackX = XBlobs;
+        m_vdLastTrackY = YBlobs;
+        m_viMatchAssignments.resize(m_iNobj);
         for(unsigned int i = 0; i < (unsigned int) m_iNobj; i++)
         {
             m_pTrackedObjects->setXY(i, XBlobs[i], YBlobs[i]);
+            m_viMatchAssignments[i] = i;
         }
         return;
     }
 
-    double dx;
-    double dy;
-    for(int i = 0; i < m_iNobj; i++)
+    if(m_bManageTracks)
+    {
+        doManagedMatching();
+        return;
+    }
+
+    if(m_bUseGatedMatching)
     {
-        for(int j = 0; j < m_iNobj; j++)
-        { 
-            dx = (XBlobs[i] - m_pTrackedObjects->getX(j));
-            dy = (YBlobs[i] - m_pTrackedObjects->getY(j));
-            m_HungarianMatcher.setValue(i,j,dx*dx + dy*dy);
+        doGatedMatching();
+    }
+    else
+    {
+        double dx;
+        double dy;
+        const double* track_x = m_pTrackStore->getXs();
+        const double* track_y = m_pTrackStore->getYs();
+        for(int i = 0; i < m_iNobj; i++)
+        {
+            for(int j = 0; j < m_iNobj; j++)
+            { 
+                dx = (XBlobs[i] - track_x[j]);
+                dy = (YBlobs[i] - track_y[j]);
+                m_HungarianMatcher.setValue(i,j,dx*dx + dy*dy);
+            }
         }
+
+        m_HungarianMatcher.doMatch(&m_viMatchAssignments);
     }
 
-    m_HungarianMatcher.doMatch(&m_viMatchAssignments);
+    m_vdLastTrackX.resize(m_iNobj);
+    m_vdLastTrackY.resize(m_iNobj);
 
     int j;
     double meas[3];
+    bool lost = false;
+    CvRect w;
     for(int i = 0; i < m_iNobj; i++)
     {
         j = m_viMatchAssignments[i];
+
+        /* a track whose measurement is outside its own search window
+         * has been lost */
+        if(j < (int) m_vTrackWindows.size())
+        {
+            w = m_vTrackWindows[j];
+            if(XBlobs[i] < w.x || XBlobs[i] >= w.x + w.width
+               || YBlobs[i] < w.y || YBlobs[i] >= w.y + w.height)
+            {
+                lost = true;
+            }
+        }
+
+        m_vdLastTrackX[j] = m_pTrackedObjects->getX(j);
+        m_vdLastTrackY[j] = m_pTrackedObjects->getY(j);
         m_pTrackedObjects->setXY(j, XBlobs[i], YBlobs[i]);
 
         meas[0] = XBlobs[i]; meas[1] = YBlobs[i]; meas[2] = OBlobs[i];
         m_pTrackedObjects->setMeasurement(j, meas);
     }
 
+    /* fall back to searching the full frame next time if tracks
+     * have been lost for too long */
+    m_iLostFrames = lost ? m_iLostFrames + 1 : 0;
+    if(m_iLostFramesBeforeFull > 0 && m_iLostFrames >= m_iLostFramesBeforeFull)
+    {
+        m_iLostFrames = 0;
+        m_bHasHistory = false;
+    }
+
 }
 
-// Main Tracking Function - this is the main workhorse.
-void GYSegmenter::doTracking(IplImage* frame)
+/* Matching with track birth and death (see m_bManageTracks).  The
+   tracked object slots follow the confirmed tracks. */
+void GYSegmenter::doManagedMatching()
 {
-    static double t_previous = MT_getTimeSec();
-    static double t_start = MT_getTimeSec();
+    m_TrackAssigner.m_dNewTrackCost = 0.5*m_dTrackGate*m_dTrackGate;
+    m_TrackAssigner.m_dMissCost = m_TrackAssigner.m_dNewTrackCost;
+    m_TrackAssigner.m_iConfirmHits = m_iTrackConfirmHits;
+    m_TrackAssigner.m_iMaxMisses = m_iTrackMaxMisses;
+    m_TrackAssigner.reserve(2*m_iNobj);
+    m_TrackAssigner.doUpdate(XBlobs, YBlobs);
+
+    unsigned int ntracks = m_TrackAssigner.getNumTracks();
+    m_viSlotTrackID.resize(m_iNobj, -1);
+    m_vdLastTrackX.resize(m_iNobj);
+    m_vdLastTrackY.resize(m_iNobj);
+    m_viMatchAssignments.assign(XBlobs.size(), -1);
+
+    /* find each slot's track, freeing the slots of deleted tracks
+     * (the tracks are in order of id) */
+    m_viTrackSlot.assign(ntracks, -1);
+    m_viFreeSlots.resize(0);
+    for(int j = 0; j < m_iNobj; j++)
+    {
+        int lo = 0;
+        int hi = ntracks;
+        while(m_viSlotTrackID[j] >= 0 && lo < hi)
+        {
+            int mid = (lo + hi)/2;
+            if(m_TrackAssigner.getTrack(mid).id < m_viSlotTrackID[j])
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+        if(m_viSlotTrackID[j] >= 0 && lo < (int) ntracks
+           && m_TrackAssigner.getTrack(lo).id == m_viSlotTrackID[j])
+        {
+            m_viTrackSlot[lo] = j;
+        }
+        else
+        {
+            m_viSlotTrackID[j] = -1;
+            m_viFreeSlots.push_back(j);
+        }
+    }
 
-    double dt;
-    double t_now = MT_getTimeSec();
+    /* give the newly confirmed tracks free slots, oldest first */
+    m_iNumConfirmedTracks = 0;
+    unsigned int next_free = 0;
+    bool lost = false;
+    double meas[3];
+    for(unsigned int k = 0; k < ntracks; k++)
+    {
+        const MT_ManagedTrack& t = m_TrackAssigner.getTrack(k);
+        if(t.state != MT_TRACK_CONFIRMED)
+        {
+            continue;
+        }
+        m_iNumConfirmedTracks++;
 
-    dt = t_now - t_previous;  /// TODO for an AVI, dt should be constant
-    m_dT = dt;
+        int slot = m_viTrackSlot[k];
+        if(slot < 0)
+        {
+            if(next_free == m_viFreeSlots.size())
+            {
+                /* more confirmed tracks than objects */
+                continue;
+            }
+            slot = m_viFreeSlots[next_free++];
+            m_viSlotTrackID[slot] = t.id;
+        }
 
-    //dt = 0.04;
-    t_previous = t_now;
+        m_vdLastTrackX[slot] = m_pTrackedObjects->getX(slot);
+        m_vdLastTrackY[slot] = m_pTrackedObjects->getY(slot);
+        m_pTrackedObjects->setXY(slot, t.x, t.y);
+        if(t.detection >= 0)
+        {
+            int i = t.detection;
+            m_viMatchAssignments[i] = slot;
+            meas[0] = XBlobs[i]; meas[1] = YBlobs[i]; meas[2] = OBlobs[i];
+            m_pTrackedObjects->setMeasurement(slot, meas);
+        }
+        else
+        {
+            lost = true;
+        }
+    }
 
-    m_iFrame_counter++;
+    /* fall back to searching the full frame next time if tracks
+     * have been lost for too long */
+    m_iLostFrames = lost ? m_iLostFrames + 1 : 0;
+    if(m_iLostFramesBeforeFull > 0 && m_iLostFrames >= m_iLostFramesBeforeFull)
+    {
+        m_iLostFrames = 0;
+        m_bHasHistory = false;
+    }
+}
 
-    // Keep a copy of the original frame pointer for display purposes
-    m_pOrg_frame = frame;
+/* Gates each track around its predicted position, with the same
+   constant velocity prediction and covariance as computeSearchWindows,
+   and matches within the gates.  The cost is the same as the dense
+   matching's, the squared distance to the track's last position. */
+void GYSegmenter::doGatedMatching()
+{
+    double s2 = m_dSearchWindowMinSigma*m_dSearchWindowMinSigma;
+    bool have_last = (m_vdLastTrackX.size() == (unsigned int) m_iNobj)
+        && (m_vdLastTrackY.size() == (unsigned int) m_iNobj);
+    double vx, vy;
+
+    m_vMatchTracks.resize(m_iNobj);
+    for(int j = 0; j < m_iNobj; j++)
+    {
+        MT_GatedTrack& t = m_vMatchTracks[j];
+        t.x = m_pTrackedObjects->getX(j);
+        t.y = m_pTrackedObjects->getY(j);
+        vx = have_last ? t.x - m_vdLastTrackX[j] : 0;
+        vy = have_last ? t.y - m_vdLastTrackY[j] : 0;
+        t.gate_x = t.x + vx;
+        t.gate_y = t.y + vy;
+        if(m_dMatchGateRadius > 0)
+        {
+            t.gate_pxx = t.gate_pyy = m_dMatchGateRadius*m_dMatchGateRadius;
+            t.gate_pxy = 0;
+            t.gate_k = 1.0;
+        }
+        else
+        {
+            /* P = s^2 I + v v^T */
+            t.gate_pxx = s2 + vx*vx;
+            t.gate_pxy = vx*vy;
+            t.gate_pyy = s2 + vy*vy;
+            t.gate_k = m_dMatchGateSigmas;
+        }
+    }
+
+    m_GatedMatcher.doMatch(XBlobs, YBlobs, m_vMatchTracks, &m_viMatchAssignments);
+    m_iMatchSubproblems = m_GatedMatcher.getNumSubproblems();
+}
 
+// Main Tracking Function - this is the main workhorse.
+void GYSegmenter::doTracking(IplImage* frame)
+{
     // Convert to grayscale
 	if(frame->nChannels == 3)
 	{
@@ -596,6 +1145,33 @@ void GYSegmenter::doTracking(IplImage* frame)
 		cvCopy(frame, m_pGS_frame);
 	}
 
+    trackGrayFrame(frame);
+    writeData();
+
+    /*if(m_pBlobFile)
+      {
+      m_pBlobFile->WriteBlobs(m_iFrame_counter, dt, m_CurrentBlobs);
+      }*/
+
+}       // end function
+
+
+void GYSegmenter::trackGrayFrame(IplImage* frame)
+{
+    double dt;
+    double t_now = MT_getTimeSec();
+
+    dt = t_now - m_dTPrevious;  /// TODO for an AVI, dt should be constant
+    m_dT = dt;
+
+    //dt = 0.04;
+    m_dTPrevious = t_now;
+
+    m_iFrame_counter++;
+
+    // Keep a copy of the original frame pointer for display purposes
+    m_pOrg_frame = frame;
+
     double t0 = MT_getTimeSec();
 
     // image operations to extract regions where fish are likely
@@ -631,58 +1207,168 @@ void GYSegmenter::doTracking(IplImage* frame)
         }
         doMatching();
     }
-    writeData();
 
-    if (t_now != t_start)
+    if (t_now != m_dTStart)
     {
-        m_dAverageFrameRate = ((double) m_iFrame_counter)/(t_now - t_start);
+        m_dAverageFrameRate = ((double) m_iFrame_counter)/(t_now - m_dTStart);
     }
 
     updateFrameRate(dt);
 
-    /*if(m_pBlobFile)
-      {
-      m_pBlobFile->WriteBlobs(m_iFrame_counter, dt, m_CurrentBlobs);
-      }*/
+}       // end function
 
-    // Reset the history at random so the whole image is searched
-    if (MT_frand(1.0) < 0.005)
+
+/* The grayscale conversion only needs the frame, so it goes into a
+   buffer kept with the frame and can run ahead of the tracking */
+void GYSegmenter::doPipelinePreprocess(MT_TrackerPipelineFrame* frame)
+{
+    if(frame->m_vpImages.size() < 1)
     {
-        m_bHasHistory = false;
+        frame->m_vpImages.push_back(NULL);
+    }
+    IplImage*& gray = frame->m_vpImages[0];
+    if(!gray)
+    {
+        gray = cvCreateImage(cvGetSize(frame->m_pFrame), IPL_DEPTH_8U, 1);
+    }
+
+    if(frame->m_pFrame->nChannels == 3)
+    {
+        cvCvtColor(frame->m_pFrame, gray, CV_BGR2GRAY);
+    }
+    else
+    {
+        cvCopy(frame->m_pFrame, gray);
     }
 }       // end function
 
 
+void GYSegmenter::doPipelineTrack(MT_TrackerPipelineFrame* frame)
+{
+    // Trade buffers rather than copy - the frame gets back the one
+    // from a frame that is already done with
+    IplImage* gray = frame->m_vpImages[0];
+    frame->m_vpImages[0] = m_pGS_frame;
+    m_pGS_frame = gray;
+
+    trackGrayFrame(frame->m_pFrame);
+
+    frame->m_vvdData.resize(4);
+    frame->m_vvdData[0] = XBlobs;
+    frame->m_vvdData[1] = YBlobs;
+    frame->m_vvdData[2] = ABlobs;
+    frame->m_vvdData[3] = OBlobs;
+    /* the blobs are in the order they were found, which changes from
+     * frame to frame */
+    frame->m_viDataTracks = m_viMatchAssignments;
+}       // end function
+
+
+void GYSegmenter::doPipelineOutput(MT_TrackerPipelineFrame* frame)
+{
+    m_XDF.writeData("X COM", frame->m_vvdData[0]);
+    m_XDF.writeData("Y COM", frame->m_vvdData[1]);
+    m_XDF.writeData("Area", frame->m_vvdData[2]);
+    m_XDF.writeData("Orientation", frame->m_vvdData[3]);
+}       // end function
+
+
 void GYSegmenter::doBlobFinding()
 {
-    int i, j;
+    int j;
 
     // Initialise the vector to contain the raw blob data
     std::vector<RawBlobPtr> FirstRawBlobs;
     FirstRawBlobs.resize(0);
 
+    // The search windows are disjoint and don't touch, so each blob
+    // lies entirely inside one of them
+    for (unsigned int w = 0 ; w < m_vSearchWindows.size() ; w++)
+    {
+        findRawBlobs(m_vSearchWindows[w], &FirstRawBlobs);
+    }
+
+    // Only the blobs of the rescan band that are clear of every window
+    // are new - the rest are (possibly parts of) blobs already found
+    // in the windows
+    if (m_RescanTile.width > 0)
+    {
+        std::vector<RawBlobPtr> BandRawBlobs;
+        findRawBlobs(m_RescanTile, &BandRawBlobs);
+        for (j = 0 ; j < (int) BandRawBlobs.size() ; j++)
+        {
+            CvRect box = BandRawBlobs[j]->GetBoundingBox();
+            bool in_window = false;
+            for (unsigned int w = 0 ; w < m_vSearchWindows.size() ; w++)
+            {
+                if (RectsOverlapOrTouch(box, m_vSearchWindows[w]))
+                {
+                    in_window = true;
+                    break;
+                }
+            }
+            if (!in_window)
+            {
+                FirstRawBlobs.push_back(BandRawBlobs[j]);
+            }
+        }
+    }
+
+    // Now filter the raw blobs according to the area thresholds
+    m_RawBlobData.resize(0);
+    for (j = 0 ; j < (int) FirstRawBlobs.size() ; j++)
+    {
+        if ((FirstRawBlobs[j]->GetNumPixels() >= m_iBlob_area_thresh_low) && (FirstRawBlobs[j]->GetNumPixels() <= m_iBlob_area_thresh_high))
+        {
+            m_RawBlobData.push_back(FirstRawBlobs[j]);
+        }
+    }
+
+    // Move the pixels of all the raw blobs into one contiguous block
+    m_PixelBuffer.Pack(m_RawBlobData);
+
+    // If we haven't found any blobs and we had a limited search area, reset the
+    // search area and try again.
+    if ((m_RawBlobData.size() == 0) && m_bHasHistory)
+    {
+        m_bHasHistory = false;
+        doImageProcessing();
+        doBlobFinding();
+    }
+
+}       // end function
+
+
+// Labels the raw blobs in the thresholded frame inside area, appending them to raw_blobs
+void GYSegmenter::findRawBlobs(CvRect area, std::vector<RawBlobPtr>* raw_blobs)
+{
+    int i, j;
+
+    std::vector<RawBlobPtr> FirstRawBlobs;
+    FirstRawBlobs.resize(0);
+
     // Temporary variables for raw blob detection
     uchar PixelValue;
     bool InsideBlob = false;
     int MaxBlobNumber = 0;
     int PixelLabel,  TopPixelLabel, LeftPixelLabel;
     int *BlobNumbers;
-    BlobNumbers = new int[m_SearchArea.width*m_SearchArea.height];
-    for (i = 0 ; i < m_SearchArea.width ; i++)
+    BlobNumbers = new int[area.width*area.height];
+    for (i = 0 ; i < area.width ; i++)
     {
-        for (j = 0 ; j < m_SearchArea.height ; j++)
+        for (j = 0 ; j < area.height ; j++)
         {
-            BlobNumbers[i + j*m_SearchArea.width] = 0;
+            BlobNumbers[i + j*area.width] = 0;
         }
     }
 
     // Find the raw blobs from the thresholded frame inside the search area
-    for (j = 0 ; j < m_SearchArea.height ; j++)
+    for (j = 0 ; j < area.height ; j++)
     {
-        for (i = 0 ; i < m_SearchArea.width ; i++)
+        for (i = 0 ; i < area.width ; i++)
         {
-            PixelValue = ((uchar*)(m_pThresh_frame->imageData + m_pThresh_frame->widthStep*(j + m_SearchArea.y)))[i + m_SearchArea.x];
-            PixelLabel = BlobNumbers[i + j*m_SearchArea.width];
+            PixelValue = ((uchar*)(m_pThresh_frame->imageData + m_pThresh_frame->widthStep*(j + area.y)))[i + area.x];
+            PixelLabel = BlobNumbers[i + j*area.width];
 
             if (j == 0)
             {
@@ -690,7 +1376,7 @@ void GYSegmenter::doBlobFinding()
             }
             else
             {
-                TopPixelLabel = BlobNumbers[i + (j-1)*m_SearchArea.width];
+                TopPixelLabel = BlobNumbers[i + (j-1)*area.width];
             }
 
             if (i == 0)
@@ -699,7 +1385,7 @@ void GYSegmenter::doBlobFinding()
             }
             else
             {
-                LeftPixelLabel = BlobNumbers[i - 1 + j*m_SearchArea.width];
+                LeftPixelLabel = BlobNumbers[i - 1 + j*area.width];
             }
 
             if (!InsideBlob)
@@ -707,31 +1393,31 @@ void GYSegmenter::doBlobFinding()
                 if ((PixelValue == 255) && (PixelLabel == 0) && (TopPixelLabel <= 0)) // We have just found the start of a new contour
                 {
                     MaxBlobNumber++;
-                    BlobNumbers[i + j*m_SearchArea.width] = MaxBlobNumber;
+                    BlobNumbers[i + j*area.width] = MaxBlobNumber;
 
                     RawBlobPtr rbp(new GYRawBlob(300));         // Make sure there is space for 300 pixels in the blob (NOTE: this number should be changed for different applications)
                     FirstRawBlobs.push_back(rbp);
-                    FirstRawBlobs[MaxBlobNumber-1]->AddPoint(cvPoint(i + m_SearchArea.x, j + m_SearchArea.y));
+                    FirstRawBlobs[MaxBlobNumber-1]->AddPoint(cvPoint(i + area.x, j + area.y));
 
                     double perimeter;
-                    perimeter = TraceContour(i, j, m_SearchArea.x, m_SearchArea.y, m_SearchArea.width, m_SearchArea.height, BlobNumbers, m_pThresh_frame);
+                    perimeter = TraceContour(i, j, area.x, area.y, area.width, area.height, BlobNumbers, m_pThresh_frame);
 
                     FirstRawBlobs[MaxBlobNumber-1]->SetPerimeter(perimeter);
                 }
                 else if ((PixelValue == 255) && (PixelLabel != 0))              // We have encountered a pixel on a labelled contour
                 {
-                    FirstRawBlobs[PixelLabel-1]->AddPoint(cvPoint(i + m_SearchArea.x, j + m_SearchArea.y));
+                    FirstRawBlobs[PixelLabel-1]->AddPoint(cvPoint(i + area.x, j + area.y));
                 }
                 else if (PixelValue == 255)             // We have encountered an unlabelled black pixel. The pixel to the left must be on the contour and labelled
                 {
-                    BlobNumbers[i + j*m_SearchArea.width] = LeftPixelLabel;
-                    FirstRawBlobs[LeftPixelLabel-1]->AddPoint(cvPoint(i + m_SearchArea.x, j + m_SearchArea.y));
+                    BlobNumbers[i + j*area.width] = LeftPixelLabel;
+                    FirstRawBlobs[LeftPixelLabel-1]->AddPoint(cvPoint(i + area.x, j + area.y));
                     InsideBlob = true;
                 }
                 else if ((LeftPixelLabel > 0) && (PixelLabel != -1))    // We have encountered an internal white pixel. It should be black
                 {
-                    BlobNumbers[i + j*m_SearchArea.width] = LeftPixelLabel;
-                    FirstRawBlobs[LeftPixelLabel-1]->AddPoint(cvPoint(i + m_SearchArea.x, j + m_SearchArea.y));
+                    BlobNumbers[i + j*area.width] = LeftPixelLabel;
+                    FirstRawBlobs[LeftPixelLabel-1]->AddPoint(cvPoint(i + area.x, j + area.y));
                     InsideBlob = true;
                 }
             }           // end if (!InsideBlob)
@@ -739,36 +1425,19 @@ void GYSegmenter::doBlobFinding()
             {
                 if (PixelLabel != 0)    // We have reached the end of the raw blob
                 {
-                    FirstRawBlobs[PixelLabel-1]->AddPoint(cvPoint(i + m_SearchArea.x, j + m_SearchArea.y));
+                    FirstRawBlobs[PixelLabel-1]->AddPoint(cvPoint(i + area.x, j + area.y));
                     InsideBlob = false;
                 }
                 else
                 {
-                    BlobNumbers[i + j*m_SearchArea.width] = LeftPixelLabel;
-                    FirstRawBlobs[LeftPixelLabel-1]->AddPoint(cvPoint(i + m_SearchArea.x, j + m_SearchArea.y));
+                    BlobNumbers[i + j*area.width] = LeftPixelLabel;
+                    FirstRawBlobs[LeftPixelLabel-1]->AddPoint(cvPoint(i + area.x, j + area.y));
                 }
             }           // end else
-        }               // end for (i = 0 ; i < m_SearchArea.width ; i++)
-    }           // end for (j = 0 ; j < m_SearchArea.height ; j++)
+        }               // end for (i = 0 ; i < area.width ; i++)
+    }           // end for (j = 0 ; j < area.height ; j++)
 
-    // Now filter the raw blobs according to the area thresholds
-    m_RawBlobData.resize(0);
-    for (j = 0 ; j < (int) FirstRawBlobs.size() ; j++)
-    {
-        if ((FirstRawBlobs[j]->GetNumPixels() >= m_iBlob_area_thresh_low) && (FirstRawBlobs[j]->GetNumPixels() <= m_iBlob_area_thresh_high))
-        {
-            m_RawBlobData.push_back(FirstRawBlobs[j]);
-        }
-    }
-
-    // If we haven't found any blobs and we had a limited search area, reset the
-    // search area and try again.
-    if ((m_RawBlobData.size() == 0) && m_bHasHistory)
-    {
-        m_bHasHistory = false;
-        doImageProcessing();
-        doBlobFinding();
-    }
+    raw_blobs->insert(raw_blobs->end(), FirstRawBlobs.begin(), FirstRawBlobs.end());
 
     delete[] BlobNumbers;       // release memory
 
@@ -827,8 +1496,8 @@ void GYSegmenter::doSegmentation()
     }
 
     int currentblob = 0;
-    /* int numpixels; */
-    int numinrawblob;
+    std::vector<int> mergedblobs(0);
+    std::vector<int> mergedfirst(0);
     std::vector<CvPoint> PixelList;
     PixelList.resize(0);
     double XXMoment, YYMoment, XYMoment, Delta, A, theta, headfraction, slope;
@@ -923,257 +1592,391 @@ void GYSegmenter::doSegmentation()
         }               // end if (BlobSizes[i] == 1)
         else if (BlobSizes[i] > 0)              // Here we have raw blobs containing several blobs
         {
-            numinrawblob = BlobSizes[i];
-            MixGaussians FittedBlobs;   // Create a mixture of Gaussians model to estimate the individual blobs
+            // These are split with EM below, once we know where each one's blobs go
+            mergedblobs.push_back(i);
+            mergedfirst.push_back(currentblob);
+            currentblob += BlobSizes[i];
+        }               // end else if (BlobSizes[i] > 0)
+    }           // end for (i = 0 ; i < numrawblobs ; i++)
+
+    // Split the merged raw blobs.  Each one only writes its own part of m_CurrentBlobs,
+    // so they can run in any order; the biggest go first so that no thread is left
+    // with a big one at the end.
+    //
+    // With an EM time budget (see MixGaussiansBudget) this happens in two passes:  a
+    // first with an iteration cap for every fit, sized to the time left, and a second
+    // in which the fits that haven't converged carry on until the deadline, those
+    // that were still changing the most first.  The pixels are only allocated to the
+    // blobs once all the fitting is done.
+    m_EMBudget.m_dBudget = 0.001*m_dEMFrameBudget;
+    bool degraded = false;
+
+    int nmerged = mergedblobs.size();
+    if (nmerged > 0)
+    {
+        int max_iters = m_iFrame_counter;
+
+        std::vector<std::pair<int, int> > order(nmerged);
+        for (k = 0 ; k < nmerged ; k++)
+        {
+            order[k] = std::make_pair(-m_RawBlobData[mergedblobs[k]]->GetNumPixels(), k);
+        }
+        std::sort(order.begin(), order.end());
 
-            if (!m_bHasHistory)
+        GYSegmentationJob job(this);
+        job.resize(nmerged);
+        job.m_viOrder.resize(nmerged);
+        double totalwork = 0;
+        for (k = 0 ; k < nmerged ; k++)
+        {
+            int m = order[k].second;
+            job.m_viRawBlobs[k] = mergedblobs[m];
+            job.m_viNumBlobs[k] = BlobSizes[mergedblobs[m]];
+            job.m_viFirstBlob[k] = mergedfirst[m];
+            job.m_viOrder[k] = k;
+            totalwork += ((double) m_RawBlobData[mergedblobs[m]]->GetNumPixels())*BlobSizes[mergedblobs[m]];
+        }
+
+        int numthreads = (m_iEMThreads > 0) ? m_iEMThreads : MT_WorkerPool::getNumCores();
+        if (!m_pWorkerPool || numthreads != m_iWorkerPoolThreads)
+        {
+            delete m_pWorkerPool;
+            m_pWorkerPool = new MT_WorkerPool(numthreads);
+            m_iWorkerPoolThreads = numthreads;
+        }
+        int numworkers = m_pWorkerPool->getNumWorkers();
+        if ((int) m_vEMWorkspaces.size() < numworkers)
+        {
+            m_vEMWorkspaces.resize(numworkers);
+        }
+        if ((int) m_vEMFits.size() < nmerged)
+        {
+            m_vEMFits.resize(nmerged);
+            m_vPixelAllocations.resize(nmerged);
+        }
+
+        m_EMBudget.StartFrame();
+        int cap = m_EMBudget.FirstPassCap(totalwork, numworkers, max_iters);
+        job.m_viMaxIters.assign(nmerged, cap);
+        job.m_iPass = GYSegmentationJob::FIRST_FIT;
+        // the cap is only a guess (and there's none before the first timing),
+        // so the first pass stops at the deadline too
+        job.m_dDeadline = m_EMBudget.GetDeadline();
+        m_pWorkerPool->run(&job, nmerged);
+
+        if (m_EMBudget.IsActive())
+        {
+            std::vector<std::pair<double, int> > pending(0);
+            for (k = 0 ; k < nmerged ; k++)
             {
-                // If we have no blob history, we make our initial estimate by distributing the mixture evenly
-                // over the bounding box around the raw blob
-                FittedBlobs = MixGaussians(numinrawblob, m_RawBlobData[i]->GetBoundingBox());
+                m_EMBudget.AddTiming(((double) m_RawBlobData[job.m_viRawBlobs[k]]->GetNumPixels())*job.m_viNumBlobs[k],
+                                     job.m_viIterations[k], job.m_vdSeconds[k]);
+                if (!job.m_viConverged[k] && job.m_viIterations[k] < max_iters)
+                {
+                    pending.push_back(std::make_pair(-job.m_vdResidual[k], k));
+                }
             }
-            else
+
+            if (pending.size() > 0 && m_EMBudget.GetRemaining() > 0)
             {
-                // If we have a history, we want to take the blobs that are closest to the raw blob as our estimates
-                CvRect RawBoundingBox = m_RawBlobData[i]->GetBoundingBox();
-                double xcentre = (double) RawBoundingBox.x + ((double) RawBoundingBox.width)/2.0 - 0.5;
-                double ycentre = (double) RawBoundingBox.y + ((double) RawBoundingBox.height)/2.0 - 0.5;
-                double maxdimension;
-                if (RawBoundingBox.width > RawBoundingBox.height)
+                std::sort(pending.begin(), pending.end());
+                job.m_viOrder.resize(pending.size());
+                for (k = 0 ; k < (int) pending.size() ; k++)
                 {
-                    maxdimension = (double) RawBoundingBox.width;
+                    int m = pending[k].second;
+                    job.m_viOrder[k] = m;
+                    job.m_viMaxIters[m] = max_iters - job.m_viIterations[m];
                 }
-                else
+                job.m_iPass = GYSegmentationJob::CONTINUE_FIT;
+                job.m_dDeadline = m_EMBudget.GetDeadline();
+                m_pWorkerPool->run(&job, pending.size());
+            }
+
+            for (k = 0 ; k < nmerged ; k++)
+            {
+                if (!job.m_viConverged[k] && job.m_viIterations[k] < max_iters)
                 {
-                    maxdimension = (double) RawBoundingBox.height;
+                    degraded = true;
                 }
+            }
+        }
 
-                double* distances;
-                distances = new double[m_iNobj];
-                int closestblob;
-                MT_Vector2 GuessMean;
-                MT_Matrix2x2 GuessCovariance;
-                double sigma1, sigma2, phi, cp, sp;
-
-                // Calculate the distances of each blob to the centre of the bounding box
-                for (k = 0 ; k < m_iNobj ; k++)
-                {
-                    distances[k] = sqrt(pow(xcentre - m_OldBlobs[k].m_dXCentre, 2) + pow(ycentre - m_OldBlobs[k].m_dYCentre, 2));
+        job.m_viOrder.resize(nmerged);
+        for (k = 0 ; k < nmerged ; k++)
+        {
+            job.m_viOrder[k] = k;
+        }
+        job.m_iPass = GYSegmentationJob::EXTRACT;
+        m_pWorkerPool->run(&job, nmerged);
+    }
 
-                    // For blobs outside the bounding box, we add additional weight to their distances
-                    if((m_OldBlobs[k].m_dXCentre < RawBoundingBox.x) || (m_OldBlobs[k].m_dXCentre > (RawBoundingBox.x + RawBoundingBox.width - 1)) || (m_OldBlobs[k].m_dYCentre < RawBoundingBox.y) || (m_OldBlobs[k].m_dYCentre > (RawBoundingBox.y + RawBoundingBox.height - 1)))
-                    {
-                        distances[k] += maxdimension;
-                    }
-                }
+    if (m_EMBudget.IsActive())
+    {
+        m_EMBudget.EndFrame(degraded);
+    }
 
-                // Find the closest blob, calculate a mean and covariance matrix then add these to the mixture model
-                for (k = 0 ; k < numinrawblob ; k++)
-                {
-                    closestblob = IndexMin(distances, m_iNobj);
-                    GuessMean.data[0] = m_OldBlobs[closestblob].m_dXCentre;
-                    GuessMean.data[1] = m_OldBlobs[closestblob].m_dYCentre;
+    // Record the current set of blobs so we can make estimates next time (if needed)
+    m_OldBlobs = m_CurrentBlobs;
+    m_bHasHistory = true;
 
-                    // If GuessMean is outside the bounding box, shift it inside
-                    if(GuessMean.data[0] < RawBoundingBox.x)
-                    {
-                        GuessMean.data[0] = (double) RawBoundingBox.x;
-                    }
-                    if(GuessMean.data[0] > RawBoundingBox.x + RawBoundingBox.width - 1)
-                    {
-                        GuessMean.data[0] = (double) (RawBoundingBox.x + RawBoundingBox.width - 1);
-                    }
-                    if(GuessMean.data[1] < RawBoundingBox.y)
-                    {
-                        GuessMean.data[1] = (double) RawBoundingBox.y;
-                    }
-                    if(GuessMean.data[1] > RawBoundingBox.y + RawBoundingBox.height - 1)
-                    {
-                        GuessMean.data[1] = (double) (RawBoundingBox.y + RawBoundingBox.height - 1);
-                    }
+    // Cleanup
+    if(numrawblobs)
+    {
+        delete[] RawBlobSizes;
+        delete[] BlobSizes;
+    }
 
-                    // If the previous measured blob had a reasonable size, use it to generate the
-                    // covariance matrix. Otherwise, use default values
-                    if (m_OldBlobs[closestblob].m_dMajorAxis > 8)
-                    {
-                        sigma1 = pow(m_OldBlobs[closestblob].m_dMajorAxis/1.95, 2);
-                    }
-                    else
-                    {
-                        sigma1 = pow(8.0/1.95, 2);
-                    }
+}       // end function
 
-                    if (m_OldBlobs[closestblob].m_dMinorAxis > 1)
-                    {
-                        sigma2 = pow(m_OldBlobs[closestblob].m_dMinorAxis/1.95, 2);
-                    }
-                    else
-                    {
-                        sigma2 = pow(1.0/1.95, 2);
-                    }
+void GYSegmenter::initMergedBlob(int i, int numinrawblob, int m)
+{
+    int k;
 
-                    phi = MT_DEG2RAD*m_OldBlobs[closestblob].m_dOrientation;
-                    cp = cos(phi);
-                    sp = -sin(phi);
+    // The mixture of Gaussians model to estimate the individual blobs
+    MixGaussians& FittedBlobs = m_vEMFits[m];
+    FittedBlobs = MixGaussians();
 
-                    GuessCovariance.data[0] = sigma1*cp*cp + sigma2*sp*sp;
-                    GuessCovariance.data[1] = sp*cp*(sigma1 - sigma2);
-                    GuessCovariance.data[2] = sp*cp*(sigma1 - sigma2);
-                    GuessCovariance.data[3] = sigma1*sp*sp + sigma2*cp*cp;
+    if (!m_bHasHistory)
+    {
+        // If we have no blob history, we make our initial estimate by distributing the mixture evenly
+        // over the bounding box around the raw blob
+        FittedBlobs = MixGaussians(numinrawblob, m_RawBlobData[i]->GetBoundingBox());
+    }
+    else
+    {
+        // If we have a history, we want to take the blobs that are closest to the raw blob as our estimates
+        CvRect RawBoundingBox = m_RawBlobData[i]->GetBoundingBox();
+        double xcentre = (double) RawBoundingBox.x + ((double) RawBoundingBox.width)/2.0 - 0.5;
+        double ycentre = (double) RawBoundingBox.y + ((double) RawBoundingBox.height)/2.0 - 0.5;
+        double maxdimension;
+        if (RawBoundingBox.width > RawBoundingBox.height)
+        {
+            maxdimension = (double) RawBoundingBox.width;
+        }
+        else
+        {
+            maxdimension = (double) RawBoundingBox.height;
+        }
 
-                    FittedBlobs.AddDist(GuessMean, GuessCovariance);
+        double* distances;
+        distances = new double[m_iNobj];
+        int closestblob;
+        MT_Vector2 GuessMean;
+        MT_Matrix2x2 GuessCovariance;
+        double sigma1, sigma2, phi, cp, sp;
 
-                    // Make the distance very large so the next loop will find another blob
-                    distances[closestblob] = 1E20;
-                }               // end for (k = 0 ; k < numinrawblob ; k++)
+        // Calculate the distances of each blob to the centre of the bounding box
+        for (k = 0 ; k < m_iNobj ; k++)
+        {
+            distances[k] = sqrt(pow(xcentre - m_OldBlobs[k].m_dXCentre, 2) + pow(ycentre - m_OldBlobs[k].m_dYCentre, 2));
 
-                delete[] distances;             // release memory
-            }           // end else
+            // For blobs outside the bounding box, we add additional weight to their distances
+            if((m_OldBlobs[k].m_dXCentre < RawBoundingBox.x) || (m_OldBlobs[k].m_dXCentre > (RawBoundingBox.x + RawBoundingBox.width - 1)) || (m_OldBlobs[k].m_dYCentre < RawBoundingBox.y) || (m_OldBlobs[k].m_dYCentre > (RawBoundingBox.y + RawBoundingBox.height - 1)))
+            {
+                distances[k] += maxdimension;
+            }
+        }
 
-            /* Create a vector to hold the distribution allocations of each pixel in the raw blob.
-               For a pixel assigned to distributions d_1, d_2, d_3, ..., the allocation number will
-               be d_1 + n*d_2 + n^2*d_3 + ..., where n is the total number of distributions 
-               (i.e. n = numinrawblob) */
-            std::vector<int> PixelAllocation;
-            PixelAllocation.resize(m_RawBlobData[i]->GetNumPixels());
+        // Find the closest blob, calculate a mean and covariance matrix then add these to the mixture model
+        for (k = 0 ; k < numinrawblob ; k++)
+        {
+            closestblob = IndexMin(distances, m_iNobj);
+            GuessMean.data[0] = m_OldBlobs[closestblob].m_dXCentre;
+            GuessMean.data[1] = m_OldBlobs[closestblob].m_dYCentre;
 
-            // Run the expectation maximisation algorithm
-            FittedBlobs.EMMG(m_RawBlobData[i], PixelAllocation, m_iFrame_counter);
+            // If GuessMean is outside the bounding box, shift it inside
+            if(GuessMean.data[0] < RawBoundingBox.x)
+            {
+                GuessMean.data[0] = (double) RawBoundingBox.x;
+            }
+            if(GuessMean.data[0] > RawBoundingBox.x + RawBoundingBox.width - 1)
+            {
+                GuessMean.data[0] = (double) (RawBoundingBox.x + RawBoundingBox.width - 1);
+            }
+            if(GuessMean.data[1] < RawBoundingBox.y)
+            {
+                GuessMean.data[1] = (double) RawBoundingBox.y;
+            }
+            if(GuessMean.data[1] > RawBoundingBox.y + RawBoundingBox.height - 1)
+            {
+                GuessMean.data[1] = (double) (RawBoundingBox.y + RawBoundingBox.height - 1);
+            }
 
-            // We now want a new vector of raw blobs for each extracted individual blob
-            std::vector<RawBlobPtr> ExtractedBlobs;
-            ExtractedBlobs.resize(0);
-            for (k = 0 ; k < numinrawblob ; k++)
+            // If the previous measured blob had a reasonable size, use it to generate the
+            // covariance matrix. Otherwise, use default values
+            if (m_OldBlobs[closestblob].m_dMajorAxis > 8)
             {
-                RawBlobPtr rbp(new GYRawBlob(m_RawBlobData[i]->GetNumPixels()));        // Make sure the new raw blobs have space for enough pixels - faster running at expense of more initial memory
-                ExtractedBlobs.push_back(rbp);
+                sigma1 = pow(m_OldBlobs[closestblob].m_dMajorAxis/1.95, 2);
+            }
+            else
+            {
+                sigma1 = pow(8.0/1.95, 2);
             }
 
-            // Run through the pixels from the original raw blob and assign them to their allocated new blobs
-            PixelList.resize(m_RawBlobData[i]->GetNumPixels());
-            m_RawBlobData[i]->GetPixelList(PixelList);
-            for (k = 0 ; k < m_RawBlobData[i]->GetNumPixels() ; k++)
+            if (m_OldBlobs[closestblob].m_dMinorAxis > 1)
+            {
+                sigma2 = pow(m_OldBlobs[closestblob].m_dMinorAxis/1.95, 2);
+            }
+            else
             {
-                int allocated;
-                int numdists = 1;
-                int dist_number = PixelAllocation[k] % numinrawblob;
+                sigma2 = pow(1.0/1.95, 2);
+            }
 
-                ExtractedBlobs[dist_number]->AddPoint(PixelList[k]);
-                allocated = dist_number;
+            phi = MT_DEG2RAD*m_OldBlobs[closestblob].m_dOrientation;
+            cp = cos(phi);
+            sp = -sin(phi);
 
-                while (allocated != PixelAllocation[k])
-                {
-                    dist_number = ((PixelAllocation[k] - allocated)/(ipow(numinrawblob, numdists))) % numinrawblob;
-                    ExtractedBlobs[dist_number]->AddPoint(PixelList[k]);
-                    allocated += dist_number*ipow(numinrawblob, numdists);
-                    numdists++;
-                }
-            }           // end for (k = 0 ; k < m_RawBlobData[i]->GetNumPixels() ; k++)
+            GuessCovariance.data[0] = sigma1*cp*cp + sigma2*sp*sp;
+            GuessCovariance.data[1] = sp*cp*(sigma1 - sigma2);
+            GuessCovariance.data[2] = sp*cp*(sigma1 - sigma2);
+            GuessCovariance.data[3] = sigma1*sp*sp + sigma2*cp*cp;
 
-            // Loop through the new blobs and extract their parameters
-            for (k = 0 ; k < numinrawblob ; k++)
-            {
-                m_CurrentBlobs[currentblob].m_dArea = ExtractedBlobs[k]->GetArea();
-                m_CurrentBlobs[currentblob].m_dXCentre = ExtractedBlobs[k]->GetXCentre();
-                m_CurrentBlobs[currentblob].m_dYCentre = ExtractedBlobs[k]->GetYCentre();
-
-                // Calculating ellipse (semi) major and minor axes from the moments
-                XXMoment = ExtractedBlobs[k]->GetXXMoment();
-                YYMoment = ExtractedBlobs[k]->GetYYMoment();
-                XYMoment = ExtractedBlobs[k]->GetXYMoment();
-                Delta = sqrt(4*pow(XYMoment, 2) + pow(XXMoment - YYMoment, 2));
-                A = pow(16*pow(M_PI, 2)*(XXMoment*YYMoment - pow(XYMoment, 2)), 0.25);
-
-                if (A == 0)             // This will happen if all the pixels lie along a line
-                {
-                    A = 1;
-                }
+            FittedBlobs.AddDist(GuessMean, GuessCovariance);
 
-                m_CurrentBlobs[currentblob].m_dMajorAxis = sqrt((2*(XXMoment + YYMoment + Delta))/A);
-                m_CurrentBlobs[currentblob].m_dMinorAxis = sqrt((2*(XXMoment + YYMoment - Delta))/A);
+            // Make the distance very large so the next loop will find another blob
+            distances[closestblob] = 1E20;
+        }               // end for (k = 0 ; k < numinrawblob ; k++)
 
-                // Calculating the orientation angle from the moments. Note that after this
-                // calculation, theta will be between -90 and 90
-                theta = 0.5*atan2(2*XYMoment, XXMoment - YYMoment)*MT_RAD2DEG;
+        delete[] distances;             // release memory
+    }           // end else
+}       // end function
 
-                // Estimate the correct orientation of the blob by assigning the side with the 
-                // most pixels as the front. We determine the two 'sides' of the blob by 
-                // drawing a line through the centroid, perpendicular to theta
-                PixelList.resize(ExtractedBlobs[k]->GetNumPixels());
-                ExtractedBlobs[k]->GetPixelList(PixelList);
+void GYSegmenter::fitMergedBlob(int i, int m, int max_iters, double deadline, int worker)
+{
+    MixGaussians& FittedBlobs = m_vEMFits[m];
+
+    // Run the expectation maximisation algorithm
+    FittedBlobs.setWorkspace(&m_vEMWorkspaces[worker]);
+    FittedBlobs.m_iBinSize = m_iEMBinSize;
+    FittedBlobs.m_iBinMinPixels = m_iEMBinMinPixels;
+    FittedBlobs.m_dBinTolerance = m_dEMBinTolerance;
+    FittedBlobs.m_dDeadline = deadline;
+    FittedBlobs.EMMG(m_RawBlobData[i], m_vPixelAllocations[m], max_iters);
+    FittedBlobs.setWorkspace(NULL);
+}       // end function
 
-                if (theta == 0)
-                {
-                    headfraction = 0.0;
-                    for (j = 0; j < (int) PixelList.size() ; j++)
-                    {
-                        if (PixelList[j].x > m_CurrentBlobs[currentblob].m_dXCentre)
-                        {
-                            headfraction += 1.0;
-                        }
-                    }
-                    headfraction /= (double) PixelList.size();
-                }               // end if (theta == 0)
-                else
-                {
-                    slope = tan((theta - 90.0)*MT_DEG2RAD);
-                    headfraction = 0.0;
+void GYSegmenter::extractMergedBlob(int i, int numinrawblob, int firstblob, int m)
+{
+    int j, k;
+    int currentblob = firstblob;
+    std::vector<CvPoint> PixelList;
+    double XXMoment, YYMoment, XYMoment, Delta, A, theta, headfraction, slope;
 
-                    if (theta > 0)
-                    {
-                        for (j = 0 ; j < (int) PixelList.size() ; j++)
-                        {
-                            if (PixelList[j].y > (slope*(PixelList[j].x - m_CurrentBlobs[currentblob].m_dXCentre) + m_CurrentBlobs[currentblob].m_dYCentre))
-                            {
-                                headfraction += 1.0;
-                            }
-                        }
-                        headfraction /= (double) PixelList.size();
-                    }           // end if (theta > 0)
-                    else
-                    {
-                        for (j = 0 ; j < (int) PixelList.size() ; j++)
-                        {
-                            if (PixelList[j].y < (slope*(PixelList[j].x - m_CurrentBlobs[currentblob].m_dXCentre) + m_CurrentBlobs[currentblob].m_dYCentre))
-                            {
-                                headfraction += 1.0;
-                            }
-                        }
-                        headfraction /= (double) PixelList.size();
-                    }           // end else
-                }               // end else
+    /* PixelAllocation holds the list of distributions each pixel in the raw
+       blob is allocated to */
+    const MixGaussiansAllocation& PixelAllocation = m_vPixelAllocations[m];
 
-                // If headfraction is less than 0.5, we have the wrong orientation
-                if (headfraction < 0.5)
+    // We now want a new vector of raw blobs for each extracted individual blob
+    std::vector<RawBlobPtr> ExtractedBlobs;
+    ExtractedBlobs.resize(0);
+    for (k = 0 ; k < numinrawblob ; k++)
+    {
+        RawBlobPtr rbp(new GYRawBlob(m_RawBlobData[i]->GetNumPixels()));        // Make sure the new raw blobs have space for enough pixels - faster running at expense of more initial memory
+        ExtractedBlobs.push_back(rbp);
+    }
+
+    // Run through the pixels from the original raw blob and assign them to their allocated new blobs
+    PixelList.resize(m_RawBlobData[i]->GetNumPixels());
+    m_RawBlobData[i]->GetPixelList(PixelList);
+    for (k = 0 ; k < m_RawBlobData[i]->GetNumPixels() ; k++)
+    {
+        const int* dists = PixelAllocation.GetDists(k);
+        for (int d = 0 ; d < PixelAllocation.GetNumDists(k) ; d++)
+        {
+            ExtractedBlobs[dists[d]]->AddPoint(PixelList[k]);
+        }
+    }           // end for (k = 0 ; k < m_RawBlobData[i]->GetNumPixels() ; k++)
+
+    // Loop through the new blobs and extract their parameters
+    for (k = 0 ; k < numinrawblob ; k++)
+    {
+        m_CurrentBlobs[currentblob].m_dArea = ExtractedBlobs[k]->GetArea();
+        m_CurrentBlobs[currentblob].m_dXCentre = ExtractedBlobs[k]->GetXCentre();
+        m_CurrentBlobs[currentblob].m_dYCentre = ExtractedBlobs[k]->GetYCentre();
+
+        // Calculating ellipse (semi) major and minor axes from the moments
+        XXMoment = ExtractedBlobs[k]->GetXXMoment();
+        YYMoment = ExtractedBlobs[k]->GetYYMoment();
+        XYMoment = ExtractedBlobs[k]->GetXYMoment();
+        Delta = sqrt(4*pow(XYMoment, 2) + pow(XXMoment - YYMoment, 2));
+        A = pow(16*pow(M_PI, 2)*(XXMoment*YYMoment - pow(XYMoment, 2)), 0.25);
+
+        if (A == 0)             // This will happen if all the pixels lie along a line
+        {
+            A = 1;
+        }
+
+        m_CurrentBlobs[currentblob].m_dMajorAxis = sqrt((2*(XXMoment + YYMoment + Delta))/A);
+        m_CurrentBlobs[currentblob].m_dMinorAxis = sqrt((2*(XXMoment + YYMoment - Delta))/A);
+
+        // Calculating the orientation angle from the moments. Note that after this
+        // calculation, theta will be between -90 and 90
+        theta = 0.5*atan2(2*XYMoment, XXMoment - YYMoment)*MT_RAD2DEG;
+
+        // Estimate the correct orientation of the blob by assigning the side with the 
+        // most pixels as the front. We determine the two 'sides' of the blob by 
+        // drawing a line through the centroid, perpendicular to theta
+        PixelList.resize(ExtractedBlobs[k]->GetNumPixels());
+        ExtractedBlobs[k]->GetPixelList(PixelList);
+
+        if (theta == 0)
+        {
+            headfraction = 0.0;
+            for (j = 0; j < (int) PixelList.size() ; j++)
+            {
+                if (PixelList[j].x > m_CurrentBlobs[currentblob].m_dXCentre)
                 {
-                    theta = theta - 180.0;
+                    headfraction += 1.0;
                 }
-                // So now theta could be between -270 and 90
+            }
+            headfraction /= (double) PixelList.size();
+        }               // end if (theta == 0)
+        else
+        {
+            slope = tan((theta - 90.0)*MT_DEG2RAD);
+            headfraction = 0.0;
 
-                if (theta < -180)
+            if (theta > 0)
+            {
+                for (j = 0 ; j < (int) PixelList.size() ; j++)
+                {
+                    if (PixelList[j].y > (slope*(PixelList[j].x - m_CurrentBlobs[currentblob].m_dXCentre) + m_CurrentBlobs[currentblob].m_dYCentre))
+                    {
+                        headfraction += 1.0;
+                    }
+                }
+                headfraction /= (double) PixelList.size();
+            }           // end if (theta > 0)
+            else
+            {
+                for (j = 0 ; j < (int) PixelList.size() ; j++)
                 {
-                    theta = theta + 360.0;
+                    if (PixelList[j].y < (slope*(PixelList[j].x - m_CurrentBlobs[currentblob].m_dXCentre) + m_CurrentBlobs[currentblob].m_dYCentre))
+                    {
+                        headfraction += 1.0;
+                    }
                 }
-                // Now we have theta between -180 and 180
-
-                m_CurrentBlobs[currentblob].m_dOrientation = -theta;
+                headfraction /= (double) PixelList.size();
+            }           // end else
+        }               // end else
 
-                currentblob++;
-            }           // end for (k = 0 ; k < numinrawblob ; k++)
-        }               // end else if (BlobSizes[i] > 0)
-    }           // end for (i = 0 ; i < numrawblobs ; i++)
+        // If headfraction is less than 0.5, we have the wrong orientation
+        if (headfraction < 0.5)
+        {
+            theta = theta - 180.0;
+        }
+        // So now theta could be between -270 and 90
 
-    // Record the current set of blobs so we can make estimates next time (if needed)
-    m_OldBlobs = m_CurrentBlobs;
-    m_bHasHistory = true;
+        if (theta < -180)
+        {
+            theta = theta + 360.0;
+        }
+        // Now we have theta between -180 and 180
 
-    // Cleanup
-    if(numrawblobs)
-    {
-        delete[] RawBlobSizes;
-        delete[] BlobSizes;
-    }
+        m_CurrentBlobs[currentblob].m_dOrientation = -theta;
 
+        currentblob++;
+    }           // end for (k = 0 ; k < numinrawblob ; k++)
 }       // end function
 
 MT_BoundingBox GYSegmenter::getObjectBoundingBox() const
@@ -1367,28 +2170,61 @@ static int IndexMin(double* array, int arraylength)
 }       // end function
 
 
-static int ipow(int& a, int& n)
+// Clips the box [xmin, xmax] x [ymin, ymax] to the frame.  The result has zero
+// width or height if the box lies entirely outside the frame.
+static CvRect ClipToFrame(double xmin, double xmax, double ymin, double ymax, int width, int height)
 {
-    if (n == 0)
+    int xmin_i = (int) MT_MAX(xmin, 0.0);
+    int ymin_i = (int) MT_MAX(ymin, 0.0);
+    int xmax_i = (int) MT_MIN(xmax, (double) (width - 1));
+    int ymax_i = (int) MT_MIN(ymax, (double) (height - 1));
+
+    if ((xmax_i < xmin_i) || (ymax_i < ymin_i))
     {
-        return 1;
+        return cvRect(0, 0, 0, 0);
     }
-    else if (n > 0)
+
+    return cvRect(xmin_i, ymin_i, xmax_i - xmin_i + 1, ymax_i - ymin_i + 1);
+}       // end function
+
+// True if a and b share a pixel or lie side by side with no gap
+static bool RectsOverlapOrTouch(const CvRect& a, const CvRect& b)
+{
+    return (a.x <= b.x + b.width) && (b.x <= a.x + a.width) && (a.y <= b.y + b.height) && (b.y <= a.y + a.height);
+}       // end function
+
+// Replaces any two rectangles that overlap or share an edge with their bounding
+// box, until no such pair remains
+static void MergeOverlappingRects(std::vector<CvRect>* rects)
+{
+    bool merged = true;
+    unsigned int i, j;
+    int x0, y0, x1, y1;
+
+    while (merged)
     {
-        int val = 1;
-        for (int i = 0; i < n ; i++)
+        merged = false;
+        for (i = 0 ; i < rects->size() ; i++)
         {
-            val *= a;
+            for (j = i + 1 ; j < rects->size() ; j++)
+            {
+                CvRect& a = (*rects)[i];
+                CvRect& b = (*rects)[j];
+                if (RectsOverlapOrTouch(a, b))
+                {
+                    x0 = MT_MIN(a.x, b.x);
+                    y0 = MT_MIN(a.y, b.y);
+                    x1 = MT_MAX(a.x + a.width, b.x + b.width);
+                    y1 = MT_MAX(a.y + a.height, b.y + b.height);
+                    a = cvRect(x0, y0, x1 - x0, y1 - y0);
+
+                    (*rects)[j] = rects->back();
+                    rects->pop_back();
+                    j--;
+                    merged = true;
+                }
+            }
         }
-        return val;
-    }
-    else if ((a == 1) || ((a == 2) && (n == -1)))
-    {
-        return 1;
-    }
-    else
-    {
-        return 0;
     }
 }       // end function
 
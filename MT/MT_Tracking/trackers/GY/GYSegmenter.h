@@ -30,10 +30,15 @@
 #include "MT/MT_Tracking/cv/MT_BlobExtras.h"
 
 #include "MT/MT_Core/primitives/Matrix.h"
+#include "MT/MT_Core/support/WorkerPool.h"
 #include "MT/MT_Tracking/base/MT_TrackerBase.h"
+#include "MT/MT_Tracking/base/MT_TrackedObjectStore.h"
+#include "MT/MT_Tracking/cv/MT_GatedMatcher.h"
+#include "MT/MT_Tracking/cv/MT_TrackAssigner.h"
 
 #include "GYBlobs.h"
 #include "MixGaussians.h"
+#include "MixGaussiansBudget.h"
 
 // for STL vector
 #include <vector>
@@ -47,6 +52,8 @@ using namespace std;
 #define RT_MIN_BLOB_SIZE 5     // minimum area of a blob
 #define RT_MAX_BLOB_SIZE 4000  // maximum area of a blob
 #define RT_NUM_OBJECTS 10          // number of objects to track
+#define RT_RESCAN_TILES 20     // frames to rescan the whole frame in
+#define RT_RESCAN_OVERLAP 30   // overlap between rescan tiles [px]
 
 #define NO_BOUNDING_BOXES false
 #define USE_BOUNDING_BOXES true
@@ -77,6 +84,46 @@ public:
                       int* area_thresh_high);
 };
 
+class GYSearchWindowParameters : public MT_DataGroup
+{
+public:
+    GYSearchWindowParameters(bool* use_predicted_windows,
+                             double* window_sigmas,
+                             double* min_sigma,
+                             int* lost_frames_before_full,
+                             int* rescan_tiles);
+};
+
+class GYEMParameters : public MT_DataGroup
+{
+public:
+    GYEMParameters(int* bin_size,
+                   int* bin_min_pixels,
+                   double* bin_tolerance,
+                   int* num_threads,
+                   double* frame_budget,
+                   int* degraded_frames);
+};
+
+class GYMatchingParameters : public MT_DataGroup
+{
+public:
+    GYMatchingParameters(bool* use_gated_matching,
+                         double* gate_sigmas,
+                         double* gate_radius,
+                         int* num_subproblems);
+};
+
+class GYTrackManagementParameters : public MT_DataGroup
+{
+public:
+    GYTrackManagementParameters(bool* manage_tracks,
+                                double* track_gate,
+                                int* confirm_hits,
+                                int* max_misses,
+                                int* num_confirmed);
+};
+
 class GYBlobInfoReport : public MT_DataReport
 {
 public:
@@ -121,6 +168,8 @@ protected:
     double m_dFrameRate;
     double m_dAverageFrameRate;
     double m_dT;
+    double m_dTPrevious;
+    double m_dTStart;
 
     int m_iNobj;
 
@@ -137,7 +186,100 @@ protected:
 
     CvRect m_SearchArea;
 
+    /* Predicted search windows.  When m_bUsePredictedWindows is set,
+     * each track gets a window around its predicted position, sized
+     * to m_dSearchWindowSigmas standard deviations of the predicted
+     * position covariance.  Overlapping windows are merged and image
+     * processing / blob finding only happen inside them.  If a track's
+     * measurement falls outside its window for m_iLostFramesBeforeFull
+     * consecutive frames, the next frame is searched in full
+     * (m_iLostFramesBeforeFull <= 0 disables this fallback). */
+    bool m_bUsePredictedWindows;
+    double m_dSearchWindowSigmas;
+    double m_dSearchWindowMinSigma;
+    int m_iLostFramesBeforeFull;
+    int m_iLostFrames;
+    std::vector<CvRect> m_vTrackWindows;   /* one per track */
+    std::vector<CvRect> m_vSearchWindows;  /* merged, disjoint */
+    std::vector<double> m_vdLastTrackX;
+    std::vector<double> m_vdLastTrackY;
+
+    /* Amortized rescan.  While the search is limited to windows, one
+     * of m_iRescanTiles bands of the frame is searched as well each
+     * frame, cycling through the frame so that new objects are found
+     * within m_iRescanTiles frames (0 disables rescanning).  The band
+     * (m_RescanTile, empty if none) isn't merged with the windows;
+     * only its blobs clear of every window are kept. */
+    int m_iRescanTiles;
+    int m_iRescanTile;
+    CvRect m_RescanTile;
+    CvRect getRescanTile();
+
     std::vector<RawBlobPtr> m_RawBlobData;
+    GYPixelBuffer m_PixelBuffer;
+
+    /* Binned EM for large blobs, see MixGaussians::m_iBinSize */
+    int m_iEMBinSize;
+    int m_iEMBinMinPixels;
+    double m_dEMBinTolerance;
+
+    /* Merged raw blobs are split on m_iEMThreads threads (<= 0 means
+     * one per core), each with its own EMMG workspace.  The result
+     * doesn't depend on the number of threads. */
+    int m_iEMThreads;
+    MT_WorkerPool* m_pWorkerPool;
+    int m_iWorkerPoolThreads;
+    std::vector<MixGaussiansWorkspace> m_vEMWorkspaces;
+    /* the mixture and pixel allocation of each merged raw blob */
+    std::vector<MixGaussians> m_vEMFits;
+    std::vector<MixGaussiansAllocation> m_vPixelAllocations;
+
+    /* EM time budget per frame, see MixGaussiansBudget.
+     * m_dEMFrameBudget is in ms, <= 0 (default) for none.  With a
+     * budget the result depends on timing. */
+    double m_dEMFrameBudget;
+    MixGaussiansBudget m_EMBudget;
+
+    /* Gated matching.  When m_bUseGatedMatching is set, a blob is
+     * only matched to a track within the track's gate (see
+     * MT_GatedMatcher), which makes matching many objects roughly
+     * linear in their number.  The gate is m_dMatchGateSigmas
+     * standard deviations of the predicted position, with the same
+     * prediction and covariance as the search windows, or a circle of
+     * radius m_dMatchGateRadius around the predicted position if that
+     * is > 0.  Blobs outside every gate are still matched to the
+     * tracks left over. */
+    bool m_bUseGatedMatching;
+    double m_dMatchGateSigmas;
+    double m_dMatchGateRadius;
+    int m_iMatchSubproblems;
+    MT_GatedMatcher m_GatedMatcher;
+    std::vector<MT_GatedTrack> m_vMatchTracks;
+
+    /* Track management.  When m_bManageTracks is set, blobs are
+     * matched with MT_TrackAssigner instead:  a blob more than
+     * m_dTrackGate from every predicted track position starts a
+     * tentative track, confirmed after m_iTrackConfirmHits matches,
+     * and a confirmed track is deleted after m_iTrackMaxMisses
+     * consecutive misses.  Confirmed tracks take the first free of
+     * the m_iNobj tracked object slots and keep it until deleted;
+     * m_viSlotTrackID is the id of the track in each slot (-1 for
+     * none).  Blobs that aren't in a slot are left out of the tracked
+     * objects, so a spurious blob or an object leaving the frame
+     * doesn't swap identities. */
+    bool m_bManageTracks;
+    double m_dTrackGate;
+    int m_iTrackConfirmHits;
+    int m_iTrackMaxMisses;
+    int m_iNumConfirmedTracks;
+    MT_TrackAssigner m_TrackAssigner;
+    std::vector<int> m_viSlotTrackID;
+    std::vector<int> m_viTrackSlot;
+    std::vector<int> m_viFreeSlots;
+
+    /* m_pTrackedObjects as what it is, so that matching can go
+     * through all of the positions at once (owned by the base) */
+    MT_TrackedObjectStore* m_pTrackStore;
 
     std::vector<GYBlob> m_CurrentBlobs;
     std::vector<GYBlob> m_OldBlobs;
@@ -145,11 +287,28 @@ protected:
     bool m_bHasHistory;
 
     void doImageProcessing();
+    void computeSearchWindows();
+    void processSearchArea(CvRect area);
     void doBlobFinding();
+    void findRawBlobs(CvRect area, std::vector<RawBlobPtr>* raw_blobs);
     void doSegmentation();
+    /* Splitting the m'th merged raw blob, m_RawBlobData[i], into
+     * numinrawblob blobs written to m_CurrentBlobs[firstblob]
+     * onwards:  an initial guess, EMMG (which can be run again to
+     * carry on) and extracting the blobs from the pixel allocation.
+     * Safe to run in parallel for different m as long as worker
+     * differs. */
+    friend class GYSegmentationJob;
+    void initMergedBlob(int i, int numinrawblob, int m);
+    void fitMergedBlob(int i, int m, int max_iters, double deadline, int worker);
+    void extractMergedBlob(int i, int numinrawblob, int firstblob, int m);
 
     double updateFrameRate(double dt);
 
+    /* everything in doTracking after the conversion of the frame to
+     * m_pGS_frame, except for writing the data */
+    void trackGrayFrame(IplImage* frame);
+
     virtual void doInit(IplImage* ProtoFrame);
     virtual void createFrames();
 
@@ -163,6 +322,8 @@ protected:
     std::vector<double> OBlobs;
 
     void doMatching();
+    void doGatedMatching();
+    void doManagedMatching();
 
 public:
     GYSegmenter(IplImage* ProtoFrame);
@@ -173,11 +334,22 @@ public:
 
     void doTracking(IplImage* frame);
 
+    /* grayscale conversion / tracking / writing out for
+     * MT_TrackerPipeline */
+    virtual void doPipelinePreprocess(MT_TrackerPipelineFrame* frame);
+    virtual void doPipelineTrack(MT_TrackerPipelineFrame* frame);
+    virtual void doPipelineOutput(MT_TrackerPipelineFrame* frame);
+
     void setNumObjects(int numobj);
+    // threads to split merged blobs on, <= 0 for one per core
+    void setEMThreads(int numthreads){m_iEMThreads = numthreads;};
+    int getEMThreads() const {return m_iEMThreads;};
     void setBlobFile(const char* BlobFilename, const char* description);
 
     int getNumObjects();
     int getNumFrames();
+    // frames in which the EM budget cut a fit short
+    int getNumDegradedFrames();
 
     double getFrameRate();
     double getAveFrameRate();
@@ -12,6 +12,11 @@
  */
 
 #include "MixGaussians.h"
+#include "MixGaussiansEStep.h"
+
+#include <string.h>
+
+#include "MT/MT_Core/support/mathsupport.h"
 
 #define MAX_ITERS 1000
 
@@ -20,6 +25,158 @@
 int intpow(int& a, int& n);
 void calculate_axes_and_angle(double xx, double xy, double yy, double* M, double* m, double* o);
 
+MixGaussiansAllocation::MixGaussiansAllocation()
+{
+    m_viStart.resize(0);
+    m_viDists.resize(0);
+}
+
+MixGaussiansWorkspace::MixGaussiansWorkspace()
+{
+}
+
+template <class T>
+static void grow(std::vector<T>& v, unsigned int n)
+{
+    if(v.size() < n)
+    {
+        v.resize(n);
+    }
+}
+
+void MixGaussiansWorkspace::Reserve(int numdists, int numpixels)
+{
+    /* at least one element each so that &v[0] is always valid */
+    unsigned int nd = MT_MAX(numdists, 1);
+    unsigned int np = MT_MAX(numpixels, 1);
+
+    grow(m_vdPus, nd*np);
+    grow(m_vdPs, nd*np);
+    grow(m_vdPls, nd*np);
+    grow(m_vdTotalDensity, np);
+    grow(m_vdTotalPls, nd);
+    grow(m_vdOldXs, nd);
+    grow(m_vdOldYs, nd);
+    grow(m_vdOldAngles, nd);
+    grow(m_vdOldMs, nd);
+    grow(m_vdOldms, nd);
+    grow(m_vdOrigXs, nd);
+    grow(m_vdOrigYs, nd);
+    grow(m_vdOrigMs, nd);
+    grow(m_vdOrigms, nd);
+    grow(m_vcDistMembership, nd);
+    grow(m_vfEStepScratch, (unsigned int) GYEStepScratchSize(nd));
+}
+
+/* Sorts the pixels into binsize x binsize cells on a grid starting at
+ * the top left of the blob and fills in the cell statistics in the
+ * workspace.  Returns the number of (non-empty) cells. */
+static int bin_pixels(const GYPixelView& pixels,
+                      int binsize,
+                      MixGaussiansWorkspace* ws)
+{
+    int numpixels = pixels.m_iNumPixels;
+    int j;
+
+    int x0 = pixels.m_pX[0];
+    int y0 = pixels.m_pY[0];
+    int x1 = x0;
+    int y1 = y0;
+    for(j = 1; j < numpixels; j++)
+    {
+        x0 = MT_MIN(x0, (int) pixels.m_pX[j]);
+        x1 = MT_MAX(x1, (int) pixels.m_pX[j]);
+        y0 = MT_MIN(y0, (int) pixels.m_pY[j]);
+        y1 = MT_MAX(y1, (int) pixels.m_pY[j]);
+    }
+    int gw = (x1 - x0)/binsize + 1;
+    int gh = (y1 - y0)/binsize + 1;
+
+    grow(ws->m_viCellIndex, (unsigned int) (gw*gh));
+    int* cellindex = &ws->m_viCellIndex[0];
+    for(j = 0; j < gw*gh; j++)
+    {
+        cellindex[j] = -1;
+    }
+
+    /* at most one cell per pixel */
+    grow(ws->m_vdCellXs, (unsigned int) numpixels);
+    grow(ws->m_vdCellYs, (unsigned int) numpixels);
+    grow(ws->m_vdCellWs, (unsigned int) numpixels);
+    grow(ws->m_vdCellSxx, (unsigned int) numpixels);
+    grow(ws->m_vdCellSxy, (unsigned int) numpixels);
+    grow(ws->m_vdCellSyy, (unsigned int) numpixels);
+    double* cxs = &ws->m_vdCellXs[0];
+    double* cys = &ws->m_vdCellYs[0];
+    double* cws = &ws->m_vdCellWs[0];
+    double* sxx = &ws->m_vdCellSxx[0];
+    double* sxy = &ws->m_vdCellSxy[0];
+    double* syy = &ws->m_vdCellSyy[0];
+
+    /* sums of the coordinates relative to the corner of the cell */
+    int numcells = 0;
+    for(j = 0; j < numpixels; j++)
+    {
+        int gx = (pixels.m_pX[j] - x0)/binsize;
+        int gy = (pixels.m_pY[j] - y0)/binsize;
+        int c = cellindex[gy*gw + gx];
+        if(c < 0)
+        {
+            c = cellindex[gy*gw + gx] = numcells++;
+            cxs[c] = cys[c] = cws[c] = 0;
+            sxx[c] = sxy[c] = syy[c] = 0;
+        }
+        double dx = pixels.m_pX[j] - x0 - gx*binsize;
+        double dy = pixels.m_pY[j] - y0 - gy*binsize;
+        cxs[c] += dx;
+        cys[c] += dy;
+        cws[c] += 1.0;
+        sxx[c] += dx*dx;
+        sxy[c] += dx*dy;
+        syy[c] += dy*dy;
+    }
+
+    /* -> centroids and scatter about them */
+    for(j = 0; j < gw*gh; j++)
+    {
+        int c = cellindex[j];
+        if(c < 0)
+        {
+            continue;
+        }
+        double mx = cxs[c]/cws[c];
+        double my = cys[c]/cws[c];
+        sxx[c] -= cws[c]*mx*mx;
+        sxy[c] -= cws[c]*mx*my;
+        syy[c] -= cws[c]*my*my;
+        cxs[c] = x0 + (j % gw)*binsize + mx;
+        cys[c] = y0 + (j / gw)*binsize + my;
+    }
+
+    return numcells;
+}
+
+/* E-step over all of the pixels, single precision if asked for and
+ * possible */
+static void estep_pixels(bool single_precision,
+                         const GYPixelView& pixels,
+                         const std::vector<MT_Vector2>& means,
+                         const std::vector<MT_Matrix2x2>& covariances,
+                         MixGaussiansWorkspace* ws)
+{
+    if(!single_precision
+       || !GYEStepFloat(pixels.m_pX, pixels.m_pY, pixels.m_iNumPixels,
+                        means, covariances,
+                        &ws->m_vdPus[0], &ws->m_vdPs[0], &ws->m_vdPls[0],
+                        &ws->m_vfEStepScratch[0]))
+    {
+        GYEStepDouble(pixels.m_pX, pixels.m_pY, pixels.m_iNumPixels,
+                      means, covariances,
+                      &ws->m_vdPus[0], &ws->m_vdPs[0], &ws->m_vdPls[0],
+                      &ws->m_vdTotalDensity[0]);
+    }
+}
+
 MixGaussians::MixGaussians()
 {
     m_iNumDists = 0;
@@ -31,7 +188,19 @@ MixGaussians::MixGaussians()
     m_dMaxDistance = -1;              
     m_dMaxSizePercentChange = -1;
 
+    m_bUseSinglePrecision = true;
+
+    m_iBinSize = 1;
+    m_iBinMinPixels = 2000;
+    m_dBinTolerance = 0.5;
+
+    m_pWorkspace = NULL;
     m_pDebugFile = NULL;
+
+    m_iNumIterations = 0;
+    m_bConverged = false;
+    m_dResidualChange = 0;
+    m_dDeadline = -1;
 }
 
 MixGaussians::MixGaussians(int numdists, const CvRect& boundingbox)
@@ -45,9 +214,21 @@ MixGaussians::MixGaussians(int numdists, const CvRect& boundingbox)
     m_dMaxDistance = -1;              
     m_dMaxSizePercentChange = -1;    
 
+    m_bUseSinglePrecision = true;
+
+    m_iBinSize = 1;
+    m_iBinMinPixels = 2000;
+    m_dBinTolerance = 0.5;
+
     CoverBox(numdists, boundingbox);
 
+    m_pWorkspace = NULL;
     m_pDebugFile = NULL;
+
+    m_iNumIterations = 0;
+    m_bConverged = false;
+    m_dResidualChange = 0;
+    m_dDeadline = -1;
 }
 
 void MixGaussians::CoverBox(int numdists, const CvRect& boundingbox)
@@ -75,6 +256,152 @@ void MixGaussians::CoverBox(int numdists, const CvRect& boundingbox)
     }
 }
 
+void MixGaussians::SeedKMeansPP(int numdists, RawBlobPtr RawData, unsigned int seed)
+{
+    GYPixelView pixels = RawData->GetPixelView();
+    int numpixels = pixels.m_iNumPixels;
+    if(numdists <= 0)
+    {
+        return;
+    }
+    if(numpixels == 0)
+    {
+        CoverBox(numdists, RawData->GetBoundingBox());
+        return;
+    }
+
+    const GYPixelCoord* xs = pixels.m_pX;
+    const GYPixelCoord* ys = pixels.m_pY;
+
+    MixGaussiansWorkspace* ws = m_pWorkspace ? m_pWorkspace : &m_Workspace;
+    ws->Reserve(m_iNumDists + numdists, numpixels);
+    if((int) ws->m_viCellIndex.size() < numpixels)
+    {
+        ws->m_viCellIndex.resize(numpixels);
+    }
+    // squared distance from each pixel to its nearest centre, and that centre
+    double* d2 = &ws->m_vdTotalDensity[0];
+    int* nearest = &ws->m_viCellIndex[0];
+
+    /* distances to the existing distributions take their shape into
+     * account:  the Mahalanobis distance, scaled to be in pixels for a
+     * round distribution */
+    int first = m_iNumDists;
+    int i, j;
+    double dx, dy, d;
+    for(j = 0; j < numpixels; j++)
+    {
+        d2[j] = -1.0;
+        nearest[j] = -1;
+    }
+    for(i = 0; i < m_iNumDists; i++)
+    {
+        const double* S = m_vCovariances[i].data;
+        double det = S[0]*S[3] - S[1]*S[2];
+        if(det <= 0)
+        {
+            continue;
+        }
+        double s = sqrt(det)/det;
+        for(j = 0; j < numpixels; j++)
+        {
+            dx = xs[j] - m_vMeans[i].data[0];
+            dy = ys[j] - m_vMeans[i].data[1];
+            d = s*(S[3]*dx*dx - (S[1] + S[2])*dx*dy + S[0]*dy*dy);
+            if(d2[j] < 0 || d < d2[j])
+            {
+                d2[j] = d;
+                nearest[j] = i;
+            }
+        }
+    }
+
+    MT_Vector2 mean;
+    MT_Matrix2x2 cov;
+    cov.data[0] = cov.data[3] = 1.0;
+    cov.data[1] = cov.data[2] = 0.0;
+    for(int k = 0; k < numdists; k++)
+    {
+        // pick a pixel with probability proportional to d2, or
+        // uniformly for the first centre
+        double total = 0;
+        for(j = 0; j < numpixels; j++)
+        {
+            total += (d2[j] < 0) ? 1.0 : d2[j];
+        }
+        seed = 1664525*seed + 1013904223;
+        double r = total*((double) (seed >> 8))/16777216.0;
+        int pick = numpixels - 1;
+        for(j = 0; j < numpixels; j++)
+        {
+            r -= (d2[j] < 0) ? 1.0 : d2[j];
+            if(r < 0)
+            {
+                pick = j;
+                break;
+            }
+        }
+
+        mean.data[0] = xs[pick];
+        mean.data[1] = ys[pick];
+        AddDist(mean, cov);
+        i = m_iNumDists - 1;
+        for(j = 0; j < numpixels; j++)
+        {
+            dx = xs[j] - mean.data[0];
+            dy = ys[j] - mean.data[1];
+            d = dx*dx + dy*dy;
+            if(d2[j] < 0 || d < d2[j])
+            {
+                d2[j] = d;
+                nearest[j] = i;
+            }
+        }
+    }
+
+    // centroid and scatter of the pixels nearest each new centre
+    double def_var = ((double) numpixels)/(4.0*M_PI*m_iNumDists);
+    for(i = first; i < m_iNumDists; i++)
+    {
+        double n = 0, sx = 0, sy = 0;
+        for(j = 0; j < numpixels; j++)
+        {
+            if(nearest[j] == i)
+            {
+                n += 1.0;
+                sx += xs[j];
+                sy += ys[j];
+            }
+        }
+        if(n < 3)
+        {
+            m_vCovariances[i].data[0] = m_vCovariances[i].data[3] = def_var;
+            continue;
+        }
+        m_vMeans[i].data[0] = sx/n;
+        m_vMeans[i].data[1] = sy/n;
+        double sxx = 0, sxy = 0, syy = 0;
+        for(j = 0; j < numpixels; j++)
+        {
+            if(nearest[j] == i)
+            {
+                dx = xs[j] - m_vMeans[i].data[0];
+                dy = ys[j] - m_vMeans[i].data[1];
+                sxx += dx*dx;
+                sxy += dx*dy;
+                syy += dy*dy;
+            }
+        }
+        m_vCovariances[i].data[0] = MT_MAX(sxx/n, 0.5);
+        m_vCovariances[i].data[1] = m_vCovariances[i].data[2] = sxy/n;
+        m_vCovariances[i].data[3] = MT_MAX(syy/n, 0.5);
+        if(m_vCovariances[i].data[0]*m_vCovariances[i].data[3] <= sxy*sxy/(n*n))
+        {
+            m_vCovariances[i].data[1] = m_vCovariances[i].data[2] = 0;
+        }
+    }
+}
+
 void MixGaussians::ClearDists()
 {
     m_iNumDists = 0;
@@ -129,7 +456,7 @@ void MixGaussians::GetCovariances(std::vector<MT_Matrix2x2>& covariances)
    component search). The GYRawBlob simplifies access to the needed data from the image
    since it contains a list of all the white pixels in the image. The function also takes 
    an integer vector as an input to store which distributions each pixel has been assigned 
-   to.
+   to (see MixGaussiansAllocation).
  
    The algorithm followed is a standard expectation maximisation for a mixture of Gaussians
    with the exception that all distributions are assumed to have equal weight in the
@@ -137,51 +464,70 @@ void MixGaussians::GetCovariances(std::vector<MT_Matrix2x2>& covariances)
 void MixGaussians::EMMG(RawBlobPtr RawData, std::vector<int>& pixelalloc, int max_iters)
 {
 
-    /* The distribution assignment algorithm uses a bit pattern for
-     * pixel assignment.  Therefore we need one bit for each
-     * distribution and will correspondingly have problems if the
-     * number of distributions is too large */
+    /* We need one bit for each distribution */
     if(m_iNumDists > 31)
     {
-        fprintf(stderr, "MixGaussians::EMMG Error:  To many distributions!\n"
-                "\tSee MixGaussians::EMMG code.\n");
+        fprintf(stderr, "MixGaussians::EMMG Error:  To many distributions for a bit pattern!\n"
+                "\tUse a MixGaussiansAllocation instead.\n");
         return;
     }
-    
+
+    if (pixelalloc.size() != (unsigned int) RawData->GetNumPixels())
+    {
+        printf("Reserved pixel allocation vector has the wrong size\n");
+        return;
+    }
+
+    MixGaussiansWorkspace* ws = m_pWorkspace ? m_pWorkspace : &m_Workspace;
+    MixGaussiansAllocation& alloc = ws->m_Allocation;
+    EMMG(RawData, alloc, max_iters);
+
+    for(unsigned int j = 0; j < pixelalloc.size(); j++)
+    {
+        pixelalloc[j] = 0;
+        const int* dists = alloc.GetDists(j);
+        for(int k = 0; k < alloc.GetNumDists(j); k++)
+        {
+            pixelalloc[j] |= (1 << dists[k]);
+        }
+    }
+}
+
+void MixGaussians::EMMG(RawBlobPtr RawData, MixGaussiansAllocation& pixelalloc, int max_iters)
+{
+
     // Retrieving relevant data
-    int numpixels = RawData->GetNumPixels();
-    std::vector<CvPoint> pixellist(numpixels);
-    RawData->GetPixelList(pixellist);
+    GYPixelView pixels = RawData->GetPixelView();
+    int numpixels = pixels.m_iNumPixels;
+    const GYPixelCoord* pixel_xs = pixels.m_pX;
+    const GYPixelCoord* pixel_ys = pixels.m_pY;
 
     if(max_iters <= 0)
     {
         max_iters = MAX_ITERS;
     }
         
-    // Check on the length of the pixelalloc vector
-    if (pixelalloc.size() != (unsigned int) numpixels)
-    {
-        printf("Reserved pixel allocation vector has the wrong size\n");
-        return;
-    }
-        
     // Arrays needed for the expectation maximisation algorithm and to
-    // determine when to stop iterating
-    double *pus;
-    double *ps;
-    double *pls;
-    double *totalpls;
-    double *totaldensity;
-    double *oldxs;
-    double *oldys;
-    double *oldangles;
-    double *oldms;
-    double *oldMs;
-
-    double *orig_xs = new double[m_iNumDists];
-    double *orig_ys = new double[m_iNumDists];
-    double *orig_Ms = new double[m_iNumDists];
-    double *orig_ms = new double[m_iNumDists];
+    // determine when to stop iterating.  These live in the workspace
+    // so that repeated calls don't allocate.
+    MixGaussiansWorkspace* ws = m_pWorkspace ? m_pWorkspace : &m_Workspace;
+    ws->Reserve(m_iNumDists, numpixels);
+
+    double *pus = &ws->m_vdPus[0];
+    double *ps = &ws->m_vdPs[0];
+    double *pls = &ws->m_vdPls[0];
+    double *totalpls = &ws->m_vdTotalPls[0];
+    double *totaldensity = &ws->m_vdTotalDensity[0];
+    double *oldxs = &ws->m_vdOldXs[0];
+    double *oldys = &ws->m_vdOldYs[0];
+    double *oldangles = &ws->m_vdOldAngles[0];
+    double *oldms = &ws->m_vdOldms[0];
+    double *oldMs = &ws->m_vdOldMs[0];
+
+    double *orig_xs = &ws->m_vdOrigXs[0];
+    double *orig_ys = &ws->m_vdOrigYs[0];
+    double *orig_Ms = &ws->m_vdOrigMs[0];
+    double *orig_ms = &ws->m_vdOrigms[0];
     
     double m, M, Mdiff, mdiff, o;
     for(int i = 0; i < m_iNumDists; i++)
@@ -196,20 +542,9 @@ void MixGaussians::EMMG(RawBlobPtr RawData, std::vector<int>& pixelalloc, int ma
         orig_ms[i] = m;
     }
     
-    pus = new double[m_iNumDists*numpixels];        
-    ps = new double[m_iNumDists*numpixels];
-    pls = new double[m_iNumDists*numpixels];
-    totalpls = new double[m_iNumDists];
-    totaldensity = new double[numpixels];
-    oldxs = new double[m_iNumDists];
-    oldys = new double[m_iNumDists];
-    oldangles = new double[m_iNumDists];
-    oldMs = new double[m_iNumDists];
-    oldms = new double[m_iNumDists];    
-        
     // Temporary variables needed inside the main loop
     int i, j, k;
-    double mu_x, mu_y, D, s_xx, s_yy, s_xy, dx, dy;
+    double dx, dy;
         
     MT_Matrix2x2 V, T;
     MT_Matrix2x1 P;
@@ -221,10 +556,37 @@ void MixGaussians::EMMG(RawBlobPtr RawData, std::vector<int>& pixelalloc, int ma
     int distributionnumber = 0;
     int numberdists;
         
-    bool *distmembership;
-    distmembership = new bool[m_iNumDists];
+    /* cleared so that results don't depend on what the workspace was
+     * last used for */
+    char *distmembership = &ws->m_vcDistMembership[0];
+    memset(distmembership, 0, m_iNumDists*sizeof(char));
+
+    /* For a big enough blob we start out fitting to cells of binned
+     * pixels (see m_iBinSize) and switch to the pixels themselves
+     * (refining) once that has converged */
+    bool binned = false;
+    bool refining = false;
+    int numcells = 0;
+    double *cell_xs = NULL, *cell_ys = NULL, *cell_ws = NULL;
+    double *cell_sxx = NULL, *cell_sxy = NULL, *cell_syy = NULL;
+    if(m_iBinSize > 1 && numpixels > 0 && numpixels >= m_iBinMinPixels)
+    {
+        numcells = bin_pixels(pixels, m_iBinSize, ws);
+        cell_xs = &ws->m_vdCellXs[0];
+        cell_ys = &ws->m_vdCellYs[0];
+        cell_ws = &ws->m_vdCellWs[0];
+        cell_sxx = &ws->m_vdCellSxx[0];
+        cell_sxy = &ws->m_vdCellSxy[0];
+        cell_syy = &ws->m_vdCellSyy[0];
+        // not worth it for a sparse blob
+        binned = (2*numcells <= numpixels);
+    }
+    double maxshift;
+    double lastshift = -1.0;
+    bool pixel_estep = false;
 
     int numiters = 0;
+    double residual = 0;
     // maxchange measures the maximum amount that the distributions have varied, either in mean position or
     // in angle. We iterate until all means move by less than 1 pixel in either direction and all angles
     // shift by less than 1 degree.
@@ -248,61 +610,40 @@ void MixGaussians::EMMG(RawBlobPtr RawData, std::vector<int>& pixelalloc, int ma
             //oldangles[i] = atan2(m_vCovariances[i].data[3] - m_vCovariances[i].data[0] + sqrt(pow(m_vCovariances[i].data[0] - m_vCovariances[i].data[3],2) + 4.0*pow(m_vCovariances[i].data[1],2)), 2*m_vCovariances[i].data[1]);
         }
                 
-        // Calculate the probability density for each pixel in each distribution
-        for (i=0 ; i < m_iNumDists ; i++)
+        // Calculate the probability density for each pixel in each
+        // distribution and the likelihood that each pixel belongs to
+        // each distribution
+        if(binned)
         {
-            mu_x = m_vMeans[i].data[0];
-            mu_y = m_vMeans[i].data[1];
-            s_xx = m_vCovariances[i].data[0];
-            s_xy = m_vCovariances[i].data[1];
-            s_yy = m_vCovariances[i].data[3];
-            D = s_xx*s_yy - s_xy*s_xy;
-                        
-            for (j=0 ; j < numpixels ; j++)
-            {
-                dx = (pixellist[j].x - mu_x);
-                dy = (pixellist[j].y - mu_y);
-                /* f is the bit in the exponent, this will be saved as
-                   pu */
-                double f = (s_yy*dx*dx + s_xx*dy*dy - 2.0*s_xy*dx*dy)/D;
-                pus[i + j*m_iNumDists] = f;
-                /* the probability that this pixel comes from the ith
-                   distribution */
-                ps[i + j*m_iNumDists] = (0.5/(M_PI*sqrt(D)))*exp(-0.5*f);
-            }
-        }
-                
-        // Determine the total probability density at each pixel
-        for (j=0 ; j < numpixels ; j++)
-        {
-            totaldensity[j] = 0;
-            for (i=0 ; i < m_iNumDists ; i++)
-            {
-                totaldensity[j] += ps[i + j*m_iNumDists];
-            }
-                        
-            if (totaldensity[j] == 0)
-            {
-                totaldensity[j] = 1.0;
-            }
+            GYEStepDouble(cell_xs, cell_ys, numcells,
+                          m_vMeans, m_vCovariances,
+                          pus, ps, pls, totaldensity);
+            pixel_estep = false;
         }
-                
-        // Calculate the likelihood that each pixel belongs to each distribution
-        for (i=0 ; i < m_iNumDists ; i++)
+        else
         {
-            for (j=0 ; j < numpixels ; j++)
-            {
-                pls[i + j*m_iNumDists] = ps[i + j*m_iNumDists]/totaldensity[j];
-            }
+            estep_pixels(m_bUseSinglePrecision, pixels,
+                         m_vMeans, m_vCovariances, ws);
+            pixel_estep = true;
         }
                 
         // Calculate the sum of the likelihoods of all pixels for each distribution
         for (i=0 ; i < m_iNumDists ; i++)
         {
             totalpls[i] = 0;
-            for (j=0 ; j < numpixels ; j++)
+            if(binned)
+            {
+                for (j=0 ; j < numcells ; j++)
+                {
+                    totalpls[i] += cell_ws[j]*pls[i*numcells + j];
+                }
+            }
+            else
             {
-                totalpls[i] += pls[i + j*m_iNumDists];
+                for (j=0 ; j < numpixels ; j++)
+                {
+                    totalpls[i] += pls[i*numpixels + j];
+                }
             }
                         
             if (totalpls[i] == 0)
@@ -317,10 +658,21 @@ void MixGaussians::EMMG(RawBlobPtr RawData, std::vector<int>& pixelalloc, int ma
         {
             m_vMeans[i].data[0] = 0.0;
             m_vMeans[i].data[1] = 0.0;
-            for (j=0; j < numpixels ; j++)
+            if(binned)
             {
-                m_vMeans[i].data[0] += pixellist[j].x*pls[i + j*m_iNumDists];
-                m_vMeans[i].data[1] += pixellist[j].y*pls[i + j*m_iNumDists];
+                for (j=0; j < numcells ; j++)
+                {
+                    m_vMeans[i].data[0] += cell_ws[j]*cell_xs[j]*pls[i*numcells + j];
+                    m_vMeans[i].data[1] += cell_ws[j]*cell_ys[j]*pls[i*numcells + j];
+                }
+            }
+            else
+            {
+                for (j=0; j < numpixels ; j++)
+                {
+                    m_vMeans[i].data[0] += pixel_xs[j]*pls[i*numpixels + j];
+                    m_vMeans[i].data[1] += pixel_ys[j]*pls[i*numpixels + j];
+                }
             }
             m_vMeans[i].data[0] /= totalpls[i];
             m_vMeans[i].data[1] /= totalpls[i];
@@ -331,15 +683,33 @@ void MixGaussians::EMMG(RawBlobPtr RawData, std::vector<int>& pixelalloc, int ma
         for (i=0 ; i < m_iNumDists ; i++)
         {
             V.data[0] = V.data[1] = V.data[2] = V.data[3] = 0;
-            for (j=0 ; j < numpixels ; j++)
+            if(binned)
+            {
+                /* each cell contributes its pixels' scatter about the
+                 * mean, i.e. that of its centroid plus its own */
+                for (j=0 ; j < numcells ; j++)
+                {
+                    double pl = pls[i*numcells + j];
+                    dx = cell_xs[j] - m_vMeans[i].data[0];
+                    dy = cell_ys[j] - m_vMeans[i].data[1];
+                    V.data[0] += pl*(cell_ws[j]*dx*dx + cell_sxx[j]);
+                    V.data[1] += pl*(cell_ws[j]*dx*dy + cell_sxy[j]);
+                    V.data[3] += pl*(cell_ws[j]*dy*dy + cell_syy[j]);
+                }
+                V.data[2] = V.data[1];
+            }
+            else
             {
-                P.data[0] = pixellist[j].x - m_vMeans[i].data[0];
-                P.data[1] = pixellist[j].y - m_vMeans[i].data[1];
+                for (j=0 ; j < numpixels ; j++)
+                {
+                    P.data[0] = pixel_xs[j] - m_vMeans[i].data[0];
+                    P.data[1] = pixel_ys[j] - m_vMeans[i].data[1];
                                 
-                T.data[0] = P.data[0]*P.data[0];
-                T.data[1] = T.data[2] = P.data[0]*P.data[1];
-                T.data[3] = P.data[1]*P.data[1];
-                V = V + pls[i + j*m_iNumDists]*T;
+                    T.data[0] = P.data[0]*P.data[0];
+                    T.data[1] = T.data[2] = P.data[0]*P.data[1];
+                    T.data[3] = P.data[1]*P.data[1];
+                    V = V + pls[i*numpixels + j]*T;
+                }
             }
                         
             m_vCovariances[i].data[0] = V.data[0]/totalpls[i];
@@ -375,6 +745,7 @@ void MixGaussians::EMMG(RawBlobPtr RawData, std::vector<int>& pixelalloc, int ma
                 
         // Determine the maximum amount by which any distribution differs from the last iteration
         maxdiff = 0.0;
+        maxshift = 0.0;
         for (i=0 ; i < m_iNumDists ; i++)
         {
             xdiff = abs(m_vMeans[i].data[0] - oldxs[i]);
@@ -403,6 +774,7 @@ void MixGaussians::EMMG(RawBlobPtr RawData, std::vector<int>& pixelalloc, int ma
             {
                 maxdiff = anglediff;
             }
+            maxshift = MT_MAX(maxshift, MT_MAX(anglediff, MT_MAX(xdiff, ydiff)));
 
 
             Mdiff = 100.0*fabs(M - oldMs[i]);
@@ -483,6 +855,48 @@ void MixGaussians::EMMG(RawBlobPtr RawData, std::vector<int>& pixelalloc, int ma
         }
                 
         maxchange = maxdiff;
+        residual = maxdiff;
+
+        if(binned && maxchange <= 1.0)
+        {
+            binned = false;
+            refining = true;
+            maxchange = 10.0;
+        }
+        else if(refining)
+        {
+            /* EM closes in on its fixed point roughly geometrically,
+             * so the distance still to go is about shift*r/(1 - r),
+             * r being the ratio of successive shifts.  We stop once
+             * both that and the shift are within the tolerance, which
+             * takes at least two iterations at full resolution. */
+            bool close = (maxshift == 0.0);
+            if(lastshift > 0 && maxshift < lastshift)
+            {
+                double r = maxshift/lastshift;
+                close = (maxshift <= m_dBinTolerance
+                         && maxshift*r/(1.0 - r) <= m_dBinTolerance);
+            }
+            maxchange = close ? 0.0 : 10.0;
+            lastshift = maxshift;
+        }
+
+        if(m_dDeadline > 0 && maxchange > 1.0 && MT_getTimeSec() >= m_dDeadline)
+        {
+            break;
+        }
+    }
+
+    m_iNumIterations = numiters;
+    m_bConverged = (maxchange <= 1.0);
+    m_dResidualChange = residual;
+
+    /* the pixel allocation below needs a full resolution E-step, which
+     * we don't have if we ran out of iterations while binned */
+    if(!pixel_estep)
+    {
+        estep_pixels(m_bUseSinglePrecision, pixels,
+                     m_vMeans, m_vCovariances, ws);
     }
         
     // Now determine which distribution(s) each pixel belongs to. We do this in two ways. First, each
@@ -490,9 +904,13 @@ void MixGaussians::EMMG(RawBlobPtr RawData, std::vector<int>& pixelalloc, int ma
     // However, since pixels could lie within multiple distributions, we also assign pixels to any
     // distribution for which it lies less than two standard deviations from the mean.
 
+    /* resize doesn't give back memory, so a reused allocation stops
+     * allocating */
+    pixelalloc.m_viStart.resize(numpixels + 1);
+    pixelalloc.m_viDists.resize(0);
     for (j=0 ; j < numpixels ; j++)
     {
-        pixelalloc[j] = 0;
+        pixelalloc.m_viStart[j] = pixelalloc.m_viDists.size();
                 
         maxlikelihood = -1.0;
         numberdists = 0;
@@ -501,18 +919,18 @@ void MixGaussians::EMMG(RawBlobPtr RawData, std::vector<int>& pixelalloc, int ma
         for(i=0 ; i < m_iNumDists ; i++)
         {
             // Determine which distribution has the maximum likelihood of containing the pixel
-            if (pls[i + j*m_iNumDists] > maxlikelihood
-                && ps[i + j*m_iNumDists] > 0.002)  // TODO: This is a
+            if (pls[i*numpixels + j] > maxlikelihood
+                && ps[i*numpixels + j] > 0.002)  // TODO: This is a
                                                    // magic number and
                                                    // should be
                                                    // replaced with
                                                    // something more meaningful
             {
-                maxlikelihood = pls[i + j*m_iNumDists];
+                maxlikelihood = pls[i*numpixels + j];
                 distributionnumber = i;
             }
             // If the pixel lies within two standard deviations of the mean of any distribution, we include it
-            else if (pus[i + j*m_iNumDists] < 4.0)
+            else if (pus[i*numpixels + j] < 4.0)
             {
                 distmembership[i] = 1;
                 numberdists++;
@@ -530,44 +948,17 @@ void MixGaussians::EMMG(RawBlobPtr RawData, std::vector<int>& pixelalloc, int ma
             numberdists++;
         }
 
-        // Generate an integer to represent the set of distributions that the pixel belongs to
-        int p = 1;
+        // List the distributions that the pixel belongs to
         for(k = 0; k < m_iNumDists; k++)
         {
             if(distmembership[k] > 0)
             {
-                pixelalloc[j] += p;
+                pixelalloc.m_viDists.push_back(k);
             }
-            p *= 2;
         }
-        /* for (k=0 ; k < numberdists ; k++)
-         * {
-         *     for (; distmembership[i] == 0 ; i++)
-         *     {}
-         *     pixelalloc[j] += i*intpow(m_iNumDists,k);
-         *     distmembership[i] = 0;
-         * } */
 
     }
-        
-    // Clear all temporary arrays
-    delete[] pus;
-    delete[] ps;
-    delete[] pls;
-    delete[] totalpls;
-    delete[] totaldensity;
-    delete[] oldxs;
-    delete[] oldys;
-    delete[] oldangles;
-    delete[] oldMs;
-    delete[] oldms;
-    delete[] distmembership;
-
-    delete[] orig_xs;
-    delete[] orig_ys;
-    delete[] orig_Ms;
-    delete[] orig_ms;    
-    
+    pixelalloc.m_viStart[numpixels] = pixelalloc.m_viDists.size();
 }
 
 int intpow(int& a, int& n)
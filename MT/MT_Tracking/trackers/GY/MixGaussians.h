@@ -30,6 +30,75 @@
 #include <vector>
 using namespace std;
 
+/* The distributions that EMMG allocated each pixel of a blob to, as a
+   list of distribution indices (in increasing order) per pixel.  There
+   is no limit on the number of distributions.  Reusing one of these
+   for several blobs avoids reallocating. */
+class MixGaussiansAllocation
+{
+    friend class MixGaussians;
+protected:
+    // the dists of pixel j are m_viDists[m_viStart[j] .. m_viStart[j+1] - 1]
+    std::vector<int> m_viStart;
+    std::vector<int> m_viDists;
+
+public:
+    MixGaussiansAllocation();
+
+    int GetNumPixels() const {return m_viStart.empty() ? 0 : (int) m_viStart.size() - 1;};
+    int GetNumDists(int pixel) const {return m_viStart[pixel + 1] - m_viStart[pixel];};
+    // NumDists(pixel) indices
+    const int* GetDists(int pixel) const
+    {return m_viDists.empty() ? NULL : &m_viDists[0] + m_viStart[pixel];};
+};
+
+/* Scratch arrays for MixGaussians::EMMG.  They only ever grow, so once
+   a workspace has seen the largest blob (pixels x distributions) EMMG
+   runs without touching the heap.  A segmenter should own one and hand
+   it to each MixGaussians it creates with setWorkspace. */
+class MixGaussiansWorkspace
+{
+public:
+    MixGaussiansWorkspace();
+
+    // Make sure there is room for the given problem size
+    void Reserve(int numdists, int numpixels);
+
+    // per distribution and pixel
+    std::vector<double> m_vdPus;
+    std::vector<double> m_vdPs;
+    std::vector<double> m_vdPls;
+    // per pixel
+    std::vector<double> m_vdTotalDensity;
+    // per distribution
+    std::vector<double> m_vdTotalPls;
+    std::vector<double> m_vdOldXs;
+    std::vector<double> m_vdOldYs;
+    std::vector<double> m_vdOldAngles;
+    std::vector<double> m_vdOldMs;
+    std::vector<double> m_vdOldms;
+    std::vector<double> m_vdOrigXs;
+    std::vector<double> m_vdOrigYs;
+    std::vector<double> m_vdOrigMs;
+    std::vector<double> m_vdOrigms;
+    std::vector<char> m_vcDistMembership;
+    // for the single precision E-step
+    std::vector<float> m_vfEStepScratch;
+    // binned pixels (see MixGaussians::m_iBinSize), per cell:  the
+    // centroid, number of pixels and scatter about the centroid
+    std::vector<double> m_vdCellXs;
+    std::vector<double> m_vdCellYs;
+    std::vector<double> m_vdCellWs;
+    std::vector<double> m_vdCellSxx;
+    std::vector<double> m_vdCellSxy;
+    std::vector<double> m_vdCellSyy;
+    // cell number of each grid square over the blob, -1 if empty.
+    // SeedKMeansPP uses it for the nearest centre of each pixel.
+    std::vector<int> m_viCellIndex;
+    // for the bit pattern version of EMMG
+    MixGaussiansAllocation m_Allocation;
+};
+
 class MixGaussians
 {
 protected:
@@ -37,6 +106,15 @@ protected:
     std::vector<MT_Vector2> m_vMeans;
     std::vector<MT_Matrix2x2> m_vCovariances;
     FILE* m_pDebugFile;
+
+    // used by EMMG when no workspace has been set
+    MixGaussiansWorkspace m_Workspace;
+    MixGaussiansWorkspace* m_pWorkspace;
+
+    // from the last EMMG call
+    int m_iNumIterations;
+    bool m_bConverged;
+    double m_dResidualChange;
                 
 public:
     // Constructors
@@ -44,23 +122,68 @@ public:
     MixGaussians(int numdists, const CvRect& boundingbox);                                      // Constructor that evenly places distributions within a bounding box
 
     void CoverBox(int numdists, const CvRect& boundingbox);
+    /* Adds numdists distributions placed on the blob by k-means++
+     * seeding, counting any distributions already there as chosen
+     * centres.  Each new distribution gets the centroid and covariance
+     * of the pixels closest to its seed.  The same seed gives the same
+     * result (no global random state is used). */
+    void SeedKMeansPP(int numdists, RawBlobPtr RawData, unsigned int seed = 1);
     
     void ClearDists();
     void AddDist(const MT_Vector2& newmean, const MT_Matrix2x2& newcovariance);       // Method to add a given distribution to a mixture model
                 
     // Expectation maximisation algorithm to fit a mixture model to a given set of image data
+    void EMMG(RawBlobPtr RawData, MixGaussiansAllocation& pixelalloc, int max_iters = -1);
+    /* Same, with the allocation of each pixel as a bit pattern (bit i
+     * set for distribution i).  Only works for up to 31
+     * distributions. */
     void EMMG(RawBlobPtr RawData, std::vector<int>& pixelalloc, int max_iters = -1);
 
     // Methods to retrieve parameters
     int GetNumDists();
+    // Iterations run by the last EMMG, and whether it stopped because
+    // the mixture converged rather than running out of iterations
+    int GetNumIterations() const {return m_iNumIterations;};
+    bool GetConverged() const {return m_bConverged;};
+    // Largest change in a mean (pixels) or angle (degrees) over the
+    // last iteration of the last EMMG
+    double GetResidualChange() const {return m_dResidualChange;};
     void GetMeans(std::vector<MT_Vector2>& means);
     void GetCovariances(std::vector<MT_Matrix2x2>& covariances);
 
     void setDebugFile(FILE* fp){m_pDebugFile = fp;};
+    // EMMG uses this workspace (not owned) instead of its own.  NULL
+    // goes back to the internal one.
+    void setWorkspace(MixGaussiansWorkspace* ws){m_pWorkspace = ws;};
 
     double m_dMaxEccentricity;
     double m_dMaxDistance;
     double m_dMaxSizePercentChange;
+
+    /* Use the single precision (SIMD) E-step in EMMG.  See
+     * MixGaussiansEStep.h for its accuracy.  Default true. */
+    bool m_bUseSinglePrecision;
+
+    /* Binned EM for large blobs.  If m_iBinSize > 1 and the blob has at
+     * least m_iBinMinPixels pixels, EMMG first fits the mixture to
+     * m_iBinSize x m_iBinSize cells of pixels, each weighted by its
+     * pixel count, and then finishes at full resolution.  The full
+     * resolution iterations stop once the means and angles are
+     * estimated to be within m_dBinTolerance pixels and degrees of
+     * where they would converge to (judging by how fast they are
+     * still moving), which takes at least two iterations.
+     * Defaults:  1 (off), 2000, 0.5 */
+    int m_iBinSize;
+    int m_iBinMinPixels;
+    double m_dBinTolerance;
+
+    /* Time (see MT_getTimeSec) after which EMMG stops at the end of
+     * the current iteration, converged or not.  At least one
+     * iteration always runs.  Calling EMMG again carries on from
+     * where it stopped, except that m_dMaxDistance and
+     * m_dMaxSizePercentChange are then measured from there.  <= 0
+     * for none (default). */
+    double m_dDeadline;
                 
 };
 #endif                  // MIXGAUSSIANS_H
@@ -0,0 +1,75 @@
+/*
+ *  MixGaussiansBudget.cpp
+ *  MADTraC
+ *
+ *  See MixGaussiansBudget.h
+ *
+ */
+
+#include "MixGaussiansBudget.h"
+
+#include <math.h>
+
+#include "MT/MT_Core/support/mathsupport.h"
+
+MixGaussiansBudget::MixGaussiansBudget()
+    : m_dBudget(-1),
+      m_iNumFrames(0),
+      m_iNumDegradedFrames(0),
+      m_dFrameStart(0),
+      m_dCostPerUnit(0)
+{
+}
+
+void MixGaussiansBudget::StartFrame()
+{
+    m_dFrameStart = MT_getTimeSec();
+}
+
+double MixGaussiansBudget::GetDeadline() const
+{
+    return IsActive() ? m_dFrameStart + m_dBudget : -1.0;
+}
+
+double MixGaussiansBudget::GetRemaining() const
+{
+    return IsActive() ? GetDeadline() - MT_getTimeSec() : 0.0;
+}
+
+int MixGaussiansBudget::FirstPassCap(double work, int numworkers, int max_iters) const
+{
+    if(!IsActive() || m_dCostPerUnit <= 0 || work <= 0)
+    {
+        return max_iters;
+    }
+
+    /* time per iteration of all of the fits, spread over the workers */
+    double t = m_dCostPerUnit*work/((double) MT_MAX(numworkers, 1));
+    double n = floor(0.5*GetRemaining()/t);
+    if(n < 1)
+    {
+        return 1;
+    }
+    return (n < max_iters) ? (int) n : max_iters;
+}
+
+void MixGaussiansBudget::AddTiming(double work, int iterations, double seconds)
+{
+    if(work <= 0 || iterations <= 0 || seconds <= 0)
+    {
+        return;
+    }
+
+    double c = seconds/(work*iterations);
+    /* a moving average, so that it follows the machine's load */
+    m_dCostPerUnit = (m_dCostPerUnit > 0) ? 0.9*m_dCostPerUnit + 0.1*c : c;
+}
+
+void MixGaussiansBudget::EndFrame(bool degraded)
+{
+    m_iNumFrames++;
+    if(degraded)
+    {
+        m_iNumDegradedFrames++;
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef MIXGAUSSIANSBUDGET_H
+#define MIXGAUSSIANSBUDGET_H
+
+/*
+ *  MixGaussiansBudget.h
+ *  MADTraC
+ *
+ *  A per-frame time budget for the EMMG fits of a segmenter.
+ *
+ *  A frame's fits run in two passes.  The first gives every fit an
+ *  iteration cap (FirstPassCap) sized so that all of them together
+ *  take about half of the time left.  The fits that haven't converged
+ *  then continue, those with the biggest residual change first, until
+ *  they converge or reach the segmenter's usual iteration limit.  In
+ *  both passes a fit also stops once the frame's deadline passes
+ *  (GetDeadline, given to MixGaussians::m_dDeadline), since the cap
+ *  is only an estimate and there is none until the first timing.  A
+ *  frame in which some fit had to stop early counts as degraded.
+ *
+ *  The budget only covers the fits:  the segmenter starts the clock
+ *  (StartFrame) right before it sizes the first pass, once the blobs
+ *  have been found and the fits set up, and the image processing
+ *  before that isn't counted.
+ *
+ *  With no budget set (the default) the fits run as before, and the
+ *  result doesn't depend on timing.
+ *
+ */
+
+class MixGaussiansBudget
+{
+public:
+    MixGaussiansBudget();
+
+    /* Seconds per frame, <= 0 for no budget */
+    double m_dBudget;
+
+    bool IsActive() const {return m_dBudget > 0;};
+
+    // Starts the clock for a frame, right before FirstPassCap
+    void StartFrame();
+    // Absolute deadline (see MT_getTimeSec) of the current frame, -1
+    // if there is no budget
+    double GetDeadline() const;
+    // Seconds left until the deadline
+    double GetRemaining() const;
+
+    /* Iteration cap for the first pass over fits totalling work
+     * (sum of pixels x distributions) on numworkers threads.  Between
+     * 1 and max_iters, and max_iters with no budget or before there
+     * is a timing to go by. */
+    int FirstPassCap(double work, int numworkers, int max_iters) const;
+
+    // Learns the cost of an iteration from a fit that took seconds
+    // for iterations iterations of work pixels x distributions
+    void AddTiming(double work, int iterations, double seconds);
+
+    // Ends the frame, degraded if some fit had to stop early
+    void EndFrame(bool degraded);
+
+    int m_iNumFrames;
+    int m_iNumDegradedFrames;
+
+protected:
+    double m_dFrameStart;
+    // estimated seconds per pixel x distribution x iteration
+    double m_dCostPerUnit;
+};
+
+#endif // MIXGAUSSIANSBUDGET_H
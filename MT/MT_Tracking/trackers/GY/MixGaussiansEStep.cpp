@@ -0,0 +1,564 @@
+/*
+ *  MixGaussiansEStep.cpp
+ *  MADTraC
+ *
+ *  E-step for MixGaussians::EMMG, see MixGaussiansEStep.h
+ *
+ */
+
+#include "MixGaussiansEStep.h"
+
+#include <math.h>
+#include <string.h>
+#include <float.h>
+
+#if defined(__AVX2__)
+#define GY_ESTEP_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GY_ESTEP_SSE2
+#include <emmintrin.h>
+#endif
+
+/* number of pixels done at once */
+#if defined(GY_ESTEP_AVX2)
+#define GY_ESTEP_WIDTH 8
+#elif defined(GY_ESTEP_SSE2)
+#define GY_ESTEP_WIDTH 4
+#else
+#define GY_ESTEP_WIDTH 4
+#endif
+
+/* exp(x) is flushed to 0 below GY_EXP_LO and clamped at GY_EXP_HI,
+ * the range where the result is a normal float */
+#define GY_EXP_LO -87.33f
+#define GY_EXP_HI 88.37f
+
+/* log of the smallest double - densities below this are 0 in the
+ * double precision E-step */
+#define GY_DOUBLE_UNDERFLOW -744.4f
+
+/* Polynomial exp (Cephes expf):  exp(x) = 2^n exp(r) with
+ * n = round(x/ln 2) and |r| <= ln(2)/2, the ln 2 split in two parts
+ * so that r is exact.  The relative error is about 2e-7. */
+static const float gy_log2e = 1.44269504088896341f;
+static const float gy_ln2_hi = 0.693359375f;
+static const float gy_ln2_lo = -2.12194440e-4f;
+static const float gy_exp_p0 = 1.9875691500E-4f;
+static const float gy_exp_p1 = 1.3981999507E-3f;
+static const float gy_exp_p2 = 8.3334519073E-3f;
+static const float gy_exp_p3 = 4.1665795894E-2f;
+static const float gy_exp_p4 = 1.6666665459E-1f;
+static const float gy_exp_p5 = 5.0000001201E-1f;
+
+/* precomputed distribution:  the exponent is f = u^2 + v^2 with
+ * u = u_x*dx and v = v_x*dx + v_y*dy (i.e. (u, v) = L^-1 (dx, dy) for
+ * the Cholesky factor L of the covariance), and the log density is
+ * lognorm - 0.5*f.  Unlike the expanded quadratic form this does not
+ * lose precision to cancellation for elongated distributions. */
+typedef struct
+{
+    float mu_x;
+    float mu_y;
+    float u_x;
+    float v_x;
+    float v_y;
+    float lognorm;
+} GYEStepDist;
+
+static bool is_finite(double x)
+{
+    return !MT_isnan(x) && fabs(x) <= DBL_MAX;
+}
+
+template <class T>
+static void gy_estep_double(const T* xs,
+                            const T* ys,
+                            int numpixels,
+                            const std::vector<MT_Vector2>& means,
+                            const std::vector<MT_Matrix2x2>& covariances,
+                            double* pus,
+                            double* ps,
+                            double* pls,
+                            double* totaldensity)
+{
+    int numdists = means.size();
+    int i, j;
+    double mu_x, mu_y, s_xx, s_xy, s_yy, D, dx, dy;
+
+    // Calculate the probability density for each pixel in each distribution
+    for (i=0 ; i < numdists ; i++)
+    {
+        mu_x = means[i].data[0];
+        mu_y = means[i].data[1];
+        s_xx = covariances[i].data[0];
+        s_xy = covariances[i].data[1];
+        s_yy = covariances[i].data[3];
+        D = s_xx*s_yy - s_xy*s_xy;
+
+        double* pu = &pus[i*numpixels];
+        double* p = &ps[i*numpixels];
+        for (j=0 ; j < numpixels ; j++)
+        {
+            dx = (xs[j] - mu_x);
+            dy = (ys[j] - mu_y);
+            /* f is the bit in the exponent, this will be saved as
+               pu */
+            double f = (s_yy*dx*dx + s_xx*dy*dy - 2.0*s_xy*dx*dy)/D;
+            pu[j] = f;
+            /* the probability that this pixel comes from the ith
+               distribution */
+            p[j] = (0.5/(M_PI*sqrt(D)))*exp(-0.5*f);
+        }
+    }
+
+    // Determine the total probability density at each pixel
+    for (j=0 ; j < numpixels ; j++)
+    {
+        totaldensity[j] = 0;
+        for (i=0 ; i < numdists ; i++)
+        {
+            totaldensity[j] += ps[i*numpixels + j];
+        }
+
+        if (totaldensity[j] == 0)
+        {
+            totaldensity[j] = 1.0;
+        }
+    }
+
+    // Calculate the likelihood that each pixel belongs to each distribution
+    for (i=0 ; i < numdists ; i++)
+    {
+        for (j=0 ; j < numpixels ; j++)
+        {
+            pls[i*numpixels + j] = ps[i*numpixels + j]/totaldensity[j];
+        }
+    }
+}
+
+void GYEStepDouble(const GYPixelCoord* xs,
+                   const GYPixelCoord* ys,
+                   int numpixels,
+                   const std::vector<MT_Vector2>& means,
+                   const std::vector<MT_Matrix2x2>& covariances,
+                   double* pus,
+                   double* ps,
+                   double* pls,
+                   double* totaldensity)
+{
+    gy_estep_double(xs, ys, numpixels, means, covariances,
+                    pus, ps, pls, totaldensity);
+}
+
+void GYEStepDouble(const double* xs,
+                   const double* ys,
+                   int numpixels,
+                   const std::vector<MT_Vector2>& means,
+                   const std::vector<MT_Matrix2x2>& covariances,
+                   double* pus,
+                   double* ps,
+                   double* pls,
+                   double* totaldensity)
+{
+    gy_estep_double(xs, ys, numpixels, means, covariances,
+                    pus, ps, pls, totaldensity);
+}
+
+int GYEStepScratchSize(int numdists)
+{
+    /* exponent and log density for each distribution for one block of
+     * pixels, plus the distributions themselves */
+    return 2*numdists*GY_ESTEP_WIDTH
+        + numdists*((sizeof(GYEStepDist) + sizeof(float) - 1)/sizeof(float));
+}
+
+#if defined(GY_ESTEP_AVX2)
+
+typedef __m256 gy_vec;
+
+static inline gy_vec gy_set1(float a){return _mm256_set1_ps(a);}
+static inline gy_vec gy_add(gy_vec a, gy_vec b){return _mm256_add_ps(a, b);}
+static inline gy_vec gy_sub(gy_vec a, gy_vec b){return _mm256_sub_ps(a, b);}
+static inline gy_vec gy_mul(gy_vec a, gy_vec b){return _mm256_mul_ps(a, b);}
+static inline gy_vec gy_div(gy_vec a, gy_vec b){return _mm256_div_ps(a, b);}
+static inline gy_vec gy_max(gy_vec a, gy_vec b){return _mm256_max_ps(a, b);}
+static inline gy_vec gy_min(gy_vec a, gy_vec b){return _mm256_min_ps(a, b);}
+static inline gy_vec gy_load(const float* p){return _mm256_loadu_ps(p);}
+static inline void gy_store(float* p, gy_vec a){_mm256_storeu_ps(p, a);}
+/* a where x >= b, 0 elsewhere */
+static inline gy_vec gy_keep_ge(gy_vec a, gy_vec x, gy_vec b)
+{
+    return _mm256_and_ps(a, _mm256_cmp_ps(x, b, _CMP_GE_OQ));
+}
+
+/* 8 coordinates minus origin */
+static inline gy_vec gy_load_coords(const GYPixelCoord* p, int origin)
+{
+    __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*) p));
+    return _mm256_cvtepi32_ps(_mm256_sub_epi32(v, _mm256_set1_epi32(origin)));
+}
+
+static inline void gy_store_double(double* p, gy_vec a)
+{
+    _mm256_storeu_pd(p, _mm256_cvtps_pd(_mm256_castps256_ps128(a)));
+    _mm256_storeu_pd(p + 4, _mm256_cvtps_pd(_mm256_extractf128_ps(a, 1)));
+}
+
+static inline gy_vec gy_exp(gy_vec x)
+{
+    gy_vec lo = gy_set1(GY_EXP_LO);
+    gy_vec in = x;
+    x = gy_max(gy_min(x, gy_set1(GY_EXP_HI)), lo);
+
+    __m256i n = _mm256_cvtps_epi32(gy_mul(x, gy_set1(gy_log2e)));
+    gy_vec nf = _mm256_cvtepi32_ps(n);
+    gy_vec r = gy_sub(gy_sub(x, gy_mul(nf, gy_set1(gy_ln2_hi))),
+                      gy_mul(nf, gy_set1(gy_ln2_lo)));
+
+    gy_vec p = gy_set1(gy_exp_p0);
+    p = gy_add(gy_mul(p, r), gy_set1(gy_exp_p1));
+    p = gy_add(gy_mul(p, r), gy_set1(gy_exp_p2));
+    p = gy_add(gy_mul(p, r), gy_set1(gy_exp_p3));
+    p = gy_add(gy_mul(p, r), gy_set1(gy_exp_p4));
+    p = gy_add(gy_mul(p, r), gy_set1(gy_exp_p5));
+    p = gy_add(gy_add(gy_mul(gy_mul(p, r), r), r), gy_set1(1.0f));
+
+    __m256i e = _mm256_slli_epi32(_mm256_add_epi32(n, _mm256_set1_epi32(127)), 23);
+    return gy_keep_ge(gy_mul(p, _mm256_castsi256_ps(e)), in, lo);
+}
+
+#elif defined(GY_ESTEP_SSE2)
+
+typedef __m128 gy_vec;
+
+static inline gy_vec gy_set1(float a){return _mm_set1_ps(a);}
+static inline gy_vec gy_add(gy_vec a, gy_vec b){return _mm_add_ps(a, b);}
+static inline gy_vec gy_sub(gy_vec a, gy_vec b){return _mm_sub_ps(a, b);}
+static inline gy_vec gy_mul(gy_vec a, gy_vec b){return _mm_mul_ps(a, b);}
+static inline gy_vec gy_div(gy_vec a, gy_vec b){return _mm_div_ps(a, b);}
+static inline gy_vec gy_max(gy_vec a, gy_vec b){return _mm_max_ps(a, b);}
+static inline gy_vec gy_min(gy_vec a, gy_vec b){return _mm_min_ps(a, b);}
+static inline gy_vec gy_load(const float* p){return _mm_loadu_ps(p);}
+static inline void gy_store(float* p, gy_vec a){_mm_storeu_ps(p, a);}
+/* a where x >= b, 0 elsewhere */
+static inline gy_vec gy_keep_ge(gy_vec a, gy_vec x, gy_vec b)
+{
+    return _mm_and_ps(a, _mm_cmpge_ps(x, b));
+}
+
+/* 4 coordinates minus origin */
+static inline gy_vec gy_load_coords(const GYPixelCoord* p, int origin)
+{
+    __m128i v = _mm_loadl_epi64((const __m128i*) p);
+    /* sign-extend the 4 low 16 bit values to 32 bits */
+    v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+    return _mm_cvtepi32_ps(_mm_sub_epi32(v, _mm_set1_epi32(origin)));
+}
+
+static inline void gy_store_double(double* p, gy_vec a)
+{
+    _mm_storeu_pd(p, _mm_cvtps_pd(a));
+    _mm_storeu_pd(p + 2, _mm_cvtps_pd(_mm_movehl_ps(a, a)));
+}
+
+static inline gy_vec gy_exp(gy_vec x)
+{
+    gy_vec lo = gy_set1(GY_EXP_LO);
+    gy_vec in = x;
+    x = gy_max(gy_min(x, gy_set1(GY_EXP_HI)), lo);
+
+    __m128i n = _mm_cvtps_epi32(gy_mul(x, gy_set1(gy_log2e)));
+    gy_vec nf = _mm_cvtepi32_ps(n);
+    gy_vec r = gy_sub(gy_sub(x, gy_mul(nf, gy_set1(gy_ln2_hi))),
+                      gy_mul(nf, gy_set1(gy_ln2_lo)));
+
+    gy_vec p = gy_set1(gy_exp_p0);
+    p = gy_add(gy_mul(p, r), gy_set1(gy_exp_p1));
+    p = gy_add(gy_mul(p, r), gy_set1(gy_exp_p2));
+    p = gy_add(gy_mul(p, r), gy_set1(gy_exp_p3));
+    p = gy_add(gy_mul(p, r), gy_set1(gy_exp_p4));
+    p = gy_add(gy_mul(p, r), gy_set1(gy_exp_p5));
+    p = gy_add(gy_add(gy_mul(gy_mul(p, r), r), r), gy_set1(1.0f));
+
+    __m128i e = _mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23);
+    return gy_keep_ge(gy_mul(p, _mm_castsi128_ps(e)), in, lo);
+}
+
+#else
+
+/* plain C++ version of the above, one "vector" is GY_ESTEP_WIDTH
+ * floats */
+typedef struct
+{
+    float v[GY_ESTEP_WIDTH];
+} gy_vec;
+
+#define GY_VEC_OP(name, expr)                                   \
+    static inline gy_vec name(gy_vec a, gy_vec b)               \
+    {                                                           \
+        gy_vec r;                                               \
+        for(int k = 0; k < GY_ESTEP_WIDTH; k++)                 \
+        {                                                       \
+            r.v[k] = (expr);                                    \
+        }                                                       \
+        return r;                                               \
+    }
+
+GY_VEC_OP(gy_add, a.v[k] + b.v[k])
+GY_VEC_OP(gy_sub, a.v[k] - b.v[k])
+GY_VEC_OP(gy_mul, a.v[k]*b.v[k])
+GY_VEC_OP(gy_div, a.v[k]/b.v[k])
+GY_VEC_OP(gy_max, (a.v[k] > b.v[k]) ? a.v[k] : b.v[k])
+GY_VEC_OP(gy_min, (a.v[k] < b.v[k]) ? a.v[k] : b.v[k])
+
+static inline gy_vec gy_set1(float a)
+{
+    gy_vec r;
+    for(int k = 0; k < GY_ESTEP_WIDTH; k++)
+    {
+        r.v[k] = a;
+    }
+    return r;
+}
+
+static inline gy_vec gy_load(const float* p)
+{
+    gy_vec r;
+    memcpy(r.v, p, sizeof(r.v));
+    return r;
+}
+
+static inline void gy_store(float* p, gy_vec a)
+{
+    memcpy(p, a.v, sizeof(a.v));
+}
+
+static inline gy_vec gy_keep_ge(gy_vec a, gy_vec x, gy_vec b)
+{
+    for(int k = 0; k < GY_ESTEP_WIDTH; k++)
+    {
+        if(!(x.v[k] >= b.v[k]))
+        {
+            a.v[k] = 0;
+        }
+    }
+    return a;
+}
+
+static inline gy_vec gy_load_coords(const GYPixelCoord* p, int origin)
+{
+    gy_vec r;
+    for(int k = 0; k < GY_ESTEP_WIDTH; k++)
+    {
+        r.v[k] = (float) (((int) p[k]) - origin);
+    }
+    return r;
+}
+
+static inline void gy_store_double(double* p, gy_vec a)
+{
+    for(int k = 0; k < GY_ESTEP_WIDTH; k++)
+    {
+        p[k] = a.v[k];
+    }
+}
+
+static inline gy_vec gy_exp(gy_vec x)
+{
+    gy_vec r;
+    for(int k = 0; k < GY_ESTEP_WIDTH; k++)
+    {
+        float xk = x.v[k];
+        if(!(xk >= GY_EXP_LO))
+        {
+            r.v[k] = 0;
+            continue;
+        }
+        xk = (xk > GY_EXP_HI) ? GY_EXP_HI : xk;
+
+        int n = (int) floorf(xk*gy_log2e + 0.5f);
+        float nf = (float) n;
+        float rk = (xk - nf*gy_ln2_hi) - nf*gy_ln2_lo;
+
+        float p = gy_exp_p0;
+        p = p*rk + gy_exp_p1;
+        p = p*rk + gy_exp_p2;
+        p = p*rk + gy_exp_p3;
+        p = p*rk + gy_exp_p4;
+        p = p*rk + gy_exp_p5;
+        p = ((p*rk)*rk + rk) + 1.0f;
+
+        int e = (n + 127) << 23;
+        float two_n;
+        memcpy(&two_n, &e, sizeof(float));
+        r.v[k] = p*two_n;
+    }
+    return r;
+}
+
+#endif
+
+/* E-step for GY_ESTEP_WIDTH pixels starting at xs, ys.  Writes count
+ * (<= GY_ESTEP_WIDTH) values per distribution at offset j of the
+ * outputs. */
+static inline void gy_estep_block(const GYPixelCoord* xs,
+                                  const GYPixelCoord* ys,
+                                  int origin_x,
+                                  int origin_y,
+                                  int j,
+                                  int count,
+                                  int numpixels,
+                                  const GYEStepDist* dists,
+                                  int numdists,
+                                  double* pus,
+                                  double* ps,
+                                  double* pls,
+                                  float* f_buf,
+                                  float* l_buf)
+{
+    const int W = GY_ESTEP_WIDTH;
+    gy_vec x = gy_load_coords(xs, origin_x);
+    gy_vec y = gy_load_coords(ys, origin_y);
+    gy_vec half = gy_set1(0.5f);
+
+    /* exponent and log density for each distribution, and the largest
+     * log density */
+    gy_vec lmax = gy_set1(-FLT_MAX);
+    for(int i = 0; i < numdists; i++)
+    {
+        const GYEStepDist& d = dists[i];
+        gy_vec dx = gy_sub(x, gy_set1(d.mu_x));
+        gy_vec dy = gy_sub(y, gy_set1(d.mu_y));
+        gy_vec u = gy_mul(gy_set1(d.u_x), dx);
+        gy_vec v = gy_add(gy_mul(gy_set1(d.v_x), dx), gy_mul(gy_set1(d.v_y), dy));
+        gy_vec f = gy_add(gy_mul(u, u), gy_mul(v, v));
+        gy_vec l = gy_sub(gy_set1(d.lognorm), gy_mul(half, f));
+        gy_store(&f_buf[i*W], f);
+        gy_store(&l_buf[i*W], l);
+        lmax = gy_max(lmax, l);
+    }
+
+    /* densities relative to the largest one (so the sum is at least
+     * 1), and the largest density itself */
+    gy_vec sum = gy_set1(0.0f);
+    for(int i = 0; i < numdists; i++)
+    {
+        gy_vec e = gy_exp(gy_sub(gy_load(&l_buf[i*W]), lmax));
+        gy_store(&l_buf[i*W], e);
+        sum = gy_add(sum, e);
+    }
+    gy_vec pmax = gy_exp(lmax);
+    /* 1/sum, or 0 where the double version would underflow */
+    gy_vec inv = gy_keep_ge(gy_div(gy_set1(1.0f), sum),
+                            lmax, gy_set1(GY_DOUBLE_UNDERFLOW));
+
+    double tmp[3][GY_ESTEP_WIDTH];
+    for(int i = 0; i < numdists; i++)
+    {
+        gy_vec e = gy_load(&l_buf[i*W]);
+        gy_vec f = gy_load(&f_buf[i*W]);
+        int o = i*numpixels + j;
+        if(count == W)
+        {
+            gy_store_double(&pus[o], f);
+            gy_store_double(&ps[o], gy_mul(e, pmax));
+            gy_store_double(&pls[o], gy_mul(e, inv));
+        }
+        else
+        {
+            gy_store_double(tmp[0], f);
+            gy_store_double(tmp[1], gy_mul(e, pmax));
+            gy_store_double(tmp[2], gy_mul(e, inv));
+            memcpy(&pus[o], tmp[0], count*sizeof(double));
+            memcpy(&ps[o], tmp[1], count*sizeof(double));
+            memcpy(&pls[o], tmp[2], count*sizeof(double));
+        }
+    }
+}
+
+bool GYEStepFloat(const GYPixelCoord* xs,
+                  const GYPixelCoord* ys,
+                  int numpixels,
+                  const std::vector<MT_Vector2>& means,
+                  const std::vector<MT_Matrix2x2>& covariances,
+                  double* pus,
+                  double* ps,
+                  double* pls,
+                  float* scratch)
+{
+    const int W = GY_ESTEP_WIDTH;
+    int numdists = means.size();
+
+    float* f_buf = scratch;
+    float* l_buf = scratch + numdists*W;
+    GYEStepDist* dists = (GYEStepDist*) (scratch + 2*numdists*W);
+
+    /* Everything is done relative to an integer origin near the
+     * distributions so that the floats hold small offsets rather than
+     * absolute positions. */
+    int origin_x = 0;
+    int origin_y = 0;
+    if(numdists > 0 && is_finite(means[0].data[0]) && is_finite(means[0].data[1])
+       && fabs(means[0].data[0]) < 32768.0 && fabs(means[0].data[1]) < 32768.0)
+    {
+        origin_x = (int) floor(means[0].data[0]);
+        origin_y = (int) floor(means[0].data[1]);
+    }
+
+    for(int i = 0; i < numdists; i++)
+    {
+        double mu_x = means[i].data[0];
+        double mu_y = means[i].data[1];
+        double s_xx = covariances[i].data[0];
+        double s_xy = covariances[i].data[1];
+        double s_yy = covariances[i].data[3];
+        double D = s_xx*s_yy - s_xy*s_xy;
+        if(!is_finite(mu_x) || !is_finite(mu_y) || !is_finite(s_xx)
+           || !is_finite(s_xy) || !is_finite(s_yy) || !is_finite(D)
+           || s_xx <= 0 || D <= 0 || fabs(mu_x) > 32768.0 || fabs(mu_y) > 32768.0)
+        {
+            return false;
+        }
+        dists[i].mu_x = (float) (mu_x - origin_x);
+        dists[i].mu_y = (float) (mu_y - origin_y);
+        dists[i].u_x = (float) (1.0/sqrt(s_xx));
+        dists[i].v_x = (float) (-s_xy/(sqrt(s_xx)*sqrt(D)));
+        dists[i].v_y = (float) sqrt(s_xx/D);
+        dists[i].lognorm = (float) log(0.5/(M_PI*sqrt(D)));
+    }
+
+    int j = 0;
+    for(; j + W <= numpixels; j += W)
+    {
+        gy_estep_block(&xs[j], &ys[j], origin_x, origin_y, j, W,
+                       numpixels, dists, numdists,
+                       pus, ps, pls, f_buf, l_buf);
+    }
+    if(j < numpixels)
+    {
+        /* pad the last few pixels out to a full block */
+        GYPixelCoord tx[GY_ESTEP_WIDTH];
+        GYPixelCoord ty[GY_ESTEP_WIDTH];
+        memset(tx, 0, sizeof(tx));
+        memset(ty, 0, sizeof(ty));
+        memcpy(tx, &xs[j], (numpixels - j)*sizeof(GYPixelCoord));
+        memcpy(ty, &ys[j], (numpixels - j)*sizeof(GYPixelCoord));
+        gy_estep_block(tx, ty, origin_x, origin_y, j, numpixels - j,
+                       numpixels, dists, numdists,
+                       pus, ps, pls, f_buf, l_buf);
+    }
+
+    return true;
+}
+
+const char* GYEStepBackend()
+{
+#if defined(GY_ESTEP_AVX2)
+    return "AVX2";
+#elif defined(GY_ESTEP_SSE2)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,88 @@
+#ifndef MIXGAUSSIANSESTEP_H
+#define MIXGAUSSIANSESTEP_H
+
+/*
+ *  MixGaussiansEStep.h
+ *  MADTraC
+ *
+ *  E-step for MixGaussians::EMMG:  evaluates the Gaussian densities
+ *  and the per-pixel responsibilities for all distributions over the
+ *  SoA pixel coordinates of a raw blob.
+ *
+ *  GYEStepDouble is the original double precision computation.
+ *  GYEStepFloat does the same in single precision, 4 (SSE2) or 8
+ *  (AVX2) pixels at a time with a polynomial exp.  The instruction
+ *  set is chosen at compile time (see WITH_AVX2 in the root
+ *  CMakeLists.txt); without either the same algorithm runs in plain
+ *  C++.
+ *
+ *  Accuracy of GYEStepFloat compared to GYEStepDouble, for pixel
+ *  coordinates and means below 4096 and standard deviations of at
+ *  least half a pixel:
+ *    - responsibilities (pls) agree to within 5e-5 absolute
+ *    - exponents (pus) agree to within 1e-5 relative (or 1e-5
+ *      absolute when smaller than 1)
+ *    - densities (ps) agree to within 1e-4 relative, except that
+ *      densities below 1e-30 may come out as 0
+ *  The responsibility bound does not hold for pixels so far from every
+ *  distribution (about 37 standard deviations) that the double
+ *  densities are denormal.  Pixels whose densities underflow to 0 in
+ *  double precision for every distribution get responsibility 0 in
+ *  both.  test_EStep checks these bounds.
+ *
+ */
+
+#include "GYBlobs.h"
+
+#include "MT/MT_Core/primitives/Matrix.h"
+
+#include <vector>
+
+/* Outputs are stored distribution-major, i.e. the element for
+ * distribution i and pixel j is at [i*numpixels + j]:
+ *   pus - exponent f = (x - mu)' S^-1 (x - mu)
+ *   ps  - density
+ *   pls - responsibility, ps normalised over the distributions
+ * totaldensity needs numpixels elements. */
+void GYEStepDouble(const GYPixelCoord* xs,
+                   const GYPixelCoord* ys,
+                   int numpixels,
+                   const std::vector<MT_Vector2>& means,
+                   const std::vector<MT_Matrix2x2>& covariances,
+                   double* pus,
+                   double* ps,
+                   double* pls,
+                   double* totaldensity);
+
+/* Same for points that aren't on the pixel grid (e.g. the cell
+ * centroids of a binned blob) */
+void GYEStepDouble(const double* xs,
+                   const double* ys,
+                   int numpixels,
+                   const std::vector<MT_Vector2>& means,
+                   const std::vector<MT_Matrix2x2>& covariances,
+                   double* pus,
+                   double* ps,
+                   double* pls,
+                   double* totaldensity);
+
+/* Number of floats of scratch space GYEStepFloat needs */
+int GYEStepScratchSize(int numdists);
+
+/* Single precision version of the above, same outputs.  Returns false
+ * without doing anything if a covariance is not positive definite or
+ * not finite - use GYEStepDouble in that case. */
+bool GYEStepFloat(const GYPixelCoord* xs,
+                  const GYPixelCoord* ys,
+                  int numpixels,
+                  const std::vector<MT_Vector2>& means,
+                  const std::vector<MT_Matrix2x2>& covariances,
+                  double* pus,
+                  double* ps,
+                  double* pls,
+                  float* scratch);
+
+/* "AVX2", "SSE2" or "scalar" */
+const char* GYEStepBackend();
+
+#endif  // MIXGAUSSIANSESTEP_H
@@ -1,5 +1,7 @@
 #include "YASegmenter.h"
+#ifndef MT_NO_GL
 #include "MT/MT_Core/gl/glSupport.h"  // for blob drawing
+#endif
 
 #include <algorithm>  // for sort and unique
 
@@ -95,6 +97,7 @@ void Segmenter::Init(IplImage* ProtoFrame)
     ROI_frame = 0;
       
     frame_counter = 0;
+    t_previous = MT_getTimeSec();
     NFound = 0;
   
     if(ProtoFrame)
@@ -318,8 +321,6 @@ void Segmenter::doTracking(IplImage* frame)
 {
     //printf("thresh low %d\n area low %d\n bool %d\n double %f\n", blob_val_thresh_low, blob_area_thresh_low, test_bool, test_double);
   
-    static double t_previous = MT_getTimeSec();
-  
     double dt;
     double t_now = MT_getTimeSec();
   
@@ -372,6 +373,7 @@ void Segmenter::doTracking(IplImage* frame)
 
 void Segmenter::glDraw(bool DrawBlobs)
 {
+#ifndef MT_NO_GL  /* headless build - nothing to draw with */
   
     MT_R3 blobcenter;
 	MT_InitGLLists();
@@ -410,6 +412,7 @@ void Segmenter::glDraw(bool DrawBlobs)
         }
     }
   
+#endif  // MT_NO_GL
 }
 
 void Segmenter::doGLDrawing(int flags)
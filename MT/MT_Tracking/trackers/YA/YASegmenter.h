@@ -124,6 +124,7 @@ protected:
     CBlobResult blobs;
         
     int frame_counter;
+    double t_previous;
     
     //BlobFile* m_pBlobFile;
     
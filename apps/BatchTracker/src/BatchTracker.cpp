@@ -0,0 +1,725 @@
+/*
+ *  BatchTracker.cpp
+ *  MADTraC
+ *
+ *  Tracks videos from the command line, as fast as the machine
+ *  allows, and writes the results to XDFs.  Nothing is displayed, so
+ *  this only needs MT_Core and MT_Tracking (built with BUILD_GUI off)
+ *  and can run e.g. on a cluster node without a display.
+ *
+ *  Given one video, the tracker runs in an MT_TrackerPipeline, so
+ *  capture, preprocessing, tracking and writing of consecutive frames
+ *  overlap.  The time spent in each of these is printed at the end.
+ *
+ *  The thread budget (-j) covers every thread:  a pipeline uses one
+ *  per step plus the one that captures, and whatever is left over goes
+ *  to the tracker's EM (GY), whose first thread is the tracking step's
+ *  own.  Without enough threads for a pipeline, the frames are tracked
+ *  one after the other and EM gets all of the threads.
+ *
+ *  Given a manifest (-m), each line is a job with its own video,
+ *  background, ROI, parameters and output.  The jobs share one budget
+ *  of threads (-j):  as many jobs as there are threads run at once,
+ *  each on its own worker of an MT_WorkerPool, and the longest videos
+ *  are started first so that the workers finish at about the same
+ *  time.  Only when there are fewer jobs than threads does a job get
+ *  more than one thread, which it splits between a pipeline and EM as
+ *  above.  A job that fails is reported and skipped; the rest of the
+ *  batch carries on.
+ *
+ *  Given one video and a number of chunks (-k), the video is cut into
+ *  that many overlapping chunks of frames, tracked at the same time by
+ *  an MT_ChunkedTracker, and stitched back together into one XDF.
+ *  This needs a tracker that hands its results over for output
+ *  (GY).
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "MT/MT_Core/fileio/XMLSupport.h"
+#include "MT/MT_Core/support/mathsupport.h"
+#include "MT/MT_Core/support/WorkerPool.h"
+
+#include "MT/MT_Tracking/capture/MT_Capture.h"
+#include "MT/MT_Tracking/base/MT_TrackerPipeline.h"
+#include "MT/MT_Tracking/base/MT_ChunkedTracker.h"
+#include "MT/MT_Tracking/trackers/GY/GYSegmenter.h"
+#include "MT/MT_Tracking/trackers/YA/YASegmenter.h"
+
+static void usage(const char* exe)
+{
+    printf("BatchTracker - track videos without a GUI.\n\n"
+           "Usage:  %s [options] <tracker> <video>\n"
+           "        %s [options] -m <manifest> <tracker>\n\n"
+           "  tracker     GY (GYSegmenter) or YA (Segmenter)\n"
+           "  video       input video file\n\n"
+           "Options:\n"
+           "  -o file     output XDF.  Default is no output.\n"
+           "  -b file     background image\n"
+           "  -r file     ROI (mask) image\n"
+           "  -p file     XML file with tracker parameters, e.g. the\n"
+           "              settings file saved by a tracking app\n"
+           "  -N n        number of objects (GY only)\n"
+           "  -n n        track at most n frames (of each video)\n"
+           "  -q n        frames queued in front of each step.  Default 2.\n"
+           "  -m file     track every job in the manifest file\n"
+           "  -j n        threads to use in all.  Default is one per core.\n"
+           "  -k n        track the video in n chunks at once (GY only)\n"
+           "  -w n        frames of overlap between chunks.  Default 50.\n"
+           "  -h          show this message\n\n"
+           "Each line of the manifest is one job:\n\n"
+           "  video [background [roi [params [output]]]]\n\n"
+           "Columns are separated by tabs, or by spaces if the line has\n"
+           "no tabs.  Use - to leave a column out.  -b, -r and -p give\n"
+           "the defaults for jobs that leave them out.  Lines starting\n"
+           "with # are ignored.\n",
+           exe, exe);
+}
+
+/* one video to track, and how it went */
+struct BatchJob
+{
+    std::string video;
+    std::string background;
+    std::string roi;
+    std::string params;
+    std::string output;
+
+    /* from the capture before starting, to order the jobs */
+    int n_frames_expected;
+
+    int n_frames;
+    double time;
+    /* indexed by MT_TP_STEP, only filled in by the pipeline */
+    double step_time[MT_TP_NUM_STEPS + 1];
+
+    bool failed;
+    std::string error;
+};
+
+/* what every job is tracked with */
+struct BatchSettings
+{
+    const char* tracker_name;
+    int n_objects;
+    int max_frames;
+    int queue_size;
+    /* threads the tracker may split EM over, <= 0 to leave it be */
+    int em_threads;
+};
+
+static void initJob(BatchJob* job)
+{
+    job->n_frames_expected = 0;
+    job->n_frames = 0;
+    job->time = 0;
+    for(int i = 0; i <= MT_TP_NUM_STEPS; i++)
+    {
+        job->step_time[i] = 0;
+    }
+    job->failed = false;
+}
+
+static void failJob(BatchJob* job, const std::string& err)
+{
+    job->failed = true;
+    job->error = err;
+}
+
+static bool readParams(MT_TrackerBase* tracker, const char* param_file)
+{
+    MT_XMLFile xml(param_file);
+    if(!xml.ReadFile())
+    {
+        return false;
+    }
+    for(unsigned int i = 0; i < tracker->getNumDataGroups(); i++)
+    {
+        ReadDataGroupFromXML(xml, tracker->getDataGroup(i));
+    }
+    return true;
+}
+
+/* Makes a tracker for job, sized for proto_frame, with its
+ * parameters, ROI and background but no data file.  Returns NULL and
+ * says why in err on failure. */
+static MT_TrackerBase* createJobTracker(const BatchJob& job,
+                                        const BatchSettings& settings,
+                                        IplImage* proto_frame,
+                                        std::string* err)
+{
+    MT_TrackerBase* tracker = NULL;
+    GYSegmenter* gy = NULL;
+    if(!strcmp(settings.tracker_name, "GY"))
+    {
+        gy = new GYSegmenter(proto_frame);
+        if(settings.n_objects > 0)
+        {
+            gy->setNumObjects(settings.n_objects);
+        }
+        tracker = gy;
+    }
+    else
+    {
+        tracker = new Segmenter(proto_frame);
+    }
+    tracker->setSourceName(job.video.c_str());
+
+    bool ok = true;
+    if(!job.params.empty() && !readParams(tracker, job.params.c_str()))
+    {
+        *err = "Could not read parameters from " + job.params;
+        ok = false;
+    }
+    else if(!job.roi.empty() && !tracker->setROIImage(job.roi.c_str(), err))
+    {
+        ok = false;
+    }
+    else if(!job.background.empty()
+            && !tracker->setBackgroundImage(job.background.c_str(), err))
+    {
+        ok = false;
+    }
+    if(!ok)
+    {
+        delete tracker;
+        return NULL;
+    }
+
+    /* after the parameters, so that a parameter file can ask for
+     * fewer EM threads but not for more than the job has */
+    if(gy && settings.em_threads > 0)
+    {
+        int n = gy->getEMThreads();
+        gy->setEMThreads((n > 0 && n < settings.em_threads) ? n : settings.em_threads);
+    }
+    return tracker;
+}
+
+/* Splits n_threads threads between a pipeline and EM (see the top
+ * of the file).  Returns whether to use the pipeline. */
+static bool splitThreads(int n_threads, int* em_threads)
+{
+    if(n_threads > MT_TP_NUM_STEPS)
+    {
+        *em_threads = n_threads - MT_TP_NUM_STEPS;
+        return true;
+    }
+    *em_threads = MT_MAX(1, n_threads);
+    return false;
+}
+
+/* Tracks one job start to finish on the calling thread, in a pipeline
+ * if use_pipeline is true.  Any failure goes into the job. */
+static void runJob(BatchJob* job, const BatchSettings& settings, bool use_pipeline)
+{
+    const char* video_file = job->video.c_str();
+
+    MT_Capture capture;
+    if(!capture.initCaptureFromFile(video_file))
+    {
+        failJob(job, "Failed to initialize capture from file " + job->video);
+        return;
+    }
+
+    /* the first frame sizes the tracker, and gets tracked as well */
+    IplImage* proto_frame = capture.getFrame();
+    if(!proto_frame)
+    {
+        failJob(job, "Could not acquire frame from file " + job->video);
+        return;
+    }
+
+    std::string err;
+    MT_TrackerBase* tracker = createJobTracker(*job, settings, proto_frame, &err);
+    if(!tracker)
+    {
+        failJob(job, err);
+        return;
+    }
+    if(!job->output.empty() && !tracker->setDataFile(job->output.c_str(), &err))
+    {
+        failJob(job, err);
+        delete tracker;
+        return;
+    }
+
+    int max_frames = settings.max_frames;
+    double t0 = MT_getTimeSec();
+    if(use_pipeline)
+    {
+        MT_TrackerPipeline pipeline(tracker, settings.queue_size);
+
+        if(pipeline.pushFrame(proto_frame))
+        {
+            job->n_frames = 1;
+            if(max_frames <= 0 || max_frames > 1)
+            {
+                job->n_frames += pipeline.run(&capture, max_frames > 0 ? max_frames - 1 : -1);
+            }
+        }
+        pipeline.flush();
+        for(int i = 0; i <= MT_TP_NUM_STEPS; i++)
+        {
+            job->step_time[i] = pipeline.getStepTime(i);
+        }
+    }
+    else
+    {
+        /* same frames as MT_TrackerPipeline::run, one after the other */
+        int n_frames = capture.getNFrames();
+        IplImage* frame = proto_frame;
+        while(frame)
+        {
+            tracker->doTracking(frame);
+            job->n_frames++;
+            if((max_frames > 0 && job->n_frames >= max_frames)
+               || capture.getIsAtEnd()
+               || (n_frames > 0 && capture.getFrameNumber() >= n_frames - 1))
+            {
+                break;
+            }
+            frame = capture.getFrame();
+        }
+    }
+    job->time = MT_getTimeSec() - t0;
+
+    /* the tracker writes out the rest of the data file when it goes */
+    delete tracker;
+
+    if(job->n_frames == 0)
+    {
+        failJob(job, "No frames tracked from " + job->video);
+    }
+}
+
+/* Tracks one job in chunks */
+class BatchChunkedTracker : public MT_ChunkedTracker
+{
+private:
+    const BatchJob& m_Job;
+    const BatchSettings& m_Settings;
+
+public:
+    BatchChunkedTracker(const BatchJob& job,
+                        const BatchSettings& settings,
+                        int n_chunks,
+                        int overlap,
+                        int n_threads)
+        : MT_ChunkedTracker(job.video.c_str(), n_chunks, overlap, n_threads),
+          m_Job(job),
+          m_Settings(settings) {};
+
+    MT_TrackerBase* createTracker(IplImage* proto_frame, std::string* error)
+    {
+        return createJobTracker(m_Job, m_Settings, proto_frame, error);
+    };
+};
+
+/* Runs the jobs of a batch on the workers of an MT_WorkerPool, in the
+ * order given by m_viOrder. */
+class BatchFarm : public MT_WorkerJob
+{
+private:
+    std::vector<BatchJob>* m_pJobs;
+    std::vector<int> m_viOrder;
+    const BatchSettings& m_Settings;
+    bool m_bUsePipeline;
+
+public:
+    BatchFarm(std::vector<BatchJob>* jobs,
+              const std::vector<int>& order,
+              const BatchSettings& settings,
+              bool use_pipeline)
+        : m_pJobs(jobs),
+          m_viOrder(order),
+          m_Settings(settings),
+          m_bUsePipeline(use_pipeline) {};
+
+    void doJob(int index, int worker)
+    {
+        BatchJob* job = &(*m_pJobs)[m_viOrder[index]];
+        runJob(job, m_Settings, m_bUsePipeline);
+
+        /* one printf per job so that the lines don't get mixed up */
+        if(job->failed)
+        {
+            printf("  FAILED %s:  %s\n", job->video.c_str(), job->error.c_str());
+        }
+        else
+        {
+            printf("  %s:  %d frames in %.3f s (%.1f frames/s)\n",
+                   job->video.c_str(), job->n_frames, job->time,
+                   job->time > 0 ? job->n_frames/job->time : 0.0);
+        }
+        fflush(stdout);
+    };
+};
+
+/* longest jobs first */
+class BatchJobOrder
+{
+private:
+    const std::vector<BatchJob>& m_Jobs;
+public:
+    BatchJobOrder(const std::vector<BatchJob>& jobs) : m_Jobs(jobs) {};
+    bool operator()(int a, int b) const
+    {
+        return m_Jobs[a].n_frames_expected > m_Jobs[b].n_frames_expected;
+    };
+};
+
+/* Splits line into columns (see usage) */
+static std::vector<std::string> splitManifestLine(const std::string& line)
+{
+    const char* seps = (line.find('\t') != std::string::npos) ? "\t" : " \t";
+    std::vector<std::string> cols;
+    std::string::size_type start = 0;
+    while(start < line.size())
+    {
+        std::string::size_type end = line.find_first_of(seps, start);
+        if(end == std::string::npos)
+        {
+            end = line.size();
+        }
+        if(end > start)
+        {
+            cols.push_back(line.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    return cols;
+}
+
+/* Reads the jobs from manifest_file.  Columns a line leaves out get
+ * the defaults from job_defaults. */
+static bool readManifest(const char* manifest_file,
+                         const BatchJob& job_defaults,
+                         std::vector<BatchJob>* jobs)
+{
+    FILE* f = fopen(manifest_file, "r");
+    if(!f)
+    {
+        fprintf(stderr, "BatchTracker Error:  Could not open manifest %s\n",
+                manifest_file);
+        return false;
+    }
+
+    char buf[4096];
+    std::string line;
+    while(fgets(buf, sizeof(buf), f))
+    {
+        line += buf;
+        if(line.empty() || line[line.size() - 1] != '\n')
+        {
+            /* line longer than buf, or the last one */
+            if(!feof(f))
+            {
+                continue;
+            }
+        }
+        while(!line.empty()
+              && (line[line.size() - 1] == '\n' || line[line.size() - 1] == '\r'))
+        {
+            line.erase(line.size() - 1);
+        }
+
+        std::vector<std::string> cols = splitManifestLine(line);
+        line.clear();
+        if(cols.empty() || cols[0][0] == '#')
+        {
+            continue;
+        }
+
+        BatchJob job = job_defaults;
+        std::string* fields[] = {&job.video, &job.background, &job.roi,
+                                 &job.params, &job.output};
+        for(unsigned int i = 0; i < cols.size() && i < 5; i++)
+        {
+            if(cols[i] != "-")
+            {
+                *fields[i] = cols[i];
+            }
+        }
+        if(job.video.empty())
+        {
+            fprintf(stderr, "BatchTracker Warning:  Job with no video in %s\n",
+                    manifest_file);
+            continue;
+        }
+        jobs->push_back(job);
+    }
+
+    fclose(f);
+    return true;
+}
+
+static void printStep(const char* name, double t, int n_frames, double t_total)
+{
+    printf("  %-12s %10.3f s  %8.3f ms/frame  %5.1f%% busy\n",
+           name,
+           t,
+           n_frames ? 1000.0*t/n_frames : 0.0,
+           t_total > 0 ? 100.0*t/t_total : 0.0);
+}
+
+int main(int argc, char** argv)
+{
+    const char* tracker_name = NULL;
+    const char* video_file = NULL;
+    const char* output_file = NULL;
+    const char* background_file = NULL;
+    const char* roi_file = NULL;
+    const char* param_file = NULL;
+    const char* manifest_file = NULL;
+    int n_objects = 0;
+    int max_frames = -1;
+    int queue_size = 2;
+    int n_threads = 0;
+    int n_chunks = 0;
+    int overlap = 50;
+
+    for(int i = 1; i < argc; i++)
+    {
+        const char* a = argv[i];
+        if(a[0] == '-' && a[1] && !a[2])
+        {
+            if(a[1] == 'h')
+            {
+                usage(argv[0]);
+                return 0;
+            }
+            if(i + 1 >= argc)
+            {
+                fprintf(stderr, "BatchTracker Error:  Option %s needs a value\n", a);
+                return 1;
+            }
+            const char* v = argv[++i];
+            switch(a[1])
+            {
+            case 'o': output_file = v; break;
+            case 'b': background_file = v; break;
+            case 'r': roi_file = v; break;
+            case 'p': param_file = v; break;
+            case 'm': manifest_file = v; break;
+            case 'N': n_objects = atoi(v); break;
+            case 'n': max_frames = atoi(v); break;
+            case 'q': queue_size = atoi(v); break;
+            case 'j': n_threads = atoi(v); break;
+            case 'k': n_chunks = atoi(v); break;
+            case 'w': overlap = atoi(v); break;
+            default:
+                fprintf(stderr, "BatchTracker Error:  Unknown option %s\n", a);
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        else if(!tracker_name)
+        {
+            tracker_name = a;
+        }
+        else if(!video_file && !manifest_file)
+        {
+            video_file = a;
+        }
+        else
+        {
+            fprintf(stderr, "BatchTracker Error:  Unexpected argument %s\n", a);
+            return 1;
+        }
+    }
+
+    if(!tracker_name || (!video_file && !manifest_file))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    if(strcmp(tracker_name, "GY") && strcmp(tracker_name, "YA"))
+    {
+        fprintf(stderr, "BatchTracker Error:  Unknown tracker %s\n", tracker_name);
+        return 1;
+    }
+    if(manifest_file && output_file)
+    {
+        fprintf(stderr, "BatchTracker Error:  With -m, outputs go in the manifest\n");
+        return 1;
+    }
+    if(n_chunks > 0 && (manifest_file || strcmp(tracker_name, "GY")))
+    {
+        fprintf(stderr, "BatchTracker Error:  -k only works for one video with GY\n");
+        return 1;
+    }
+    if(n_threads <= 0)
+    {
+        n_threads = MT_WorkerPool::getNumCores();
+    }
+
+    BatchSettings settings;
+    settings.tracker_name = tracker_name;
+    settings.n_objects = n_objects;
+    settings.max_frames = max_frames;
+    settings.queue_size = queue_size;
+    settings.em_threads = 0;
+
+    BatchJob job_defaults;
+    initJob(&job_defaults);
+    job_defaults.background = background_file ? background_file : "";
+    job_defaults.roi = roi_file ? roi_file : "";
+    job_defaults.params = param_file ? param_file : "";
+
+    if(n_chunks > 0)
+    {
+        /* one video in chunks - the threads go to the chunks, and
+         * each chunk's EM gets its share */
+        BatchJob job = job_defaults;
+        job.video = video_file;
+        int n_workers = std::min(n_threads, n_chunks);
+        settings.em_threads = MT_MAX(1, n_threads/n_workers);
+
+        BatchChunkedTracker chunked(job, settings, n_chunks, overlap, n_threads);
+        if(!chunked.run(output_file, max_frames))
+        {
+            fprintf(stderr, "BatchTracker Error:  %s\n", chunked.getError().c_str());
+            return 1;
+        }
+
+        int n_frames = chunked.getNumFramesWritten();
+        double t_total = chunked.getTrackTime() + chunked.getStitchTime();
+        printf("Tracked %d frames of %s in %.3f s (%.1f frames/s)\n",
+               n_frames, video_file, t_total,
+               t_total > 0 ? n_frames/t_total : 0.0);
+        printf("  %d chunks on %d threads, %d identities\n",
+               chunked.getNumChunks(), chunked.getNumThreads(),
+               chunked.getNumIdentities());
+        for(int k = 0; k < chunked.getNumChunks(); k++)
+        {
+            printf("  chunk %3d  frames %7d - %7d  %10.3f s",
+                   k, chunked.getChunkStart(k), chunked.getChunkEnd(k) - 1,
+                   chunked.getChunkTime(k));
+            if(k > 0)
+            {
+                printf("  %3d matched, RMS %.2f px",
+                       chunked.getChunkNumMatched(k),
+                       chunked.getChunkRMSDistance(k));
+            }
+            printf("\n");
+        }
+        printf("  stitch and write %10.3f s\n", chunked.getStitchTime());
+        return 0;
+    }
+
+    if(!manifest_file)
+    {
+        /* one video - all of the threads go to its pipeline */
+        BatchJob job = job_defaults;
+        job.video = video_file;
+        job.output = output_file ? output_file : "";
+
+        bool use_pipeline = splitThreads(n_threads, &settings.em_threads);
+        runJob(&job, settings, use_pipeline);
+        if(job.failed)
+        {
+            fprintf(stderr, "BatchTracker Error:  %s\n", job.error.c_str());
+            return 1;
+        }
+
+        printf("Tracked %d frames of %s in %.3f s (%.1f frames/s)\n",
+               job.n_frames, video_file, job.time,
+               job.time > 0 ? job.n_frames/job.time : 0.0);
+        if(use_pipeline)
+        {
+            printStep("capture", job.step_time[MT_TP_CAPTURE], job.n_frames, job.time);
+            printStep("preprocess", job.step_time[MT_TP_PREPROCESS], job.n_frames, job.time);
+            printStep("track", job.step_time[MT_TP_TRACK], job.n_frames, job.time);
+            printStep("output", job.step_time[MT_TP_OUTPUT], job.n_frames, job.time);
+        }
+        return 0;
+    }
+
+    std::vector<BatchJob> jobs;
+    if(!readManifest(manifest_file, job_defaults, &jobs))
+    {
+        return 1;
+    }
+    if(jobs.empty())
+    {
+        fprintf(stderr, "BatchTracker Error:  No jobs in %s\n", manifest_file);
+        return 1;
+    }
+
+    /* look at every video up front, so that the longest can go first
+     * and the ones that won't open don't take a worker.  This also
+     * sets up MT_Capture's shared interface table before any of the
+     * workers make captures. */
+    std::vector<int> order;
+    for(unsigned int i = 0; i < jobs.size(); i++)
+    {
+        MT_Capture probe;
+        if(!probe.initCaptureFromFile(jobs[i].video.c_str()))
+        {
+            failJob(&jobs[i], "Failed to initialize capture from file " + jobs[i].video);
+            printf("  FAILED %s:  %s\n", jobs[i].video.c_str(), jobs[i].error.c_str());
+            continue;
+        }
+        jobs[i].n_frames_expected = probe.getNFrames();
+        order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(), BatchJobOrder(jobs));
+
+    /* one job per thread, with any threads over split between each
+     * job's pipeline and EM */
+    int n_workers = std::min(n_threads, (int) order.size());
+    bool use_pipeline = n_workers > 0
+        && splitThreads(n_threads/n_workers, &settings.em_threads);
+
+    printf("Tracking %d videos with %d workers (%d threads)%s\n",
+           (int) order.size(), n_workers, n_threads,
+           use_pipeline ? ", pipelined" : "");
+    fflush(stdout);
+
+    double t0 = MT_getTimeSec();
+    if(n_workers > 0)
+    {
+        MT_WorkerPool pool(n_workers);
+        BatchFarm farm(&jobs, order, settings, use_pipeline);
+        pool.run(&farm, (int) order.size());
+    }
+    double t_total = MT_getTimeSec() - t0;
+
+    int n_frames = 0;
+    int n_failed = 0;
+    for(unsigned int i = 0; i < jobs.size(); i++)
+    {
+        if(jobs[i].failed)
+        {
+            n_failed++;
+        }
+        else
+        {
+            n_frames += jobs[i].n_frames;
+        }
+    }
+
+    printf("Tracked %d frames from %d of %d videos in %.3f s (%.1f frames/s)\n",
+           n_frames, (int) jobs.size() - n_failed, (int) jobs.size(), t_total,
+           t_total > 0 ? n_frames/t_total : 0.0);
+    if(n_failed)
+    {
+        printf("%d jobs failed:\n", n_failed);
+        for(unsigned int i = 0; i < jobs.size(); i++)
+        {
+            if(jobs[i].failed)
+            {
+                printf("  %s\n", jobs[i].video.c_str());
+            }
+        }
+    }
+
+    return n_failed ? 1 : 0;
+}
@@ -63,6 +63,9 @@ endif(MT_HAVE_AVT)
 if(MT_USE_WX_JOYSTICK)
   add_definitions(-DMT_GAMEPAD_USE_WX)
 endif(MT_USE_WX_JOYSTICK)
+if(NOT MT_HAVE_GUI)
+  add_definitions(-DMT_NO_GL)
+endif(NOT MT_HAVE_GUI)
 
 ######################################################################
 # Library setup
@@ -73,11 +76,13 @@ if(NOT MSVC)
   set(MT_GUI_LIBS ${MT_LIBS_DIR}/libMT_GUI.a ${MT_CORE_LIBS})
   set(MT_TRACKING_LIBS ${MT_LIBS_DIR}/libMT_Tracking.a ${MT_GUI_LIBS}) 
   set(MT_ROBOT_LIBS ${MT_LIBS_DIR}/libMT_Robot.a ${MT_TRACKING_LIBS})
+  set(MT_TRACKING_HEADLESS_LIBS ${MT_LIBS_DIR}/libMT_Tracking.a ${MT_CORE_LIBS})
 else(NOT MSVC)
   set(MT_CORE_LIBS ${MT_LIBS_DIR}/Release/MT_Core.lib)
   set(MT_GUI_LIBS ${MT_CORE_LIBS} ${MT_LIBS_DIR}/Release/MT_GUI.lib)
   set(MT_TRACKING_LIBS ${MT_GUI_LIBS} ${MT_LIBS_DIR}/Release/MT_Tracking.lib)
   set(MT_ROBOT_LIBS ${MT_TRACKING_LIBS} ${MT_LIBS_DIR}/Release/MT_Robot.lib)
+  set(MT_TRACKING_HEADLESS_LIBS ${MT_CORE_LIBS} ${MT_LIBS_DIR}/Release/MT_Tracking.lib)
 endif(NOT MSVC)  
 
 ##### MT_Core extra libraries
@@ -86,6 +91,7 @@ if(MT_HAVE_OPENCV)
   set(MT_CORE_EXTRA_LIBS "${MT_CORE_EXTRA_LIBS};${MT_OPENCV_LIBS}")
 endif(MT_HAVE_OPENCV)
 set(MT_CORE_EXTRA_LIBS "${MT_CORE_EXTRA_LIBS};${MT_GL_LIBS}")
+set(MT_CORE_EXTRA_LIBS "${MT_CORE_EXTRA_LIBS};${MT_THREAD_LIBS}")
 
 if(MT_HAVE_CLF)
   set(MT_CORE_EXTRA_LIBS "${MT_CORE_EXTRA_LIBS};${MT_HDF5_LIB};${MT_CLF_LIB}")
@@ -110,6 +116,10 @@ if(MT_HAVE_AVT)
   set(MT_TRACKING_EXTRA_LIBS "${MT_TRACKING_EXTRA_LIBS};${MT_AVT_LIB}")
 endif(MT_HAVE_AVT)  
 
+#### MT_Tracking without MT_GUI (console apps, needs a build with
+#### BUILD_GUI off so that MT_Tracking has no wx or OpenGL code)
+set(MT_TRACKING_HEADLESS_EXTRA_LIBS "${MT_CORE_EXTRA_LIBS}")
+
 #### MT_Robot extra libraries
 set(MT_ROBOT_EXTRA_LIBS "${MT_TRACKING_EXTRA_LIBS}")
 
@@ -160,6 +170,13 @@ function(MT_link_tracking_app APP_NAME)
   target_link_libraries(${APP_NAME} ${MT_TRACKING_LIBS} ${MT_TRACKING_EXTRA_LIBS})
 endfunction(MT_link_tracking_app)  
 
+function(MT_link_headless_tracking_app APP_NAME)
+  if(MT_HAVE_GUI)
+    message(SEND_ERROR "${APP_NAME} needs MADTraC built with BUILD_GUI off")
+  endif(MT_HAVE_GUI)
+  target_link_libraries(${APP_NAME} ${MT_TRACKING_HEADLESS_LIBS} ${MT_TRACKING_HEADLESS_EXTRA_LIBS})
+endfunction(MT_link_headless_tracking_app)
+
 function(MT_link_robot_app APP_NAME)
   target_link_libraries(${APP_NAME} ${MT_ROBOT_LIBS} ${MT_ROBOT_EXTRA_LIBS})
 endfunction(MT_link_robot_app)
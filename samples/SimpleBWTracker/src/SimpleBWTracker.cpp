@@ -159,11 +159,20 @@ void SimpleBWTracker::doTracking(IplImage* frame)
     doSegmentation();
 
     /* convert blob results to std::vectors */
-    m_vdBlobXs = m_Blobs.GetSTLResult(MT_CBlobGetXCenterOfMass());
-    m_vdBlobYs = m_Blobs.GetSTLResult(MT_CBlobGetYCenterOfMass());
-    m_vdBlobPs = m_Blobs.GetSTLResult(CBlobGetPerimeter());
-    m_vdBlobAs = m_Blobs.GetSTLResult(CBlobGetArea());
-    m_vdBlobOs = m_Blobs.GetSTLResult(MT_CBlobGetHeadOrientation());
+    /*   all features are computed in one pass over the blobs, then
+     *   swapped into our vectors (the data report holds pointers to
+     *   them, and swapping lets both sets of storage be reused) */
+    MT_GetBlobFeatures(m_Blobs,
+                       &m_BlobFeatures,
+                       MT_BLOB_FEATURE_XY
+                       | MT_BLOB_FEATURE_AREA
+                       | MT_BLOB_FEATURE_PERIMETER
+                       | MT_BLOB_FEATURE_ORIENTATION);
+    m_vdBlobXs.swap(m_BlobFeatures.m_vdX);
+    m_vdBlobYs.swap(m_BlobFeatures.m_vdY);
+    m_vdBlobPs.swap(m_BlobFeatures.m_vdPerimeter);
+    m_vdBlobAs.swap(m_BlobFeatures.m_vdArea);
+    m_vdBlobOs.swap(m_BlobFeatures.m_vdOrientation);
 
     /* adjust for the image origin vs. coordinate origin */
     for(unsigned int i = 0; i < m_iNBlobsFound; i++)
@@ -201,16 +210,16 @@ void SimpleBWTracker::doSegmentation()
     /* using CBlobsLib */
     m_Blobs = CBlobResult(m_pThreshFrame, NULL, 0);
   
-    /* Blob filtering - by size */
-    m_Blobs.Filter(m_Blobs, B_INCLUDE, CBlobGetArea(), B_GREATER, m_dMinBlobArea);
-    m_Blobs.Filter(m_Blobs, B_INCLUDE, CBlobGetArea(), B_LESS, m_dMaxBlobArea);
+    /* Blob filtering - by size.  Filtering in place avoids copying
+     * the surviving blobs each time. */
+    m_Blobs.FilterInPlace(B_INCLUDE, CBlobGetArea(), B_GREATER, m_dMinBlobArea);
+    m_Blobs.FilterInPlace(B_INCLUDE, CBlobGetArea(), B_LESS, m_dMaxBlobArea);
     /* Certain conditions tend to generate a blob with this property,
      * so we delete it */
-    m_Blobs.Filter(m_Blobs,
-                   B_EXCLUDE,
-                   CBlobGetXCenter(),
-                   B_EQUAL,
-                   0.5*((double) m_pThreshFrame->width) + 0.5 );
+    m_Blobs.FilterInPlace(B_EXCLUDE,
+                          CBlobGetXCenter(),
+                          B_EQUAL,
+                          0.5*((double) m_pThreshFrame->width) + 0.5 );
   
     /* number of blobs found */
     m_iNBlobsFound = m_Blobs.GetNumBlobs();
@@ -25,6 +25,7 @@ private:
 
     /* output variables */
     CBlobResult m_Blobs;
+    MT_BlobFeatures m_BlobFeatures;
     std::vector<double> m_vdBlobXs;
     std::vector<double> m_vdBlobYs;
     std::vector<double> m_vdBlobPs;
@@ -0,0 +1,107 @@
+#include <stdlib.h>
+#include <vector>
+
+#include "MT_Test.h"
+
+#include "MT/MT_Core/support/BiCC.h"
+
+/* run the dense and sparse versions on the same adjacency and make
+ * sure they give the same labels */
+void COMPARE_TEST(unsigned int rows,
+                  unsigned int cols,
+                  const std::vector<unsigned int>& adj,
+                  int* p_in_status)
+{
+    std::vector<MT_BiCCEdge> edges(0);
+    for(unsigned int i = 0; i < rows; i++)
+    {
+        for(unsigned int j = 0; j < cols; j++)
+        {
+            if(adj[i*cols + j])
+            {
+                edges.push_back(MT_BiCCEdge(i, j));
+            }
+        }
+    }
+    /* the order of the edges should not matter */
+    for(unsigned int k = edges.size(); k > 1; k--)
+    {
+        unsigned int r = rand() % k;
+        MT_BiCCEdge tmp = edges[k-1];
+        edges[k-1] = edges[r];
+        edges[r] = tmp;
+    }
+
+    MT_BiCC dense(rows, cols);
+    MT_BiCC sparse(rows, cols);
+
+    int n_dense = dense.findComponents(adj);
+    int n_sparse = sparse.findComponents(edges);
+
+    if(n_dense != n_sparse
+       || dense.getLabelVector() != sparse.getLabelVector()
+       || dense.getLabelMatrix() != sparse.getLabelMatrix())
+    {
+        *p_in_status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Sparse labels differ from dense labels");
+        fprintf(stderr, "    + %dx%d with %d edges:  %d vs %d components\n",
+                rows, cols, (int) edges.size(), n_dense, n_sparse);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int status = MT_TEST_SUCCESS;
+
+    /**************************************************/
+    MT_TEST_START("MT_BiCC known components");
+
+    /* rows 0 and 2 share col 1, row 1 has nothing, col 3 has nothing */
+    unsigned int a[] = {1, 1, 0, 0,
+                        0, 0, 0, 0,
+                        0, 1, 1, 0};
+    std::vector<unsigned int> adj(a, a + 12);
+    unsigned int expect[] = {1, 2, 1, 1, 1, 1, 3};
+
+    std::vector<MT_BiCCEdge> edges(0);
+    edges.push_back(MT_BiCCEdge(2, 2));
+    edges.push_back(MT_BiCCEdge(0, 1));
+    edges.push_back(MT_BiCCEdge(2, 1));
+    edges.push_back(MT_BiCCEdge(0, 0));
+    edges.push_back(MT_BiCCEdge(0, 0));
+
+    MT_BiCC bicc(3, 4);
+    if(bicc.findComponents(edges) != 3
+       || bicc.getLabelVector() != std::vector<unsigned int>(expect, expect + 7))
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Wrong labels from sparse findComponents");
+    }
+    COMPARE_TEST(3, 4, adj, &status);
+
+    /**************************************************/
+    MT_TEST_START("MT_BiCC sparse vs. dense");
+
+    srand(12345);
+    unsigned int sizes[] = {1, 2, 5, 13, 40};
+    for(unsigned int r = 0; r < 5; r++)
+    {
+        for(unsigned int c = 0; c < 5; c++)
+        {
+            unsigned int rows = sizes[r];
+            unsigned int cols = sizes[c];
+            /* from mostly isolated to mostly connected */
+            for(int density = 0; density <= 100; density += 5)
+            {
+                std::vector<unsigned int> m(rows*cols, 0);
+                for(unsigned int k = 0; k < rows*cols; k++)
+                {
+                    m[k] = ((rand() % 1000) < 3*density) ? 1 : 0;
+                }
+                COMPARE_TEST(rows, cols, m, &status);
+            }
+        }
+    }
+
+    return status;
+}
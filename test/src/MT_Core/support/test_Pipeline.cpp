@@ -0,0 +1,235 @@
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "MT_Test.h"
+
+#include "MT/MT_Core/support/mathsupport.h"
+#include "MT/MT_Core/support/Pipeline.h"
+
+static void sleepMs(int ms)
+{
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    usleep(1000*ms);
+#endif
+}
+
+const int N_STAGES = 3;
+
+/* what each stage did to an item */
+struct TestItem
+{
+    int number;
+    double value;
+    int seen_by[N_STAGES];
+};
+
+/* checks that it sees items in order and does some work on each, the
+ * result depending on the previous item, as it would for a tracker */
+class TestStage : public MT_PipelineStage
+{
+public:
+    TestStage(int index, int sleep_ms)
+        : m_iIndex(index),
+          m_iSleepMs(sleep_ms),
+          m_iNext(0),
+          m_iOutOfOrder(0),
+          m_dLast(0),
+          m_piStarted(NULL)
+    {
+    };
+
+    void process(void* p)
+    {
+        TestItem* item = (TestItem*) p;
+        if(m_piStarted)
+        {
+            (*m_piStarted)++;
+        }
+        if(item->number != m_iNext++)
+        {
+            m_iOutOfOrder++;
+        }
+        if(m_iSleepMs)
+        {
+            sleepMs(m_iSleepMs);
+        }
+        item->value = sin(item->value + m_dLast) + m_iIndex;
+        m_dLast = item->value;
+        item->seen_by[m_iIndex]++;
+    };
+
+    int m_iIndex;
+    int m_iSleepMs;
+    int m_iNext;
+    int m_iOutOfOrder;
+    double m_dLast;
+    /* counts items the stage has started on */
+    volatile int* m_piStarted;
+};
+
+/* runs n_items through the stages, reusing at most max_items items
+ * the way a frame source would, and returns the values out of the
+ * last stage */
+static std::vector<double> runItems(int n_items,
+                                    int max_items,
+                                    int queue_size,
+                                    int sleep_ms,
+                                    bool start,
+                                    int* p_in_status,
+                                    int* p_max_ahead = NULL)
+{
+    MT_Pipeline pipeline(queue_size);
+    std::vector<TestStage*> stages;
+    for(int k = 0; k < N_STAGES; k++)
+    {
+        stages.push_back(new TestStage(k, sleep_ms));
+        pipeline.addStage(stages[k]);
+    }
+    volatile int n_started_last = 0;
+    stages[N_STAGES - 1]->m_piStarted = &n_started_last;
+    if(start && !pipeline.start())
+    {
+        *p_in_status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Could not start the pipeline");
+    }
+
+    std::vector<TestItem> items(max_items);
+    std::vector<double> values(n_items, 0);
+    int n_bad = 0;
+    int n_out = 0;
+    int max_ahead = 0;
+    for(int i = 0; i < n_items + max_items; i++)
+    {
+        TestItem* item = NULL;
+        if(i >= max_items || i >= n_items)
+        {
+            item = (TestItem*) pipeline.pop();
+            if(!item)
+            {
+                break;
+            }
+            if(item->number != n_out)
+            {
+                n_bad++;
+            }
+            for(int k = 0; k < N_STAGES; k++)
+            {
+                if(item->seen_by[k] != 1)
+                {
+                    n_bad++;
+                }
+            }
+            values[n_out++] = item->value;
+        }
+        else
+        {
+            item = &items[i];
+        }
+
+        if(i < n_items)
+        {
+            item->number = i;
+            item->value = 0.01*i;
+            for(int k = 0; k < N_STAGES; k++)
+            {
+                item->seen_by[k] = 0;
+            }
+            pipeline.push(item);
+            max_ahead = MT_MAX(max_ahead, i + 1 - n_started_last);
+        }
+    }
+    pipeline.finish();
+
+    for(int k = 0; k < N_STAGES; k++)
+    {
+        n_bad += stages[k]->m_iOutOfOrder;
+        delete stages[k];
+    }
+    if(n_bad || n_out != n_items || pipeline.getNumInFlight() != 0)
+    {
+        *p_in_status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Items lost, repeated or out of order");
+        fprintf(stderr, "    + %d of %d items out, %d bad\n", n_out, n_items, n_bad);
+    }
+    if(p_max_ahead)
+    {
+        *p_max_ahead = max_ahead;
+    }
+    return values;
+}
+
+int main(int argc, char** argv)
+{
+    int status = MT_TEST_SUCCESS;
+
+    const int n_items = 2000;
+
+    /* reference results, run through the stages on this thread */
+    MT_TEST_START("MT_Pipeline not started runs serially");
+    std::vector<double> reference = runItems(n_items, 4, 2, 0, false, &status);
+
+    /**************************************************/
+    MT_TEST_START("MT_Pipeline order and results");
+
+    for(int q = 1; q <= 4; q++)
+    {
+        std::vector<double> v = runItems(n_items, 12, q, 0, true, &status);
+        if(v != reference)
+        {
+            status = MT_TEST_ERROR;
+            MT_TEST_ERROR_MESSAGE("Results differ from serial");
+            fprintf(stderr, "    + queue size %d\n", q);
+        }
+    }
+    /* fewer items than stages */
+    if(runItems(2, 2, 2, 0, true, &status) != std::vector<double>(reference.begin(), reference.begin() + 2))
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Results differ from serial");
+    }
+
+    /**************************************************/
+    MT_TEST_START("MT_Pipeline queues are bounded");
+
+    /* with plenty of items, the source can only get so far ahead of
+     * the last stage */
+    const int queue_size = 2;
+    int max_ahead = 0;
+    runItems(30, 100, queue_size, 1, true, &status, &max_ahead);
+    printf("  Source got at most %d items ahead of the last stage\n", max_ahead);
+    if(max_ahead > N_STAGES*(queue_size + 1))
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Source got too far ahead");
+    }
+
+    /**************************************************/
+    MT_TEST_START("MT_Pipeline throughput");
+
+    const int n_timed = 40;
+    const int sleep_ms = 5;
+    double t0 = MT_getTimeSec();
+    runItems(n_timed, 12, 2, sleep_ms, false, &status);
+    double t_serial = MT_getTimeSec() - t0;
+    t0 = MT_getTimeSec();
+    runItems(n_timed, 12, 2, sleep_ms, true, &status);
+    double t_pipelined = MT_getTimeSec() - t0;
+    printf("  %d items, %d stages of %d ms:  serial %f s, pipelined %f s\n",
+           n_timed, N_STAGES, sleep_ms, t_serial, t_pipelined);
+    if(t_pipelined > 0.7*t_serial)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Pipelining didn't overlap the stages");
+    }
+
+    return status;
+}
@@ -0,0 +1,174 @@
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "MT_Test.h"
+
+#include "MT/MT_Core/support/TripleBuffer.h"
+
+/* a result big enough that a torn copy would show */
+const int N_VALUES = 256;
+struct TestResult
+{
+    int number;
+    int values[N_VALUES];
+};
+
+struct TestShared
+{
+    MT_TripleBuffer buffer;
+    TestResult results[3];
+    int n_results;
+};
+
+/* fills in and publishes results 1 .. n_results */
+static void writeResults(TestShared* s)
+{
+    for(int n = 1; n <= s->n_results; n++)
+    {
+        TestResult* r = &s->results[s->buffer.getWriteIndex()];
+        r->number = n;
+        for(int i = 0; i < N_VALUES; i++)
+        {
+            r->values[i] = n + i;
+        }
+        s->buffer.publish();
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI writerEntry(LPVOID arg)
+{
+    writeResults((TestShared*) arg);
+    return 0;
+}
+#else
+static void* writerEntry(void* arg)
+{
+    writeResults((TestShared*) arg);
+    return NULL;
+}
+#endif
+
+int main(int argc, char** argv)
+{
+    int status = MT_TEST_SUCCESS;
+
+    /**************************************************/
+    MT_TEST_START("MT_TripleBuffer single thread");
+
+    MT_TripleBuffer tb;
+    int slots[3];
+    if(tb.update() || tb.getHasNew())
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("New result before anything was published");
+    }
+
+    slots[0] = tb.getWriteIndex();
+    tb.publish();
+    if(!tb.getHasNew() || !tb.update() || tb.getReadIndex() != slots[0])
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Reader didn't get the published slot");
+    }
+    if(tb.update())
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Same result taken twice");
+    }
+
+    /* two published before the reader looks - it gets the second */
+    slots[1] = tb.getWriteIndex();
+    tb.publish();
+    slots[2] = tb.getWriteIndex();
+    tb.publish();
+    if(!tb.update() || tb.getReadIndex() != slots[2])
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Reader didn't get the latest result");
+    }
+    if(tb.getReadIndex() == tb.getWriteIndex())
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Reader and writer share a slot");
+    }
+
+    /**************************************************/
+    MT_TEST_START("MT_TripleBuffer writer thread");
+
+    TestShared* s = new TestShared;
+    s->n_results = 200000;
+    s->results[s->buffer.getReadIndex()].number = 0;
+
+#ifdef _WIN32
+    HANDLE t = CreateThread(NULL, 0, writerEntry, s, 0, NULL);
+    bool ok = (t != NULL);
+#else
+    pthread_t t;
+    bool ok = (pthread_create(&t, NULL, writerEntry, s) == 0);
+#endif
+    if(!ok)
+    {
+        MT_TEST_ERROR_MESSAGE("Could not start the writer thread");
+        delete s;
+        return MT_TEST_ERROR;
+    }
+
+    /* every result the reader gets should be whole and newer than the
+     * last one */
+    int last = 0;
+    int n_seen = 0;
+    int n_torn = 0;
+    int n_old = 0;
+    while(last < s->n_results)
+    {
+        if(!s->buffer.update())
+        {
+            continue;
+        }
+        const TestResult* r = &s->results[s->buffer.getReadIndex()];
+        if(r->number <= last)
+        {
+            n_old++;
+        }
+        for(int i = 0; i < N_VALUES; i++)
+        {
+            if(r->values[i] != r->number + i)
+            {
+                n_torn++;
+                break;
+            }
+        }
+        last = r->number;
+        n_seen++;
+    }
+
+#ifdef _WIN32
+    WaitForSingleObject(t, INFINITE);
+    CloseHandle(t);
+#else
+    pthread_join(t, NULL);
+#endif
+
+    printf("  Reader saw %d of %d results\n", n_seen, s->n_results);
+    if(n_torn || n_old)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Reader got torn or stale results");
+        fprintf(stderr, "    + %d torn, %d not newer\n", n_torn, n_old);
+    }
+    if(s->buffer.update())
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Result left over after the last one");
+    }
+
+    delete s;
+
+    return status;
+}
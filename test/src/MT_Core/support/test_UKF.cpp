@@ -1,5 +1,13 @@
+#include <math.h>
+#include <vector>
+
+#include "MT_Test.h"
+
+#include "MT/MT_Core/support/mathsupport.h"
 #include "MT/MT_Core/support/OpenCVmath.h"
 #include "MT/MT_Core/support/UKF.h"
+#include "MT/MT_Core/support/UKFBatch.h"
+#include "MT/MT_Core/support/UKFTemplate.h"
 
 /* example of a state transformation function.  This can be as
  * arbitrarily complex as desired. The only limitation is that it
@@ -69,8 +77,343 @@ void h(const CvMat* x_k, const CvMat* n_k, CvMat* z_k)
 
 }
 
+/* f and h for MT_UKFBatch:  the same transformations done on all of
+ * the sigma points of all of the objects at once.  Element i of point
+ * p is at [i*num_points + p] */
+void f_batch(const double* X, const double* U, const double* V, double* X1,
+             unsigned int num_points)
+{
+    const double* x0 = X;
+    const double* x1 = X + num_points;
+    for(unsigned int p = 0; p < num_points; p++)
+    {
+        double a = 1.0*x0[p] + 0.1*x1[p] + U[p];
+        double b = 0.0*x0[p] + 0.9*x1[p] + U[num_points + p];
+        X1[p] = a + sin(x0[p]) + V[p];
+        X1[num_points + p] = b + V[num_points + p];
+    }
+}
+
+void h_batch(const double* X, const double* N, double* Z,
+             unsigned int num_points)
+{
+    for(unsigned int p = 0; p < num_points; p++)
+    {
+        Z[p] = X[p] + N[p];
+    }
+}
+
+/* runs n_objects per-object UKFs and one batch side by side, each
+ * object with its own initial condition and input and with some
+ * measurements missed.  Returns the number of steps where they
+ * differ by more than tol, and the time each took */
+int compareBatch(unsigned int n_objects, unsigned int Nt, double tol,
+                 double* t_single, double* t_batch)
+{
+    int n = 2;
+    int m = 1;
+    double dt = 0.05;
+
+    CvMat* Q = cvCreateMat(n, n, CV_64FC1);
+    CvMat* R = cvCreateMat(m, m, CV_64FC1);
+    CvMat* z = cvCreateMat(m, 1, CV_64FC1);
+    cvSetIdentity(Q);
+    cvSetIdentity(R);
+    double Qd[] = {1.0, 0.0, 0.0, 1.0};
+    double Rd[] = {1.0};
+
+    std::vector<MT_UKF_struct*> UKFs(n_objects);
+    std::vector<CvMat*> us(n_objects);
+    std::vector<CvMat*> x_acts(n_objects);
+    MT_UKFBatch_struct* batch = MT_UKFBatchInit(n_objects, n, m, n);
+    MT_UKFBatchCopyQR(batch, Qd, n, Rd, m);
+
+    for(unsigned int o = 0; o < n_objects; o++)
+    {
+        UKFs[o] = MT_UKFInit(n, m);
+        MT_UKFCopyQR(UKFs[o], Q, R);
+        us[o] = cvCreateMat(n, 1, CV_64FC1);
+        cvZero(us[o]);
+        x_acts[o] = cvCreateMat(n, 1, CV_64FC1);
+        cvSetReal2D(x_acts[o], 0, 0, 0.1*o);
+        cvSetReal2D(x_acts[o], 1, 0, 1.0 - 0.05*o);
+        MT_UKFSetState(UKFs[o], x_acts[o]);
+        double x0[] = {0.1*o, 1.0 - 0.05*o};
+        MT_UKFBatchSetState(batch, o, x0);
+    }
+
+    int n_bad = 0;
+    double t = 0;
+    double x_b[2], P_b[4];
+    *t_single = *t_batch = 0;
+    for(unsigned int i = 0; i < Nt; i++)
+    {
+        t += dt;
+        for(unsigned int o = 0; o < n_objects; o++)
+        {
+            double u0 = (t > 0.2) ? 1.0 + 0.01*o : 0;
+            double u1 = (t > 0.15) ? -1.0 + 0.02*o : 0;
+            cvSetReal2D(us[o], 0, 0, u0);
+            cvSetReal2D(us[o], 1, 0, u1);
+            double ub[] = {u0, u1};
+            MT_UKFBatchSetInput(batch, o, ub);
+        }
+
+        double t0 = MT_getTimeSec();
+        for(unsigned int o = 0; o < n_objects; o++)
+        {
+            MT_UKFPredict(UKFs[o], &f, &h, us[o]);
+        }
+        double t1 = MT_getTimeSec();
+        MT_UKFBatchPredict(batch, &f_batch, &h_batch);
+        double t2 = MT_getTimeSec();
+        *t_single += t1 - t0;
+        *t_batch += t2 - t1;
+
+        for(unsigned int o = 0; o < n_objects; o++)
+        {
+            f(x_acts[o], us[o], NULL, x_acts[o]);
+            h(x_acts[o], NULL, z);
+            /* miss a measurement now and then */
+            if((i + o) % 7 != 3)
+            {
+                MT_UKFSetMeasurement(UKFs[o], z);
+                MT_UKFBatchSetMeasurement(batch, o, z->data.db);
+            }
+        }
+
+        t0 = MT_getTimeSec();
+        for(unsigned int o = 0; o < n_objects; o++)
+        {
+            MT_UKFCorrect(UKFs[o]);
+        }
+        t1 = MT_getTimeSec();
+        MT_UKFBatchCorrect(batch);
+        t2 = MT_getTimeSec();
+        *t_single += t1 - t0;
+        *t_batch += t2 - t1;
+
+        bool same = true;
+        for(unsigned int o = 0; o < n_objects; o++)
+        {
+            MT_UKFBatchGetState(batch, o, x_b);
+            MT_UKFBatchGetCovariance(batch, o, P_b);
+            for(int r = 0; r < n; r++)
+            {
+                double x_s = cvGetReal2D(UKFs[o]->x, r, 0);
+                same &= fabs(x_b[r] - x_s) <= tol*(1.0 + fabs(x_s));
+                for(int c = 0; c < n; c++)
+                {
+                    double P_s = cvGetReal2D(UKFs[o]->P, r, c);
+                    same &= fabs(P_b[r*n + c] - P_s) <= tol*(1.0 + fabs(P_s));
+                }
+            }
+        }
+        if(!same)
+        {
+            n_bad++;
+        }
+    }
+
+    for(unsigned int o = 0; o < n_objects; o++)
+    {
+        MT_UKFFree(&UKFs[o]);
+        cvReleaseMat(&us[o]);
+        cvReleaseMat(&x_acts[o]);
+    }
+    MT_UKFBatchFree(&batch);
+    cvReleaseMat(&Q);
+    cvReleaseMat(&R);
+    cvReleaseMat(&z);
+
+    return n_bad;
+}
+
+/* f and h for MT_UKF<2, 1>, with the input in the functor */
+struct Model2x1
+{
+    double u[2];
+    void setInput(double t, CvMat* u_cv)
+    {
+        u[0] = (t > 0.2) ? 1.0 : 0;
+        u[1] = (t > 0.15) ? -1.0 : 0;
+        cvSetReal2D(u_cv, 0, 0, u[0]);
+        cvSetReal2D(u_cv, 1, 0, u[1]);
+    }
+    void operator()(const MT_Vector<2>& x, const MT_Vector<2>& v,
+                    MT_Vector<2>& x1) const
+    {
+        x1.data[0] = 1.0*x.data[0] + 0.1*x.data[1] + u[0]
+            + sin(x.data[0]) + v.data[0];
+        x1.data[1] = 0.0*x.data[0] + 0.9*x.data[1] + u[1] + v.data[1];
+    }
+    void operator()(const MT_Vector<2>& x, const MT_Vector<1>& n,
+                    MT_Vector<1>& z) const
+    {
+        z.data[0] = x.data[0] + n.data[0];
+    }
+};
+
+/* a constant turn rate model with range and bearing measurements:
+ * x = [x y vx vy], z = [range bearing] */
+const double turn = 0.1;
+
+void f4(const CvMat* x_k, const CvMat* u_k, const CvMat* v_k, CvMat* x_kplus1)
+{
+    double x = cvGetReal2D(x_k, 0, 0);
+    double y = cvGetReal2D(x_k, 1, 0);
+    double vx = cvGetReal2D(x_k, 2, 0);
+    double vy = cvGetReal2D(x_k, 3, 0);
+    cvSetReal2D(x_kplus1, 0, 0, x + vx);
+    cvSetReal2D(x_kplus1, 1, 0, y + vy);
+    cvSetReal2D(x_kplus1, 2, 0, cos(turn)*vx - sin(turn)*vy);
+    cvSetReal2D(x_kplus1, 3, 0, sin(turn)*vx + cos(turn)*vy);
+    if(v_k)
+    {
+        cvAdd(x_kplus1, v_k, x_kplus1);
+    }
+}
+
+void h4(const CvMat* x_k, const CvMat* n_k, CvMat* z_k)
+{
+    double x = cvGetReal2D(x_k, 0, 0);
+    double y = cvGetReal2D(x_k, 1, 0);
+    cvSetReal2D(z_k, 0, 0, sqrt(x*x + y*y));
+    cvSetReal2D(z_k, 1, 0, atan2(y, x));
+    if(n_k)
+    {
+        cvAdd(z_k, n_k, z_k);
+    }
+}
+
+struct Model4x2
+{
+    void setInput(double t, CvMat* u_cv)
+    {
+        cvZero(u_cv);
+    }
+    void operator()(const MT_Vector<4>& x, const MT_Vector<4>& v,
+                    MT_Vector<4>& x1) const
+    {
+        x1.data[0] = x.data[0] + x.data[2] + v.data[0];
+        x1.data[1] = x.data[1] + x.data[3] + v.data[1];
+        x1.data[2] = cos(turn)*x.data[2] - sin(turn)*x.data[3] + v.data[2];
+        x1.data[3] = sin(turn)*x.data[2] + cos(turn)*x.data[3] + v.data[3];
+    }
+    void operator()(const MT_Vector<4>& x, const MT_Vector<2>& n,
+                    MT_Vector<2>& z) const
+    {
+        z.data[0] = sqrt(x.data[0]*x.data[0] + x.data[1]*x.data[1]) + n.data[0];
+        z.data[1] = atan2(x.data[1], x.data[0]) + n.data[1];
+    }
+};
+
+/* runs MT_UKF<NX, NZ> next to the CvMat UKF on the same model from
+ * x0, with noisy measurements and some of them missed.  Returns the
+ * number of steps where they differ by more than tol, and the time
+ * each took */
+template<int NX, int NZ, class Model>
+int compareTemplate(MT_UKFStateTxfm f_cv, MT_UKFMeasTxfm h_cv, Model& model,
+                    const double* x0, double q, double r, unsigned int Nt,
+                    double tol, double* t_cv, double* t_template)
+{
+    double dt = 0.05;
+
+    MT_UKF_struct* UKF = MT_UKFInit(NX, NZ);
+    CvMat* Q = cvCreateMat(NX, NX, CV_64FC1);
+    CvMat* R = cvCreateMat(NZ, NZ, CV_64FC1);
+    CvMat* u = cvCreateMat(NX, 1, CV_64FC1);
+    CvMat* x_act = cvCreateMat(NX, 1, CV_64FC1);
+    CvMat* z = cvCreateMat(NZ, 1, CV_64FC1);
+    cvSetIdentity(Q, cvRealScalar(q));
+    cvSetIdentity(R, cvRealScalar(r));
+    MT_UKFCopyQR(UKF, Q, R);
+
+    MT_UKF<NX, NZ> ukf;
+    MT_Matrix<NX, NX> Qt = IdentityMT_Matrix<NX>();
+    MT_Matrix<NZ, NZ> Rt = IdentityMT_Matrix<NZ>();
+    ukf.setQR(q*Qt, r*Rt);
+
+    MT_Vector<NX> xt;
+    MT_Vector<NZ> zt;
+    for(int i = 0; i < NX; i++)
+    {
+        cvSetReal2D(x_act, i, 0, x0[i]);
+        xt.data[i] = x0[i];
+    }
+    MT_UKFSetState(UKF, x_act);
+    ukf.setState(xt);
+
+    int n_bad = 0;
+    double t = 0;
+    *t_cv = *t_template = 0;
+    for(unsigned int k = 0; k < Nt; k++)
+    {
+        t += dt;
+        model.setInput(t, u);
+
+        double t0 = MT_getTimeSec();
+        MT_UKFPredict(UKF, f_cv, h_cv, u);
+        double t1 = MT_getTimeSec();
+        ukf.predict(model, model);
+        double t2 = MT_getTimeSec();
+        *t_cv += t1 - t0;
+        *t_template += t2 - t1;
+
+        f_cv(x_act, u, NULL, x_act);
+        h_cv(x_act, NULL, z);
+        for(int j = 0; j < NZ; j++)
+        {
+            zt.data[j] = cvGetReal2D(z, j, 0) + 0.01*sqrt(r)*sin(3.0*k + j);
+            cvSetReal2D(z, j, 0, zt.data[j]);
+        }
+        if(k % 5 != 2)
+        {
+            MT_UKFSetMeasurement(UKF, z);
+            ukf.setMeasurement(zt);
+        }
+
+        t0 = MT_getTimeSec();
+        MT_UKFCorrect(UKF);
+        t1 = MT_getTimeSec();
+        ukf.correct();
+        t2 = MT_getTimeSec();
+        *t_cv += t1 - t0;
+        *t_template += t2 - t1;
+
+        bool same = true;
+        for(int i = 0; i < NX; i++)
+        {
+            double x_s = cvGetReal2D(UKF->x, i, 0);
+            same &= fabs(ukf.getState().data[i] - x_s) <= tol*(1.0 + fabs(x_s));
+            for(int j = 0; j < NX; j++)
+            {
+                double P_s = cvGetReal2D(UKF->P, i, j);
+                same &= fabs(ukf.getCovariance().data[i*NX + j] - P_s)
+                    <= tol*(1.0 + fabs(P_s));
+            }
+        }
+        if(!same)
+        {
+            n_bad++;
+        }
+    }
+
+    MT_UKFFree(&UKF);
+    cvReleaseMat(&Q);
+    cvReleaseMat(&R);
+    cvReleaseMat(&u);
+    cvReleaseMat(&x_act);
+    cvReleaseMat(&z);
+
+    return n_bad;
+}
+
 int main(int argc, char** argv)
 {
+    int status = MT_TEST_SUCCESS;
+
+    MT_TEST_START("UKF example");
 
     /* number of states */
     int n = 2;
@@ -214,5 +557,44 @@ int main(int argc, char** argv)
     cvReleaseMat(&x0);
     cvReleaseMat(&z);
     cvReleaseMat(&x_act);
-                  
+
+    /**************************************************/
+    MT_TEST_START("Batched UKF vs per-object UKF");
+
+    double t_single, t_batch;
+    if(compareBatch(20, Nt, 1e-6, &t_single, &t_batch))
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Batched and per-object estimates differ");
+    }
+
+    compareBatch(500, 20, 1e-6, &t_single, &t_batch);
+    printf("  500 objects, 20 steps:  per-object %f s, batched %f s\n",
+           t_single, t_batch);
+
+    /**************************************************/
+    MT_TEST_START("Template UKF vs UKF");
+
+    double t_cv, t_template;
+    Model2x1 model2x1;
+    double x0_2x1[] = {0.0, 1.0};
+    if(compareTemplate<2, 1>(&f, &h, model2x1, x0_2x1, 1.0, 1.0, Nt, 1e-6,
+                             &t_cv, &t_template))
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Template and CvMat estimates differ, 2 states");
+    }
+
+    Model4x2 model4x2;
+    double x0_4x2[] = {50.0, 20.0, 1.0, 0.5};
+    if(compareTemplate<4, 2>(&f4, &h4, model4x2, x0_4x2, 0.01, 0.1, 1000, 1e-5,
+                             &t_cv, &t_template))
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Template and CvMat estimates differ, 4 states");
+    }
+    printf("  4 states, 2 measurements, 1000 steps:  CvMat %f s, template %f s\n",
+           t_cv, t_template);
+
+    return status;
 }
@@ -0,0 +1,207 @@
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+#include "MT_Test.h"
+
+#include "MT/MT_Core/support/WorkerPool.h"
+
+/* a job whose cost depends on its index, with a scratch buffer per
+ * worker the way the EMMG workspaces are used */
+class TestJob : public MT_WorkerJob
+{
+public:
+    TestJob(int n_jobs, int n_workers)
+        : m_viRuns(n_jobs, 0),
+          m_viBusy(n_workers, 0),
+          m_vdResults(n_jobs, 0),
+          m_vvdScratch(n_workers),
+          m_iBadWorker(0),
+          m_iOverlap(0)
+    {
+    };
+
+    void doJob(int index, int worker)
+    {
+        if(worker < 0 || worker >= (int) m_viBusy.size())
+        {
+            m_iBadWorker++;
+            return;
+        }
+        if(m_viBusy[worker]++)
+        {
+            m_iOverlap++;
+        }
+
+        m_viRuns[index]++;
+        std::vector<double>& s = m_vvdScratch[worker];
+        s.resize(100*(1 + index % 7));
+        double r = 0;
+        for(unsigned int k = 0; k < s.size(); k++)
+        {
+            s[k] = sin(0.01*k + index);
+            r += s[k]*s[k];
+        }
+        m_vdResults[index] = r;
+
+        m_viBusy[worker]--;
+    };
+
+    std::vector<int> m_viRuns;
+    std::vector<int> m_viBusy;
+    std::vector<double> m_vdResults;
+    std::vector<std::vector<double> > m_vvdScratch;
+    int m_iBadWorker;
+    int m_iOverlap;
+};
+
+/* counts how often each item is covered and records the ranges */
+class TestRangeJob : public MT_RangeJob
+{
+public:
+    TestRangeJob(int n_items)
+        : m_viRuns(n_items, 0),
+          m_vdResults(n_items, 0),
+          m_iNumRanges(0),
+          m_iBadRange(0)
+    {
+    };
+
+    void doRange(int begin, int end, int worker)
+    {
+        if(begin < 0 || end > (int) m_viRuns.size() || begin >= end)
+        {
+            m_iBadRange++;
+            return;
+        }
+        /* m_iNumRanges is only checked when run serially */
+        m_iNumRanges++;
+        for(int i = begin; i < end; i++)
+        {
+            m_viRuns[i]++;
+            m_vdResults[i] = sin(0.1*i)*cos(0.3*i);
+        }
+    };
+
+    std::vector<int> m_viRuns;
+    std::vector<double> m_vdResults;
+    int m_iNumRanges;
+    int m_iBadRange;
+};
+
+void CHUNK_TEST(MT_WorkerPool* pool, int n_items, int chunk_size,
+                int min_parallel, int* p_in_status)
+{
+    TestRangeJob job(n_items);
+    pool->runChunked(&job, n_items, chunk_size, min_parallel);
+
+    int n_bad = 0;
+    for(int i = 0; i < n_items; i++)
+    {
+        if(job.m_viRuns[i] != 1 || job.m_vdResults[i] != sin(0.1*i)*cos(0.3*i))
+        {
+            n_bad++;
+        }
+    }
+    if(n_bad || job.m_iBadRange)
+    {
+        *p_in_status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Items not covered exactly once each");
+        fprintf(stderr, "    + %d items, chunks of %d:  %d bad items, "
+                "%d bad ranges\n", n_items, chunk_size, n_bad, job.m_iBadRange);
+    }
+    if(n_items < min_parallel && job.m_iNumRanges != 1)
+    {
+        *p_in_status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Expected one serial range below min_parallel");
+    }
+}
+
+void POOL_TEST(int n_threads, int n_jobs, int n_batches,
+               const std::vector<double>& expected, int* p_in_status)
+{
+    MT_WorkerPool pool(n_threads);
+    if(pool.getNumWorkers() < 1 || pool.getNumWorkers() > n_threads)
+    {
+        *p_in_status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Wrong number of workers");
+        return;
+    }
+
+    for(int b = 0; b < n_batches; b++)
+    {
+        TestJob job(n_jobs, pool.getNumWorkers());
+        pool.run(&job, n_jobs);
+
+        int n_bad = 0;
+        for(int i = 0; i < n_jobs; i++)
+        {
+            if(job.m_viRuns[i] != 1 || job.m_vdResults[i] != expected[i])
+            {
+                n_bad++;
+            }
+        }
+        if(n_bad || job.m_iBadWorker || job.m_iOverlap)
+        {
+            *p_in_status = MT_TEST_ERROR;
+            MT_TEST_ERROR_MESSAGE("Jobs not run exactly once each");
+            fprintf(stderr, "    + %d threads, batch %d:  %d bad jobs, "
+                    "%d bad workers, %d overlaps\n",
+                    n_threads, b, n_bad, job.m_iBadWorker, job.m_iOverlap);
+            return;
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int status = MT_TEST_SUCCESS;
+
+    const int n_jobs = 200;
+
+    /* reference results, without a pool */
+    TestJob reference(n_jobs, 1);
+    for(int i = 0; i < n_jobs; i++)
+    {
+        reference.doJob(i, 0);
+    }
+
+    /**************************************************/
+    MT_TEST_START("MT_WorkerPool results independent of thread count");
+
+    POOL_TEST(1, n_jobs, 3, reference.m_vdResults, &status);
+    POOL_TEST(2, n_jobs, 3, reference.m_vdResults, &status);
+    POOL_TEST(4, n_jobs, 50, reference.m_vdResults, &status);
+    POOL_TEST(8, n_jobs, 3, reference.m_vdResults, &status);
+
+    /**************************************************/
+    MT_TEST_START("MT_WorkerPool fewer jobs than threads");
+
+    POOL_TEST(8, 1, 3, reference.m_vdResults, &status);
+    POOL_TEST(8, 3, 50, reference.m_vdResults, &status);
+
+    /**************************************************/
+    MT_TEST_START("MT_WorkerPool one thread per core");
+
+    MT_WorkerPool pool;
+    if(pool.getNumWorkers() < 1 || pool.getNumWorkers() > MT_WorkerPool::getNumCores())
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Wrong number of workers");
+    }
+    pool.run(NULL, 0);
+
+    /**************************************************/
+    MT_TEST_START("MT_WorkerPool::runChunked");
+
+    MT_WorkerPool chunk_pool(4);
+    CHUNK_TEST(&chunk_pool, 1000, 64, 0, &status);
+    CHUNK_TEST(&chunk_pool, 1001, 64, 0, &status);
+    CHUNK_TEST(&chunk_pool, 63, 64, 0, &status);
+    CHUNK_TEST(&chunk_pool, 1000, 1, 0, &status);
+    CHUNK_TEST(&chunk_pool, 1000, 0, 0, &status);
+    CHUNK_TEST(&chunk_pool, 1000, 64, 1001, &status);
+    chunk_pool.runChunked(NULL, 0, 64);
+
+    return status;
+}
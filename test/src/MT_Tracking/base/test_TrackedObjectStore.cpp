@@ -0,0 +1,373 @@
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+#include "MT_Test.h"
+
+#include "MT/MT_Core/support/mathsupport.h"
+#include "MT/MT_Tracking/base/MT_TrackedObjectStore.h"
+
+/* Checks the batched constant velocity Kalman filter of
+ * MT_TrackedObjectStore against a plain one object at a time, and the
+ * spans against the per-object accessors. */
+
+static double randomUniform(double a, double b)
+{
+    return a + (b - a)*((double) rand())/RAND_MAX;
+}
+
+/* one object's filter, written out with general matrix products */
+struct Reference
+{
+    double x[4];
+    double P[4][4];
+
+    void reset(double x0, double y0, double r, double v0)
+    {
+        x[0] = x0;  x[1] = y0;  x[2] = x[3] = 0;
+        for(int i = 0; i < 4; i++)
+        {
+            for(int j = 0; j < 4; j++)
+            {
+                P[i][j] = 0;
+            }
+        }
+        P[0][0] = P[1][1] = r;
+        P[2][2] = P[3][3] = v0;
+    }
+
+    void predict(double dt, double q)
+    {
+        double F[4][4] = {{1, 0, dt, 0}, {0, 1, 0, dt}, {0, 0, 1, 0}, {0, 0, 0, 1}};
+        double G[4][2] = {{0.5*dt*dt, 0}, {0, 0.5*dt*dt}, {dt, 0}, {0, dt}};
+        double x1[4], FP[4][4];
+        for(int i = 0; i < 4; i++)
+        {
+            x1[i] = 0;
+            for(int k = 0; k < 4; k++)
+            {
+                x1[i] += F[i][k]*x[k];
+            }
+            for(int j = 0; j < 4; j++)
+            {
+                FP[i][j] = 0;
+                for(int k = 0; k < 4; k++)
+                {
+                    FP[i][j] += F[i][k]*P[k][j];
+                }
+            }
+        }
+        for(int i = 0; i < 4; i++)
+        {
+            x[i] = x1[i];
+            for(int j = 0; j < 4; j++)
+            {
+                /* F P F' + G q G' */
+                P[i][j] = q*(G[i][0]*G[j][0] + G[i][1]*G[j][1]);
+                for(int k = 0; k < 4; k++)
+                {
+                    P[i][j] += FP[i][k]*F[j][k];
+                }
+            }
+        }
+    }
+
+    void update(double zx, double zy, double r)
+    {
+        double S[2][2] = {{P[0][0] + r, P[0][1]}, {P[1][0], P[1][1] + r}};
+        double d = S[0][0]*S[1][1] - S[0][1]*S[1][0];
+        double Si[2][2] = {{S[1][1]/d, -S[0][1]/d}, {-S[1][0]/d, S[0][0]/d}};
+        double K[4][2];
+        for(int i = 0; i < 4; i++)
+        {
+            for(int j = 0; j < 2; j++)
+            {
+                K[i][j] = P[i][0]*Si[0][j] + P[i][1]*Si[1][j];
+            }
+        }
+        double e[2] = {zx - x[0], zy - x[1]};
+        double P1[4][4];
+        for(int i = 0; i < 4; i++)
+        {
+            x[i] += K[i][0]*e[0] + K[i][1]*e[1];
+            for(int j = 0; j < 4; j++)
+            {
+                P1[i][j] = P[i][j] - (K[i][0]*P[0][j] + K[i][1]*P[1][j]);
+            }
+        }
+        for(int i = 0; i < 4; i++)
+        {
+            for(int j = 0; j < 4; j++)
+            {
+                P[i][j] = P1[i][j];
+            }
+        }
+    }
+};
+
+int main(int argc, char** argv)
+{
+    int status = MT_TEST_SUCCESS;
+    srand(1);
+
+    const unsigned int n = 200;
+    const int n_frames = 100;
+    const double noise = 2.0;
+
+    MT_TrackedObjectStore store(n);
+    store.m_dProcessNoise = 0.05;
+    store.m_dMeasurementNoise = noise*noise;
+    std::vector<Reference> ref(n);
+
+    /* the actual objects */
+    std::vector<double> ax(n), ay(n), avx(n), avy(n);
+    std::vector<double> zx(n), zy(n);
+    std::vector<unsigned char> has(n);
+    for(unsigned int i = 0; i < n; i++)
+    {
+        ax[i] = randomUniform(0, 1000);
+        ay[i] = randomUniform(0, 1000);
+        avx[i] = randomUniform(-3, 3);
+        avy[i] = randomUniform(-3, 3);
+        store.reset(i, ax[i], ay[i]);
+        ref[i].reset(ax[i], ay[i], store.m_dMeasurementNoise,
+                     store.m_dInitialVelocityVariance);
+    }
+
+    /**************************************************/
+    MT_TEST_START("Batched Kalman filter vs one at a time");
+
+    int n_bad = 0;
+    double err_meas = 0;
+    double err_filt = 0;
+    for(int f = 0; f < n_frames; f++)
+    {
+        for(unsigned int i = 0; i < n; i++)
+        {
+            avx[i] += randomUniform(-0.1, 0.1);
+            avy[i] += randomUniform(-0.1, 0.1);
+            ax[i] += avx[i];
+            ay[i] += avy[i];
+            zx[i] = ax[i] + randomUniform(-noise, noise);
+            zy[i] = ay[i] + randomUniform(-noise, noise);
+            /* miss now and then */
+            has[i] = ((i + f) % 9 != 4);
+        }
+
+        store.doPredict();
+        store.setMeasurements(&zx[0], &zy[0], &has[0]);
+        store.doUpdate();
+
+        for(unsigned int i = 0; i < n; i++)
+        {
+            ref[i].predict(store.m_dDt, store.m_dProcessNoise);
+            if(has[i])
+            {
+                ref[i].update(zx[i], zy[i], store.m_dMeasurementNoise);
+            }
+
+            double* s = store.getState(i);
+            for(int r = 0; r < 4; r++)
+            {
+                if(fabs(s[r] - ref[i].x[r]) > 1e-9*(1 + fabs(ref[i].x[r])))
+                {
+                    n_bad++;
+                }
+                for(int c = 0; c < 4; c++)
+                {
+                    if(fabs(store.getCovariance(r, c)[i] - ref[i].P[r][c])
+                       > 1e-9*(1 + fabs(ref[i].P[r][c])))
+                    {
+                        n_bad++;
+                    }
+                }
+            }
+
+            if(f >= n_frames/2)
+            {
+                err_meas += (zx[i] - ax[i])*(zx[i] - ax[i])
+                    + (zy[i] - ay[i])*(zy[i] - ay[i]);
+                err_filt += (store.getX(i) - ax[i])*(store.getX(i) - ax[i])
+                    + (store.getY(i) - ay[i])*(store.getY(i) - ay[i]);
+            }
+        }
+    }
+    if(n_bad)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Batched and one at a time estimates differ");
+        fprintf(stderr, "    + %d differences\n", n_bad);
+    }
+    printf("  RMS error, measured %f, filtered %f\n",
+           sqrt(err_meas/(n*n_frames/2)), sqrt(err_filt/(n*n_frames/2)));
+    if(err_filt >= err_meas)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Filtering didn't reduce the error");
+    }
+
+    /**************************************************/
+    MT_TEST_START("Spans and per-object accessors");
+
+    MT_TrackedObjectsBase* objects = &store;
+    n_bad = 0;
+    for(unsigned int i = 0; i < n; i++)
+    {
+        if(objects->getX(i) != store.getXs()[i]
+           || objects->getY(i) != store.getYs()[i]
+           || objects->getState(i)[2] != store.getVXs()[i]
+           || objects->getState(i)[3] != store.getVYs()[i]
+           || store.getHasMeasurement()[i] != 0)
+        {
+            n_bad++;
+        }
+        if(objects->getNumConsecutiveFrames(i) != store.getNumConsecutiveFrames()[i]
+           || store.getNumConsecutiveFrames()[i] > 8)
+        {
+            n_bad++;
+        }
+    }
+
+    /* setXY sets the position unless it's to be taken as a
+     * measurement */
+    double state[] = {1.0, 2.0, 3.0, 4.0};
+    objects->setState(0, state);
+    objects->setXY(0, 5.0, 6.0);
+    if(store.getXs()[0] != 5.0 || store.getYs()[0] != 6.0 || store.getVXs()[0] != 3.0)
+    {
+        n_bad++;
+    }
+    store.m_bMeasureOnSetXY = true;
+    objects->setXY(0, 7.0, 8.0);
+    if(store.getXs()[0] != 5.0 || !store.getHasMeasurement()[0])
+    {
+        n_bad++;
+    }
+    double meas[] = {9.0, 10.0, 0.5};
+    objects->setMeasurement(1, meas);
+    if(!store.getHasMeasurement()[1] || objects->getOrientation(1) != 0.5
+       || objects->getMeasurement(1)[0] != 9.0)
+    {
+        n_bad++;
+    }
+    if(objects->getX(n) != 0 || objects->getState(n) != NULL
+       || objects->getKalmanFilterStruct(0) != NULL)
+    {
+        n_bad++;
+    }
+    if(n_bad)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Spans and accessors disagree");
+    }
+
+    /**************************************************/
+    MT_TEST_START("Chunked on a worker pool vs serial");
+
+    /* odd sizes so that the last chunk is short */
+    const unsigned int n_par = 5003;
+    MT_TrackedObjectStore serial(n_par);
+    MT_TrackedObjectStore parallel(n_par);
+    MT_WorkerPool pool(4);
+    parallel.setWorkerPool(&pool, 100, 0);
+    zx.resize(n_par);
+    zy.resize(n_par);
+    has.resize(n_par);
+    for(unsigned int i = 0; i < n_par; i++)
+    {
+        double x0 = randomUniform(0, 1000);
+        double y0 = randomUniform(0, 1000);
+        serial.reset(i, x0, y0);
+        parallel.reset(i, x0, y0);
+    }
+    n_bad = 0;
+    for(int f = 0; f < 20; f++)
+    {
+        for(unsigned int i = 0; i < n_par; i++)
+        {
+            zx[i] = serial.getX(i) + randomUniform(-3, 3);
+            zy[i] = serial.getY(i) + randomUniform(-3, 3);
+            has[i] = ((i + f) % 7 != 2);
+        }
+        serial.doPredict();
+        parallel.doPredict();
+        serial.setMeasurements(&zx[0], &zy[0], &has[0]);
+        parallel.setMeasurements(&zx[0], &zy[0], &has[0]);
+        serial.doUpdate();
+        parallel.doUpdate();
+    }
+    for(unsigned int i = 0; i < n_par; i++)
+    {
+        /* same operations in the same order, so exactly equal */
+        if(serial.getXs()[i] != parallel.getXs()[i]
+           || serial.getYs()[i] != parallel.getYs()[i]
+           || serial.getVXs()[i] != parallel.getVXs()[i]
+           || serial.getVYs()[i] != parallel.getVYs()[i]
+           || serial.getNumConsecutiveFrames()[i] != parallel.getNumConsecutiveFrames()[i])
+        {
+            n_bad++;
+        }
+        for(unsigned int k = 0; k < 16; k++)
+        {
+            if(serial.getCovariance(k/4, k%4)[i] != parallel.getCovariance(k/4, k%4)[i])
+            {
+                n_bad++;
+            }
+        }
+    }
+    if(n_bad)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Parallel and serial estimates differ");
+        fprintf(stderr, "    + %d differences\n", n_bad);
+    }
+
+    /**************************************************/
+    MT_TEST_START("Timing, 1000 objects");
+
+    MT_TrackedObjectStore big(1000);
+    zx.resize(1000);
+    zy.resize(1000);
+    for(unsigned int i = 0; i < 1000; i++)
+    {
+        big.reset(i, randomUniform(0, 1000), randomUniform(0, 1000));
+        zx[i] = big.getX(i);
+        zy[i] = big.getY(i);
+    }
+    double t0 = MT_getTimeSec();
+    for(int f = 0; f < 1000; f++)
+    {
+        big.doPredict();
+        big.setMeasurements(&zx[0], &zy[0]);
+        big.doUpdate();
+    }
+    printf("  1000 objects:  %f us per frame\n", 1e3*(MT_getTimeSec() - t0));
+
+    /* serial vs the default pool settings on a large store */
+    const unsigned int n_big = 100000;
+    MT_TrackedObjectStore huge(n_big);
+    MT_WorkerPool core_pool;
+    zx.resize(n_big);
+    zy.resize(n_big);
+    for(unsigned int i = 0; i < n_big; i++)
+    {
+        huge.reset(i, randomUniform(0, 1000), randomUniform(0, 1000));
+        zx[i] = huge.getX(i);
+        zy[i] = huge.getY(i);
+    }
+    for(int p = 0; p < 2; p++)
+    {
+        huge.setWorkerPool(p ? &core_pool : NULL);
+        t0 = MT_getTimeSec();
+        for(int f = 0; f < 100; f++)
+        {
+            huge.doPredict();
+            huge.setMeasurements(&zx[0], &zy[0]);
+            huge.doUpdate();
+        }
+        printf("  %d objects, %d worker(s):  %f us per frame\n", n_big,
+               p ? core_pool.getNumWorkers() : 1, 1e4*(MT_getTimeSec() - t0));
+    }
+
+    return status;
+}
@@ -0,0 +1,221 @@
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+#include "MT_Test.h"
+
+#include "MT/MT_Tracking/cv/MT_ChunkStitcher.h"
+
+/* Objects wandering about, tracked in overlapping chunks that each
+ * number the objects their own (shuffled) way, checking that the
+ * stitched identities follow the objects. */
+
+static double randomUniform(double a, double b)
+{
+    return a + (b - a)*((double) rand())/RAND_MAX;
+}
+
+typedef std::vector<std::vector<double> > Rows;
+
+/* true positions, [frame][object] */
+static void makePaths(int n_objects, int n_frames, Rows* xs, Rows* ys)
+{
+    xs->assign(n_frames, std::vector<double>(n_objects));
+    ys->assign(n_frames, std::vector<double>(n_objects));
+    for(int k = 0; k < n_objects; k++)
+    {
+        double x = 50.0 + 100.0*(k % 5);
+        double y = 50.0 + 100.0*(k/5);
+        double vx = 0, vy = 0;
+        for(int f = 0; f < n_frames; f++)
+        {
+            vx = 0.9*vx + randomUniform(-0.5, 0.5);
+            vy = 0.9*vy + randomUniform(-0.5, 0.5);
+            x += vx;
+            y += vy;
+            (*xs)[f][k] = x;
+            (*ys)[f][k] = y;
+        }
+    }
+}
+
+/* what a chunk's tracker reports for frames first .. end - 1:
+ * objects[j] is the true object of its object j, with a bit of noise */
+static void trackChunk(const Rows& xs, const Rows& ys,
+                       int first, int end,
+                       const std::vector<int>& objects,
+                       Rows* cx, Rows* cy)
+{
+    cx->resize(0);
+    cy->resize(0);
+    for(int f = first; f < end; f++)
+    {
+        std::vector<double> rx(objects.size()), ry(objects.size());
+        for(unsigned int j = 0; j < objects.size(); j++)
+        {
+            rx[j] = xs[f][objects[j]] + randomUniform(-1, 1);
+            ry[j] = ys[f][objects[j]] + randomUniform(-1, 1);
+        }
+        cx->push_back(rx);
+        cy->push_back(ry);
+    }
+}
+
+static Rows slice(const Rows& rows, int begin, int end)
+{
+    return Rows(rows.begin() + begin, rows.begin() + end);
+}
+
+int main(int argc, char** argv)
+{
+    int status = MT_TEST_SUCCESS;
+    srand(1);
+
+    const int n_objects = 20;
+    const int n_frames = 1000;
+    const int n_chunks = 8;
+    const int overlap = 20;
+    Rows xs, ys;
+    makePaths(n_objects, n_frames, &xs, &ys);
+
+    /**************************************************/
+    MT_TEST_START("MT_ChunkStitcher identities");
+
+    MT_ChunkStitcher stitcher;
+    /* identity -> true object, -1 until seen */
+    std::vector<int> identity_object(n_objects, -1);
+    Rows prev_x, prev_y;
+    int prev_first = 0;
+    int n_bad = 0;
+    for(int k = 0; k < n_chunks; k++)
+    {
+        int start = k*n_frames/n_chunks;
+        int end = (k + 1)*n_frames/n_chunks;
+        int first = std::max(0, start - overlap);
+
+        std::vector<int> objects(n_objects);
+        for(int j = 0; j < n_objects; j++)
+        {
+            objects[j] = j;
+        }
+        std::random_shuffle(objects.begin(), objects.end());
+
+        Rows cx, cy;
+        trackChunk(xs, ys, first, end, objects, &cx, &cy);
+
+        std::vector<int> ids;
+        if(k == 0)
+        {
+            ids = stitcher.addChunk(n_objects);
+        }
+        else
+        {
+            ids = stitcher.addChunk(n_objects,
+                                    slice(prev_x, first - prev_first, start - prev_first),
+                                    slice(prev_y, first - prev_first, start - prev_first),
+                                    slice(cx, 0, start - first),
+                                    slice(cy, 0, start - first));
+            if(stitcher.getNumMatched() != n_objects
+               || stitcher.getRMSDistance() > 3.0)
+            {
+                n_bad++;
+            }
+        }
+
+        for(int j = 0; j < n_objects; j++)
+        {
+            int id = ids[j];
+            if(id < 0 || id >= n_objects)
+            {
+                n_bad++;
+                continue;
+            }
+            if(identity_object[id] < 0)
+            {
+                identity_object[id] = objects[j];
+            }
+            else if(identity_object[id] != objects[j])
+            {
+                n_bad++;
+            }
+        }
+
+        prev_x = cx;
+        prev_y = cy;
+        prev_first = first;
+    }
+    if(stitcher.getNumIdentities() != n_objects)
+    {
+        n_bad++;
+    }
+    if(n_bad)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Identities didn't follow the objects");
+        fprintf(stderr, "    + %d mistakes\n", n_bad);
+    }
+
+    /**************************************************/
+    MT_TEST_START("MT_ChunkStitcher arrivals, departures and NaNs");
+
+    /* chunk 0 sees objects 0 .. 9, chunk 1 objects 1 .. 10 and loses
+     * track of object 5 half of the time in the overlap */
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    stitcher.reset();
+    n_bad = 0;
+
+    std::vector<int> objects0, objects1;
+    for(int k = 0; k < 10; k++)
+    {
+        objects0.push_back(k);
+        objects1.push_back(10 - k);
+    }
+    Rows c0x, c0y, c1x, c1y;
+    trackChunk(xs, ys, 0, 100, objects0, &c0x, &c0y);
+    trackChunk(xs, ys, 80, 200, objects1, &c1x, &c1y);
+    for(int f = 0; f < 20; f += 2)
+    {
+        /* object 5 is at index 5 in both */
+        c1x[f][5] = nan;
+        c1y[f][5] = nan;
+    }
+
+    std::vector<int> ids0 = stitcher.addChunk(objects0.size());
+    std::vector<int> ids1 = stitcher.addChunk(objects1.size(),
+                                              slice(c0x, 80, 100),
+                                              slice(c0y, 80, 100),
+                                              slice(c1x, 0, 20),
+                                              slice(c1y, 0, 20));
+    for(unsigned int j = 0; j < objects1.size(); j++)
+    {
+        int obj = objects1[j];
+        if(obj < 10)
+        {
+            /* should have object obj's identity from chunk 0 */
+            if(ids1[j] != ids0[obj])
+            {
+                n_bad++;
+            }
+        }
+        else if(ids1[j] != 10)
+        {
+            /* the newcomer should get a new identity */
+            n_bad++;
+        }
+    }
+    if(stitcher.getNumMatched() != 9 || stitcher.getNumIdentities() != 11)
+    {
+        n_bad++;
+    }
+    if(n_bad)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Wrong identities with objects coming and going");
+        fprintf(stderr, "    + %d mistakes, %d matched, %d identities\n",
+                n_bad, stitcher.getNumMatched(), stitcher.getNumIdentities());
+    }
+
+    return status;
+}
@@ -0,0 +1,273 @@
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+#include "MT_Test.h"
+
+#include "MT/MT_Core/support/mathsupport.h"
+#include "MT/MT_Tracking/cv/MT_GatedMatcher.h"
+#include "MT/MT_Tracking/cv/MT_LAPJV.h"
+
+/* Checks the gated matcher against the dense LAPJV solution. */
+
+static double randomUniform(double a, double b)
+{
+    return a + (b - a)*((double) rand())/RAND_MAX;
+}
+
+/* n tracks spread out on a grid (spacing apart) with detections
+ * that moved by up to jitter */
+static void makeScene(int n, double spacing, double jitter,
+                      std::vector<double>* xs,
+                      std::vector<double>* ys,
+                      std::vector<MT_GatedTrack>* tracks)
+{
+    int side = (int) ceil(sqrt((double) n));
+    xs->resize(n);
+    ys->resize(n);
+    tracks->resize(n);
+    for(int j = 0; j < n; j++)
+    {
+        MT_GatedTrack& t = (*tracks)[j];
+        t.x = t.gate_x = spacing*(j % side) + randomUniform(-5, 5);
+        t.y = t.gate_y = spacing*(j/side) + randomUniform(-5, 5);
+        t.gate_pxx = t.gate_pyy = jitter*jitter;
+        t.gate_pxy = 0;
+        t.gate_k = 3;
+    }
+    /* detections in a different order from the tracks */
+    for(int j = 0; j < n; j++)
+    {
+        int i = n - 1 - j;
+        (*xs)[i] = (*tracks)[j].x + randomUniform(-jitter, jitter);
+        (*ys)[i] = (*tracks)[j].y + randomUniform(-jitter, jitter);
+    }
+}
+
+static double denseMatch(MT_LAPJV* solver,
+                         const std::vector<double>& xs,
+                         const std::vector<double>& ys,
+                         const std::vector<MT_GatedTrack>& tracks,
+                         std::vector<double>* cost,
+                         std::vector<int>* a)
+{
+    int n = xs.size();
+    int m = tracks.size();
+    cost->resize(n*m);
+    for(int i = 0; i < n; i++)
+    {
+        for(int j = 0; j < m; j++)
+        {
+            double dx = xs[i] - tracks[j].x;
+            double dy = ys[i] - tracks[j].y;
+            (*cost)[i*m + j] = dx*dx + dy*dy;
+        }
+    }
+    return solver->solve(&(*cost)[0], n, m, a);
+}
+
+/* -1 if a isn't a one-to-one assignment using min(n, m) pairs */
+static double total(const std::vector<double>& xs,
+                    const std::vector<double>& ys,
+                    const std::vector<MT_GatedTrack>& tracks,
+                    const std::vector<int>& a)
+{
+    int n = xs.size();
+    int m = tracks.size();
+    std::vector<int> used(m, 0);
+    int assigned = 0;
+    double t = 0;
+    for(int i = 0; i < n; i++)
+    {
+        if(a[i] < 0)
+        {
+            continue;
+        }
+        if(a[i] >= m || used[a[i]]++)
+        {
+            return -1;
+        }
+        assigned++;
+        double dx = xs[i] - tracks[a[i]].x;
+        double dy = ys[i] - tracks[a[i]].y;
+        t += dx*dx + dy*dy;
+    }
+    return (assigned == MT_MIN(n, m)) ? t : -1;
+}
+
+int main(int argc, char** argv)
+{
+    int status = MT_TEST_SUCCESS;
+    std::vector<double> xs, ys, cost;
+    std::vector<MT_GatedTrack> tracks;
+    std::vector<int> a_d, a_g;
+    MT_LAPJV dense;
+    MT_GatedMatcher gated;
+    srand(1);
+
+    /**************************************************/
+    MT_TEST_START("Gated vs dense, spread out");
+
+    int n_bad = 0;
+    for(int t = 0; t < 50; t++)
+    {
+        int n = 1 + t*3;
+        makeScene(n, 50.0, 10.0, &xs, &ys, &tracks);
+        double td = denseMatch(&dense, xs, ys, tracks, &cost, &a_d);
+        gated.doMatch(xs, ys, tracks, &a_g);
+        double tg = total(xs, ys, tracks, a_g);
+        if(tg < 0 || fabs(tg - td) > 1e-6*(1 + td))
+        {
+            n_bad++;
+            fprintf(stderr, "    + %d objects:  dense %f, gated %f\n", n, td, tg);
+        }
+    }
+    if(n_bad)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Gated and dense totals differ");
+    }
+
+    /**************************************************/
+    MT_TEST_START("Gated vs dense, crowded");
+
+    /* gates overlapping a lot, so fewer and bigger subproblems */
+    n_bad = 0;
+    for(int t = 0; t < 50; t++)
+    {
+        int n = 2 + t;
+        makeScene(n, 10.0, 8.0, &xs, &ys, &tracks);
+        double td = denseMatch(&dense, xs, ys, tracks, &cost, &a_d);
+        gated.doMatch(xs, ys, tracks, &a_g);
+        double tg = total(xs, ys, tracks, a_g);
+        if(tg < 0 || fabs(tg - td) > 1e-6*(1 + td))
+        {
+            n_bad++;
+            fprintf(stderr, "    + %d objects:  dense %f, gated %f\n", n, td, tg);
+        }
+    }
+    if(n_bad)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Gated and dense totals differ");
+    }
+
+    /**************************************************/
+    MT_TEST_START("Detections outside every gate");
+
+    makeScene(25, 50.0, 5.0, &xs, &ys, &tracks);
+    /* move one detection far away, it still gets a track */
+    xs[4] = 1e4;
+    ys[4] = -1e4;
+    gated.doMatch(xs, ys, tracks, &a_g);
+    if(total(xs, ys, tracks, a_g) < 0 || a_g[4] < 0)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Not a full assignment");
+    }
+
+    /* more tracks than detections */
+    makeScene(25, 50.0, 5.0, &xs, &ys, &tracks);
+    xs.resize(20);
+    ys.resize(20);
+    gated.doMatch(xs, ys, tracks, &a_g);
+    if(total(xs, ys, tracks, a_g) < 0)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Not a full assignment with more tracks");
+    }
+
+    /**************************************************/
+    MT_TEST_START("Gate of a diagonally moving track");
+
+    /* P = s^2 I + v v' with v = (10, 10) and s = 2, 3 sigmas:  the
+     * gate reaches 3*sqrt(204) = 42.8 along the motion and only 6
+     * across it, while the axis aligned ellipse through its bounding
+     * box has semi-axes 3*sqrt(104) = 30.6 */
+    tracks.resize(1);
+    tracks[0].x = 90;
+    tracks[0].y = 90;
+    tracks[0].gate_x = 100;
+    tracks[0].gate_y = 100;
+    tracks[0].gate_pxx = 4 + 100;
+    tracks[0].gate_pxy = 100;
+    tracks[0].gate_pyy = 4 + 100;
+    tracks[0].gate_k = 3;
+    n_bad = 0;
+    /* 40 along the motion:  inside the gate, outside the axis
+     * aligned ellipse */
+    xs.assign(1, 100 + 40/sqrt(2.0));
+    ys.assign(1, 100 + 40/sqrt(2.0));
+    if(gated.doMatch(xs, ys, tracks, &a_g) != 1 || a_g[0] != 0)
+    {
+        n_bad++;
+    }
+    /* 15 across the motion:  the other way around */
+    xs.assign(1, 100 + 15/sqrt(2.0));
+    ys.assign(1, 100 - 15/sqrt(2.0));
+    if(gated.doMatch(xs, ys, tracks, &a_g) != 0 || a_g[0] != 0)
+    {
+        n_bad++;
+    }
+    /* both, only the first is a candidate */
+    xs.assign(2, 0);
+    ys.assign(2, 0);
+    xs[0] = 100 + 15/sqrt(2.0);  ys[0] = 100 - 15/sqrt(2.0);
+    xs[1] = 100 + 40/sqrt(2.0);  ys[1] = 100 + 40/sqrt(2.0);
+    if(gated.doMatch(xs, ys, tracks, &a_g) != 1 || a_g[1] != 0 || a_g[0] != -1)
+    {
+        n_bad++;
+    }
+    if(n_bad)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Gate isn't the covariance ellipse");
+        fprintf(stderr, "    + %d mistakes\n", n_bad);
+    }
+
+    /**************************************************/
+    MT_TEST_START("Subproblems");
+
+    makeScene(100, 50.0, 5.0, &xs, &ys, &tracks);
+    gated.doMatch(xs, ys, tracks, &a_g);
+    /* far apart gates, every track on its own */
+    if(gated.getNumSubproblems() != 100 || gated.getLargestSubproblem() != 2)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Expected 100 subproblems of 2");
+        fprintf(stderr, "    + %d subproblems, largest %d\n",
+                gated.getNumSubproblems(), gated.getLargestSubproblem());
+    }
+
+    /**************************************************/
+    MT_TEST_START("Timing, 1000 objects");
+
+    const int n_obj = 1000;
+    double t_d = 0, t_g = 0;
+    n_bad = 0;
+    for(int f = 0; f < 5; f++)
+    {
+        makeScene(n_obj, 30.0, 8.0, &xs, &ys, &tracks);
+        double t0 = MT_getTimeSec();
+        double td = denseMatch(&dense, xs, ys, tracks, &cost, &a_d);
+        double t1 = MT_getTimeSec();
+        gated.doMatch(xs, ys, tracks, &a_g);
+        double t2 = MT_getTimeSec();
+        t_d += t1 - t0;
+        t_g += t2 - t1;
+        double tg = total(xs, ys, tracks, a_g);
+        if(tg < 0 || fabs(tg - td) > 1e-6*(1 + td))
+        {
+            n_bad++;
+        }
+    }
+    printf("  %d objects, 5 frames:  dense %f s, gated %f s (%d subproblems, largest %d)\n",
+           n_obj, t_d, t_g, gated.getNumSubproblems(), gated.getLargestSubproblem());
+    if(n_bad)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Gated and dense totals differ");
+    }
+
+    return status;
+}
@@ -0,0 +1,357 @@
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+#include "MT_Test.h"
+
+#include "MT/MT_Core/support/mathsupport.h"
+#include "MT/MT_Tracking/cv/MT_HungarianMatcher.h"
+#include "MT/MT_Tracking/cv/MT_LAPJV.h"
+
+/* Checks the LAPJV solver against libhungarian and, for small
+ * problems, against trying every assignment. */
+
+static double randomCost(bool integer)
+{
+    double r = ((double) rand())/RAND_MAX;
+    return integer ? floor(1000.0*r) : 1000.0*r;
+}
+
+/* total of the assignment, -1 if it isn't one (a column used twice
+ * or a row left over when it didn't have to be) */
+static double total(const std::vector<double>& c,
+                    int m, int n,
+                    const std::vector<int>& a)
+{
+    if((int) a.size() != m)
+    {
+        return -1;
+    }
+    std::vector<int> used(n, 0);
+    int assigned = 0;
+    double t = 0;
+    for(int i = 0; i < m; i++)
+    {
+        if(a[i] < 0)
+        {
+            continue;
+        }
+        if(a[i] >= n || used[a[i]]++)
+        {
+            return -1;
+        }
+        assigned++;
+        t += c[i*n + a[i]];
+    }
+    return (assigned == MT_MIN(m, n)) ? t : -1;
+}
+
+static double match(const std::vector<double>& c, int m, int n,
+                    int mode, int algorithm, std::vector<int>* a)
+{
+    MT_HungarianMatcher matcher;
+    matcher.doInit(m, n, mode, algorithm);
+    for(int i = 0; i < m; i++)
+    {
+        for(int j = 0; j < n; j++)
+        {
+            matcher.setValue(i, j, c[i*n + j]);
+        }
+    }
+    a->resize(m);
+    matcher.doMatch(a);
+    return total(c, m, n, *a);
+}
+
+static std::vector<double> transpose(const std::vector<double>& c, int m, int n)
+{
+    std::vector<double> t(m*n);
+    for(int i = 0; i < m; i++)
+    {
+        for(int j = 0; j < n; j++)
+        {
+            t[j*m + i] = c[i*n + j];
+        }
+    }
+    return t;
+}
+
+/* the best assignment of an n x n problem by trying every one */
+static double bruteForce(const std::vector<double>& c, int n)
+{
+    std::vector<int> p(n);
+    for(int i = 0; i < n; i++)
+    {
+        p[i] = i;
+    }
+    double best = 1e300;
+    do
+    {
+        double t = 0;
+        for(int i = 0; i < n; i++)
+        {
+            t += c[i*n + p[i]];
+        }
+        best = MT_MIN(best, t);
+    } while(std::next_permutation(p.begin(), p.end()));
+    return best;
+}
+
+int main(int argc, char** argv)
+{
+    int status = MT_TEST_SUCCESS;
+    std::vector<int> a_h, a_j;
+    srand(1);
+
+    /**************************************************/
+    MT_TEST_START("LAPJV vs Hungarian, square");
+
+    int n_bad = 0;
+    for(int t = 0; t < 200; t++)
+    {
+        int n = 1 + t % 40;
+        int mode = (t % 3 == 0) ? HUNGARIAN_MAX : HUNGARIAN_MIN;
+        std::vector<double> c(n*n);
+        for(int k = 0; k < n*n; k++)
+        {
+            c[k] = randomCost(true);
+        }
+        /* some ties */
+        if(t % 5 == 0)
+        {
+            for(int k = 0; k < n*n; k += 3)
+            {
+                c[k] = 500;
+            }
+        }
+        double th = match(c, n, n, mode, MT_HM_HUNGARIAN, &a_h);
+        double tj = match(c, n, n, mode, MT_HM_LAPJV, &a_j);
+        if(th < 0 || tj < 0 || fabs(th - tj) > 1e-6)
+        {
+            n_bad++;
+            fprintf(stderr, "    + %d x %d (%s):  Hungarian %f, LAPJV %f\n",
+                    n, n, mode == HUNGARIAN_MAX ? "max" : "min", th, tj);
+        }
+    }
+    if(n_bad)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("LAPJV and Hungarian totals differ");
+    }
+
+    /**************************************************/
+    MT_TEST_START("LAPJV vs Hungarian, rectangular");
+
+    n_bad = 0;
+    for(int t = 0; t < 100; t++)
+    {
+        int m = 1 + t % 17;
+        int n = m + 1 + (t*7) % 13;
+        std::vector<double> c(m*n);
+        for(int k = 0; k < m*n; k++)
+        {
+            c[k] = randomCost(true);
+        }
+
+        /* fewer rows than columns */
+        double th = match(c, m, n, HUNGARIAN_MIN, MT_HM_HUNGARIAN, &a_h);
+        double tj = match(c, m, n, HUNGARIAN_MIN, MT_HM_LAPJV, &a_j);
+        if(th < 0 || tj < 0 || fabs(th - tj) > 1e-6)
+        {
+            n_bad++;
+            fprintf(stderr, "    + %d x %d:  Hungarian %f, LAPJV %f\n", m, n, th, tj);
+        }
+
+        /* more rows than columns, which libhungarian can only do
+         * transposed */
+        std::vector<double> ct = transpose(c, m, n);
+        tj = match(ct, n, m, HUNGARIAN_MIN, MT_HM_LAPJV, &a_j);
+        if(tj < 0 || fabs(th - tj) > 1e-6)
+        {
+            n_bad++;
+            fprintf(stderr, "    + %d x %d:  Hungarian (transposed) %f, LAPJV %f\n",
+                    n, m, th, tj);
+        }
+    }
+    if(n_bad)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("LAPJV and Hungarian totals differ");
+    }
+
+    /**************************************************/
+    MT_TEST_START("LAPJV double precision");
+
+    /* differences well below the Hungarian's integer resolution */
+    n_bad = 0;
+    for(int t = 0; t < 50; t++)
+    {
+        int n = 2 + t % 6;
+        std::vector<double> c(n*n);
+        for(int k = 0; k < n*n; k++)
+        {
+            c[k] = 1000.0 + 1e-6*randomCost(false);
+        }
+        double best = bruteForce(c, n);
+        double tj = match(c, n, n, HUNGARIAN_MIN, MT_HM_LAPJV, &a_j);
+        if(tj < 0 || fabs(tj - best) > 1e-9)
+        {
+            n_bad++;
+            fprintf(stderr, "    + %d x %d:  best %.12f, LAPJV %.12f\n", n, n, best, tj);
+        }
+    }
+    if(n_bad)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("LAPJV not optimal");
+    }
+
+    /**************************************************/
+    MT_TEST_START("LAPJV reused between frames");
+
+    /* the same matcher, as in a tracker, on slowly moving points */
+    const int n_obj = 200;
+    std::vector<double> x(n_obj), y(n_obj), c(n_obj*n_obj);
+    for(int i = 0; i < n_obj; i++)
+    {
+        x[i] = randomCost(false);
+        y[i] = randomCost(false);
+    }
+    MT_HungarianMatcher hm, jv;
+    hm.doInit(n_obj);
+    jv.doInit(n_obj, MT_HM_SAME, HUNGARIAN_MIN, MT_HM_LAPJV);
+    double t_h = 0, t_j = 0;
+    n_bad = 0;
+    for(int f = 0; f < 10; f++)
+    {
+        for(int i = 0; i < n_obj; i++)
+        {
+            for(int j = 0; j < n_obj; j++)
+            {
+                double dx = x[i] + randomCost(false)/100.0 - x[j];
+                double dy = y[i] + randomCost(false)/100.0 - y[j];
+                c[i*n_obj + j] = dx*dx + dy*dy;
+                hm.setValue(i, j, c[i*n_obj + j]);
+                jv.setValue(i, j, c[i*n_obj + j]);
+            }
+        }
+        a_h.resize(n_obj);
+        a_j.resize(n_obj);
+        double t0 = MT_getTimeSec();
+        hm.doMatch(&a_h);
+        double t1 = MT_getTimeSec();
+        jv.doMatch(&a_j);
+        double t2 = MT_getTimeSec();
+        t_h += t1 - t0;
+        t_j += t2 - t1;
+
+        double th = total(c, n_obj, n_obj, a_h);
+        double tj = total(c, n_obj, n_obj, a_j);
+        /* the Hungarian's integer scaling costs it some precision */
+        if(tj < 0 || tj > th + 1e-6)
+        {
+            n_bad++;
+        }
+    }
+    printf("  %d objects, 10 frames:  Hungarian %f s, LAPJV %f s\n", n_obj, t_h, t_j);
+    if(n_bad)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("LAPJV worse than Hungarian");
+    }
+
+    /**************************************************/
+    MT_TEST_START("LAPJV warm start");
+
+    /* warm and cold on the same sequence, with the detections
+     * shuffled every frame, a jump now and then and a change of size */
+    MT_LAPJV cold, warm;
+    warm.setWarmStart(true);
+    std::vector<double> cx, cy;
+    int aug_cold = 0, aug_warm = 0;
+    n_bad = 0;
+    for(int f = 0; f < 60; f++)
+    {
+        int n = (f < 40) ? 50 : 30;
+        if(f == 0 || f == 40)
+        {
+            x.resize(n);
+            y.resize(n);
+            for(int j = 0; j < n; j++)
+            {
+                x[j] = randomCost(false);
+                y[j] = randomCost(false);
+            }
+        }
+        for(int j = 0; j < n; j++)
+        {
+            x[j] += randomCost(false)/100.0 - 5.0;
+            y[j] += randomCost(false)/100.0 - 5.0;
+        }
+        if(f % 10 == 5)
+        {
+            x[f % n] = randomCost(false);
+        }
+        cx = x;
+        cy = y;
+        std::random_shuffle(cx.begin(), cx.end());
+        c.resize(n*n);
+        for(int i = 0; i < n; i++)
+        {
+            for(int j = 0; j < n; j++)
+            {
+                double dx = cx[i] - x[j] + randomCost(false)/100.0;
+                double dy = cy[i] - y[j] + randomCost(false)/100.0;
+                c[i*n + j] = dx*dx + dy*dy;
+            }
+        }
+        double tc = cold.solve(&c[0], n, n, &a_h);
+        double tw = warm.solve(&c[0], n, n, &a_j);
+        if(total(c, n, n, a_j) < 0 || fabs(tc - tw) > 1e-9*(1 + tc)
+           || warm.wasWarmStarted() != (f != 0 && f != 40))
+        {
+            n_bad++;
+            fprintf(stderr, "    + frame %d:  cold %.12f, warm %.12f\n", f, tc, tw);
+        }
+        aug_cold += cold.getNumAugmentations();
+        aug_warm += warm.getNumAugmentations();
+    }
+    printf("  augmenting paths:  cold %d, warm %d\n", aug_cold, aug_warm);
+    if(n_bad)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Warm started LAPJV not optimal");
+    }
+
+    /**************************************************/
+    MT_TEST_START("Elements outside the matrix");
+
+    /* should be ignored, not land on the last row or column (which
+     * would make the swapped assignment cheaper) */
+    n_bad = 0;
+    for(int alg = MT_HM_HUNGARIAN; alg <= MT_HM_LAPJV; alg++)
+    {
+        MT_HungarianMatcher m;
+        m.doInit(2, MT_HM_SAME, HUNGARIAN_MIN, alg);
+        m.setValue(0, 0, 1);
+        m.setValue(0, 1, 10);
+        m.setValue(1, 0, 10);
+        m.setValue(1, 1, 1);
+        m.setValue(2, 0, -100);
+        m.setValue(0, 2, -100);
+        a_h.resize(2);
+        m.doMatch(&a_h);
+        if(a_h[0] != 0 || a_h[1] != 1)
+        {
+            n_bad++;
+        }
+    }
+    if(n_bad)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Elements outside the matrix changed the match");
+    }
+
+    return status;
+}
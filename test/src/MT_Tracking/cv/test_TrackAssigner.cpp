@@ -0,0 +1,260 @@
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+#include "MT_Test.h"
+
+#include "MT/MT_Tracking/cv/MT_TrackAssigner.h"
+
+/* Objects moving about, with some leaving, some arriving and some
+ * spurious detections, checking that the track ids follow the
+ * objects. */
+
+static double randomUniform(double a, double b)
+{
+    return a + (b - a)*((double) rand())/RAND_MAX;
+}
+
+struct Object
+{
+    double x, y, vx, vy;
+    bool present;
+    int track_id;   /* id of the confirmed track following it, -1 if none */
+};
+
+static void moveObjects(std::vector<Object>* objects)
+{
+    for(unsigned int k = 0; k < objects->size(); k++)
+    {
+        Object& o = (*objects)[k];
+        o.vx = 0.9*o.vx + randomUniform(-0.5, 0.5);
+        o.vy = 0.9*o.vy + randomUniform(-0.5, 0.5);
+        o.x += o.vx;
+        o.y += o.vy;
+    }
+}
+
+/* detections of the objects present, shuffled, plus spurious ones;
+ * which[i] is the object of detection i or -1 */
+static void detect(const std::vector<Object>& objects,
+                   int n_spurious,
+                   std::vector<double>* xs,
+                   std::vector<double>* ys,
+                   std::vector<int>* which)
+{
+    which->resize(0);
+    for(unsigned int k = 0; k < objects.size(); k++)
+    {
+        if(objects[k].present)
+        {
+            which->push_back(k);
+        }
+    }
+    for(int s = 0; s < n_spurious; s++)
+    {
+        which->push_back(-1);
+    }
+    std::random_shuffle(which->begin(), which->end());
+    xs->resize(which->size());
+    ys->resize(which->size());
+    for(unsigned int i = 0; i < which->size(); i++)
+    {
+        int k = (*which)[i];
+        (*xs)[i] = (k >= 0) ? objects[k].x : randomUniform(0, 1000);
+        (*ys)[i] = (k >= 0) ? objects[k].y : randomUniform(0, 1000);
+    }
+}
+
+/* checks that every present object with a confirmed track is still
+ * matched to that track, records the ones that just got one;
+ * returns the number of mismatches */
+static int checkIDs(const MT_TrackAssigner& tracks,
+                    const std::vector<int>& which,
+                    std::vector<Object>* objects)
+{
+    int n_bad = 0;
+    const std::vector<int>& det_tracks = tracks.getDetectionTracks();
+    for(unsigned int k = 0; k < tracks.getNumTracks(); k++)
+    {
+        const MT_ManagedTrack& t = tracks.getTrack(k);
+        if(t.state != MT_TRACK_CONFIRMED || t.detection < 0)
+        {
+            continue;
+        }
+        if(det_tracks[t.detection] != t.id)
+        {
+            n_bad++;
+        }
+        int obj = which[t.detection];
+        if(obj < 0)
+        {
+            /* a confirmed track on a spurious detection */
+            n_bad++;
+            continue;
+        }
+        Object& o = (*objects)[obj];
+        if(o.track_id < 0)
+        {
+            o.track_id = t.id;
+        }
+        else if(o.track_id != t.id)
+        {
+            n_bad++;
+        }
+    }
+    return n_bad;
+}
+
+int main(int argc, char** argv)
+{
+    int status = MT_TEST_SUCCESS;
+    srand(1);
+
+    MT_TrackAssigner tracks;
+    std::vector<Object> objects(20);
+    std::vector<double> xs, ys;
+    std::vector<int> which;
+    for(unsigned int k = 0; k < objects.size(); k++)
+    {
+        objects[k].x = 25.0 + 100.0*(k % 5) + randomUniform(-10, 10);
+        objects[k].y = 25.0 + 100.0*(k/5) + randomUniform(-10, 10);
+        objects[k].vx = objects[k].vy = 0;
+        objects[k].present = true;
+        objects[k].track_id = -1;
+    }
+
+    /**************************************************/
+    MT_TEST_START("Confirming tracks");
+
+    int n_bad = 0;
+    for(int f = 0; f < 10; f++)
+    {
+        moveObjects(&objects);
+        detect(objects, 0, &xs, &ys, &which);
+        tracks.doUpdate(xs, ys);
+        n_bad += checkIDs(tracks, which, &objects);
+        unsigned int expected = (f + 1 >= tracks.m_iConfirmHits) ? objects.size() : 0;
+        if(tracks.getNumConfirmed() != expected || tracks.getNumTracks() != objects.size())
+        {
+            n_bad++;
+            fprintf(stderr, "    + frame %d:  %d tracks, %d confirmed\n",
+                    f, tracks.getNumTracks(), tracks.getNumConfirmed());
+        }
+    }
+    if(n_bad || tracks.getNumBirths() != (int) objects.size())
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Wrong tracks for a steady scene");
+    }
+
+    /**************************************************/
+    MT_TEST_START("Spurious detections");
+
+    n_bad = 0;
+    int births = tracks.getNumBirths();
+    for(int f = 0; f < 20; f++)
+    {
+        moveObjects(&objects);
+        /* one or two spurious blobs now and then */
+        detect(objects, (f % 4 == 0) ? 1 + f % 3 : 0, &xs, &ys, &which);
+        tracks.doUpdate(xs, ys);
+        n_bad += checkIDs(tracks, which, &objects);
+        if(tracks.getNumConfirmed() != objects.size())
+        {
+            n_bad++;
+        }
+    }
+    if(n_bad)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Spurious detections changed identities");
+    }
+    if(tracks.getNumBirths() == births)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Spurious detections didn't start tentative tracks");
+    }
+
+    /**************************************************/
+    MT_TEST_START("Objects leaving and arriving");
+
+    /* 3 leave */
+    n_bad = 0;
+    int deaths = tracks.getNumDeaths();
+    for(int k = 0; k < 3; k++)
+    {
+        objects[k].present = false;
+    }
+    for(int f = 0; f < tracks.m_iMaxMisses; f++)
+    {
+        moveObjects(&objects);
+        detect(objects, 0, &xs, &ys, &which);
+        tracks.doUpdate(xs, ys);
+        n_bad += checkIDs(tracks, which, &objects);
+    }
+    if(tracks.getNumDeaths() != deaths + 3 || tracks.getNumTracks() != objects.size() - 3)
+    {
+        n_bad++;
+        fprintf(stderr, "    + %d deaths, %d tracks\n",
+                tracks.getNumDeaths() - deaths, tracks.getNumTracks());
+    }
+
+    /* 2 come back somewhere else */
+    for(int k = 0; k < 2; k++)
+    {
+        objects[k].present = true;
+        objects[k].x = 800.0 + 100.0*k;
+        objects[k].y = 800.0;
+        objects[k].track_id = -1;
+    }
+    for(int f = 0; f < 10; f++)
+    {
+        moveObjects(&objects);
+        detect(objects, 0, &xs, &ys, &which);
+        tracks.doUpdate(xs, ys);
+        n_bad += checkIDs(tracks, which, &objects);
+    }
+    if(tracks.getNumConfirmed() != objects.size() - 1)
+    {
+        n_bad++;
+    }
+    for(int k = 0; k < 2; k++)
+    {
+        /* new ids */
+        if(objects[k].track_id < (int) objects.size())
+        {
+            n_bad++;
+        }
+    }
+    if(n_bad)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Wrong tracks when objects leave and arrive");
+    }
+
+    /**************************************************/
+    MT_TEST_START("No detections");
+
+    /* everything missed until deleted, then starting again */
+    for(int f = 0; f < tracks.m_iMaxMisses; f++)
+    {
+        xs.resize(0);
+        ys.resize(0);
+        tracks.doUpdate(xs, ys);
+    }
+    if(tracks.getNumTracks() != 0)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Tracks not deleted");
+    }
+    detect(objects, 0, &xs, &ys, &which);
+    tracks.doUpdate(xs, ys);
+    if(tracks.getNumTracks() != objects.size() - 1)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Tracks not started again");
+    }
+
+    return status;
+}
@@ -0,0 +1,158 @@
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+#include "MT_Test.h"
+
+#include "MT/MT_Tracking/trackers/GY/MixGaussians.h"
+
+/* Checks that binned EMMG (MixGaussians::m_iBinSize) ends up within
+ * its tolerance of the full resolution fit, on clumps of large fish.
+ * Both fits start near the fish so that they find the same optimum;
+ * the full resolution fit itself stops once nothing moves by more
+ * than a pixel or a degree, which adds to the tolerance. */
+
+const double tolerance = 0.5;
+const double full_convergence = 1.0;
+
+/* the angle of the major axis, in degrees */
+static double major_angle(const MT_Matrix2x2& S)
+{
+    return 0.5*atan2(2.0*S.data[1], S.data[0] - S.data[3])*180.0/M_PI;
+}
+
+static RawBlobPtr makeClump(int n_fish, double len, double width, int seed,
+                            MixGaussians* start = NULL)
+{
+    srand(seed);
+    RawBlobPtr blob(new GYRawBlob(n_fish*(int) (4*len*width)));
+    for(int k = 0; k < n_fish; k++)
+    {
+        /* side by side, touching */
+        double cx = 1000.0 + 2.1*width*k + 3.0*((double) rand())/RAND_MAX;
+        double cy = 800.0 + 0.2*len*(k % 2);
+        double th = M_PI/2 + 0.1*k + 0.2*((double) rand())/RAND_MAX;
+        if(start)
+        {
+            /* a bit off from the actual fish */
+            MT_Vector2 mean;
+            MT_Matrix2x2 cov;
+            double c = cos(th + 0.2);
+            double s = sin(th + 0.2);
+            double a = 0.3*len*len;
+            double b = 0.3*width*width;
+            mean.data[0] = cx + 3.0;
+            mean.data[1] = cy - 2.0;
+            cov.data[0] = c*c*a + s*s*b;
+            cov.data[1] = cov.data[2] = c*s*(a - b);
+            cov.data[3] = s*s*a + c*c*b;
+            start->AddDist(mean, cov);
+        }
+        int r = (int) len + 1;
+        for(int y = -r; y <= r; y++)
+        {
+            for(int x = -r; x <= r; x++)
+            {
+                double u = cos(th)*x + sin(th)*y;
+                double v = -sin(th)*x + cos(th)*y;
+                if(u*u/(len*len) + v*v/(width*width) < 1.0)
+                {
+                    blob->AddPoint(cvPoint((int) cx + x, (int) cy + y));
+                }
+            }
+        }
+    }
+    return blob;
+}
+
+void BINNED_TEST(int n_fish, double len, double width, int binsize,
+                 int seed, int* p_in_status)
+{
+    MixGaussians full;
+    RawBlobPtr blob = makeClump(n_fish, len, width, seed, &full);
+    int numpixels = blob->GetNumPixels();
+
+    MixGaussians binned = full;
+    binned.m_iBinSize = binsize;
+    binned.m_iBinMinPixels = 0;
+    binned.m_dBinTolerance = tolerance;
+
+    std::vector<int> alloc_full(numpixels);
+    std::vector<int> alloc_binned(numpixels);
+    full.EMMG(blob, alloc_full, 200);
+    binned.EMMG(blob, alloc_binned, 200);
+
+    std::vector<MT_Vector2> means_full(n_fish), means_binned(n_fish);
+    std::vector<MT_Matrix2x2> covs_full(n_fish), covs_binned(n_fish);
+    full.GetMeans(means_full);
+    binned.GetMeans(means_binned);
+    full.GetCovariances(covs_full);
+    binned.GetCovariances(covs_binned);
+
+    double max_d = 0;
+    double max_a = 0;
+    for(int i = 0; i < n_fish; i++)
+    {
+        max_d = MT_MAX(max_d, fabs(means_full[i].data[0] - means_binned[i].data[0]));
+        max_d = MT_MAX(max_d, fabs(means_full[i].data[1] - means_binned[i].data[1]));
+        double da = fabs(major_angle(covs_full[i]) - major_angle(covs_binned[i]));
+        max_a = MT_MAX(max_a, MT_MIN(da, 180.0 - da));
+    }
+
+    double bound = tolerance + full_convergence;
+    if(max_d > bound || max_a > bound)
+    {
+        *p_in_status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Binned EMMG too far from the full resolution fit");
+        fprintf(stderr, "    + %d fish, %d pixels, %dx%d bins:  "
+                "means %f px, angles %f deg\n",
+                n_fish, numpixels, binsize, binsize, max_d, max_a);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int status = MT_TEST_SUCCESS;
+
+    /**************************************************/
+    MT_TEST_START("Binned EMMG vs. full resolution");
+
+    for(int seed = 1; seed <= 5; seed++)
+    {
+        for(int binsize = 2; binsize <= 4; binsize *= 2)
+        {
+            BINNED_TEST(1, 60.0, 12.0, binsize, seed, &status);
+            BINNED_TEST(3, 60.0, 12.0, binsize, seed, &status);
+            BINNED_TEST(5, 90.0, 15.0, binsize, seed, &status);
+        }
+    }
+
+    /**************************************************/
+    MT_TEST_START("Binned EMMG allocation");
+
+    /* out of iterations while still binned:  the allocation still has
+     * to come from the pixels */
+    RawBlobPtr blob = makeClump(2, 40.0, 8.0, 7);
+    int numpixels = blob->GetNumPixels();
+    MixGaussians g;
+    g.CoverBox(2, blob->GetBoundingBox());
+    g.m_iBinSize = 4;
+    g.m_iBinMinPixels = 0;
+    std::vector<int> alloc(numpixels, -1);
+    g.EMMG(blob, alloc, 1);
+    int n_unallocated = 0;
+    for(int j = 0; j < numpixels; j++)
+    {
+        if(alloc[j] < 0 || alloc[j] > 3)
+        {
+            n_unallocated++;
+        }
+    }
+    if(n_unallocated > 0)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Bad pixel allocation after a binned-only fit");
+    }
+
+    return status;
+}
@@ -0,0 +1,157 @@
+#include <math.h>
+#include <vector>
+
+#include "MT_Test.h"
+
+#include "MT/MT_Core/support/mathsupport.h"
+#include "MT/MT_Tracking/trackers/GY/MixGaussians.h"
+#include "MT/MT_Tracking/trackers/GY/MixGaussiansBudget.h"
+
+/* Time budgets for EMMG:  MixGaussians::m_dDeadline stops a fit,
+ * which carries on where it left off when EMMG is called again, and
+ * MixGaussiansBudget sizes the first pass iteration caps to the time
+ * left. */
+
+/* n_fish ellipses side by side, tilted alternately */
+static RawBlobPtr makeClump(int n_fish)
+{
+    const double len = 12.0;
+    const double width = 3.0;
+    RawBlobPtr blob(new GYRawBlob(n_fish*(int) (4*len*width)));
+    for(int k = 0; k < n_fish; k++)
+    {
+        double cx = 300 + 2.5*width*k;
+        double cy = 300 + 0.5*len*(k % 2);
+        double th = M_PI/2 + ((k % 2) ? 0.15 : -0.15);
+        int r = (int) len + 1;
+        for(int y = -r; y <= r; y++)
+        {
+            for(int x = -r; x <= r; x++)
+            {
+                double u = cos(th)*x + sin(th)*y;
+                double v = -sin(th)*x + cos(th)*y;
+                if(u*u/(len*len) + v*v/(width*width) < 1.0)
+                {
+                    blob->AddPoint(cvPoint((int) cx + x, (int) cy + y));
+                }
+            }
+        }
+    }
+    return blob;
+}
+
+int main(int argc, char** argv)
+{
+    int status = MT_TEST_SUCCESS;
+
+    const int n_fish = 4;
+    const int max_iters = 200;
+    RawBlobPtr blob = makeClump(n_fish);
+    MixGaussiansAllocation alloc;
+
+    /**************************************************/
+    MT_TEST_START("EMMG stops at the deadline");
+
+    MixGaussians late;
+    late.CoverBox(n_fish, blob->GetBoundingBox());
+    late.m_dDeadline = MT_getTimeSec() - 1.0;
+    late.EMMG(blob, alloc, max_iters);
+    if(late.GetNumIterations() != 1 || late.GetConverged())
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Past deadline did not stop after one iteration");
+        fprintf(stderr, "    + %d iterations\n", late.GetNumIterations());
+    }
+    if(late.GetResidualChange() <= 1.0)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Residual change too small for an unconverged fit");
+    }
+
+    /**************************************************/
+    MT_TEST_START("Resumed EMMG matches an uninterrupted fit");
+
+    MixGaussians whole;
+    whole.CoverBox(n_fish, blob->GetBoundingBox());
+    whole.EMMG(blob, alloc, max_iters);
+
+    MixGaussians parts;
+    parts.CoverBox(n_fish, blob->GetBoundingBox());
+    parts.EMMG(blob, alloc, 3);
+    int iters = parts.GetNumIterations();
+    parts.EMMG(blob, alloc, max_iters - iters);
+    iters += parts.GetNumIterations();
+
+    std::vector<MT_Vector2> mw(n_fish), mp(n_fish);
+    whole.GetMeans(mw);
+    parts.GetMeans(mp);
+    double maxdiff = 0;
+    for(int i = 0; i < n_fish; i++)
+    {
+        maxdiff = MT_MAX(maxdiff, fabs(mw[i].data[0] - mp[i].data[0]));
+        maxdiff = MT_MAX(maxdiff, fabs(mw[i].data[1] - mp[i].data[1]));
+    }
+    if(iters != whole.GetNumIterations() || maxdiff > 1e-9
+       || parts.GetConverged() != whole.GetConverged())
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Resumed fit differs");
+        fprintf(stderr, "    + %d vs %d iterations, means differ by %g\n",
+                iters, whole.GetNumIterations(), maxdiff);
+    }
+
+    /**************************************************/
+    MT_TEST_START("MixGaussiansBudget iteration caps");
+
+    MixGaussiansBudget budget;
+    budget.StartFrame();
+    if(budget.IsActive() || budget.GetDeadline() > 0
+       || budget.FirstPassCap(1000, 1, 50) != 50)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("No budget should leave the cap alone");
+    }
+
+    /* 1 us per pixel x distribution x iteration and 10 ms:  half of
+     * it is 5 iterations of 1000 units on one thread */
+    budget.m_dBudget = 0.010;
+    budget.StartFrame();
+    if(budget.FirstPassCap(1000, 1, 50) != 50)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Cap set before any timing");
+    }
+    budget.AddTiming(1000, 10, 0.010);
+    int cap1 = budget.FirstPassCap(1000, 1, 50);
+    int cap4 = budget.FirstPassCap(1000, 4, 50);
+    if(cap1 < 1 || cap1 > 5 || cap4 < cap1 || cap4 > 20)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Wrong caps");
+        fprintf(stderr, "    + 1 thread %d, 4 threads %d\n", cap1, cap4);
+    }
+    if(budget.FirstPassCap(1000, 1, 2) > 2)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Cap above the limit");
+    }
+
+    budget.m_dBudget = 1e-9;
+    budget.StartFrame();
+    if(budget.FirstPassCap(1000, 1, 50) != 1 || budget.GetRemaining() > 0)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Spent budget should give one iteration");
+    }
+
+    budget.EndFrame(false);
+    budget.EndFrame(true);
+    budget.EndFrame(true);
+    if(budget.m_iNumFrames != 3 || budget.m_iNumDegradedFrames != 2)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Wrong frame counts");
+    }
+
+    return status;
+}
@@ -0,0 +1,175 @@
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+#include "MT_Test.h"
+
+#include "MT/MT_Tracking/trackers/GY/MixGaussians.h"
+
+/* Checks EMMG's pixel allocation for blobs made up of 1 to 64 fish,
+ * i.e. beyond the 31 distributions that fit in a bit pattern */
+
+const double fish_len = 10.0;
+const double fish_width = 3.0;
+
+/* a school of n_fish fish in rows of 8, neighbours touching so that
+ * they form one blob.  true_x and true_y get the fish centres and g
+ * gets a distribution close to each fish. */
+static RawBlobPtr makeSchool(int n_fish,
+                             std::vector<double>* true_x,
+                             std::vector<double>* true_y,
+                             MixGaussians* g)
+{
+    RawBlobPtr blob(new GYRawBlob(n_fish*(int) (4*fish_len*fish_width)));
+    true_x->resize(0);
+    true_y->resize(0);
+    g->ClearDists();
+    for(int k = 0; k < n_fish; k++)
+    {
+        int cx = 200 + (int) (2.0*fish_width)*(k % 8) + (k % 3)/2;
+        int cy = 200 + (int) (2.0*fish_len)*(k / 8) + (k % 8)/3;
+        true_x->push_back(cx);
+        true_y->push_back(cy);
+
+        MT_Vector2 mean;
+        MT_Matrix2x2 cov;
+        mean.data[0] = cx + 0.5;
+        mean.data[1] = cy - 0.5;
+        cov.data[0] = 0.25*fish_width*fish_width;
+        cov.data[1] = cov.data[2] = 0;
+        cov.data[3] = 0.25*fish_len*fish_len;
+        g->AddDist(mean, cov);
+
+        int r = (int) fish_len + 1;
+        for(int y = -r; y <= r; y++)
+        {
+            for(int x = -r; x <= r; x++)
+            {
+                if(x*x/(fish_width*fish_width) + y*y/(fish_len*fish_len) < 1.0)
+                {
+                    blob->AddPoint(cvPoint(cx + x, cy + y));
+                }
+            }
+        }
+    }
+    return blob;
+}
+
+void COMPONENTS_TEST(int n_fish, int* p_in_status)
+{
+    std::vector<double> true_x, true_y;
+    MixGaussians g;
+    RawBlobPtr blob = makeSchool(n_fish, &true_x, &true_y, &g);
+    int numpixels = blob->GetNumPixels();
+    MixGaussians g_bits = g;
+
+    MixGaussiansAllocation alloc;
+    g.EMMG(blob, alloc, 50);
+
+    if(alloc.GetNumPixels() != numpixels || g.GetNumDists() != n_fish)
+    {
+        *p_in_status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Wrong allocation size");
+        return;
+    }
+
+    /* every pixel belongs somewhere, to valid distributions listed in
+     * increasing order */
+    int n_bad = 0;
+    for(int j = 0; j < numpixels; j++)
+    {
+        const int* dists = alloc.GetDists(j);
+        if(alloc.GetNumDists(j) < 1)
+        {
+            n_bad++;
+        }
+        for(int d = 0; d < alloc.GetNumDists(j); d++)
+        {
+            if(dists[d] < 0 || dists[d] >= n_fish
+               || (d > 0 && dists[d] <= dists[d - 1]))
+            {
+                n_bad++;
+            }
+        }
+    }
+    if(n_bad > 0)
+    {
+        *p_in_status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Bad pixel allocation");
+        fprintf(stderr, "    + %d fish:  %d bad pixels\n", n_fish, n_bad);
+    }
+
+    /* each fish is found, and the pixel at its centre is allocated to it */
+    std::vector<MT_Vector2> means(n_fish);
+    g.GetMeans(means);
+    GYPixelView pixels = blob->GetPixelView();
+    int n_lost = 0;
+    for(int i = 0; i < n_fish; i++)
+    {
+        double dx = means[i].data[0] - true_x[i];
+        double dy = means[i].data[1] - true_y[i];
+        bool found = (dx*dx + dy*dy < 1.0);
+        for(int j = 0; j < numpixels; j++)
+        {
+            if(pixels.m_pX[j] == (int) true_x[i] && pixels.m_pY[j] == (int) true_y[i])
+            {
+                bool mine = false;
+                for(int d = 0; d < alloc.GetNumDists(j); d++)
+                {
+                    mine = mine || (alloc.GetDists(j)[d] == i);
+                }
+                found = found && mine;
+            }
+        }
+        if(!found)
+        {
+            n_lost++;
+        }
+    }
+    if(n_lost > 0)
+    {
+        *p_in_status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Fish not separated");
+        fprintf(stderr, "    + %d fish:  %d lost\n", n_fish, n_lost);
+    }
+
+    /* the bit pattern version agrees while it can */
+    if(n_fish <= 31)
+    {
+        std::vector<int> bits(numpixels);
+        g_bits.EMMG(blob, bits, 50);
+        int n_diff = 0;
+        for(int j = 0; j < numpixels; j++)
+        {
+            int b = 0;
+            for(int d = 0; d < alloc.GetNumDists(j); d++)
+            {
+                b |= (1 << alloc.GetDists(j)[d]);
+            }
+            if(b != bits[j])
+            {
+                n_diff++;
+            }
+        }
+        if(n_diff > 0)
+        {
+            *p_in_status = MT_TEST_ERROR;
+            MT_TEST_ERROR_MESSAGE("Bit pattern allocation differs");
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int status = MT_TEST_SUCCESS;
+
+    /**************************************************/
+    MT_TEST_START("EMMG pixel allocation, k = 1, 8, 32, 64");
+
+    COMPONENTS_TEST(1, &status);
+    COMPONENTS_TEST(8, &status);
+    COMPONENTS_TEST(32, &status);
+    COMPONENTS_TEST(64, &status);
+
+    return status;
+}
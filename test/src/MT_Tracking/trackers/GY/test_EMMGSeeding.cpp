@@ -0,0 +1,217 @@
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+#include "MT_Test.h"
+
+#include "MT/MT_Tracking/trackers/GY/MixGaussians.h"
+
+/* Compares the ways of starting EMMG on a clump of fish:  spread over
+ * the bounding box (MixGaussians::CoverBox), k-means++ seeds
+ * (SeedKMeansPP) and a warm start near the fish, as from a tracker's
+ * prediction.  The warm start and the seeds should need fewer
+ * iterations than the box, and the seeds should be repeatable. */
+
+const double fish_len = 12.0;
+const double fish_width = 3.0;
+
+/* fish next to each other at different angles.  Fills in the fish
+ * centres and angles. */
+static RawBlobPtr makeClump(int n_fish, int seed,
+                            std::vector<double>* xs,
+                            std::vector<double>* ys,
+                            std::vector<double>* ths)
+{
+    srand(seed);
+    RawBlobPtr blob(new GYRawBlob(n_fish*(int) (4*fish_len*fish_width)));
+    xs->resize(0);
+    ys->resize(0);
+    ths->resize(0);
+    for(int k = 0; k < n_fish; k++)
+    {
+        double cx = 300 + 2.5*fish_width*k;
+        double cy = 300 + 0.5*fish_len*(k % 2);
+        double th = M_PI/2 + 0.4*(((double) rand())/RAND_MAX - 0.5);
+        xs->push_back(cx);
+        ys->push_back(cy);
+        ths->push_back(th);
+        int r = (int) fish_len + 1;
+        for(int y = -r; y <= r; y++)
+        {
+            for(int x = -r; x <= r; x++)
+            {
+                double u = cos(th)*x + sin(th)*y;
+                double v = -sin(th)*x + cos(th)*y;
+                if(u*u/(fish_len*fish_len) + v*v/(fish_width*fish_width) < 1.0)
+                {
+                    blob->AddPoint(cvPoint((int) cx + x, (int) cy + y));
+                }
+            }
+        }
+    }
+    return blob;
+}
+
+/* the covariance of a fish at angle th */
+static MT_Matrix2x2 fishCovariance(double th)
+{
+    double s1 = 0.25*fish_len*fish_len;
+    double s2 = 0.25*fish_width*fish_width;
+    double c = cos(th);
+    double s = sin(th);
+    MT_Matrix2x2 cov;
+    cov.data[0] = s1*c*c + s2*s*s;
+    cov.data[1] = cov.data[2] = (s1 - s2)*c*s;
+    cov.data[3] = s1*s*s + s2*c*c;
+    return cov;
+}
+
+/* number of fish with a mean within a pixel */
+static int numFound(MixGaussians* g,
+                    const std::vector<double>& xs,
+                    const std::vector<double>& ys)
+{
+    std::vector<MT_Vector2> means(g->GetNumDists());
+    g->GetMeans(means);
+    int n = 0;
+    for(unsigned int k = 0; k < xs.size(); k++)
+    {
+        for(unsigned int i = 0; i < means.size(); i++)
+        {
+            double dx = means[i].data[0] - xs[k];
+            double dy = means[i].data[1] - ys[k];
+            if(dx*dx + dy*dy < 1.0)
+            {
+                n++;
+                break;
+            }
+        }
+    }
+    return n;
+}
+
+int main(int argc, char** argv)
+{
+    int status = MT_TEST_SUCCESS;
+
+    const int n_trials = 10;
+    const int max_iters = 200;
+    std::vector<double> xs, ys, ths;
+    MixGaussiansAllocation alloc;
+
+    /**************************************************/
+    MT_TEST_START("k-means++ seeds are repeatable");
+
+    RawBlobPtr blob = makeClump(4, 1, &xs, &ys, &ths);
+    MixGaussians a, b;
+    a.SeedKMeansPP(4, blob, 7);
+    b.SeedKMeansPP(4, blob, 7);
+    std::vector<MT_Vector2> ma(4), mb(4);
+    a.GetMeans(ma);
+    b.GetMeans(mb);
+    for(int i = 0; i < 4; i++)
+    {
+        if(ma[i].data[0] != mb[i].data[0] || ma[i].data[1] != mb[i].data[1])
+        {
+            status = MT_TEST_ERROR;
+            MT_TEST_ERROR_MESSAGE("Same seed gave different distributions");
+            break;
+        }
+    }
+
+    /* existing distributions count as centres:  adding to a good
+     * guess for three of the fish should put the new one on the
+     * fourth, whatever the seed */
+    MT_Vector2 mean;
+    std::vector<MT_Vector2> mc(4);
+    int n_missed = 0;
+    for(unsigned int seed = 1; seed <= 20; seed++)
+    {
+        MixGaussians c;
+        for(int k = 0; k < 3; k++)
+        {
+            mean.data[0] = xs[k];
+            mean.data[1] = ys[k];
+            c.AddDist(mean, fishCovariance(ths[k]));
+        }
+        c.SeedKMeansPP(1, blob, seed);
+        c.GetMeans(mc);
+        if(c.GetNumDists() != 4
+           || fabs(mc[3].data[0] - xs[3]) > fish_width
+           || fabs(mc[3].data[1] - ys[3]) > fish_len)
+        {
+            n_missed++;
+        }
+    }
+    if(n_missed > 0)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Added seed not on the remaining fish");
+        fprintf(stderr, "    + missed %d of 20 times\n", n_missed);
+    }
+
+    /**************************************************/
+    MT_TEST_START("EMMG iterations by initialization");
+
+    int iters_box = 0, iters_seeded = 0, iters_warm = 0;
+    int found_box = 0, found_seeded = 0, found_warm = 0;
+    int n_fish_total = 0;
+    for(int t = 0; t < n_trials; t++)
+    {
+        int n_fish = 2 + t % 4;
+        n_fish_total += n_fish;
+        blob = makeClump(n_fish, t + 1, &xs, &ys, &ths);
+
+        MixGaussians box;
+        box.CoverBox(n_fish, blob->GetBoundingBox());
+        box.EMMG(blob, alloc, max_iters);
+        iters_box += box.GetNumIterations();
+        found_box += numFound(&box, xs, ys);
+
+        MixGaussians seeded;
+        seeded.SeedKMeansPP(n_fish, blob, t + 1);
+        seeded.EMMG(blob, alloc, max_iters);
+        iters_seeded += seeded.GetNumIterations();
+        found_seeded += numFound(&seeded, xs, ys);
+
+        /* predictions a couple of pixels off */
+        MixGaussians warm;
+        for(int k = 0; k < n_fish; k++)
+        {
+            mean.data[0] = xs[k] + 1.5;
+            mean.data[1] = ys[k] - 1.5;
+            warm.AddDist(mean, fishCovariance(ths[k] + 0.1));
+        }
+        warm.EMMG(blob, alloc, max_iters);
+        iters_warm += warm.GetNumIterations();
+        found_warm += numFound(&warm, xs, ys);
+        if(!warm.GetConverged())
+        {
+            status = MT_TEST_ERROR;
+            MT_TEST_ERROR_MESSAGE("Warm start did not converge");
+        }
+    }
+
+    printf("  Iterations (fish found of %d):  box %d (%d), k-means++ %d (%d), "
+           "warm %d (%d)\n", n_fish_total,
+           iters_box, found_box, iters_seeded, found_seeded,
+           iters_warm, found_warm);
+
+    if(found_warm != n_fish_total)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Warm start lost fish");
+    }
+    if(iters_warm >= iters_box || iters_seeded >= iters_box)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Warm start or seeds no faster than the box");
+    }
+    if(found_seeded < found_box)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Seeds found fewer fish than the box");
+    }
+
+    return status;
+}
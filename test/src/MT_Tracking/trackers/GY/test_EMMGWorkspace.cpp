@@ -0,0 +1,162 @@
+#include <stdlib.h>
+#include <math.h>
+#include <new>
+#include <vector>
+
+#include "MT_Test.h"
+
+#include "MT/MT_Tracking/trackers/GY/MixGaussians.h"
+
+/* Checks that repeated EMMG runs sharing a MixGaussiansWorkspace stop
+ * allocating once the workspace has seen the biggest blob, and that
+ * the results don't depend on the workspace.
+ *
+ * Heap traffic is counted by replacing the global operator new. */
+
+static int g_iNumAllocs = 0;
+
+#if __cplusplus >= 201103L
+#define NEW_THROWS
+#define DELETE_THROWS noexcept
+#else
+#define NEW_THROWS throw(std::bad_alloc)
+#define DELETE_THROWS throw()
+#endif
+
+void* operator new(size_t size) NEW_THROWS
+{
+    g_iNumAllocs++;
+    void* p = malloc(size ? size : 1);
+    if(!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size) NEW_THROWS
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) DELETE_THROWS
+{
+    free(p);
+}
+
+void operator delete[](void* p) DELETE_THROWS
+{
+    free(p);
+}
+
+const int n_frames = 60;
+const int n_warmup_frames = 20;
+const int n_clumps = 4;
+
+/* One frame of a "video":  n_clumps clumps of 2 to 5 fish swimming
+ * back and forth, so the blob sizes repeat every 20 frames. */
+static std::vector<RawBlobPtr> makeFrame(int frame, std::vector<int>* fish_per_clump)
+{
+    std::vector<RawBlobPtr> blobs(0);
+    fish_per_clump->resize(0);
+    for(int c = 0; c < n_clumps; c++)
+    {
+        int n_fish = 2 + c;
+        double phase = 2.0*M_PI*((double) (frame % 20))/20.0;
+        RawBlobPtr blob(new GYRawBlob(n_fish*300));
+        for(int k = 0; k < n_fish; k++)
+        {
+            double cx = 100.0 + 200.0*c + 9.0*k + 5.0*sin(phase + k);
+            double cy = 100.0 + 3.0*(k % 3) + 5.0*cos(phase);
+            double th = 0.3*k + 0.2*sin(phase);
+            double len = 18.0 + 2.0*sin(phase + c);
+            for(int y = -30; y <= 30; y++)
+            {
+                for(int x = -30; x <= 30; x++)
+                {
+                    double u = cos(th)*x + sin(th)*y;
+                    double v = -sin(th)*x + cos(th)*y;
+                    if(u*u/(len*len) + v*v/(4.0*4.0) < 1.0)
+                    {
+                        blob->AddPoint(cvPoint((int) cx + x, (int) cy + y));
+                    }
+                }
+            }
+        }
+        blobs.push_back(blob);
+        fish_per_clump->push_back(n_fish);
+    }
+    return blobs;
+}
+
+int main(int argc, char** argv)
+{
+    int status = MT_TEST_SUCCESS;
+
+    /**************************************************/
+    MT_TEST_START("MixGaussians workspace reuse");
+
+    MixGaussiansWorkspace workspace;
+    int steady_allocs = 0;
+    bool same = true;
+
+    for(int frame = 0; frame < n_frames; frame++)
+    {
+        std::vector<int> fish_per_clump;
+        std::vector<RawBlobPtr> blobs = makeFrame(frame, &fish_per_clump);
+
+        for(unsigned int b = 0; b < blobs.size(); b++)
+        {
+            /* everything but the EM itself is set up outside of the
+             * counted region */
+            MixGaussians shared;
+            MixGaussians fresh;
+            shared.CoverBox(fish_per_clump[b], blobs[b]->GetBoundingBox());
+            fresh.CoverBox(fish_per_clump[b], blobs[b]->GetBoundingBox());
+            shared.setWorkspace(&workspace);
+            std::vector<int> alloc_shared(blobs[b]->GetNumPixels());
+            std::vector<int> alloc_fresh(blobs[b]->GetNumPixels());
+            std::vector<MT_Vector2> means_shared(shared.GetNumDists());
+            std::vector<MT_Vector2> means_fresh(fresh.GetNumDists());
+
+            int before = g_iNumAllocs;
+            shared.EMMG(blobs[b], alloc_shared, 20);
+            if(frame >= n_warmup_frames)
+            {
+                steady_allocs += g_iNumAllocs - before;
+            }
+
+            fresh.EMMG(blobs[b], alloc_fresh, 20);
+
+            shared.GetMeans(means_shared);
+            fresh.GetMeans(means_fresh);
+            for(unsigned int i = 0; i < means_shared.size(); i++)
+            {
+                if(means_shared[i].data[0] != means_fresh[i].data[0]
+                   || means_shared[i].data[1] != means_fresh[i].data[1])
+                {
+                    same = false;
+                }
+            }
+            if(alloc_shared != alloc_fresh)
+            {
+                same = false;
+            }
+        }
+    }
+
+    printf("  %d allocations in EMMG after %d warm-up frames\n",
+           steady_allocs, n_warmup_frames);
+    if(steady_allocs != 0)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("EMMG allocated memory in steady state");
+    }
+    if(!same)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Shared workspace changed the EMMG results");
+    }
+
+    return status;
+}
@@ -0,0 +1,145 @@
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+#include "MT_Test.h"
+
+#include "MT/MT_Tracking/trackers/GY/MixGaussiansEStep.h"
+
+/* Checks GYEStepFloat against GYEStepDouble to within the tolerances
+ * documented in MixGaussiansEStep.h */
+
+const double pls_tol = 5e-5;
+const double pus_tol = 1e-5;
+const double ps_tol = 1e-4;
+const double ps_floor = 1e-30;
+const double ps_normal = 1e-300;
+
+static double urand(double a, double b)
+{
+    return a + (b - a)*((double) rand())/((double) RAND_MAX);
+}
+
+static double rel_err(double a, double b)
+{
+    return fabs(a - b)/MT_MAX(fabs(b), 1.0);
+}
+
+void ESTEP_TEST(int numdists, int numpixels, double spread, int* p_in_status)
+{
+    std::vector<MT_Vector2> means(numdists);
+    std::vector<MT_Matrix2x2> covs(numdists);
+
+    /* a cluster of distributions somewhere in a 4096x4096 frame */
+    double cx = urand(100, 3996);
+    double cy = urand(100, 3996);
+    for(int i = 0; i < numdists; i++)
+    {
+        means[i].data[0] = cx + urand(-30, 30);
+        means[i].data[1] = cy + urand(-30, 30);
+        double s1 = urand(0.5, 15);
+        double s2 = urand(0.5, 15);
+        double th = urand(0, M_PI);
+        double c = cos(th);
+        double s = sin(th);
+        covs[i].data[0] = c*c*s1*s1 + s*s*s2*s2;
+        covs[i].data[1] = covs[i].data[2] = c*s*(s1*s1 - s2*s2);
+        covs[i].data[3] = s*s*s1*s1 + c*c*s2*s2;
+    }
+
+    /* pixels around the cluster, some of them far away */
+    std::vector<GYPixelCoord> xs(numpixels);
+    std::vector<GYPixelCoord> ys(numpixels);
+    for(int j = 0; j < numpixels; j++)
+    {
+        xs[j] = (GYPixelCoord) floor(cx + urand(-spread, spread));
+        ys[j] = (GYPixelCoord) floor(cy + urand(-spread, spread));
+    }
+
+    int n = numdists*numpixels;
+    std::vector<double> pus_d(n), ps_d(n), pls_d(n), total(numpixels);
+    std::vector<double> pus_f(n), ps_f(n), pls_f(n);
+    std::vector<float> scratch(GYEStepScratchSize(numdists));
+
+    GYEStepDouble(&xs[0], &ys[0], numpixels, means, covs,
+                  &pus_d[0], &ps_d[0], &pls_d[0], &total[0]);
+    if(!GYEStepFloat(&xs[0], &ys[0], numpixels, means, covs,
+                     &pus_f[0], &ps_f[0], &pls_f[0], &scratch[0]))
+    {
+        *p_in_status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("GYEStepFloat refused valid distributions");
+        return;
+    }
+
+    /* pixels so far out that the largest double density is denormal
+     * (more than ~37 standard deviations) can't be compared */
+    std::vector<bool> compare(numpixels, false);
+    for(int k = 0; k < n; k++)
+    {
+        if(ps_d[k] > ps_normal)
+        {
+            compare[k % numpixels] = true;
+        }
+    }
+
+    double max_pls = 0, max_pus = 0, max_ps = 0;
+    for(int k = 0; k < n; k++)
+    {
+        if(compare[k % numpixels])
+        {
+            max_pls = MT_MAX(max_pls, fabs(pls_f[k] - pls_d[k]));
+        }
+        max_pus = MT_MAX(max_pus, rel_err(pus_f[k], pus_d[k]));
+        if(ps_d[k] > ps_floor)
+        {
+            max_ps = MT_MAX(max_ps, fabs(ps_f[k] - ps_d[k])/ps_d[k]);
+        }
+    }
+
+    if(max_pls > pls_tol || max_pus > pus_tol || max_ps > ps_tol)
+    {
+        *p_in_status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Single precision E-step out of tolerance");
+        fprintf(stderr, "    + %d dists, %d pixels, spread %f:  "
+                "pls %g, pus %g, ps %g\n",
+                numdists, numpixels, spread, max_pls, max_pus, max_ps);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int status = MT_TEST_SUCCESS;
+
+    /**************************************************/
+    MT_TEST_START("GYEStepFloat vs. GYEStepDouble");
+    printf("  Using the %s E-step\n", GYEStepBackend());
+
+    srand(4321);
+    for(int trial = 0; trial < 200; trial++)
+    {
+        int numdists = 1 + rand() % 8;
+        /* odd sizes exercise the partial last block */
+        int numpixels = 1 + rand() % 700;
+        double spread = (trial % 4 == 0) ? 150.0 : 40.0;
+        ESTEP_TEST(numdists, numpixels, spread, &status);
+    }
+
+    /**************************************************/
+    MT_TEST_START("GYEStepFloat bad covariance");
+
+    std::vector<MT_Vector2> means(1);
+    std::vector<MT_Matrix2x2> covs(1);
+    means[0].data[0] = means[0].data[1] = 10;
+    covs[0].data[0] = covs[0].data[3] = 1;
+    covs[0].data[1] = covs[0].data[2] = 2;
+    GYPixelCoord x = 10;
+    double pu, p, pl;
+    std::vector<float> scratch(GYEStepScratchSize(1));
+    if(GYEStepFloat(&x, &x, 1, means, covs, &pu, &p, &pl, &scratch[0]))
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("GYEStepFloat accepted a singular covariance");
+    }
+
+    return status;
+}
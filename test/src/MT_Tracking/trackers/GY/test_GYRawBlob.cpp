@@ -0,0 +1,256 @@
+#include <stdlib.h>
+#include <stddef.h>
+#include <math.h>
+#include <vector>
+
+#include "MT_Test.h"
+
+#include "MT/MT_Tracking/trackers/GY/GYBlobs.h"
+
+/* Checks that GYRawBlob keeps its pixels as int16 x and y arrays
+ * that GYPixelBuffer packs into one aligned, contiguous block, and
+ * that packing doesn't change anything measured from the pixels. */
+
+/* what a blob should have, from its pixels */
+struct Expected
+{
+    std::vector<CvPoint> pixels;
+    CvRect box;
+    double x;
+    double y;
+    double xx;
+    double xy;
+    double yy;
+};
+
+static RawBlobPtr makeBlob(int n, int x0, int y0, Expected* e)
+{
+    RawBlobPtr b(new GYRawBlob(n));
+    e->pixels.resize(0);
+    int xmin = 0, xmax = 0, ymin = 0, ymax = 0;
+    for(int k = 0; k < n; k++)
+    {
+        /* a ragged patch, with coordinates beyond 8 bits */
+        CvPoint p = cvPoint(x0 + (k % 13) + rand() % 3, y0 + k/13);
+        b->AddPoint(p);
+        e->pixels.push_back(p);
+        if(k == 0)
+        {
+            xmin = xmax = p.x;
+            ymin = ymax = p.y;
+        }
+        xmin = (p.x < xmin) ? p.x : xmin;
+        xmax = (p.x > xmax) ? p.x : xmax;
+        ymin = (p.y < ymin) ? p.y : ymin;
+        ymax = (p.y > ymax) ? p.y : ymax;
+    }
+    e->box = (n > 0) ? cvRect(xmin, ymin, xmax - xmin + 1, ymax - ymin + 1) : cvRect(0, 0, 0, 0);
+    e->x = b->GetXCentre();
+    e->y = b->GetYCentre();
+    e->xx = b->GetXXMoment();
+    e->xy = b->GetXYMoment();
+    e->yy = b->GetYYMoment();
+    return b;
+}
+
+/* number of mistakes in b compared to e */
+static int checkBlob(GYRawBlob* b, const Expected& e)
+{
+    int n_bad = 0;
+    int n = e.pixels.size();
+    if(b->GetNumPixels() != n)
+    {
+        return 1;
+    }
+
+    GYPixelView v = b->GetPixelView();
+    if(v.m_iNumPixels != n || (n == 0 && (v.m_pX || v.m_pY)))
+    {
+        n_bad++;
+    }
+    for(int k = 0; k < n && v.m_pX && v.m_pY; k++)
+    {
+        if(v.m_pX[k] != e.pixels[k].x || v.m_pY[k] != e.pixels[k].y)
+        {
+            n_bad++;
+        }
+    }
+
+    std::vector<CvPoint> list(n);
+    b->GetPixelList(list);
+    for(int k = 0; k < n; k++)
+    {
+        if(list[k].x != e.pixels[k].x || list[k].y != e.pixels[k].y)
+        {
+            n_bad++;
+        }
+    }
+
+    CvRect r = b->GetBoundingBox();
+    if(r.x != e.box.x || r.y != e.box.y || r.width != e.box.width || r.height != e.box.height)
+    {
+        n_bad++;
+    }
+    if(b->GetXCentre() != e.x || b->GetYCentre() != e.y
+       || b->GetXXMoment() != e.xx || b->GetXYMoment() != e.xy
+       || b->GetYYMoment() != e.yy)
+    {
+        n_bad++;
+    }
+    return n_bad;
+}
+
+int main(int argc, char** argv)
+{
+    int status = MT_TEST_SUCCESS;
+    srand(1);
+
+    /* sizes around the alignment, an empty blob and a big one */
+    const int sizes[] = {0, 1, 7, 8, 9, 300, 2000};
+    const int n_blobs = sizeof(sizes)/sizeof(sizes[0]);
+
+    std::vector<RawBlobPtr> blobs(n_blobs);
+    std::vector<Expected> expected(n_blobs);
+    for(int i = 0; i < n_blobs; i++)
+    {
+        blobs[i] = makeBlob(sizes[i], 100*i + 300, 1500 - 150*i, &expected[i]);
+    }
+
+    /**************************************************/
+    MT_TEST_START("GYRawBlob pixels before packing");
+
+    int n_bad = 0;
+    if(sizeof(GYPixelCoord) != 2)
+    {
+        n_bad++;
+    }
+    for(int i = 0; i < n_blobs; i++)
+    {
+        n_bad += checkBlob(blobs[i].get(), expected[i]);
+        if(blobs[i]->GetPixelView().m_bPadded)
+        {
+            n_bad++;
+        }
+    }
+    if(n_bad)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Blob pixels or measurements wrong");
+        fprintf(stderr, "    + %d mistakes\n", n_bad);
+    }
+
+    /**************************************************/
+    MT_TEST_START("GYPixelBuffer packing");
+
+    /* all the x arrays one after the other, each aligned and padded
+     * with zeros to GY_PIXEL_ALIGN entries, then the y arrays */
+    GYPixelBuffer buffer;
+    buffer.Pack(blobs);
+    n_bad = 0;
+    const GYPixelCoord* next_x = NULL;
+    const GYPixelCoord* next_y = NULL;
+    const GYPixelCoord* last_x = NULL;
+    const GYPixelCoord* first_y = NULL;
+    for(int i = 0; i < n_blobs; i++)
+    {
+        n_bad += checkBlob(blobs[i].get(), expected[i]);
+        GYPixelView v = blobs[i]->GetPixelView();
+        if(!v.m_bPadded)
+        {
+            n_bad++;
+        }
+        int n = v.m_iNumPixels;
+        if(n == 0)
+        {
+            continue;
+        }
+        int padded = GY_PIXEL_ALIGN*((n + GY_PIXEL_ALIGN - 1)/GY_PIXEL_ALIGN);
+        if(((size_t) v.m_pX) % (GY_PIXEL_ALIGN*sizeof(GYPixelCoord))
+           || ((size_t) v.m_pY) % (GY_PIXEL_ALIGN*sizeof(GYPixelCoord)))
+        {
+            n_bad++;
+        }
+        if((next_x && v.m_pX != next_x) || (next_y && v.m_pY != next_y))
+        {
+            n_bad++;
+        }
+        for(int k = n; k < padded; k++)
+        {
+            if(v.m_pX[k] != 0 || v.m_pY[k] != 0)
+            {
+                n_bad++;
+            }
+        }
+        next_x = v.m_pX + padded;
+        next_y = v.m_pY + padded;
+        last_x = next_x;
+        first_y = first_y ? first_y : v.m_pY;
+    }
+    if(last_x != first_y)
+    {
+        n_bad++;
+    }
+    if(n_bad)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Packed pixels wrong or not laid out in one block");
+        fprintf(stderr, "    + %d mistakes\n", n_bad);
+    }
+
+    /**************************************************/
+    MT_TEST_START("GYRawBlob after packing");
+
+    /* adding a pixel takes the blob's pixels back out of the buffer,
+     * and packing again (e.g. the next frame) reuses the buffer */
+    n_bad = 0;
+    CvPoint extra = cvPoint(4000, 10);
+    blobs[3]->AddPoint(extra);
+    expected[3].pixels.push_back(extra);
+    if(blobs[3]->GetPixelView().m_bPadded)
+    {
+        n_bad++;
+    }
+    if(blobs[3]->GetNumPixels() != sizes[3] + 1
+       || blobs[3]->GetPixelView().m_pX[sizes[3]] != extra.x
+       || blobs[3]->GetPixelView().m_pY[sizes[3]] != extra.y)
+    {
+        n_bad++;
+    }
+    for(int i = 0; i < n_blobs; i++)
+    {
+        if(i == 3)
+        {
+            continue;
+        }
+        n_bad += checkBlob(blobs[i].get(), expected[i]);
+    }
+
+    std::vector<RawBlobPtr> again(blobs.rbegin(), blobs.rend());
+    /* a blob listed twice is only packed once */
+    again.push_back(blobs[5]);
+    buffer.Pack(again);
+    for(int i = 0; i < n_blobs; i++)
+    {
+        if(i == 3)
+        {
+            if(blobs[i]->GetNumPixels() != sizes[3] + 1)
+            {
+                n_bad++;
+            }
+            continue;
+        }
+        n_bad += checkBlob(blobs[i].get(), expected[i]);
+        if(sizes[i] > 0 && !blobs[i]->GetPixelView().m_bPadded)
+        {
+            n_bad++;
+        }
+    }
+    if(n_bad)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Blob pixels wrong after unpacking or repacking");
+        fprintf(stderr, "    + %d mistakes\n", n_bad);
+    }
+
+    return status;
+}
@@ -0,0 +1,341 @@
+#include <math.h>
+#include <vector>
+
+#include "MT_Test.h"
+
+#include "MT/MT_Tracking/trackers/GY/GYSegmenter.h"
+#include "MT/MT_Tracking/base/MT_TrackerPipeline.h"
+#include "MT/MT_Tracking/base/MT_ChunkedTracker.h"
+
+/* GYSegmenter run on drawn frames:  dark disks moving over a white
+ * background, which is also the frame the tracker is made with. */
+
+const int width = 200;
+const int height = 200;
+const int radius = 5;
+
+typedef std::vector<std::vector<double> > Rows;
+
+/* for looking at the search windows */
+class GYSegmenterTester : public GYSegmenter
+{
+public:
+    GYSegmenterTester(IplImage* frame) : GYSegmenter(frame) {};
+
+    void usePredictedWindows(int rescan_tiles)
+    {
+        m_bUsePredictedWindows = true;
+        m_iRescanTiles = rescan_tiles;
+    };
+    const std::vector<CvRect>& getTrackWindows() const {return m_vTrackWindows;};
+    const std::vector<CvRect>& getSearchWindows() const {return m_vSearchWindows;};
+    CvRect getRescanBand() const {return m_RescanTile;};
+    std::vector<RawBlobPtr>& getRawBlobs() {return m_RawBlobData;};
+};
+
+static int rectArea(const CvRect& r)
+{
+    return r.width*r.height;
+}
+
+static void drawFrame(IplImage* frame,
+                      const std::vector<double>& xs,
+                      const std::vector<double>& ys)
+{
+    cvSet(frame, cvScalarAll(255));
+    for(unsigned int k = 0; k < xs.size(); k++)
+    {
+        cvCircle(frame, cvPoint((int) xs[k], (int) ys[k]), radius,
+                 cvScalarAll(0), CV_FILLED);
+    }
+}
+
+/* the object at (x, y), -1 if none is within a pixel */
+static int whichObject(double x, double y,
+                       const std::vector<double>& xs,
+                       const std::vector<double>& ys)
+{
+    for(unsigned int k = 0; k < xs.size(); k++)
+    {
+        double dx = x - xs[k];
+        double dy = y - ys[k];
+        if(dx*dx + dy*dy < 1.0)
+        {
+            return k;
+        }
+    }
+    return -1;
+}
+
+int main(int argc, char** argv)
+{
+    int status = MT_TEST_SUCCESS;
+
+    IplImage* frame = cvCreateImage(cvSize(width, height), IPL_DEPTH_8U, 1);
+    std::vector<double> xs(3), ys(3);
+
+    /**************************************************/
+    MT_TEST_START("GYSegmenter pipeline data in track order");
+
+    /* Blobs are found top to bottom, so with objects 0 and 2 passing
+     * each other vertically the order of the blobs changes, but each
+     * tracked object should stay with its object. */
+    cvSet(frame, cvScalarAll(255));
+    GYSegmenter* tracker = new GYSegmenter(frame);
+    tracker->setNumObjects(3);
+
+    MT_TrackerPipelineFrame pf;
+    pf.m_pFrame = cvCloneImage(frame);
+    std::vector<int> track_object;
+    Rows rows;
+    int n_frames = 60;
+    int n_reordered = 0;
+    int n_bad = 0;
+    for(int f = 0; f < n_frames; f++)
+    {
+        xs[0] = 40;   ys[0] = 40 + 2*f;
+        xs[1] = 100;  ys[1] = 100;
+        xs[2] = 160;  ys[2] = 160 - 2*f;
+        drawFrame(pf.m_pFrame, xs, ys);
+        pf.m_iNumber = f;
+
+        tracker->doPipelinePreprocess(&pf);
+        tracker->doPipelineTrack(&pf);
+
+        /* the blobs as found */
+        const Rows& data = pf.m_vvdData;
+        if(data.size() < 2 || data[0].size() != 3)
+        {
+            n_bad++;
+            break;
+        }
+        for(unsigned int j = 0; j < data[0].size(); j++)
+        {
+            if(whichObject(data[0][j], data[1][j], xs, ys) != (int) j)
+            {
+                n_reordered++;
+                break;
+            }
+        }
+
+        MT_ChunkedTracker::getTrackOrderedData(pf, 0, 3, &rows);
+        for(unsigned int j = 0; j < rows[0].size(); j++)
+        {
+            int k = whichObject(rows[0][j], rows[1][j], xs, ys);
+            if(f == 0)
+            {
+                track_object.push_back(k);
+            }
+            if(k < 0 || k != track_object[j])
+            {
+                n_bad++;
+            }
+        }
+    }
+    delete tracker;
+
+    if(n_reordered == 0)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("The blobs were always found in the same order");
+    }
+    if(n_bad)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Tracked objects didn't follow the objects");
+        fprintf(stderr, "    + %d mistakes in %d frames\n", n_bad, n_frames);
+    }
+
+    /* the rest on a bigger frame, with three objects whose search
+     * windows are well apart */
+    const int big = 400;
+    IplImage* big_frame = cvCreateImage(cvSize(big, big), IPL_DEPTH_8U, 1);
+    cvSet(big_frame, cvScalarAll(255));
+
+    /**************************************************/
+    MT_TEST_START("GYSegmenter predicted search windows");
+
+    /* Object 1 moves right at constant speed, so from the third frame
+     * on each track's window should be centred on where its object is
+     * now rather than where it was, and the moving one's should be
+     * stretched along its motion.  Only the windows are searched. */
+    const double speed = 6;
+    MT_TrackerPipelineFrame wf;
+    wf.m_pFrame = cvCloneImage(big_frame);
+    GYSegmenterTester* windower = new GYSegmenterTester(big_frame);
+    windower->setNumObjects(3);
+    windower->usePredictedWindows(0);
+
+    xs.assign(3, 0);
+    ys.assign(3, 0);
+    n_bad = 0;
+    for(int f = 0; f < 20; f++)
+    {
+        xs[0] = 70;               ys[0] = 70;
+        xs[1] = 110 + speed*f;    ys[1] = 200;
+        xs[2] = 330;              ys[2] = 330;
+        drawFrame(wf.m_pFrame, xs, ys);
+        wf.m_iNumber = f;
+        windower->doPipelinePreprocess(&wf);
+        windower->doPipelineTrack(&wf);
+        if(f < 2)
+        {
+            continue;
+        }
+
+        const std::vector<CvRect>& tw = windower->getTrackWindows();
+        const std::vector<CvRect>& sw = windower->getSearchWindows();
+        if(tw.size() != 3 || sw.size() != 3)
+        {
+            n_bad++;
+            continue;
+        }
+        std::vector<int> seen(3, 0);
+        for(unsigned int j = 0; j < tw.size(); j++)
+        {
+            double cx = tw[j].x + 0.5*(tw[j].width - 1);
+            double cy = tw[j].y + 0.5*(tw[j].height - 1);
+            int k = -1;
+            for(unsigned int o = 0; o < xs.size(); o++)
+            {
+                if(fabs(cx - xs[o]) <= 1.0 && fabs(cy - ys[o]) <= 1.0)
+                {
+                    k = o;
+                }
+            }
+            if(k < 0 || seen[k]++
+               || (k == 1 && tw[j].width <= tw[j].height)
+               || (k != 1 && tw[j].width != tw[j].height))
+            {
+                n_bad++;
+            }
+        }
+        int area = 0;
+        for(unsigned int k = 0; k < sw.size(); k++)
+        {
+            area += rectArea(sw[k]);
+        }
+        if(2*area > big*big)
+        {
+            n_bad++;
+        }
+    }
+    delete windower;
+
+    if(n_bad)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Search windows not around the predicted positions");
+        fprintf(stderr, "    + %d mistakes\n", n_bad);
+    }
+
+    /**************************************************/
+    MT_TEST_START("GYSegmenter rescan cost and delay");
+
+    /* Each frame the band should add at most one band's worth of
+     * area to the search windows, even where it runs into one, and
+     * the bands of any tiles frames in a row should cover the frame.
+     * An object appearing away from the others should be found by
+     * the band within tiles frames. */
+    const int tiles = 10;
+    const int max_band = big*((big + tiles - 1)/tiles + 2*RT_RESCAN_OVERLAP);
+    MT_TrackerPipelineFrame rf;
+    rf.m_pFrame = cvCloneImage(big_frame);
+    GYSegmenterTester* rescanner = new GYSegmenterTester(big_frame);
+    rescanner->setNumObjects(3);
+    rescanner->usePredictedWindows(tiles);
+
+    xs.assign(3, 0);
+    ys.assign(3, 0);
+    xs[0] = 70;   ys[0] = 70;
+    xs[1] = 200;  ys[1] = 200;
+    xs[2] = 330;  ys[2] = 330;
+    const int f_new = 12;
+    const double x_new = 330, y_new = 200;
+    int f_found = -1;
+    int max_extra = 0;
+    std::vector<int> row_seen(big, -1);
+    n_bad = 0;
+    for(int f = 0; f < f_new + tiles + 2 && f_found < 0; f++)
+    {
+        if(f == f_new)
+        {
+            xs.push_back(x_new);
+            ys.push_back(y_new);
+        }
+        drawFrame(rf.m_pFrame, xs, ys);
+        rf.m_iNumber = f;
+        rescanner->doPipelinePreprocess(&rf);
+        rescanner->doPipelineTrack(&rf);
+        if(f == 0)
+        {
+            /* full frame, no windows yet */
+            continue;
+        }
+
+        const std::vector<CvRect>& tw = rescanner->getTrackWindows();
+        const std::vector<CvRect>& sw = rescanner->getSearchWindows();
+        CvRect band = rescanner->getRescanBand();
+        int extra = rectArea(band);
+        for(unsigned int k = 0; k < sw.size(); k++)
+        {
+            extra += rectArea(sw[k]);
+        }
+        for(unsigned int k = 0; k < tw.size(); k++)
+        {
+            extra -= rectArea(tw[k]);
+        }
+        max_extra = MT_MAX(max_extra, extra);
+        if(tw.size() != 3 || extra > max_band)
+        {
+            n_bad++;
+        }
+        for(int y = band.y; y < band.y + band.height; y++)
+        {
+            row_seen[y] = f;
+        }
+        /* every row searched in the last tiles frames */
+        if(f >= tiles)
+        {
+            for(int y = 0; y < big; y++)
+            {
+                if(row_seen[y] <= f - tiles)
+                {
+                    n_bad++;
+                    break;
+                }
+            }
+        }
+
+        std::vector<RawBlobPtr>& raw = rescanner->getRawBlobs();
+        for(unsigned int k = 0; k < raw.size(); k++)
+        {
+            double dx = raw[k]->GetXCentre() - x_new;
+            double dy = raw[k]->GetYCentre() - y_new;
+            if(dx*dx + dy*dy < 1.0)
+            {
+                f_found = f;
+            }
+        }
+    }
+    delete rescanner;
+
+    if(n_bad)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("Rescan band cost more than one band or missed rows");
+        fprintf(stderr, "    + %d mistakes, at most %d px added (%d allowed)\n",
+                n_bad, max_extra, max_band);
+    }
+    if(f_found < f_new || f_found >= f_new + tiles)
+    {
+        status = MT_TEST_ERROR;
+        MT_TEST_ERROR_MESSAGE("New object not found within one rescan cycle");
+        fprintf(stderr, "    + appeared in frame %d, found in frame %d\n", f_new, f_found);
+    }
+
+    cvReleaseImage(&big_frame);
+    cvReleaseImage(&frame);
+
+    return status;
+}
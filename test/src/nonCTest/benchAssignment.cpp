@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+#include "MT_Test.h"
+
+#include "MT/MT_Core/support/mathsupport.h"
+#include "MT/MT_Tracking/cv/MT_HungarianMatcher.h"
+
+/* Benchmark of frame-to-frame matching with MT_HungarianMatcher,
+ * solving each frame from scratch (MT_HM_LAPJV) vs warm started from
+ * the previous frame (MT_HM_LAPJV_WARM).  Also checks that both give
+ * the same total.
+ *
+ * Runs on synthetic objects moving about at random and, if a file is
+ * given, on the tracks in a sample data file (e.g.
+ * testdata/sample_4fish.dat:  one line per object per frame, object
+ * index in the first column and x, y in the third and fourth, objects
+ * one after the other).
+ *
+ * Usage: benchAssignment [number of objects] [number of frames]
+ *                        [sample data file]  */
+
+const int default_n_objects = 300;
+const int default_n_frames = 200;
+const double field_size = 1000.0;
+
+static double randomUniform(double a, double b)
+{
+    return a + (b - a)*((double) rand())/RAND_MAX;
+}
+
+/* positions[f][j] of object j in frame f */
+typedef std::vector<std::vector<double> > Positions;
+
+static void makeSynthetic(int n_objects, int n_frames, Positions* xs, Positions* ys)
+{
+    std::vector<double> x(n_objects), y(n_objects), vx(n_objects), vy(n_objects);
+    for(int j = 0; j < n_objects; j++)
+    {
+        x[j] = randomUniform(0, field_size);
+        y[j] = randomUniform(0, field_size);
+        vx[j] = randomUniform(-2, 2);
+        vy[j] = randomUniform(-2, 2);
+    }
+    xs->resize(n_frames);
+    ys->resize(n_frames);
+    for(int f = 0; f < n_frames; f++)
+    {
+        for(int j = 0; j < n_objects; j++)
+        {
+            vx[j] = 0.9*vx[j] + randomUniform(-0.5, 0.5);
+            vy[j] = 0.9*vy[j] + randomUniform(-0.5, 0.5);
+            x[j] += vx[j];
+            y[j] += vy[j];
+        }
+        (*xs)[f] = x;
+        (*ys)[f] = y;
+    }
+}
+
+static bool readSample(const char* filename, Positions* xs, Positions* ys)
+{
+    FILE* fp = fopen(filename, "r");
+    if(!fp)
+    {
+        fprintf(stderr, "Could not open %s\n", filename);
+        return false;
+    }
+    std::vector<std::vector<double> > ox, oy;
+    char line[1024];
+    double id, t, x, y;
+    while(fgets(line, sizeof(line), fp))
+    {
+        if(sscanf(line, "%lf %lf %lf %lf", &id, &t, &x, &y) != 4 || id < 0)
+        {
+            continue;
+        }
+        unsigned int j = (unsigned int) id;
+        if(j >= ox.size())
+        {
+            ox.resize(j + 1);
+            oy.resize(j + 1);
+        }
+        ox[j].push_back(x);
+        oy[j].push_back(y);
+    }
+    fclose(fp);
+
+    unsigned int n_frames = ox.size() ? ox[0].size() : 0;
+    for(unsigned int j = 1; j < ox.size(); j++)
+    {
+        n_frames = MT_MIN(n_frames, ox[j].size());
+    }
+    xs->resize(n_frames);
+    ys->resize(n_frames);
+    for(unsigned int f = 0; f < n_frames; f++)
+    {
+        (*xs)[f].resize(ox.size());
+        (*ys)[f].resize(ox.size());
+        for(unsigned int j = 0; j < ox.size(); j++)
+        {
+            (*xs)[f][j] = ox[j][f];
+            (*ys)[f][j] = oy[j][f];
+        }
+    }
+    return n_frames > 1;
+}
+
+/* matches the (shuffled, noisy) detections of each frame to the
+ * objects' positions in the frame before, the way a tracker would */
+static void runMatching(const char* name,
+                        const Positions& xs,
+                        const Positions& ys,
+                        int n_repeats)
+{
+    int n = xs[0].size();
+    int n_frames = xs.size();
+    MT_HungarianMatcher cold, warm;
+    cold.doInit(n, MT_HM_SAME, HUNGARIAN_MIN, MT_HM_LAPJV);
+    warm.doInit(n, MT_HM_SAME, HUNGARIAN_MIN, MT_HM_LAPJV_WARM);
+
+    std::vector<int> order(n), a_c(n), a_w(n);
+    std::vector<double> c(n*n);
+    for(int i = 0; i < n; i++)
+    {
+        order[i] = i;
+    }
+
+    double t0;
+    double t_cold = 0;
+    double t_warm = 0;
+    int n_bad = 0;
+    for(int r = 0; r < n_repeats; r++)
+    {
+        for(int f = 1; f < n_frames; f++)
+        {
+            std::random_shuffle(order.begin(), order.end());
+            for(int i = 0; i < n; i++)
+            {
+                double x = xs[f][order[i]] + randomUniform(-0.5, 0.5);
+                double y = ys[f][order[i]] + randomUniform(-0.5, 0.5);
+                for(int j = 0; j < n; j++)
+                {
+                    double dx = x - xs[f - 1][j];
+                    double dy = y - ys[f - 1][j];
+                    c[i*n + j] = dx*dx + dy*dy;
+                    cold.setValue(i, j, c[i*n + j]);
+                    warm.setValue(i, j, c[i*n + j]);
+                }
+            }
+
+            t0 = MT_getTimeSec();
+            cold.doMatch(&a_c);
+            t_cold += MT_getTimeSec() - t0;
+
+            t0 = MT_getTimeSec();
+            warm.doMatch(&a_w);
+            t_warm += MT_getTimeSec() - t0;
+
+            double tc = 0;
+            double tw = 0;
+            for(int i = 0; i < n; i++)
+            {
+                tc += c[i*n + a_c[i]];
+                tw += c[i*n + a_w[i]];
+            }
+            if(fabs(tc - tw) > 1e-9*(1.0 + tc))
+            {
+                n_bad++;
+            }
+        }
+    }
+
+    int n_solves = n_repeats*(n_frames - 1);
+    printf("  %s:  %d objects, %d frames\n", name, n, n_solves);
+    printf("    from scratch:  %8.3f us per frame\n", 1e6*t_cold/n_solves);
+    printf("    warm started:  %8.3f us per frame\n", 1e6*t_warm/n_solves);
+    if(t_warm > 0)
+    {
+        printf("    Speedup: %4.2fx\n", t_cold/t_warm);
+    }
+    if(n_bad)
+    {
+        MT_TEST_ERROR_MESSAGE("Warm started totals differ");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int n_objects = default_n_objects;
+    int n_frames = default_n_frames;
+    if(argc > 1)
+    {
+        sscanf(argv[1], "%d", &n_objects);
+    }
+    if(argc > 2)
+    {
+        sscanf(argv[2], "%d", &n_frames);
+    }
+
+    MT_TEST_START("Frame-to-frame assignment benchmark");
+    srand(1);
+
+    Positions xs, ys;
+    makeSynthetic(n_objects, n_frames, &xs, &ys);
+    runMatching("Synthetic", xs, ys, 1);
+
+    if(argc > 3)
+    {
+        if(readSample(argv[3], &xs, &ys))
+        {
+            /* few objects, so go through it a number of times */
+            runMatching(argv[3], xs, ys, 20);
+        }
+        else
+        {
+            return MT_TEST_ERROR;
+        }
+    }
+
+    return MT_TEST_SUCCESS;
+}
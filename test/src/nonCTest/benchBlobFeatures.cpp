@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+
+#include "MT_Test.h"
+
+#include "MT/MT_Core/support/mathsupport.h"
+#include "MT/MT_Tracking/cv/MT_BlobExtras.h"
+
+/* Benchmark comparing the copying Filter + one GetSTLResult per
+ * feature (the way SimpleBWTracker used to work) to FilterInPlace +
+ * MT_GetBlobFeatures.  Also checks that both give the same features.
+ *
+ * Usage: benchBlobFeatures [blobs per side] [number of trials]  */
+
+const int default_blobs_per_side = 25;  /* 625 blobs */
+const int default_n_trials = 20;
+const int blob_spacing = 24;
+
+static bool sameVectors(const std::vector<double>& a,
+                        const std::vector<double>& b)
+{
+    if(a.size() != b.size())
+    {
+        return false;
+    }
+    for(unsigned int i = 0; i < a.size(); i++)
+    {
+        if(a[i] != b[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    int blobs_per_side = default_blobs_per_side;
+    int n_trials = default_n_trials;
+    if(argc > 1)
+    {
+        sscanf(argv[1], "%d", &blobs_per_side);
+    }
+    if(argc > 2)
+    {
+        sscanf(argv[2], "%d", &n_trials);
+    }
+
+    MT_TEST_START("blob feature extraction benchmark");
+
+    /* an image full of small fish-ish ellipses with varying size and
+     * orientation */
+    int side = blobs_per_side*blob_spacing;
+    IplImage* frame = cvCreateImage(cvSize(side, side), IPL_DEPTH_8U, 1);
+    cvZero(frame);
+    for(int i = 0; i < blobs_per_side; i++)
+    {
+        for(int j = 0; j < blobs_per_side; j++)
+        {
+            CvPoint c = cvPoint(i*blob_spacing + blob_spacing/2,
+                                j*blob_spacing + blob_spacing/2);
+            cvEllipse(frame, c,
+                      cvSize(4 + (i + j) % 6, 2 + (i*j) % 3),
+                      (double) (17*i + 29*j), 0, 360,
+                      cvScalarAll(255), CV_FILLED);
+        }
+    }
+
+    CBlobResult all_blobs(frame, NULL, 0);
+    printf("  Found %d blobs in a %dx%d frame\n",
+           all_blobs.GetNumBlobs(), side, side);
+
+    double min_area = 10.0;
+    double max_area = 1000.0;
+    double bad_x = 0.5*((double) side) + 0.5;
+
+    CBlobGetArea get_area;
+    CBlobGetPerimeter get_perimeter;
+    CBlobGetXCenter get_xcenter;
+    MT_CBlobGetXCenterOfMass get_x;
+    MT_CBlobGetYCenterOfMass get_y;
+    MT_CBlobGetHeadOrientation get_orientation;
+
+    std::vector<double> X, Y, P, A, O;
+    MT_BlobFeatures features;
+
+    double t_copy = 0;
+    double t_inplace = 0;
+    double t0;
+    int status = MT_TEST_SUCCESS;
+
+    for(int k = 0; k < n_trials; k++)
+    {
+        /* copying filter, one pass per feature */
+        CBlobResult r1(all_blobs);
+        CBlobResult f1, f2, f3;
+        t0 = MT_getTimeSec();
+        r1.Filter(f1, B_INCLUDE, &get_area, B_GREATER, min_area);
+        f1.Filter(f2, B_INCLUDE, &get_area, B_LESS, max_area);
+        f2.Filter(f3, B_EXCLUDE, &get_xcenter, B_EQUAL, bad_x);
+        X = f3.GetSTLResult(&get_x);
+        Y = f3.GetSTLResult(&get_y);
+        P = f3.GetSTLResult(&get_perimeter);
+        A = f3.GetSTLResult(&get_area);
+        O = f3.GetSTLResult(&get_orientation);
+        t_copy += MT_getTimeSec() - t0;
+
+        /* in-place filter, single pass */
+        CBlobResult r2(all_blobs);
+        t0 = MT_getTimeSec();
+        r2.FilterInPlace(B_INCLUDE, &get_area, B_GREATER, min_area);
+        r2.FilterInPlace(B_INCLUDE, &get_area, B_LESS, max_area);
+        r2.FilterInPlace(B_EXCLUDE, &get_xcenter, B_EQUAL, bad_x);
+        MT_GetBlobFeatures(r2,
+                           &features,
+                           MT_BLOB_FEATURE_XY
+                           | MT_BLOB_FEATURE_AREA
+                           | MT_BLOB_FEATURE_PERIMETER
+                           | MT_BLOB_FEATURE_ORIENTATION);
+        t_inplace += MT_getTimeSec() - t0;
+
+        if(k == 0)
+        {
+            if(f3.GetNumBlobs() != r2.GetNumBlobs()
+               || !sameVectors(X, features.m_vdX)
+               || !sameVectors(Y, features.m_vdY)
+               || !sameVectors(P, features.m_vdPerimeter)
+               || !sameVectors(A, features.m_vdArea)
+               || !sameVectors(O, features.m_vdOrientation))
+            {
+                MT_TEST_ERROR_MESSAGE("Single-pass features differ from GetSTLResult");
+                status = MT_TEST_ERROR;
+            }
+        }
+    }
+
+    printf("  %d trials, %d blobs after filtering\n",
+           n_trials, features.m_iNBlobs);
+    printf("  Filter + GetSTLResult:              %8.3f ms/frame\n",
+           1000.0*t_copy/((double) n_trials));
+    printf("  FilterInPlace + MT_GetBlobFeatures: %8.3f ms/frame\n",
+           1000.0*t_inplace/((double) n_trials));
+    if(t_inplace > 0)
+    {
+        printf("  Speedup: %4.2fx\n", t_copy/t_inplace);
+    }
+
+    cvReleaseImage(&frame);
+
+    return status;
+}
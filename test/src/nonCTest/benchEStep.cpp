@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+#include "MT_Test.h"
+
+#include "MT/MT_Core/support/mathsupport.h"
+#include "MT/MT_Tracking/trackers/GY/MixGaussians.h"
+#include "MT/MT_Tracking/trackers/GY/MixGaussiansEStep.h"
+
+/* Benchmark of the double and single precision EMMG E-steps, on their
+ * own and as part of a full EMMG fit of a clump of fish.
+ *
+ * Usage: benchEStep [number of fish] [number of trials]  */
+
+const int default_n_fish = 6;
+const int default_n_trials = 200;
+
+/* a clump of elongated fish next to each other */
+static RawBlobPtr makeClump(int n_fish)
+{
+    RawBlobPtr blob(new GYRawBlob(n_fish*300));
+    for(int k = 0; k < n_fish; k++)
+    {
+        double cx = 500.0 + 9.0*k;
+        double cy = 400.0 + 3.0*(k % 3);
+        double th = 0.3*k;
+        for(int y = -30; y <= 30; y++)
+        {
+            for(int x = -30; x <= 30; x++)
+            {
+                double u = cos(th)*x + sin(th)*y;
+                double v = -sin(th)*x + cos(th)*y;
+                if(u*u/(20.0*20.0) + v*v/(4.0*4.0) < 1.0)
+                {
+                    blob->AddPoint(cvPoint((int) cx + x, (int) cy + y));
+                }
+            }
+        }
+    }
+    return blob;
+}
+
+int main(int argc, char** argv)
+{
+    int n_fish = default_n_fish;
+    int n_trials = default_n_trials;
+    if(argc > 1)
+    {
+        sscanf(argv[1], "%d", &n_fish);
+    }
+    if(argc > 2)
+    {
+        sscanf(argv[2], "%d", &n_trials);
+    }
+
+    MT_TEST_START("EMMG E-step benchmark");
+    printf("  Single precision E-step uses %s\n", GYEStepBackend());
+
+    RawBlobPtr blob = makeClump(n_fish);
+    GYPixelView pixels = blob->GetPixelView();
+    int numpixels = pixels.m_iNumPixels;
+    printf("  %d fish, %d pixels\n", n_fish, numpixels);
+
+    MixGaussians start;
+    start.CoverBox(n_fish, blob->GetBoundingBox());
+    std::vector<MT_Vector2> means(n_fish);
+    std::vector<MT_Matrix2x2> covs(n_fish);
+    start.GetMeans(means);
+    start.GetCovariances(covs);
+
+    int n = n_fish*numpixels;
+    std::vector<double> pus(n), ps(n), pls(n), total(numpixels);
+    std::vector<float> scratch(GYEStepScratchSize(n_fish));
+
+    double t0;
+    double t_double = 0;
+    double t_float = 0;
+    for(int k = 0; k < n_trials; k++)
+    {
+        t0 = MT_getTimeSec();
+        GYEStepDouble(pixels.m_pX, pixels.m_pY, numpixels, means, covs,
+                      &pus[0], &ps[0], &pls[0], &total[0]);
+        t_double += MT_getTimeSec() - t0;
+
+        t0 = MT_getTimeSec();
+        GYEStepFloat(pixels.m_pX, pixels.m_pY, numpixels, means, covs,
+                     &pus[0], &ps[0], &pls[0], &scratch[0]);
+        t_float += MT_getTimeSec() - t0;
+    }
+
+    printf("  E-step, double:             %8.3f us\n",
+           1e6*t_double/((double) n_trials));
+    printf("  E-step, single:             %8.3f us\n",
+           1e6*t_float/((double) n_trials));
+    if(t_float > 0)
+    {
+        printf("  Speedup: %4.2fx\n", t_double/t_float);
+    }
+
+    /* whole EMMG fits, 10 iterations each */
+    std::vector<int> alloc(numpixels);
+    t_double = t_float = 0;
+    int n_fits = MT_MAX(1, n_trials/10);
+    for(int k = 0; k < n_fits; k++)
+    {
+        MixGaussians d;
+        d.CoverBox(n_fish, blob->GetBoundingBox());
+        d.m_bUseSinglePrecision = false;
+        t0 = MT_getTimeSec();
+        d.EMMG(blob, alloc, 10);
+        t_double += MT_getTimeSec() - t0;
+
+        MixGaussians f;
+        f.CoverBox(n_fish, blob->GetBoundingBox());
+        f.m_bUseSinglePrecision = true;
+        t0 = MT_getTimeSec();
+        f.EMMG(blob, alloc, 10);
+        t_float += MT_getTimeSec() - t0;
+    }
+
+    printf("  EMMG, double E-step:        %8.3f ms\n",
+           1e3*t_double/((double) n_fits));
+    printf("  EMMG, single E-step:        %8.3f ms\n",
+           1e3*t_float/((double) n_fits));
+    if(t_float > 0)
+    {
+        printf("  Speedup: %4.2fx\n", t_double/t_float);
+    }
+
+    return MT_TEST_SUCCESS;
+}